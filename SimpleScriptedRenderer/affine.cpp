@@ -0,0 +1,47 @@
+#include "affine.hpp"
+
+affine affine_identity()
+{
+  affine ret;
+  ret.rows[0] = { 1.0f, 0.0f, 0.0f, 0.0f };
+  ret.rows[1] = { 0.0f, 1.0f, 0.0f, 0.0f };
+  ret.rows[2] = { 0.0f, 0.0f, 1.0f, 0.0f };
+  return ret;
+}
+
+affine affine_from_trs(glm::vec3 const& t, glm::quat const& r, glm::vec3 const& s)
+{
+  // Columns of the rotation scaled per axis, written as rows.
+  affine ret;
+  ret.rows[0] = { s.x * 2.0f * (r.x * r.x + r.w * r.w - 0.5f), s.y * 2.0f * (r.y * r.x - r.z * r.w),
+                  s.z * 2.0f * (r.z * r.x + r.y * r.w), t.x };
+  ret.rows[1] = { s.x * 2.0f * (r.x * r.y + r.z * r.w), s.y * 2.0f * (r.y * r.y + r.w * r.w - 0.5f),
+                  s.z * 2.0f * (r.z * r.y - r.x * r.w), t.y };
+  ret.rows[2] = { s.x * 2.0f * (r.x * r.z - r.y * r.w), s.y * 2.0f * (r.y * r.z + r.x * r.w),
+                  s.z * 2.0f * (r.z * r.z + r.w * r.w - 0.5f), t.z };
+  return ret;
+}
+
+affine affine_mul(affine const& a, affine const& b)
+{
+  // Row i of the product is a combination of rows of b, plus translation of a.
+  affine ret;
+  for (u32 i = 0; i < 3; i++)
+  {
+    const glm::vec4& r = a.rows[i];
+    ret.rows[i] = r.x * b.rows[0] + r.y * b.rows[1] + r.z * b.rows[2];
+    ret.rows[i].w += r.w;
+  }
+  return ret;
+}
+
+glm::vec3 affine_transform_point(affine const& a, glm::vec3 const& p)
+{
+  const glm::vec4 v = { p, 1.0f };
+  return { glm::dot(a.rows[0], v), glm::dot(a.rows[1], v), glm::dot(a.rows[2], v) };
+}
+
+glm::mat4x4 affine_to_mat4(affine const& a)
+{
+  return glm::transpose(glm::mat4x4{ a.rows[0], a.rows[1], a.rows[2], glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f } });
+}
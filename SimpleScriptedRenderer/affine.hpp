@@ -0,0 +1,25 @@
+#pragma once
+#include "my_glm.hpp"
+#include "types.hpp"
+
+// Affine transform stored as the top three rows of a 4x4 matrix, the last row is always (0, 0, 0, 1).
+// Rows hold translation in w, so a row is a plane equation and a point transforms with three dot products.
+// Layout matches float4 local_to_world[3] in shaders.
+struct affine
+{
+  glm::vec4 rows[3];
+};
+
+affine affine_identity();
+// Same matrix as transform::local_to_world(): scale, then rotation, then translation.
+affine affine_from_trs(glm::vec3 const& t, glm::quat const& r, glm::vec3 const& s);
+// Applies b, then a.
+affine affine_mul(affine const& a, affine const& b);
+glm::vec3 affine_transform_point(affine const& a, glm::vec3 const& p);
+
+inline glm::vec3 affine_translation(affine const& a)
+{
+  return { a.rows[0].w, a.rows[1].w, a.rows[2].w };
+}
+
+glm::mat4x4 affine_to_mat4(affine const& a);
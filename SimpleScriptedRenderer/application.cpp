@@ -1,24 +1,42 @@
+#include <float.h>
+#include <stddef.h>
 #include <SDL.h>
 #include <SDL_syswm.h>
-#pragma warning(push)
-#pragma warning(disable: 4201)
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
-#include <glm/gtc/quaternion.hpp>
-#pragma warning(pop)
 
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_dx11.h"
 
 #include "application.hpp"
+#include "affine.hpp"
+#include "bvh.hpp"
+#include "capture.hpp"
+#include "cooked_mesh.hpp"
+#include "culling.hpp"
+#include "frame_graph.hpp"
 #include "object_pool.hpp"
 #include "hash_map.hpp"
+#include "jobs.hpp"
+#include "lod.hpp"
+#include "mesh.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_registry.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlet.hpp"
+#include "my_glm.hpp"
+#include "occlusion.hpp"
+#include "range_allocator.hpp"
+#include "render_commands.hpp"
+#include "scene.hpp"
+#include "scripting.hpp"
+#include "upload_ring.hpp"
 #include "ring_buffer.hpp"
 #include "static_string.hpp"
 #include "static_vector.hpp"
 #include "shader_bytecodes.h"
+#include "soft_renderer.hpp"
 #include "vector.hpp"
+#include "vertex.hpp"
 
 // TODO: invent scripting support. Think about structure of engine API.
 //  Store it in a table.
@@ -196,170 +214,358 @@ struct script_system
   lua_State* L = nullptr;
 };
 
-// All mesh-related data.
-// Vertex-index buffers for IA stage.
-// AABB for frustum culling.
-struct vertex_data
+// BEGIN: Mesh data
+
+// Shared vertex and index buffers of all meshes.
+// Meshes are ranges in them, so draws of different meshes differ only in offsets.
+
+static constexpr u32 MESH_ARENA_VERTEX_COUNT = 1u << 20;
+static constexpr u32 MESH_ARENA_INDEX_COUNT = 4u << 20;
+
+struct mesh_arena
 {
-  com_ptr<ID3D11Buffer> data;
-  u32 index_data_offset;
-  u32 index_count;
-  glm::vec3 aabb_center;
-  glm::vec3 aabb_extent;
+  // Vertices are stored in this format, VERTEX_FORMAT_*.
+  u32 format = VERTEX_FORMAT_FLOAT;
+  com_ptr<ID3D11Buffer> vertices;
+  // Bound with 16 or 32-bit format, depending on the mesh.
+  com_ptr<ID3D11Buffer> indices;
+  range_allocator vertex_ranges;
+  // Counts 32-bit slots.
+  range_allocator index_ranges;
 };
 
-// Vertex description.
-// Should include:
-//  Position, normal, tangent (binormal inferred). Common for many meshes.
-//  UV channels (texture coordinates, morph displacements). Optional.
-//  Blend weights + blend indices (for skeletal meshes). Required for skeletal meshes.
-// Preferably in separate buffers/separate parts of buffers.
-struct vertex
+static mesh_arena g_mesh_arena;
+
+// Capture of renderer commands for offline replay, see capture.hpp.
+// Buffers are identified in the capture by these ids.
+
+static constexpr u32 CAPTURE_BUFFER_VERTICES = 0;
+static constexpr u32 CAPTURE_BUFFER_INDICES = 1;
+static constexpr u32 CAPTURE_BUFFER_SCENE_CONSTANTS = 2;
+static command_capture g_capture;
+static i32 g_capture_frames = 60;
+// Frames still to be captured, capture is running while non-zero.
+static u32 g_capture_frames_left = 0;
+static u32 g_capture_frame = 0;
+
+static void create_mesh_arena_vertices(d3d11_renderer& renderer)
 {
-  glm::vec3 position;
-  glm::vec3 normal;
-};
+  D3D11_BUFFER_DESC desc = {};
+  desc.ByteWidth = MESH_ARENA_VERTEX_COUNT * vertex_format_size(g_mesh_arena.format);
+  desc.Usage = D3D11_USAGE_DEFAULT;
+  desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+  HRESULT hr = renderer.device->CreateBuffer(&desc, nullptr, g_mesh_arena.vertices.ReleaseAndGetAddressOf());
+  my_assert(SUCCEEDED(hr));
+}
 
-// TODO: Skeleton + skeleton pose.
+static void create_mesh_arena(d3d11_renderer& renderer)
+{
+  HRESULT hr;
 
-// BEGIN: Mesh data
+  create_mesh_arena_vertices(renderer);
 
-static vertex_data create_vertex_data(d3d11_renderer& renderer, vector<vertex> const& vertices, vector<u32> const& indices)
+  D3D11_BUFFER_DESC desc = {};
+  desc.ByteWidth = MESH_ARENA_INDEX_COUNT * sizeof(u32);
+  desc.Usage = D3D11_USAGE_DEFAULT;
+  desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+  hr = renderer.device->CreateBuffer(&desc, nullptr, g_mesh_arena.indices.ReleaseAndGetAddressOf());
+  my_assert(SUCCEEDED(hr));
+
+  g_mesh_arena.vertex_ranges.init(MESH_ARENA_VERTEX_COUNT);
+  g_mesh_arena.index_ranges.init(MESH_ARENA_INDEX_COUNT);
+}
+
+static void destroy_mesh_arena()
 {
-  vertex_data ret;
-  const u32 vertex_array_size = vertices.size() * sizeof(vertices[0]);
-  const u32 index_array_size = indices.size() * sizeof(indices[0]);
+  g_mesh_arena.indices.Reset();
+  g_mesh_arena.vertices.Reset();
+}
 
-  char* buffer_data = new char[vertex_array_size + index_array_size];
-  memcpy(buffer_data, vertices.data(), vertex_array_size);
-  memcpy(buffer_data + vertex_array_size, indices.data(), index_array_size);
-  ret.index_data_offset = vertex_array_size;
-  ret.index_count = indices.size();
+static void upload_to_buffer(d3d11_renderer& renderer, ID3D11Buffer* buffer, u32 byte_offset, void const* data, u32 size)
+{
+  D3D11_BOX box = {};
+  box.left = byte_offset;
+  box.right = byte_offset + size;
+  box.bottom = 1;
+  box.back = 1;
+  renderer.ctx->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+  if (g_capture_frames_left > 0)
+  {
+    const u32 id = buffer == g_mesh_arena.vertices.Get() ? CAPTURE_BUFFER_VERTICES : CAPTURE_BUFFER_INDICES;
+    my_assert(buffer == g_mesh_arena.vertices.Get() || buffer == g_mesh_arena.indices.Get());
+    g_capture.upload(id, byte_offset, data, size);
+  }
+}
 
-  glm::vec3 aabb_min = vertices[0].position;
-  glm::vec3 aabb_max = vertices[0].position;
-  for (u32 i = 0; i < vertices.size(); i++)
+// Encodes vertices of all levels in the arena format and uploads them at the vertex offset of the mesh.
+static void upload_vertices(d3d11_renderer& renderer, vertex_data& vd)
+{
+  const u32 format = g_mesh_arena.format;
+  const u32 size = vd.vertex_count * vertex_format_size(format);
+  vector<u8> encoded;
+  encoded.resize(size, 0);
+  encode_vertices(vertices_of(vd), vd.vertex_count, format, vd.quantization, encoded.data());
+  vd.encoding_error = measure_encoding_error(vertices_of(vd), vd.vertex_count, format, vd.quantization,
+                                             encoded.data());
+  upload_to_buffer(renderer, g_mesh_arena.vertices.Get(), vd.vertex_offset * vertex_format_size(format),
+                   encoded.data(), size);
+}
+
+// Allocates arena ranges and moves levels into them.
+// Returns false and allocates nothing if the arena has no room for the mesh.
+static bool place_vertex_data(vertex_data& vd)
+{
+  vd.vertex_offset = g_mesh_arena.vertex_ranges.allocate(vd.vertex_count);
+  if (vd.vertex_offset == range_allocator::INVALID_OFFSET)
+    return false;
+  vd.index_offset = g_mesh_arena.index_ranges.allocate(index_slot_count(vd));
+  if (vd.index_offset == range_allocator::INVALID_OFFSET)
   {
-    aabb_min = glm::min(aabb_min, vertices[i].position);
-    aabb_max = glm::max(aabb_max, vertices[i].position);
+    g_mesh_arena.vertex_ranges.release(vd.vertex_offset, vd.vertex_count);
+    return false;
   }
-  ret.aabb_center = 0.5f * (aabb_max + aabb_min);
-  ret.aabb_extent = 0.5f * (aabb_max - aabb_min);
+  const u32 indices_per_slot = 4 / vd.index_size;
+  for (u32 i = 0; i < vd.lod_count; i++)
+  {
+    vd.lods[i].first_index += vd.index_offset * indices_per_slot;
+    vd.lods[i].base_vertex += (i32)vd.vertex_offset;
+  }
+  return true;
+}
 
+// Returns false if the arena is full, out is left without ranges then.
+static bool create_vertex_data(d3d11_renderer& renderer, mesh_lod const* lods, u32 lod_count, vertex_data& out)
+{
+  vertex_data ret = make_vertex_data(lods, lod_count);
+  if (place_vertex_data(ret) == false)
+    return false;
+
+  vector<u16> indices_16;
+  for (u32 i = 0; i < lod_count; i++)
   {
-    HRESULT hr;
+    const mesh_lod& lod = lods[i];
+    const vertex_data_lod& l = ret.lods[i];
+    if (ret.index_size == 2)
+    {
+      indices_16.clear();
+      for (u32 j = 0; j < lod.indices.size(); j++)
+        indices_16.push_back((u16)lod.indices[j]);
+      upload_to_buffer(renderer, g_mesh_arena.indices.Get(), l.first_index * sizeof(u16),
+                       indices_16.data(), indices_16.size() * sizeof(u16));
+    }
+    else
+    {
+      upload_to_buffer(renderer, g_mesh_arena.indices.Get(), l.first_index * sizeof(u32),
+                       lod.indices.data(), lod.indices.size() * sizeof(u32));
+    }
+  }
+  upload_vertices(renderer, ret);
+  out = util::move(ret);
+  return true;
+}
 
-    D3D11_BUFFER_DESC desc = {};
-    desc.ByteWidth = vertex_array_size + index_array_size;
-    desc.Usage = D3D11_USAGE_IMMUTABLE;
-    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER;
+// Streams of a cooked mesh are laid out like the arena, they are uploaded from the mapping as they are.
+static bool create_vertex_data(d3d11_renderer& renderer, cooked_mesh const& mesh, vertex_data& out)
+{
+  vertex_data ret = make_vertex_data(mesh);
+  if (place_vertex_data(ret) == false)
+    return false;
+  upload_to_buffer(renderer, g_mesh_arena.indices.Get(), ret.index_offset * sizeof(u32), mesh.indices,
+                   ret.index_count * ret.index_size);
+  if (g_mesh_arena.format == VERTEX_FORMAT_FLOAT)
+  {
+    ret.encoding_error = {};
+    upload_to_buffer(renderer, g_mesh_arena.vertices.Get(), ret.vertex_offset * (u32)sizeof(vertex), mesh.vertices,
+                     ret.vertex_count * (u32)sizeof(vertex));
+  }
+  else
+  {
+    upload_vertices(renderer, ret);
+  }
+  out = util::move(ret);
+  return true;
+}
+
+static void destroy_vertex_data(vertex_data& vd)
+{
+  // Slots of released meshes and of meshes which didn't fit hold no ranges.
+  if (vd.vertex_count == 0)
+    return;
+  g_mesh_arena.vertex_ranges.release(vd.vertex_offset, vd.vertex_count);
+  g_mesh_arena.index_ranges.release(vd.index_offset, index_slot_count(vd));
+  vd.vertex_count = 0;
+  vd.index_count = 0;
+}
 
-    D3D11_SUBRESOURCE_DATA initial_data = {};
-    initial_data.pSysMem = buffer_data;
-    hr = renderer.device->CreateBuffer(&desc, &initial_data, ret.data.ReleaseAndGetAddressOf());
+// Moves copy through a temporary buffer, source and destination ranges may overlap.
+static void apply_arena_moves(d3d11_renderer& renderer, ID3D11Buffer* buffer, u32 bind_flags, u32 element_size,
+                              vector<range_allocator::range_move> const& moves)
+{
+  for (u32 i = 0; i < moves.size(); i++)
+  {
+    const range_allocator::range_move& m = moves[i];
+    com_ptr<ID3D11Buffer> temp;
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = m.count * element_size;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = bind_flags;
+    HRESULT hr = renderer.device->CreateBuffer(&desc, nullptr, temp.ReleaseAndGetAddressOf());
     my_assert(SUCCEEDED(hr));
+
+    D3D11_BOX box = {};
+    box.left = m.src * element_size;
+    box.right = (m.src + m.count) * element_size;
+    box.bottom = 1;
+    box.back = 1;
+    renderer.ctx->CopySubresourceRegion(temp.Get(), 0, 0, 0, 0, buffer, 0, &box);
+    box.left = 0;
+    box.right = m.count * element_size;
+    renderer.ctx->CopySubresourceRegion(buffer, 0, m.dst * element_size, 0, 0, temp.Get(), 0, &box);
   }
+}
+
+// Mesh ids are indices into g_vds and have to fit into the sort key together with level of detail.
+static constexpr u32 MAX_MESHES = (1u << SORT_KEY_MESH_BITS) / MAX_LODS;
+
+// Storage is reserved up front, entities point into it.
+// Built-in meshes come first, loaded and batch meshes follow in any order.
+static vector<vertex_data> g_vds = {};
 
+// Returns a free mesh id, or MAX_MESHES when all are taken.
+// Slots of released meshes are reused, they have no vertices and no entity points to them.
+static u32 allocate_mesh_slot()
+{
+  for (u32 id = BUILTIN_MESH_COUNT; id < g_vds.size(); id++)
+  {
+    if (g_vds[id].vertex_count == 0)
+      return id;
+  }
+  if (g_vds.size() == g_vds.capacity())
+    return MAX_MESHES;
+  g_vds.push_back({});
+  return g_vds.size() - 1;
+}
+
+static u32 free_mesh_slot_count()
+{
+  u32 ret = g_vds.capacity() - g_vds.size();
+  for (u32 id = BUILTIN_MESH_COUNT; id < g_vds.size(); id++)
+    ret += g_vds[id].vertex_count == 0 ? 1 : 0;
   return ret;
 }
 
-static vector<vertex_data> g_vds = {};
+// Meshes are optimized before upload, see mesh_optimizer.hpp.
+// Statistics are sums over all optimized levels.
+static bool g_optimize_meshes = true;
+static mesh_optimization_stats g_builtin_optimization = {};
+static mesh_optimization_stats g_bake_optimization = {};
+static f64 g_bake_optimize_time = 0.0;
+
+static mesh_optimization_stats sum_optimization_stats(vector<mesh_optimization_stats> const& stats)
+{
+  mesh_optimization_stats ret;
+  for (u32 i = 0; i < stats.size(); i++)
+  {
+    accumulate(ret.before, stats[i].before);
+    accumulate(ret.after, stats[i].after);
+  }
+  return ret;
+}
 
 static void create_vds(d3d11_renderer& renderer)
 {
-  // Triangle
-  {
-    vector<vertex> verts;
-    vector<u32> indices;
-
-    verts.push_back({ {-sqrt(3.0f) * 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, +1.0f} });
-    verts.push_back({ {+0.0f, +sqrt(3.0f) * 0.5f, 0.0f}, {0.0f, 0.0f, +1.0f} });
-    verts.push_back({ {+sqrt(3.0f) * 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, +1.0f} });
-    indices.push_back(0);
-    indices.push_back(1);
-    indices.push_back(2);
-
-    g_vds.push_back(create_vertex_data(renderer, verts, indices));
-  }
-  // Cube
-  {
-    vector<vertex> verts;
-    vector<u32> indices;
-
-    // left side
-    verts.push_back({ {-0.5f, +0.5f, -0.5f}, {-1.0f, 0.0f, 0.0f} });
-    verts.push_back({ {-0.5f, +0.5f, +0.5f}, {-1.0f, 0.0f, 0.0f} });
-    verts.push_back({ {-0.5f, -0.5f, +0.5f}, {-1.0f, 0.0f, 0.0f} });
-    verts.push_back({ {-0.5f, -0.5f, -0.5f}, {-1.0f, 0.0f, 0.0f} });
-    indices.push_back(0);
-    indices.push_back(1);
-    indices.push_back(2);
-    indices.push_back(0);
-    indices.push_back(2);
-    indices.push_back(3);
-    // right side
-    verts.push_back({ {+0.5f, +0.5f, +0.5f}, {+1.0f, 0.0f, 0.0f} });
-    verts.push_back({ {+0.5f, +0.5f, -0.5f}, {+1.0f, 0.0f, 0.0f} });
-    verts.push_back({ {+0.5f, -0.5f, -0.5f}, {+1.0f, 0.0f, 0.0f} });
-    verts.push_back({ {+0.5f, -0.5f, +0.5f}, {+1.0f, 0.0f, 0.0f} });
-    indices.push_back(4);
-    indices.push_back(5);
-    indices.push_back(6);
-    indices.push_back(4);
-    indices.push_back(6);
-    indices.push_back(7);
-    // top side
-    verts.push_back({ {-0.5f, +0.5f, -0.5f}, {0.0f, +1.0f, 0.0f} });
-    verts.push_back({ {+0.5f, +0.5f, -0.5f}, {0.0f, +1.0f, 0.0f} });
-    verts.push_back({ {+0.5f, +0.5f, +0.5f}, {0.0f, +1.0f, 0.0f} });
-    verts.push_back({ {-0.5f, +0.5f, +0.5f}, {0.0f, +1.0f, 0.0f} });
-    indices.push_back(8);
-    indices.push_back(9);
-    indices.push_back(10);
-    indices.push_back(8);
-    indices.push_back(10);
-    indices.push_back(11);
-    // bottom side
-    verts.push_back({ {-0.5f, -0.5f, +0.5f}, {0.0f, -1.0f, 0.0f} });
-    verts.push_back({ {+0.5f, -0.5f, +0.5f}, {0.0f, -1.0f, 0.0f} });
-    verts.push_back({ {+0.5f, -0.5f, -0.5f}, {0.0f, -1.0f, 0.0f} });
-    verts.push_back({ {-0.5f, -0.5f, -0.5f}, {0.0f, -1.0f, 0.0f} });
-    indices.push_back(12);
-    indices.push_back(13);
-    indices.push_back(14);
-    indices.push_back(12);
-    indices.push_back(14);
-    indices.push_back(15);
-    // face side
-    verts.push_back({ {-0.5f, +0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
-    verts.push_back({ {+0.5f, +0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
-    verts.push_back({ {+0.5f, -0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
-    verts.push_back({ {-0.5f, -0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
-    indices.push_back(16);
-    indices.push_back(17);
-    indices.push_back(18);
-    indices.push_back(16);
-    indices.push_back(18);
-    indices.push_back(19);
-    // back side
-    verts.push_back({ {+0.5f, +0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
-    verts.push_back({ {-0.5f, +0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
-    verts.push_back({ {-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
-    verts.push_back({ {+0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
-    indices.push_back(20);
-    indices.push_back(21);
-    indices.push_back(22);
-    indices.push_back(20);
-    indices.push_back(22);
-    indices.push_back(23);
-
-    g_vds.push_back(create_vertex_data(renderer, verts, indices));
+  create_mesh_arena(renderer);
+  g_vds.reserve(MAX_MESHES);
+
+  mesh_lod lods[BUILTIN_MESH_COUNT][MAX_LODS];
+  u32 lod_counts[BUILTIN_MESH_COUNT];
+  for (u32 i = 0; i < BUILTIN_MESH_COUNT; i++)
+    lod_counts[i] = create_builtin_mesh(i, lods[i]);
+
+  // Levels of all meshes are optimized together, one job each.
+  vector<mesh_lod*> all_lods;
+  for (u32 i = 0; i < BUILTIN_MESH_COUNT; i++)
+  {
+    for (u32 l = 0; l < lod_counts[i]; l++)
+      all_lods.push_back(&lods[i][l]);
+  }
+  vector<mesh_optimization_stats> stats;
+  stats.resize(all_lods.size(), {});
+  optimize_meshes(all_lods.data(), all_lods.size(), stats.data());
+  g_builtin_optimization = sum_optimization_stats(stats);
+
+  for (u32 i = 0; i < BUILTIN_MESH_COUNT; i++)
+  {
+    g_vds.push_back({});
+    // Arena is created with room for built-in meshes.
+    const bool created = create_vertex_data(renderer, lods[i], lod_counts[i], g_vds.back());
+    my_assert(created);
+    (void)created;
   }
 }
 
 static void destroy_vds()
 {
+  for (u32 i = 0; i < g_vds.size(); i++)
+    destroy_vertex_data(g_vds[i]);
   g_vds = vector<vertex_data>{};
+  destroy_mesh_arena();
+}
+
+// Removes holes left by destroyed meshes and patches ranges of the remaining ones.
+static void compact_mesh_arena(d3d11_renderer& renderer)
+{
+  vector<range_allocator::range_move> vertex_moves;
+  vector<range_allocator::range_move> index_moves;
+  g_mesh_arena.vertex_ranges.compact(vertex_moves);
+  g_mesh_arena.index_ranges.compact(index_moves);
+  apply_arena_moves(renderer, g_mesh_arena.vertices.Get(), D3D11_BIND_VERTEX_BUFFER,
+                    vertex_format_size(g_mesh_arena.format), vertex_moves);
+  apply_arena_moves(renderer, g_mesh_arena.indices.Get(), D3D11_BIND_INDEX_BUFFER, sizeof(u32), index_moves);
+
+  for (u32 i = 0; i < g_vds.size(); i++)
+  {
+    vertex_data& vd = g_vds[i];
+    if (vd.vertex_count == 0)
+      continue;
+    for (u32 m = 0; m < vertex_moves.size(); m++)
+    {
+      const range_allocator::range_move& move = vertex_moves[m];
+      if (vd.vertex_offset >= move.src && vd.vertex_offset < move.src + move.count)
+      {
+        const i32 delta = (i32)move.dst - (i32)move.src;
+        vd.vertex_offset += delta;
+        for (u32 l = 0; l < vd.lod_count; l++)
+          vd.lods[l].base_vertex += delta;
+        break;
+      }
+    }
+    for (u32 m = 0; m < index_moves.size(); m++)
+    {
+      const range_allocator::range_move& move = index_moves[m];
+      if (vd.index_offset >= move.src && vd.index_offset < move.src + move.count)
+      {
+        const i32 delta = (i32)move.dst - (i32)move.src;
+        vd.index_offset += delta;
+        for (u32 l = 0; l < vd.lod_count; l++)
+          vd.lods[l].first_index += delta * (i32)(4 / vd.index_size);
+        break;
+      }
+    }
+  }
+}
+
+// Re-encodes vertices of every mesh into the format. Ranges stay where they are.
+static void set_vertex_format(d3d11_renderer& renderer, u32 format)
+{
+  my_assert(format < VERTEX_FORMAT_COUNT);
+  g_mesh_arena.format = format;
+  create_mesh_arena_vertices(renderer);
+  for (u32 i = 0; i < g_vds.size(); i++)
+  {
+    if (g_vds[i].vertex_count > 0)
+      upload_vertices(renderer, g_vds[i]);
+  }
 }
 
 // END: Mesh data
@@ -381,17 +587,25 @@ struct scene_constants
 // Object constants buffer.
 // Probably should be separated for vertex/pixel shaders.
 // Should separate object data and material data.
+// Normal matrix is derived from local_to_world in the vertex shader.
 struct object_constants
 {
-  glm::mat4x4 local_to_world;
-  glm::mat4x4 world_to_local_transposed;
-  glm::vec3 object_color;
-  f32 _pad0;
+  affine local_to_world;
+  // RGBA8.
+  u32 object_color;
+  u32 _pad0[3];
 };
 
-// TODO: optimize to minimize pipeline state changes.
+// Draws are recorded into a command buffer and sorted by pass, pipeline and mesh,
+// see render_commands.hpp. Mesh ids are indices into g_vds.
 //  Mesh = list of submeshes + all that hubbub common for vertex data.
-//  Sort drawcalls by material.
+
+static constexpr u32 PASS_OPAQUE = 0;
+
+static constexpr u32 PIPELINE_SOLID = 0;
+static constexpr u32 PIPELINE_WIREFRAME = 1;
+// Set for pipelines which take object constants per instance from vertex buffer slot 1.
+static constexpr u32 PIPELINE_INSTANCED_BIT = 2;
 
 static scene_constants g_scene_constants;
 static object_constants g_object_constants;
@@ -400,12 +614,35 @@ static object_constants g_object_constants;
 static com_ptr<ID3D11VertexShader> g_vs;
 // Per material. Common part in shaders.
 static com_ptr<ID3D11PixelShader> g_ps;
+// Vertex shader of instanced draws.
+static com_ptr<ID3D11VertexShader> g_vs_instanced;
+// Same for quantized vertex formats, dequantization constants of the mesh are in slot 2.
+static com_ptr<ID3D11VertexShader> g_vs_quantized;
+static com_ptr<ID3D11VertexShader> g_vs_instanced_quantized;
 // U-uh... Per material? Meshes should conform...
-static com_ptr<ID3D11InputLayout> g_input_layout;
+// One per vertex format.
+static com_ptr<ID3D11InputLayout> g_input_layouts[VERTEX_FORMAT_COUNT];
+static com_ptr<ID3D11InputLayout> g_input_layouts_instanced[VERTEX_FORMAT_COUNT];
+static com_ptr<ID3D11Buffer> g_buf_mesh_constants;
 // Read up on proper usage of constant buffers.
 // Because having one buffer per material smells less than great...
 static com_ptr<ID3D11Buffer> g_buf_scene_constants;
 static com_ptr<ID3D11Buffer> g_buf_object_constants;
+// Object constants of instanced draws, grows on demand.
+static com_ptr<ID3D11Buffer> g_buf_instances;
+static u32 g_instance_capacity = 0;
+// Object constants of regular draws are suballocated from one big buffer,
+// which is mapped with NO_OVERWRITE and bound with offsets. Needs D3D11.1.
+// Every frame ends with an event query, ring memory of a frame is reused once its query is signaled.
+static constexpr u32 OBJECT_RING_SIZE = 8 * 1024 * 1024;
+static bool g_object_ring_supported = false;
+static bool g_object_ring_enabled = true;
+static u32 g_object_ring_fallbacks = 0;
+static upload_ring g_object_ring;
+static com_ptr<ID3D11Buffer> g_buf_object_ring;
+static com_ptr<ID3D11Query> g_frame_queries[upload_ring::MAX_FRAMES_IN_FLIGHT];
+static u64 g_frame_fence = 0;
+static u64 g_completed_fence = 0;
 // How to manage these states by material?
 // Also, have default materials and states for only-in-engine parts.
 static com_ptr<ID3D11BlendState> g_blend_state;
@@ -413,6 +650,84 @@ static com_ptr<ID3D11RasterizerState> g_rasterizer_state_solid;
 static com_ptr<ID3D11RasterizerState> g_rasterizer_state_wireframe;
 static com_ptr<ID3D11DepthStencilState> g_depth_stencil_state;
 
+// Vertex elements of the format in slot 0, followed by per-instance elements in slot 1 for instanced shaders.
+static HRESULT create_input_layout(d3d11_renderer& renderer, u32 format, bool instanced, ID3D11InputLayout** out)
+{
+  D3D11_INPUT_ELEMENT_DESC elem_descs[8] = {};
+  u32 count = 0;
+  if (format == VERTEX_FORMAT_FLOAT)
+  {
+    elem_descs[0].SemanticName = "POSITION";
+    elem_descs[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    elem_descs[0].AlignedByteOffset = offsetof(vertex, position);
+    elem_descs[1].SemanticName = "NORMAL";
+    elem_descs[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    elem_descs[1].AlignedByteOffset = offsetof(vertex, normal);
+    elem_descs[2].SemanticName = "COLOR";
+    elem_descs[2].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    elem_descs[2].AlignedByteOffset = offsetof(vertex, color);
+    count = 3;
+  }
+  else
+  {
+    // Both quantized formats start with the same position, see vertex.hpp.
+    const bool normal_8 = format == VERTEX_FORMAT_QUANTIZED_8;
+    elem_descs[0].SemanticName = "POSITION";
+    elem_descs[0].Format = DXGI_FORMAT_R16G16_UNORM;
+    elem_descs[0].AlignedByteOffset = 0;
+    elem_descs[1].SemanticName = "POSITION";
+    elem_descs[1].SemanticIndex = 1;
+    elem_descs[1].Format = DXGI_FORMAT_R16_UNORM;
+    elem_descs[1].AlignedByteOffset = 4;
+    elem_descs[2].SemanticName = "NORMAL";
+    elem_descs[2].Format = normal_8 ? DXGI_FORMAT_R8G8_SNORM : DXGI_FORMAT_R16G16_SNORM;
+    elem_descs[2].AlignedByteOffset = normal_8 ? offsetof(vertex_quantized_8, normal)
+                                               : offsetof(vertex_quantized_16, normal);
+    elem_descs[3].SemanticName = "COLOR";
+    elem_descs[3].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    elem_descs[3].AlignedByteOffset = normal_8 ? offsetof(vertex_quantized_8, color)
+                                               : offsetof(vertex_quantized_16, color);
+    count = 4;
+  }
+
+  if (instanced)
+  {
+    // Per-instance elements follow object_constants layout.
+    for (u32 i = 0; i < 3; i++)
+    {
+      D3D11_INPUT_ELEMENT_DESC& desc = elem_descs[count++];
+      desc.SemanticName = "LOCAL_TO_WORLD";
+      desc.SemanticIndex = i;
+      desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+      desc.InputSlot = 1;
+      desc.AlignedByteOffset = offsetof(object_constants, local_to_world) + 16 * i;
+      desc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+      desc.InstanceDataStepRate = 1;
+    }
+    D3D11_INPUT_ELEMENT_DESC& desc = elem_descs[count++];
+    desc.SemanticName = "OBJECT_COLOR";
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.InputSlot = 1;
+    desc.AlignedByteOffset = offsetof(object_constants, object_color);
+    desc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+    desc.InstanceDataStepRate = 1;
+  }
+
+  BYTE const* bytecode;
+  u32 bytecode_size;
+  if (format == VERTEX_FORMAT_FLOAT)
+  {
+    bytecode = instanced ? vs_instanced_bytecode : vs_bytecode;
+    bytecode_size = instanced ? sizeof(vs_instanced_bytecode) : sizeof(vs_bytecode);
+  }
+  else
+  {
+    bytecode = instanced ? vs_instanced_quantized_bytecode : vs_quantized_bytecode;
+    bytecode_size = instanced ? sizeof(vs_instanced_quantized_bytecode) : sizeof(vs_quantized_bytecode);
+  }
+  return renderer.device->CreateInputLayout(elem_descs, count, bytecode, bytecode_size, out);
+}
+
 static void create_common_pipeline_objects(d3d11_renderer& renderer)
 {
   HRESULT hr;
@@ -422,17 +737,31 @@ static void create_common_pipeline_objects(d3d11_renderer& renderer)
     my_assert(SUCCEEDED(hr));
     hr = renderer.device->CreatePixelShader(ps_bytecode, sizeof(ps_bytecode), nullptr, g_ps.ReleaseAndGetAddressOf());
     my_assert(SUCCEEDED(hr));
+    hr = renderer.device->CreateVertexShader(vs_instanced_bytecode, sizeof(vs_instanced_bytecode), nullptr, g_vs_instanced.ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+    hr = renderer.device->CreateVertexShader(vs_quantized_bytecode, sizeof(vs_quantized_bytecode), nullptr,
+                                             g_vs_quantized.ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+    hr = renderer.device->CreateVertexShader(vs_instanced_quantized_bytecode, sizeof(vs_instanced_quantized_bytecode),
+                                             nullptr, g_vs_instanced_quantized.ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
   }
 
+  for (u32 format = 0; format < VERTEX_FORMAT_COUNT; format++)
   {
-    D3D11_INPUT_ELEMENT_DESC elem_descs[2] = {};
-    elem_descs[0].SemanticName = "POSITION";
-    elem_descs[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-    elem_descs[0].AlignedByteOffset = 0;
-    elem_descs[1].SemanticName = "NORMAL";
-    elem_descs[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-    elem_descs[1].AlignedByteOffset = 12;
-    hr = renderer.device->CreateInputLayout(elem_descs, 2, vs_bytecode, sizeof(vs_bytecode), g_input_layout.ReleaseAndGetAddressOf());
+    hr = create_input_layout(renderer, format, false, g_input_layouts[format].ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+    hr = create_input_layout(renderer, format, true, g_input_layouts_instanced[format].ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+  }
+
+  {
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = sizeof(vertex_quantization);
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    hr = renderer.device->CreateBuffer(&desc, nullptr, g_buf_mesh_constants.ReleaseAndGetAddressOf());
     my_assert(SUCCEEDED(hr));
   }
 
@@ -446,6 +775,34 @@ static void create_common_pipeline_objects(d3d11_renderer& renderer)
     my_assert(SUCCEEDED(hr));
   }
 
+  {
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    hr = renderer.device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+    g_object_ring_supported = SUCCEEDED(hr) && renderer.ctx1.Get() != nullptr && options.ConstantBufferOffsetting
+      && options.MapNoOverwriteOnDynamicConstantBuffer;
+    if (g_object_ring_supported)
+    {
+      D3D11_BUFFER_DESC desc = {};
+      desc.ByteWidth = OBJECT_RING_SIZE;
+      desc.Usage = D3D11_USAGE_DYNAMIC;
+      desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+      desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+      hr = renderer.device->CreateBuffer(&desc, nullptr, g_buf_object_ring.ReleaseAndGetAddressOf());
+      my_assert(SUCCEEDED(hr));
+      g_object_ring.init(OBJECT_RING_SIZE);
+
+      D3D11_QUERY_DESC query_desc = {};
+      query_desc.Query = D3D11_QUERY_EVENT;
+      for (u32 i = 0; i < upload_ring::MAX_FRAMES_IN_FLIGHT; i++)
+      {
+        hr = renderer.device->CreateQuery(&query_desc, g_frame_queries[i].ReleaseAndGetAddressOf());
+        my_assert(SUCCEEDED(hr));
+      }
+      g_frame_fence = 0;
+      g_completed_fence = 0;
+    }
+  }
+
   {
     D3D11_BUFFER_DESC desc = {};
     desc.ByteWidth = sizeof(g_scene_constants);
@@ -496,179 +853,874 @@ static void destroy_common_pipeline_objects()
   g_rasterizer_state_wireframe.Reset();
   g_rasterizer_state_solid.Reset();
   g_blend_state.Reset();
+  for (u32 i = 0; i < upload_ring::MAX_FRAMES_IN_FLIGHT; i++)
+    g_frame_queries[i].Reset();
+  g_buf_object_ring.Reset();
+  g_buf_instances.Reset();
+  g_instance_capacity = 0;
   g_buf_object_constants.Reset();
   g_buf_scene_constants.Reset();
-  g_input_layout.Reset();
+  g_buf_mesh_constants.Reset();
+  for (u32 i = 0; i < VERTEX_FORMAT_COUNT; i++)
+  {
+    g_input_layouts_instanced[i].Reset();
+    g_input_layouts[i].Reset();
+  }
   g_ps.Reset();
+  g_vs_instanced_quantized.Reset();
+  g_vs_quantized.Reset();
+  g_vs_instanced.Reset();
   g_vs.Reset();
 }
 
-// This is transform component.
+// Static batching.
+// Static entities are grouped by the cell of a uniform grid which contains center of their bounds.
+// Every cell is baked into one mesh with vertices pre-transformed to world space and colored
+// by their entity, and drawn by one batch entity with identity transform.
+// Batch bounds are bounds of the whole cell, so culling tests one box per cell.
+
+static f32 g_bake_cell_size = 4.0f;
+static u32 g_num_baked_entities = 0;
+// Ids of batch meshes in g_vds, in the order of scene::static_batches.
+static vector<u32> g_batch_mesh_ids = {};
+static f64 g_bake_time = 0.0;
+
+// Batches get levels of detail generated by simplification, see mesh_simplifier.hpp.
+// Generated levels switch where their error projects to g_lod_error_pixels of the viewport.
+static bool g_generate_lods = true;
+static f32 g_lod_error_pixels = 1.0f;
+// Fraction of the screen height applied to meshes so far.
+static f32 g_lod_screen_error = 1.0f / 1080.0f;
+static u32 g_bake_lod_triangles[MAX_LODS] = {};
+static f64 g_bake_simplify_time = 0.0;
+
+static void update_lod_screen_error(f32 viewport_height)
+{
+  const f32 screen_error = g_lod_error_pixels / glm::max(viewport_height, 1.0f);
+  if (screen_error == g_lod_screen_error)
+    return;
+  g_lod_screen_error = screen_error;
+  for (u32 i = 0; i < g_vds.size(); i++)
+    set_lod_screen_error(g_vds[i], g_lod_screen_error);
+}
+
+static u32 pack_color(glm::vec3 const& color)
+{
+  const glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+  return (u32)c.x | ((u32)c.y << 8) | ((u32)c.z << 16) | 0xFF000000u;
+}
 
-struct transform
+static void unbake_static_entities(scene& sc)
 {
-  glm::vec3 t = { 0.0f, 0.0f, 0.0f };
-  glm::quat r = { 0.0f, 0.0f, 0.0f, 1.0f };
-  glm::vec3 s = { 1.0f, 1.0f, 1.0f };
+  if (sc.static_batches.size() == 0)
+    return;
 
-  glm::mat4x4 local_to_world() const
+  vector<u8> is_batch_mesh;
+  is_batch_mesh.resize(g_vds.size(), 0);
+  for (u32 i = 0; i < g_batch_mesh_ids.size(); i++)
+    is_batch_mesh[g_batch_mesh_ids[i]] = 1;
+
+  for (u32 i = 0; i < sc.entities.size();)
   {
-    glm::mat4x4 m;
-    m[0] = s.x * 2.0f * glm::vec4{ r.x * r.x + r.w * r.w - 0.5f, r.x * r.y + r.z * r.w, r.x * r.z - r.y * r.w, 0.0f };
-    m[1] = s.y * 2.0f * glm::vec4{ r.y * r.x - r.z * r.w, r.y * r.y + r.w * r.w - 0.5f, r.y * r.z + r.x * r.w, 0.0f };
-    m[2] = s.z * 2.0f * glm::vec4{ r.z * r.x + r.y * r.w, r.z * r.y - r.x * r.w, r.z * r.z + r.w * r.w - 0.5f, 0.0f };
-    m[3] = { t.x, t.y, t.z, 1.0f };
-    return m;
+    entity* e = sc.entities[i];
+    if (e->batch != nullptr)
+    {
+      e->batch = nullptr;
+      update_entity_bounds(sc, e);
+    }
+    // Batches are destroyed below, order of entities doesn't matter.
+    if (e->vd != nullptr && is_batch_mesh[(u32)(e->vd - g_vds.data())])
+    {
+      sc.entities[i] = sc.entities.back();
+      sc.entities.pop_back();
+      continue;
+    }
+    i++;
   }
 
-  glm::mat4x4 world_to_local_transposed() const
+  for (u32 i = 0; i < sc.static_batches.size(); i++)
   {
-    // omit translation because this matrix is used to transform vectors
-    glm::mat4x4 m;
-    m[0] = (2.0f / s.x) * glm::vec4{ r.x * r.x + r.w * r.w - 0.5f, r.x * r.y + r.z * r.w, r.x * r.z - r.y * r.w, 0.0f };
-    m[1] = (2.0f / s.y) * glm::vec4{ r.y * r.x - r.z * r.w, r.y * r.y + r.w * r.w - 0.5f, r.y * r.z + r.x * r.w, 0.0f };
-    m[2] = (2.0f / s.z) * glm::vec4{ r.z * r.x + r.y * r.w, r.z * r.y - r.x * r.w, r.z * r.z + r.w * r.w - 0.5f, 0.0f };
-    m[3] = { 0.0f, 0.0f, 0.0f, 1.0f };
-    return m;
+    entity* batch = sc.static_batches[i];
+    batch->vd = nullptr;
+    update_entity_bounds(sc, batch);
+    sc.entity_pool.destroy(batch);
+    destroy_vertex_data(g_vds[g_batch_mesh_ids[i]]);
+    g_vds[g_batch_mesh_ids[i]] = vertex_data{};
   }
-};
+  while (g_vds.size() > BUILTIN_MESH_COUNT && g_vds.back().vertex_count == 0)
+    g_vds.pop_back();
+  sc.static_batches.clear();
+  g_batch_mesh_ids.clear();
+  g_num_baked_entities = 0;
+  sc.tree.rebuild();
+}
+
+static void bake_static_entities(d3d11_renderer& renderer, scene& sc, f32 cell_size)
+{
+  unbake_static_entities(sc);
 
-// This is camera component.
+  // Cell key packs 21 bits of every coordinate.
+  hash_map<u64, u32> cell_indices;
+  vector<vector<entity*>> cells;
+  for (u32 i = 0; i < sc.entities.size(); i++)
+  {
+    entity* e = sc.entities[i];
+    if (e->is_static == false || e->vd == nullptr)
+      continue;
+    const aabb bounds = transform_aabb(e->vd->aabb_center, e->vd->aabb_extent, entity_local_to_world(*e));
+    const glm::ivec3 cell = glm::ivec3{ glm::floor(0.5f * (bounds.min + bounds.max) / cell_size) };
+    const u64 key = ((u64)(cell.x & 0x1FFFFF) << 42) | ((u64)(cell.y & 0x1FFFFF) << 21) | (u64)(cell.z & 0x1FFFFF);
+    auto it = cell_indices.find(key);
+    if (it == cell_indices.end())
+    {
+      cell_indices.insert(u64{ key }, cells.size());
+      cells.push_back({});
+      cells.back().push_back(e);
+    }
+    else
+    {
+      cells[it->value].push_back(e);
+    }
+  }
 
-struct camera
+  // Levels of batch c start at batch_lods[c * MAX_LODS].
+  const u32 batch_count = glm::min(cells.size(), free_mesh_slot_count());
+  if (batch_count < cells.size())
+  {
+    // Entities of the remaining cells stay unbaked.
+    if (console::g_log.size() == console::g_log.capacity()) console::g_log.pop_front();
+    console::g_log.push_back({ "Mesh slots are full, some cells are not baked" });
+  }
+  vector<mesh_lod> batch_lods;
+  batch_lods.resize(batch_count * MAX_LODS, {});
+  vector<u32> lod_counts;
+  lod_counts.resize(batch_count, 1);
+  for (u32 c = 0; c < batch_count; c++)
+  {
+    const vector<entity*>& members = cells[c];
+    mesh_lod& lod = batch_lods[c * MAX_LODS];
+    lod.min_screen_size = 0.0f;
+    for (u32 i = 0; i < members.size(); i++)
+    {
+      const entity& e = *members[i];
+      const glm::mat4x4 ltw = entity_local_to_world(e);
+      const glm::mat3x3 normal_matrix = glm::transpose(glm::inverse(glm::mat3x3{ ltw }));
+      const u32 color = pack_color(e.color);
+      const u32 base_vertex = lod.vertices.size();
+      for (u32 v = 0; v < lod_vertex_count(*e.vd, 0); v++)
+      {
+        const vertex& src = vertices_of(*e.vd)[v];
+        vertex dst;
+        dst.position = glm::vec3{ ltw * glm::vec4{ src.position, 1.0f } };
+        dst.normal = glm::normalize(normal_matrix * src.normal);
+        dst.color = color;
+        lod.vertices.push_back(dst);
+      }
+      for (u32 v = 0; v < e.vd->occluder_indices.size(); v++)
+        lod.indices.push_back(base_vertex + e.vd->occluder_indices[v]);
+    }
+  }
+
+  for (u32 l = 0; l < MAX_LODS; l++)
+    g_bake_lod_triangles[l] = 0;
+  g_bake_simplify_time = 0.0;
+  if (g_generate_lods)
+  {
+    const f64 simplify_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+    generate_lod_chains(batch_lods.data(), batch_count, lod_counts.data());
+    g_bake_simplify_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - simplify_start_time;
+  }
+  vector<mesh_lod*> all_lods;
+  for (u32 c = 0; c < batch_count; c++)
+  {
+    for (u32 l = 0; l < lod_counts[c]; l++)
+    {
+      all_lods.push_back(&batch_lods[c * MAX_LODS + l]);
+      g_bake_lod_triangles[l] += batch_lods[c * MAX_LODS + l].indices.size() / 3;
+    }
+  }
+
+  g_bake_optimization = {};
+  if (g_optimize_meshes)
+  {
+    const f64 optimize_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+    vector<mesh_optimization_stats> stats;
+    stats.resize(all_lods.size(), {});
+    optimize_meshes(all_lods.data(), all_lods.size(), stats.data());
+    g_bake_optimization = sum_optimization_stats(stats);
+    g_bake_optimize_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - optimize_start_time;
+  }
+
+  for (u32 c = 0; c < batch_count; c++)
+  {
+    const vector<entity*>& members = cells[c];
+    // Cells are limited to free slots, so there is one.
+    const u32 id = allocate_mesh_slot();
+    if (create_vertex_data(renderer, &batch_lods[c * MAX_LODS], lod_counts[c], g_vds[id]) == false)
+    {
+      // Entities of the remaining cells stay unbaked.
+      if (console::g_log.size() == console::g_log.capacity()) console::g_log.pop_front();
+      console::g_log.push_back({ "Mesh arena is full, baking stopped" });
+      break;
+    }
+    g_batch_mesh_ids.push_back(id);
+    set_lod_screen_error(g_vds[id], g_lod_screen_error);
+
+    entity* batch = sc.entity_pool.construct();
+    batch->vd = &g_vds[id];
+    batch->color = { 1.0f, 1.0f, 1.0f };
+    update_entity_bounds(sc, batch);
+    sc.entities.push_back(batch);
+    sc.static_batches.push_back(batch);
+    for (u32 i = 0; i < members.size(); i++)
+    {
+      members[i]->batch = batch;
+      update_entity_bounds(sc, members[i]);
+    }
+    g_num_baked_entities += members.size();
+  }
+  sc.tree.rebuild();
+}
+
+// Render system uses this to render everything.
+
+static i32 g_cull_mode = CULL_MODE_BVH;
+static bool g_temporal_coherence = true;
+static camera_motion g_camera_motion;
+static u32 g_num_visible = 0;
+static f64 g_cull_time = 0.0;
+static cull_stats g_cull_stats = {};
+static vector<void*> g_visible_entities = {};
+
+// Occlusion culling of entities which passed frustum culling.
+// Entities which are large on screen are rasterized as occluders,
+// the rest is tested against the resulting depth buffer.
+
+static constexpr u32 MAX_OCCLUDERS = 1024;
+
+static bool g_occlusion_enabled = false;
+// Minimum projected radius of an occluder, fraction of screen height.
+static f32 g_occluder_min_size = 0.02f;
+static u32 g_num_frustum_visible = 0;
+static u32 g_num_occluders = 0;
+static u32 g_num_occluded = 0;
+static f64 g_occlusion_time = 0.0;
+static occlusion_buffer g_occlusion_buffer;
+static vector<u8> g_occlusion_flags = {};
+
+static void cull_occluded(const scene& sc, const glm::mat4x4& world_to_screen, vector<void*>& visible)
+{
+  g_occlusion_buffer.begin_frame(world_to_screen);
+  g_occlusion_flags.clear();
+  g_occlusion_flags.resize(visible.size(), 0);
+
+  const glm::vec3 cam_pos = sc.cam.tr.t;
+  const f32 proj_scale = 0.5f / tan(glm::radians(sc.cam.fov_degrees) * 0.5f);
+  g_num_occluders = 0;
+  for (u32 i = 0; i < visible.size() && g_num_occluders < MAX_OCCLUDERS; i++)
+  {
+    const entity* e = static_cast<const entity*>(visible[i]);
+    const aabb& box = sc.tree.fat_aabb(e->bvh_proxy);
+    const f32 radius = 0.5f * glm::length(box.max - box.min);
+    const f32 dist = glm::length(0.5f * (box.max + box.min) - cam_pos);
+    if (dist <= radius || radius * proj_scale < g_occluder_min_size * dist)
+      continue;
+    g_occlusion_buffer.add_occluder(entity_local_to_world(*e), e->vd->occluder_positions.data(),
+                                    e->vd->occluder_indices.data(), e->vd->occluder_indices.size());
+    g_occlusion_flags[i] = 1;
+    g_num_occluders++;
+  }
+  g_occlusion_buffer.rasterize();
+
+  jobs::parallel_for(visible.size(), 256, [&](u32 begin, u32 end, u32)
+  {
+    for (u32 i = begin; i < end; i++)
+    {
+      if (g_occlusion_flags[i] == 0)
+      {
+        const entity* e = static_cast<const entity*>(visible[i]);
+        g_occlusion_flags[i] = g_occlusion_buffer.is_visible(sc.tree.fat_aabb(e->bvh_proxy)) ? 1 : 0;
+      }
+    }
+  });
+
+  u32 num_visible = 0;
+  for (u32 i = 0; i < visible.size(); i++)
+  {
+    if (g_occlusion_flags[i])
+      visible[num_visible++] = visible[i];
+  }
+  g_num_occluded = visible.size() - num_visible;
+  visible.resize(num_visible, nullptr);
+}
+
+// Culling of several views in one pass, e.g. split screen or shadow cascades.
+// Benchmark runs views spread around the camera either in one pass or in a pass per view.
+
+static bool g_multi_view_benchmark = false;
+static i32 g_multi_view_count = 4;
+static f64 g_multi_view_single_pass_time = 0.0;
+static f64 g_multi_view_separate_passes_time = 0.0;
+static u32 g_multi_view_visible[MAX_VIEWS] = {};
+static vector<aabb> g_multi_view_boxes = {};
+static vector<u8> g_multi_view_masks = {};
+
+static void benchmark_multi_view_culling(const scene& sc)
+{
+  g_multi_view_boxes.clear();
+  for (u32 i = 0; i < sc.entities.size(); i++)
+  {
+    const entity* e = sc.entities[i];
+    if (e->bvh_proxy != bvh::NULL_NODE)
+      g_multi_view_boxes.push_back(sc.tree.fat_aabb(e->bvh_proxy));
+  }
+  const u32 count = g_multi_view_boxes.size();
+  if (count == 0)
+    return;
+  g_multi_view_masks.resize(count, 0);
+
+  const u32 view_count = (u32)g_multi_view_count;
+  frustum frusta[MAX_VIEWS];
+  for (u32 v = 0; v < view_count; v++)
+  {
+    camera cam = sc.cam;
+    const f32 angle = 2.0f * glm::pi<f32>() * (f32)v / (f32)view_count;
+    cam.tr.r = glm::angleAxis(angle, glm::vec3{ 0.0f, 1.0f, 0.0f }) * cam.tr.r;
+    frusta[v] = make_frustum(cam.world_to_screen());
+  }
+
+  const f64 separate_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  for (u32 v = 0; v < view_count; v++)
+    cull_aabbs_multi_view(&frusta[v], 1, g_multi_view_boxes.data(), count, g_multi_view_masks.data());
+  g_multi_view_separate_passes_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - separate_start_time;
+
+  const f64 single_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  cull_aabbs_multi_view(frusta, view_count, g_multi_view_boxes.data(), count, g_multi_view_masks.data());
+  g_multi_view_single_pass_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - single_start_time;
+
+  for (u32 v = 0; v < MAX_VIEWS; v++)
+    g_multi_view_visible[v] = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    for (u32 v = 0; v < view_count; v++)
+      g_multi_view_visible[v] += (g_multi_view_masks[i] >> v) & 1u;
+  }
+}
+
+// Level of detail selection for visible entities, see select_lods.
+
+static f32 g_lod_hysteresis = lod::DEFAULT_HYSTERESIS;
+static u32 g_num_triangles = 0;
+static f64 g_lod_time = 0.0;
+static lod_selection g_lod_selection = {};
+
+// Draw command recording and submission.
+
+static bool g_sort_draws = true;
+static bool g_wireframe = false;
+// Visible entities which share mesh and level of detail are drawn with one instanced draw.
+static bool g_instancing = true;
+// Draws are recorded into a command buffer per thread, each sorted on its own and then merged.
+static constexpr u32 MAX_RECORD_THREADS = 64;
+static constexpr u32 RECORD_CHUNK_SIZE = 512;
+static bool g_parallel_recording = true;
+// Recording time includes sorting of per-thread buffers.
+static f64 g_command_record_time = 0.0;
+static f64 g_command_merge_time = 0.0;
+static f64 g_command_submit_time = 0.0;
+static submit_stats g_submit_stats = {};
+static command_buffer g_thread_commands[MAX_RECORD_THREADS];
+static u32 g_thread_triangles[MAX_RECORD_THREADS] = {};
+static command_buffer g_commands;
+
+// Levels with at least this many meshlets are drawn as ranges of the meshlets which pass
+// frustum and normal cone tests. Every range is a draw of its own, which breaks up instancing,
+// so small meshes are drawn whole.
+static bool g_cluster_culling = true;
+static i32 g_cluster_min_meshlets = DEFAULT_CLUSTER_MIN_MESHLETS;
+static vector<index_range> g_thread_ranges[MAX_RECORD_THREADS];
+static meshlet_cull_stats g_thread_meshlet_stats[MAX_RECORD_THREADS];
+static meshlet_cull_stats g_meshlet_stats = {};
+
+// Redundant state binds are dropped by the filter before they reach the device context.
+static bool g_state_filtering = true;
+static d3d11_context g_d3d11_context;
+static state_filter g_state_filter{ g_d3d11_context };
+
+// Translates sorted draw commands into D3D11 calls.
+struct d3d11_backend : render_backend
 {
-  transform tr = {};
-  float fov_degrees = 45.0f;
-  float z_near = 0.1f;
-  float z_far = 80.0f;
-  float aspect = 1.0f;
+  d3d11_renderer* renderer;
+  render_context* rc;
+  ID3D11RenderTargetView* rtv;
+  ID3D11DepthStencilView* dsv;
+  render_context::viewport viewport;
 
-  glm::mat4x4 world_to_view() const
+  void begin_pass(u32 pass) override
   {
-    const glm::vec3& t = tr.t;
-    const glm::quat& r = tr.r;
-    glm::mat4x4 m;
-    m[0] = 2.0f * glm::vec4{ r.x * r.x + r.w * r.w - 0.5f, r.x * r.y - r.z * r.w, r.x * r.z + r.y * r.w, 0.0f };
-    m[1] = 2.0f * glm::vec4{ r.y * r.x + r.z * r.w, r.y * r.y + r.w * r.w - 0.5f, r.y * r.z - r.x * r.w, 0.0f };
-    m[2] = 2.0f * glm::vec4{ r.z * r.x - r.y * r.w, r.z * r.y + r.x * r.w, r.z * r.z + r.w * r.w - 0.5f, 0.0f };
-    m[3] = {
-      -(m[0][0] * t.x + m[1][0] * t.y + m[2][0] * t.z),
-      -(m[0][1] * t.x + m[1][1] * t.y + m[2][1] * t.z),
-      -(m[0][2] * t.x + m[1][2] * t.y + m[2][2] * t.z),
-      1.0f };
-    return m;
+    my_assert(pass == PASS_OPAQUE);
+    rc->set_blend_state(g_blend_state.Get());
+    rc->set_depth_stencil_state(g_depth_stencil_state.Get());
+    rc->set_render_target(rtv, dsv);
+    rc->set_viewport(viewport);
+    rc->set_vs_constant_buffer(0, g_buf_scene_constants.Get());
+    rc->set_ps_constant_buffer(0, g_buf_scene_constants.Get());
   }
 
-  glm::mat4x4 view_to_screen() const
+  void set_pipeline(u32 pipeline) override
   {
-    const f32 h = 1.0f / tan(glm::radians(fov_degrees) * 0.5f);
-    const f32 f = z_far / (z_near - z_far);
-    glm::mat4x4 p = {};
-    p[0][0] = h / aspect;
-    p[1][1] = h;
-    p[2][2] = f;
-    p[2][3] = -1.0f;
-    p[3][2] = z_near * f;
-    return p;
+    const bool instanced = (pipeline & PIPELINE_INSTANCED_BIT) != 0;
+    const bool wireframe = (pipeline & PIPELINE_WIREFRAME) != 0;
+    const u32 format = g_mesh_arena.format;
+    rc->set_input_layout(instanced ? g_input_layouts_instanced[format].Get() : g_input_layouts[format].Get());
+    rc->set_primitive_topology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (format == VERTEX_FORMAT_FLOAT)
+      rc->set_vertex_shader(instanced ? g_vs_instanced.Get() : g_vs.Get());
+    else
+      rc->set_vertex_shader(instanced ? g_vs_instanced_quantized.Get() : g_vs_quantized.Get());
+    rc->set_pixel_shader(g_ps.Get());
+    rc->set_rasterizer_state(wireframe ? g_rasterizer_state_wireframe.Get() : g_rasterizer_state_solid.Get());
   }
 
-  glm::mat4x4 world_to_screen() const
+  void set_mesh(u32 mesh) override
   {
-    return view_to_screen() * world_to_view();
+    // Every mesh lives in the arena, only offsets of the draws differ.
+    const u32 format = g_mesh_arena.format;
+    rc->set_vertex_buffer(0, g_mesh_arena.vertices.Get(), vertex_format_size(format), 0);
+    const DXGI_FORMAT index_format = g_vds[mesh].index_size == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    rc->set_index_buffer(g_mesh_arena.indices.Get(), index_format, 0);
+    if (format != VERTEX_FORMAT_FLOAT)
+    {
+      D3D11_MAPPED_SUBRESOURCE mapped;
+      renderer->ctx->Map(g_buf_mesh_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+      memcpy(mapped.pData, &g_vds[mesh].quantization, sizeof(vertex_quantization));
+      renderer->ctx->Unmap(g_buf_mesh_constants.Get(), 0);
+      rc->set_vs_constant_buffer(2, g_buf_mesh_constants.Get());
+    }
+  }
+
+  void set_object_constants(void const* data, u32 size) override
+  {
+    if (g_object_ring_supported && g_object_ring_enabled)
+    {
+      const u32 offset = g_object_ring.allocate(size);
+      if (offset != upload_ring::INVALID_OFFSET)
+      {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        renderer->ctx->Map(g_buf_object_ring.Get(), 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped);
+        memcpy(static_cast<u8*>(mapped.pData) + offset, data, size);
+        renderer->ctx->Unmap(g_buf_object_ring.Get(), 0);
+        // Constant counts have to be multiples of 16.
+        const u32 constant_count = (size + upload_ring::ALIGNMENT - 1) / upload_ring::ALIGNMENT * 16;
+        rc->set_vs_constant_buffer_range(1, g_buf_object_ring.Get(), offset / 16, constant_count);
+        return;
+      }
+      g_object_ring_fallbacks++;
+    }
+
+    rc->set_vs_constant_buffer(1, g_buf_object_constants.Get());
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    renderer->ctx->Map(g_buf_object_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    memcpy(mapped.pData, data, size);
+    renderer->ctx->Unmap(g_buf_object_constants.Get(), 0);
+  }
+
+  void draw_indexed(u32 index_count, u32 first_index, i32 base_vertex) override
+  {
+    renderer->ctx->DrawIndexed(index_count, first_index, base_vertex);
+  }
+
+  void set_instance_data(void const* data, u32 stride, u32 count) override
+  {
+    if (count > g_instance_capacity)
+    {
+      g_instance_capacity = count + count / 2;
+      D3D11_BUFFER_DESC desc = {};
+      desc.ByteWidth = g_instance_capacity * stride;
+      desc.Usage = D3D11_USAGE_DYNAMIC;
+      desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+      desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+      HRESULT hr = renderer->device->CreateBuffer(&desc, nullptr, g_buf_instances.ReleaseAndGetAddressOf());
+      my_assert(SUCCEEDED(hr));
+    }
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    renderer->ctx->Map(g_buf_instances.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    memcpy(mapped.pData, data, count * stride);
+    renderer->ctx->Unmap(g_buf_instances.Get(), 0);
+    rc->set_vertex_buffer(1, g_buf_instances.Get(), stride, 0);
+  }
+
+  void draw_indexed_instanced(u32 index_count, u32 first_index, i32 base_vertex,
+                              u32 instance_count, u32 first_instance) override
+  {
+    renderer->ctx->DrawIndexedInstanced(index_count, instance_count, first_index, base_vertex, first_instance);
   }
 };
 
-// Entity. Hello there. Root object has a pool of these.
+// Retires ring memory of frames which GPU has finished.
+// Waits for the oldest frame when all queries are in use.
+static void retire_completed_frames(d3d11_renderer& renderer)
+{
+  while (g_completed_fence < g_frame_fence)
+  {
+    ID3D11Query* query = g_frame_queries[(g_completed_fence + 1) % upload_ring::MAX_FRAMES_IN_FLIGHT].Get();
+    const bool must_wait = g_frame_fence - g_completed_fence >= upload_ring::MAX_FRAMES_IN_FLIGHT - 1;
+    const HRESULT hr = renderer.ctx->GetData(query, nullptr, 0, must_wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+    if (hr == S_OK)
+      g_completed_fence++;
+    else if (must_wait == false)
+      break;
+  }
+  g_object_ring.retire(g_completed_fence);
+}
 
-struct entity
+static void end_frame_fence(d3d11_renderer& renderer)
 {
-  static_string<32> name = {};
-  transform tr = {};
-  const vertex_data* vd = nullptr;
-  glm::vec3 color = { 0.5f, 0.8f, 0.5f };
-  entity* parent = nullptr;
+  g_frame_fence++;
+  renderer.ctx->End(g_frame_queries[g_frame_fence % upload_ring::MAX_FRAMES_IN_FLIGHT].Get());
+  g_object_ring.end_frame(g_frame_fence);
+}
+
+static void pack_object_constants(const entity& e, object_constants& out)
+{
+  affine ltw = e.tr.local_to_world_affine();
+  entity* pe = e.parent;
+  while (pe)
+  {
+    ltw = affine_mul(pe->tr.local_to_world_affine(), ltw);
+    pe = pe->parent;
+  }
+  out.local_to_world = ltw;
+  out.object_color = pack_color(e.color);
+  out._pad0[0] = 0;
+  out._pad0[1] = 0;
+  out._pad0[2] = 0;
+}
+
+// Previous layout of object constants with two full matrices, kept to compare packing cost.
+struct object_constants_mat4
+{
+  glm::mat4x4 local_to_world;
+  glm::mat4x4 world_to_local_transposed;
+  glm::vec3 object_color;
+  f32 _pad0;
 };
 
-// Render system uses this for frustum culling.
-
-static bool aabb_view_frustum_intersection(const camera& cam, const vertex_data& vd, const transform& tr)
-{
-  // Points of AABB
-  // c - center, e - extent
-  // p = c + s * e, where s = {-1, -1, -1} ... {1, 1, 1}
-  // T - local to view transform matrix
-  // T(c+s*e) = T(c) + T(s*e)
-  // T(s*e).x = T.xx * s.x * e.x + T.xy * s.y * e.y + T.xz * s.z * e.z
-  // T(s*e).y = T.yx * s.x * e.x + T.yy * s.y * e.y + T.yz * s.z * e.z
-  // T(s*e).z = T.zx * s.x * e.x + T.zy * s.y * e.y + T.zz * s.z * e.z
-  // let cx = e.x * (T.xx, T.yx, T.zx),
-  // let cy = e.y * (T.xy, T.yy, T.zy),
-  // let cz = e.z * (T.xz, T.yz, T.zz),
-  // then T(s*e) = cx * s.x + cy * s.y + cz * s.z
-  const glm::mat4x4 tr_mat = cam.world_to_view() * tr.local_to_world();
-  const glm::vec4 c = tr_mat * glm::vec4{ vd.aabb_center, 1.0f };
-  const glm::vec4 cx = vd.aabb_extent[0] * tr_mat[0];
-  const glm::vec4 cy = vd.aabb_extent[1] * tr_mat[1];
-  const glm::vec4 cz = vd.aabb_extent[2] * tr_mat[2];
-  const glm::vec4 corners[8]
-  {
-    c + cx + cy + cz,
-    c + cx + cy - cz,
-    c + cx - cy + cz,
-    c + cx - cy - cz,
-    c - cx + cy + cz,
-    c - cx + cy - cz,
-    c - cx - cy + cz,
-    c - cx - cy - cz,
-  };
-
-  // Frustum plane normals are pointed outside the view frustum.
-  const f32 t = tan(glm::radians(cam.fov_degrees) * 0.5f);
-  const f32 a = cam.aspect;
-  const glm::vec4 frustum[6]
-  {
-    {0.0f, 0.0f, +1.0f, -cam.z_near},
-    {0.0f, 0.0f, -1.0f, -cam.z_far},
-    {+1.0f, 0.0f, a * t, 0.0f},
-    {-1.0f, 0.0f, a * t, 0.0f},
-    {0.0f, +1.0f, t, 0.0f},
-    {0.0f, -1.0f, t, 0.0f},
-  };
-  for (i32 plane = 0; plane < 6; plane++)
-  {
-    int i = 0;
-    int o = 0;
-    for (i32 vert = 0; vert < 8 && (i == 0 || o == 0); vert++)
+static void pack_object_constants_mat4(const entity& e, object_constants_mat4& out)
+{
+  glm::mat4x4 ltw = e.tr.local_to_world();
+  glm::mat4x4 wtlt = e.tr.world_to_local_transposed();
+  entity* pe = e.parent;
+  while (pe)
+  {
+    ltw = pe->tr.local_to_world() * ltw;
+    wtlt = pe->tr.world_to_local_transposed() * wtlt;
+    pe = pe->parent;
+  }
+  out.local_to_world = ltw;
+  out.world_to_local_transposed = wtlt;
+  out.object_color = e.color;
+  out._pad0 = 0.0f;
+}
+
+static bool g_pack_benchmark = false;
+static f64 g_pack_affine_time = 0.0;
+static f64 g_pack_mat4_time = 0.0;
+static u32 g_pack_count = 0;
+static vector<object_constants> g_pack_affine = {};
+static vector<object_constants_mat4> g_pack_mat4 = {};
+
+// Packs constants of all entities with both layouts.
+static void benchmark_constants_packing(const scene& sc)
+{
+  g_pack_affine.resize(sc.entities.size(), {});
+  g_pack_mat4.resize(sc.entities.size(), {});
+
+  f64 start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  for (u32 i = 0; i < sc.entities.size(); i++)
+    pack_object_constants_mat4(*sc.entities[i], g_pack_mat4[i]);
+  g_pack_mat4_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - start_time;
+
+  start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  for (u32 i = 0; i < sc.entities.size(); i++)
+    pack_object_constants(*sc.entities[i], g_pack_affine[i]);
+  g_pack_affine_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - start_time;
+
+  g_pack_count = sc.entities.size();
+}
+
+static bool uses_cluster_culling(const entity& e)
+{
+  return g_cluster_culling && uses_cluster_culling(e, (u32)g_cluster_min_meshlets);
+}
+
+// Records draws of visible entities [begin, end), returns number of triangles.
+static u32 record_draws(const scene& sc, const frustum& view_frustum, const vector<void*>& visible, u32 begin, u32 end,
+                        command_buffer& commands, vector<index_range>& ranges, meshlet_cull_stats& meshlet_stats)
+{
+  u32 num_triangles = 0;
+  for (u32 i = begin; i < end; i++)
+  {
+    const entity* e = static_cast<const entity*>(visible[i]);
+    object_constants constants;
+    pack_object_constants(*e, constants);
+
+    const vertex_data_lod& lod = e->vd->lods[e->lod];
+    ranges.clear();
+    if (uses_cluster_culling(*e))
     {
-      const glm::vec4& v = corners[vert];
-      const glm::vec4& p = frustum[plane];
-      int d = v.x * p.x + v.y * p.y + v.z * p.z > -p.w;
-      o |= d;
-      i |= !d;
+      cull_entity_meshlets(sc, *e, view_frustum, g_wireframe == false, ranges, meshlet_stats);
+      if (ranges.size() == 0)
+        continue;
+    }
+    else
+    {
+      ranges.push_back({ 0, lod.index_count });
+    }
+
+    draw_packet packet;
+    packet.pass = PASS_OPAQUE;
+    packet.pipeline = (g_wireframe ? PIPELINE_WIREFRAME : PIPELINE_SOLID) | (g_instancing ? PIPELINE_INSTANCED_BIT : 0);
+    packet.mesh = (u32)(e->vd - g_vds.data());
+    packet.base_vertex = lod.base_vertex;
+    packet.constants_offset = commands.push_constants(&constants, sizeof(constants));
+    packet.constants_size = sizeof(constants);
+    packet.object = i;
+    // Opaque geometry goes front to back.
+    // Level of detail is a part of the mesh field, so draws of the same index range end up together.
+    const f32 depth = glm::length(affine_translation(constants.local_to_world) - sc.cam.tr.t);
+    const u32 mesh_key = packet.mesh * MAX_LODS + e->lod;
+    const u64 key = g_sort_draws ? make_sort_key(packet.pass, packet.pipeline, mesh_key, depth) : 0;
+    // Ranges of one entity share its constants.
+    for (u32 r = 0; r < ranges.size(); r++)
+    {
+      packet.index_count = ranges[r].index_count;
+      packet.first_index = lod.first_index + ranges[r].first_index;
+      num_triangles += packet.index_count / 3;
+      commands.push_draw(key, packet);
     }
-    if (!i) return false; // no points inside the frustum
-    if (o) return true;   // points are on both sides of the frustum plane
   }
-  return true; // all points inside the frustum
+  return num_triangles;
 }
 
-// This is a root object.
+// Culls the scene and records sorted draw commands of visible entities into g_commands.
+static void build_commands(const scene& sc, const frustum& view_frustum)
+{
+  const f64 cull_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  track_camera_motion(g_camera_motion, sc.cam);
+  g_visible_entities.clear();
+  cull_scene(sc, view_frustum, g_cull_mode, g_temporal_coherence, g_camera_motion, g_visible_entities, g_cull_stats);
+  g_cull_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - cull_start_time;
+
+  if (g_multi_view_benchmark)
+    benchmark_multi_view_culling(sc);
+  if (g_pack_benchmark)
+    benchmark_constants_packing(sc);
+
+  g_num_frustum_visible = g_visible_entities.size();
+  g_num_occluders = 0;
+  g_num_occluded = 0;
+  if (g_occlusion_enabled)
+  {
+    const f64 occlusion_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+    cull_occluded(sc, g_scene_constants.world_to_screen, g_visible_entities);
+    g_occlusion_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - occlusion_start_time;
+  }
+
+  {
+    const f64 lod_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+    select_lods(sc, g_visible_entities, g_lod_hysteresis, g_lod_selection);
+    g_lod_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - lod_start_time;
+  }
+
+  g_num_visible = g_visible_entities.size();
+  const f64 record_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  const u32 record_threads = g_parallel_recording ? glm::min(jobs::thread_count(), MAX_RECORD_THREADS) : 1;
+  for (u32 i = 0; i < record_threads; i++)
+  {
+    g_thread_commands[i].clear();
+    g_thread_triangles[i] = 0;
+    g_thread_meshlet_stats[i] = {};
+  }
+  if (g_parallel_recording)
+  {
+    jobs::parallel_for(g_visible_entities.size(), RECORD_CHUNK_SIZE, [&](u32 begin, u32 end, u32 thread_idx)
+    {
+      my_assert(thread_idx < record_threads);
+      g_thread_triangles[thread_idx] += record_draws(sc, view_frustum, g_visible_entities, begin, end,
+                                                     g_thread_commands[thread_idx], g_thread_ranges[thread_idx],
+                                                     g_thread_meshlet_stats[thread_idx]);
+    });
+    jobs::parallel_for(record_threads, 1, [](u32 begin, u32 end, u32)
+    {
+      for (u32 i = begin; i < end; i++)
+        g_thread_commands[i].sort();
+    });
+  }
+  else
+  {
+    g_thread_triangles[0] = record_draws(sc, view_frustum, g_visible_entities, 0, g_visible_entities.size(),
+                                         g_thread_commands[0], g_thread_ranges[0], g_thread_meshlet_stats[0]);
+    g_thread_commands[0].sort();
+  }
+  g_num_triangles = 0;
+  g_meshlet_stats = {};
+  for (u32 i = 0; i < record_threads; i++)
+  {
+    g_num_triangles += g_thread_triangles[i];
+    accumulate(g_meshlet_stats, g_thread_meshlet_stats[i]);
+  }
+  g_command_record_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - record_start_time;
+
+  const f64 merge_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  g_commands.merge(g_thread_commands, record_threads);
+  if (g_instancing)
+    g_commands.build_instance_batches();
+  g_command_merge_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - merge_start_time;
+}
+
+// Retained render list.
+// Sorted commands of the previous frame are submitted again while nothing they depend on has changed.
+// Moved entities which stay visible at the same level of detail get their constants patched in place,
+// any other change rebuilds the list.
 
-struct scene
+static constexpr u32 MAX_PATCHED_ENTITIES = 256;
+
+static constexpr u32 RETAINED_REBUILT = 0;
+static constexpr u32 RETAINED_PATCHED = 1;
+static constexpr u32 RETAINED_REPLAYED = 2;
+
+// Settings which affect contents of the command list.
+struct retained_settings
 {
-  glm::vec3 light_dir = glm::normalize(glm::vec3{ 1.0f, 1.0f, 1.0f });
-  glm::vec3 light_color = glm::vec3{ 1.0f, 1.0f, 1.0f };
-  glm::vec3 ambient_color = glm::vec3{ 0.05f, 0.05f, 0.05f };
-  camera cam = {};
-  vector<entity*> entities;
-  object_pool<entity> entity_pool = { 1024 * 1024 };
+  i32 cull_mode;
+  bool occlusion_enabled;
+  f32 occluder_min_size;
+  f32 lod_hysteresis;
+  bool sort_draws;
+  bool wireframe;
+  bool instancing;
+  bool cluster_culling;
+  i32 cluster_min_meshlets;
+  f32 lod_screen_error;
 };
 
-// Render system uses this to render everything.
+static bool g_retain_commands = true;
+// Cleared by changes which are not tracked, e.g. mesh arena compaction.
+static bool g_retained_valid = false;
+static u64 g_retained_structure_epoch = 0;
+static glm::mat4x4 g_retained_world_to_screen = {};
+static retained_settings g_retained_settings = {};
+// Packet of every drawn entity, built on the first patch after a rebuild.
+static hash_map<const entity*, u32> g_retained_packets;
+static bool g_retained_packets_built = false;
+static u32 g_retained_state = RETAINED_REBUILT;
+static u32 g_num_patched = 0;
+static f64 g_retained_update_time = 0.0;
+
+static retained_settings current_retained_settings()
+{
+  retained_settings ret;
+  ret.cull_mode = g_cull_mode;
+  ret.occlusion_enabled = g_occlusion_enabled;
+  ret.occluder_min_size = g_occluder_min_size;
+  ret.lod_hysteresis = g_lod_hysteresis;
+  ret.sort_draws = g_sort_draws;
+  ret.wireframe = g_wireframe;
+  ret.instancing = g_instancing;
+  ret.cluster_culling = g_cluster_culling;
+  ret.cluster_min_meshlets = g_cluster_min_meshlets;
+  ret.lod_screen_error = g_lod_screen_error;
+  return ret;
+}
 
-static u32 g_num_visible = 0;
+static bool same_settings(const retained_settings& a, const retained_settings& b)
+{
+  return a.cull_mode == b.cull_mode && a.occlusion_enabled == b.occlusion_enabled
+    && a.occluder_min_size == b.occluder_min_size && a.lod_hysteresis == b.lod_hysteresis
+    && a.sort_draws == b.sort_draws && a.wireframe == b.wireframe && a.instancing == b.instancing
+    && a.cluster_culling == b.cluster_culling && a.cluster_min_meshlets == b.cluster_min_meshlets
+    && a.lod_screen_error == b.lod_screen_error;
+}
+
+static void retain_commands(const scene& sc)
+{
+  g_retained_valid = true;
+  g_retained_structure_epoch = sc.structure_epoch;
+  g_retained_world_to_screen = g_scene_constants.world_to_screen;
+  g_retained_settings = current_retained_settings();
+  g_retained_packets_built = false;
+  g_retained_state = RETAINED_REBUILT;
+}
+
+// Brings g_commands up to date with the scene, returns false if they have to be rebuilt.
+static bool update_retained_commands(const scene& sc, const frustum& view_frustum)
+{
+  if (g_retained_valid == false || sc.structure_epoch != g_retained_structure_epoch
+      || g_scene_constants.world_to_screen != g_retained_world_to_screen
+      || same_settings(current_retained_settings(), g_retained_settings) == false)
+    return false;
+
+  g_num_patched = 0;
+  if (sc.moved.size() == 0)
+  {
+    g_retained_state = RETAINED_REPLAYED;
+    return true;
+  }
+  // Moved occluders change visibility of everything behind them.
+  if (g_occlusion_enabled || sc.moved.size() > MAX_PATCHED_ENTITIES)
+    return false;
+
+  if (g_retained_packets_built == false)
+  {
+    g_retained_packets.clear();
+    for (u32 i = 0; i < g_commands.packet_count(); i++)
+      g_retained_packets.insert(static_cast<const entity*>(g_visible_entities[g_commands.packet(i).object]), u32{ i });
+    g_retained_packets_built = true;
+  }
+
+  // Patching stops at the first entity which can't be patched, the list is rebuilt anyway.
+  for (u32 i = 0; i < sc.moved.size(); i++)
+  {
+    const entity* e = sc.moved[i];
+    const auto it = g_retained_packets.find(e);
+    const bool was_drawn = it != g_retained_packets.end();
+    if (e->vd == nullptr || e->batch != nullptr)
+    {
+      if (was_drawn)
+        return false;
+      continue;
+    }
+
+    const aabb& box = sc.tree.fat_aabb(e->bvh_proxy);
+    u32 plane_mask;
+    const bool visible = cull_aabb(view_frustum, box, 0x3F, &plane_mask) != cull_result::outside;
+    if (visible != was_drawn)
+      return false;
+    if (visible == false)
+      continue;
+    // Visible meshlets depend on the transform.
+    if (uses_cluster_culling(*e))
+      return false;
+
+    glm::vec3 center;
+    f32 radius;
+    entity_lod_sphere(sc, *e, center, radius);
+    f32 size;
+    lod::compute_screen_sizes(&center.x, &center.y, &center.z, &radius, 1, sc.cam.tr.t, sc.cam.fov_degrees, &size);
+    if (lod::select(size, e->lod, e->vd->lod_min_screen_sizes, e->vd->lod_count, g_lod_hysteresis) != e->lod)
+      return false;
+
+    object_constants constants;
+    pack_object_constants(*e, constants);
+    g_commands.patch_constants(it->value, &constants, sizeof(constants));
+    g_num_patched++;
+  }
+  g_retained_state = RETAINED_PATCHED;
+  return true;
+}
 
-static void render_scene(d3d11_renderer& renderer, const scene& sc,
+static void render_scene(d3d11_renderer& renderer, scene& sc, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv,
                          glm::vec2 viewport_pos, glm::vec2 viewport_size)
 {
   g_scene_constants.ambient_color = sc.ambient_color;
@@ -681,118 +1733,196 @@ static void render_scene(d3d11_renderer& renderer, const scene& sc,
     memcpy(mapped.pData, &g_scene_constants, sizeof(g_scene_constants));
     renderer.ctx->Unmap(g_buf_scene_constants.Get(), 0);
   }
+  if (g_capture_frames_left > 0)
+  {
+    g_capture.begin_frame(g_capture_frame++);
+    g_capture.upload(CAPTURE_BUFFER_SCENE_CONSTANTS, 0, &g_scene_constants, sizeof(g_scene_constants));
+  }
 
-  renderer.ctx->OMSetBlendState(g_blend_state.Get(), nullptr, 0xFFFFFFFu);
-  renderer.ctx->OMSetDepthStencilState(g_depth_stencil_state.Get(), 0);
-  renderer.ctx->OMSetRenderTargets(1, renderer.swapchain_rtv.GetAddressOf(), renderer.dsv.Get());
+  update_lod_screen_error(viewport_size.y);
+  const frustum view_frustum = make_frustum(g_scene_constants.world_to_screen);
+  const f64 retained_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  const bool reused = g_retain_commands && update_retained_commands(sc, view_frustum);
+  g_retained_update_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - retained_start_time;
+  sc.moved.clear();
+  if (reused)
+  {
+    g_cull_time = 0.0;
+    g_occlusion_time = 0.0;
+    g_lod_time = 0.0;
+    g_command_record_time = 0.0;
+    g_command_merge_time = 0.0;
+  }
+  else
+  {
+    build_commands(sc, view_frustum);
+    retain_commands(sc);
+  }
 
-  g_num_visible = 0;
-  for (u32 i = 0; i < sc.entities.size(); i++)
+  const f64 submit_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  if (g_object_ring_supported)
+    retire_completed_frames(renderer);
+  g_object_ring_fallbacks = 0;
+
+  // UI rendering binds its own state, nothing is known about the context at this point.
+  g_d3d11_context.ctx = renderer.ctx.Get();
+  g_d3d11_context.ctx1 = renderer.ctx1.Get();
+  g_state_filter.invalidate();
+  g_state_filter.reset_counters();
+  d3d11_backend backend;
+  backend.renderer = &renderer;
+  backend.rtv = rtv;
+  backend.dsv = dsv;
+  backend.rc = g_state_filtering ? static_cast<render_context*>(&g_state_filter) : &g_d3d11_context;
+  backend.viewport = { viewport_pos.x, viewport_pos.y, viewport_size.x, viewport_size.y, 0.0f, 1.0f };
+  render_backend* target = &backend;
+  if (g_capture_frames_left > 0)
   {
-    entity* e = sc.entities[i];
-    if (e->vd == nullptr || aabb_view_frustum_intersection(sc.cam, *e->vd, e->tr) == false)
-      continue;
-    g_num_visible++;
-    glm::mat4x4 ltw = e->tr.local_to_world();
-    glm::mat4x4 wtlt = e->tr.world_to_local_transposed();
-    {
-      entity* pe = e->parent;
-      while (pe)
-      {
-        ltw = pe->tr.local_to_world() * ltw;
-        wtlt = pe->tr.world_to_local_transposed() * wtlt;
-        pe = pe->parent;
-      }
-    }
-    g_object_constants.local_to_world = ltw;
-    g_object_constants.world_to_local_transposed = wtlt;
-    g_object_constants.object_color = e->color;
+    g_capture.target = &backend;
+    target = &g_capture;
+  }
+  if (g_instancing)
+    g_commands.submit_instanced(*target, &g_submit_stats);
+  else
+    g_commands.submit(*target, &g_submit_stats);
+  if (g_object_ring_supported)
+    end_frame_fence(renderer);
+  if (g_capture_frames_left > 0)
+  {
+    g_capture.end_frame();
+    g_capture.target = nullptr;
+    if (--g_capture_frames_left == 0 && !g_capture.write_file("capture.bin"))
     {
-      D3D11_MAPPED_SUBRESOURCE mapped;
-      renderer.ctx->Map(g_buf_object_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
-      memcpy(mapped.pData, &g_object_constants, sizeof(g_object_constants));
-      renderer.ctx->Unmap(g_buf_object_constants.Get(), 0);
+      if (console::g_log.size() == console::g_log.capacity()) console::g_log.pop_front();
+      console::g_log.push_back({ "Failed to write capture.bin" });
     }
-    u32 stride = sizeof(vertex);
-    u32 offset = 0;
-    renderer.ctx->IASetVertexBuffers(0, 1, e->vd->data.GetAddressOf(), &stride, &offset);
-    renderer.ctx->IASetIndexBuffer(e->vd->data.Get(), DXGI_FORMAT_R32_UINT, e->vd->index_data_offset);
-    renderer.ctx->IASetInputLayout(g_input_layout.Get());
-    renderer.ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    renderer.ctx->VSSetShader(g_vs.Get(), nullptr, 0);
-    renderer.ctx->VSSetConstantBuffers(0, 1, g_buf_scene_constants.GetAddressOf());
-    renderer.ctx->VSSetConstantBuffers(1, 1, g_buf_object_constants.GetAddressOf());
-    renderer.ctx->PSSetShader(g_ps.Get(), nullptr, 0);
-    renderer.ctx->PSSetConstantBuffers(0, 1, g_buf_scene_constants.GetAddressOf());
-    renderer.ctx->PSSetConstantBuffers(1, 1, g_buf_object_constants.GetAddressOf());
-    renderer.ctx->RSSetState(g_rasterizer_state_solid.Get());
-    D3D11_VIEWPORT vp = {};
-    vp.MinDepth = 0.0f;
-    vp.MaxDepth = 1.0f;
-    vp.TopLeftX = viewport_pos.x;
-    vp.TopLeftY = viewport_pos.y;
-    vp.Width = viewport_size.x;
-    vp.Height = viewport_size.y;
-    renderer.ctx->RSSetViewports(1, &vp);
-    renderer.ctx->DrawIndexed(e->vd->index_count, 0, 0);
   }
+  g_command_submit_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - submit_start_time;
 }
 
-static scene g_scene = {};
+// CPU renderer, draws what the camera sees with the finest level of every mesh.
+// Used as a reference image and to measure rasterization throughput over job threads.
 
-// Exported function to manipulate scene. Make more of these to extend console capabilities.
+static constexpr u32 SOFT_RENDER_WIDTH = 1280;
+static constexpr u32 SOFT_RENDER_HEIGHT = 720;
+static soft_renderer g_soft_renderer;
+static vector<soft_renderer::draw> g_soft_draws;
+static vector<void*> g_soft_visible;
+static bool g_soft_render_enabled = false;
+static f64 g_soft_render_time = 0.0;
 
-static int luaexport_set_light_dir(lua_State* lua)
+static void soft_render_scene(const scene& sc)
 {
-  glm::vec3 dir;
-  dir[0] = (f32)luaL_checknumber(lua, 1);
-  dir[1] = (f32)luaL_checknumber(lua, 2);
-  dir[2] = (f32)luaL_checknumber(lua, 3);
-  if (dir[0] == 0.0f && dir[1] == 0.0f && dir[2] == 0.0f)
+  const f64 start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+  g_soft_renderer.resize(SOFT_RENDER_WIDTH, SOFT_RENDER_HEIGHT);
+  camera cam = sc.cam;
+  cam.aspect = (f32)SOFT_RENDER_WIDTH / (f32)SOFT_RENDER_HEIGHT;
+  soft_renderer::frame_constants constants;
+  constants.world_to_screen = cam.world_to_screen();
+  constants.light_dir = glm::normalize(sc.light_dir);
+  constants.light_color = sc.light_color;
+  constants.ambient_color = sc.ambient_color;
+
+  g_soft_visible.clear();
+  sc.tree.query(make_frustum(constants.world_to_screen), g_soft_visible);
+  g_soft_draws.clear();
+  for (u32 i = 0; i < g_soft_visible.size(); i++)
   {
-    lua_pushstring(lua, "nonzero vector expected");
-    return lua_error(lua);
+    const entity* e = static_cast<const entity*>(g_soft_visible[i]);
+    object_constants oc;
+    pack_object_constants(*e, oc);
+    g_soft_draws.push_back({ vertices_of(*e->vd), e->vd->occluder_indices.data(), e->vd->occluder_indices.size(),
+                             oc.local_to_world, oc.object_color });
   }
-  g_scene.light_dir = glm::normalize(dir);
-  return 0;
+  g_soft_renderer.render(constants, g_soft_draws.data(), g_soft_draws.size());
+  g_soft_render_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - start_time;
+}
+
+// Frame graph of a frame, rebuilt every frame.
+// Back buffer and depth buffer are owned by the renderer and imported,
+// their views are only referenced while the frame is rendered so that swapchain can be resized.
+
+struct frame_pass_data
+{
+  d3d11_renderer* renderer;
+  u32 back_buffer;
+  u32 depth;
+};
+
+static frame_graph g_frame_graph;
+static d3d11_frame_graph_backend g_frame_graph_backend;
+static d3d11_fg_texture g_back_buffer;
+static d3d11_fg_texture g_depth_buffer;
+static frame_pass_data g_frame_pass_data;
+
+static scene g_scene = {};
+static script_bindings g_script_bindings = {};
+
+// Loaded meshes by content, built-in and batch meshes are not registered.
+static mesh_loader g_mesh_loader;
+
+// Store of loaded meshes, ctx is the renderer.
+static u32 allocate_loaded_mesh(void*)
+{
+  const u32 id = allocate_mesh_slot();
+  return id == MAX_MESHES ? mesh_registry::INVALID_ID : id;
 }
 
-// Function to set up default scene.
-// Redo in terms of components and entities.
+static bool create_loaded_mesh(void* host, u32 id, cooked_mesh const& mesh)
+{
+  if (create_vertex_data(*static_cast<d3d11_renderer*>(host), mesh, g_vds[id]) == false)
+    return false;
+  set_lod_screen_error(g_vds[id], g_lod_screen_error);
+  return true;
+}
 
-static void setup_scene(scene& sc)
+static void destroy_loaded_mesh(void* host, u32 id)
 {
-  sc.light_dir = glm::normalize(glm::vec3{ 1.0f, 0.5f, 0.75f });
-  sc.cam.tr.t = { 0.0f, 0.0f, 24.0f };
-  const f32 r = 8.0f;
-  const f32 s = 1.0f;
-  for (f32 x = -r; x <= r; x += s)
+  // Batches hold copies of baked entities, they are baked again without the destroyed ones.
+  bool baked = false;
+  for (u32 i = 0; i < g_scene.entities.size() && baked == false; i++)
+    baked = g_scene.entities[i]->vd == &g_vds[id] && g_scene.entities[i]->batch != nullptr;
+  if (baked)
+    unbake_static_entities(g_scene);
+  destroy_entities_with_mesh(g_scene, &g_vds[id]);
+  destroy_vertex_data(g_vds[id]);
+  g_vds[id] = vertex_data{};
+  if (baked)
   {
-    for (f32 y = -r; y <= r; y += s)
-    {
-      for (f32 z = -r; z <= r; z += s)
-      {
-        if (sc.entity_pool.size() == sc.entity_pool.capacity())
-        {
-          return;
-        }
-        sc.entities.push_back(sc.entity_pool.construct());
-        entity* e = sc.entities.back();
-        e->vd = &g_vds[1];
-        e->tr.t.x = x;
-        e->tr.t.y = y;
-        e->tr.t.z = z;
-        e->tr.s.x = 0.5f;
-        e->tr.s.y = 0.5f;
-        e->tr.s.z = 0.5f;
-        e->color.x = (x + r) / (r * 2.0f);
-        e->color.y = (y + r) / (r * 2.0f);
-        e->color.z = (z + r) / (r * 2.0f);
-      }
-    }
+    if (console::g_log.size() == console::g_log.capacity()) console::g_log.pop_front();
+    console::g_log.push_back({ "Released mesh was baked, static entities are baked again" });
+    bake_static_entities(*static_cast<d3d11_renderer*>(host), g_scene, g_bake_cell_size);
   }
 }
 
+static vertex_data const* get_loaded_mesh(void*, u32 id)
+{
+  return &g_vds[id];
+}
+
+static mesh_store loaded_mesh_store(void* host)
+{
+  return { host, allocate_loaded_mesh, create_loaded_mesh, destroy_loaded_mesh, get_loaded_mesh,
+           vertex_format_size(g_mesh_arena.format) };
+}
+
+// Called from scripts, host is the renderer.
+static i32 load_mesh(void* host, const char* path)
+{
+  const i32 id = g_mesh_loader.load(path, loaded_mesh_store(host));
+  if (id >= 0)
+    g_retained_valid = false;
+  return id;
+}
+
+static bool release_mesh(void* host, u32 id)
+{
+  if (g_mesh_loader.release(id, loaded_mesh_store(host)) == false)
+    return false;
+  g_retained_valid = false;
+  return true;
+}
+
 // Exported function to print to console.
 static int luaexport_print(lua_State* lua)
 {
@@ -818,25 +1948,6 @@ static int luaexport_print(lua_State* lua)
   return 0;
 }
 
-// Setup lua state.
-// Load necessary libraries (nothing more).
-// Scripting state. Table per entity? Not sure...
-// Engine table for engine API to be used in scripting components.
-// Scripting component = object + functions + reference to owner entity.
-
-static void setup_lua(lua_State** pLua)
-{
-  *pLua = luaL_newstate();
-  lua_State* lua = *pLua;
-  luaL_openlibs(lua);
-  lua_pushglobaltable(lua);
-  lua_pushcfunction(lua, luaexport_print);
-  lua_setfield(lua, -2, "print");
-  lua_pushcfunction(lua, luaexport_set_light_dir);
-  lua_setfield(lua, -2, "set_light_dir");
-  lua_pop(lua, 1);
-}
-
 application::application(SDL_Window* window) :
   m_window{ window }
 {
@@ -852,12 +1963,16 @@ application::application(SDL_Window* window) :
   ImGui_ImplSDL2_InitForD3D(window);
   ImGui_ImplDX11_Init(renderer.device.Get(), renderer.ctx.Get());
 
+  jobs::init();
+
   create_vds(renderer);
   create_common_pipeline_objects(renderer);
+  g_frame_graph_backend.device = renderer.device.Get();
 
-  setup_lua(&lua);
+  g_script_bindings = { &g_scene, &g_vds, load_mesh, release_mesh, &renderer };
+  setup_lua(&lua, &g_script_bindings, luaexport_print);
 
-  setup_scene(g_scene);
+  setup_scene(g_scene, &g_vds[MESH_CUBE]);
 }
 
 application::~application()
@@ -865,8 +1980,11 @@ application::~application()
   lua_close(lua);
 
   destroy_common_pipeline_objects();
+  g_frame_graph.release(g_frame_graph_backend);
   destroy_vds();
 
+  jobs::shutdown();
+
   ImGui_ImplDX11_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
@@ -995,9 +2113,15 @@ static f32 g_mouse_angle_y = 0.0f;
 static bool g_camera_controls_active = false;
 static i32 g_selected_entity = (i32)-1;
 
+// Scripted camera path around the scene. Used to profile culling with a moving camera.
+static bool g_flythrough = false;
+static f64 g_flythrough_time = 0.0;
+
 // Draw ImGUI here.
 void application::update(f64 delta_time)
 {
+  call_script_hook(lua, "update", delta_time);
+
   // In-editor camera.
   if (g_camera_controls_active)
   {
@@ -1017,6 +2141,12 @@ void application::update(f64 delta_time)
     g_mouse_angle_y += g_mouse_dy * 0.00125f;
     g_mouse_angle_y = glm::clamp(g_mouse_angle_y, -glm::pi<f32>() * 0.25f, glm::pi<f32>() * 0.25f);
   }
+  if (g_flythrough)
+  {
+    g_flythrough_time += delta_time;
+    flythrough_camera(g_flythrough_time, g_scene.cam.tr.t, g_mouse_angle_x);
+    g_mouse_angle_y = 0.0f;
+  }
   g_scene.cam.tr.r = glm::angleAxis(g_mouse_angle_x, glm::vec3{ 0.0f, -1.0f, 0.0f })
     * glm::angleAxis(g_mouse_angle_y, glm::vec3{ -1.0f, 0.0f, 0.0f });
 
@@ -1058,7 +2188,241 @@ void application::update(f64 delta_time)
     if (ImGui::RadioButton("MS x4", sample_count == 4)) renderer.set_multisample_count(4);
 
     ImGui::Text("View frustum culling");
-    ImGui::Text("Visible entities: %u", g_num_visible);
+    ImGui::Checkbox("Fly-through camera", &g_flythrough);
+    if (ImGui::RadioButton("flat", g_cull_mode == CULL_MODE_FLAT)) g_cull_mode = CULL_MODE_FLAT;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("bvh", g_cull_mode == CULL_MODE_BVH)) g_cull_mode = CULL_MODE_BVH;
+    ImGui::Text("Visible entities: %u / %u", g_num_visible, g_scene.entities.size());
+    ImGui::Checkbox("Occlusion culling", &g_occlusion_enabled);
+    if (g_occlusion_enabled)
+    {
+      ImGui::SliderFloat("Occluder size", &g_occluder_min_size, 0.0f, 0.5f);
+      ImGui::Text("Frustum visible: %u, occluders: %u", g_num_frustum_visible, g_num_occluders);
+      ImGui::Text("Occluded: %u, visible: %u", g_num_occluded, g_num_visible);
+      ImGui::Text("Occlusion time: %5.3lf ms (%u triangles)", g_occlusion_time * 1000.0, g_occlusion_buffer.triangle_count());
+    }
+    ImGui::Text("Culling time: %5.3lf ms", g_cull_time * 1000.0);
+    if (g_cull_mode == CULL_MODE_FLAT)
+    {
+      ImGui::Checkbox("Temporal coherence", &g_temporal_coherence);
+      ImGui::Text("Plane tests: %u", g_cull_stats.plane_tests);
+      ImGui::Text("Entities skipped by margin: %u", g_cull_stats.coherent_skips);
+    }
+    if (g_cull_mode == CULL_MODE_BVH)
+    {
+      ImGui::Text("BVH height: %u", g_scene.tree.height());
+      ImGui::Text("BVH nodes visited: %u", g_cull_stats.bvh_stats.nodes_visited);
+      ImGui::Text("BVH subtrees accepted/rejected: %u/%u", g_cull_stats.bvh_stats.subtrees_accepted, g_cull_stats.bvh_stats.subtrees_rejected);
+    }
+
+    ImGui::Checkbox("Multi-view culling benchmark", &g_multi_view_benchmark);
+    if (g_multi_view_benchmark)
+    {
+      ImGui::SliderInt("Views", &g_multi_view_count, 1, (i32)MAX_VIEWS);
+      ImGui::Text("Single pass: %5.3lf ms", g_multi_view_single_pass_time * 1000.0);
+      ImGui::Text("Pass per view: %5.3lf ms", g_multi_view_separate_passes_time * 1000.0);
+      for (i32 v = 0; v < g_multi_view_count; v++)
+        ImGui::Text("View %d visible: %u", v, g_multi_view_visible[v]);
+    }
+
+    ImGui::Text("Draw commands");
+    ImGui::Checkbox("Sort draws", &g_sort_draws);
+    ImGui::SameLine();
+    ImGui::Checkbox("Wireframe", &g_wireframe);
+    ImGui::SameLine();
+    ImGui::Checkbox("Instancing", &g_instancing);
+    ImGui::Checkbox("Parallel recording", &g_parallel_recording);
+    ImGui::SameLine();
+    ImGui::Checkbox("Retain commands", &g_retain_commands);
+    if (g_retain_commands)
+    {
+      static const char* const state_names[] = { "rebuilt", "patched", "replayed" };
+      ImGui::Text("Commands %s, patched: %u, check: %5.3lf ms", state_names[g_retained_state], g_num_patched,
+                  g_retained_update_time * 1000.0);
+    }
+    ImGui::Text("Record: %5.3lf ms, merge: %5.3lf ms, submit: %5.3lf ms",
+                g_command_record_time * 1000.0, g_command_merge_time * 1000.0, g_command_submit_time * 1000.0);
+    ImGui::Text("Draw calls: %u, instances: %u", g_submit_stats.draws, g_submit_stats.instances);
+    ImGui::Checkbox("Cluster culling", &g_cluster_culling);
+    if (g_cluster_culling)
+    {
+      ImGui::SliderInt("Min meshlets", &g_cluster_min_meshlets, 1, 64);
+      const meshlet_cull_stats& ms = g_meshlet_stats;
+      ImGui::Text("Meshlets: %u, frustum culled: %u, backface culled: %u", ms.meshlets, ms.frustum_culled,
+                  ms.backface_culled);
+      ImGui::Text("Cluster triangles submitted: %u, culled: %u", ms.triangles_submitted, ms.triangles_culled);
+    }
+    ImGui::Text("Pipeline changes: %u, mesh changes: %u", g_submit_stats.pipeline_changes, g_submit_stats.mesh_changes);
+    ImGui::Checkbox("Constants packing benchmark", &g_pack_benchmark);
+    if (g_pack_benchmark && g_pack_count > 0)
+    {
+      ImGui::Text("3x4: %5.3lf ms, %u bytes per object, %.1f M objects/s", g_pack_affine_time * 1000.0,
+                  (u32)sizeof(object_constants), g_pack_count / g_pack_affine_time * 1e-6);
+      ImGui::Text("4x4: %5.3lf ms, %u bytes per object, %.1f M objects/s", g_pack_mat4_time * 1000.0,
+                  (u32)sizeof(object_constants_mat4), g_pack_count / g_pack_mat4_time * 1e-6);
+    }
+    if (g_object_ring_supported)
+    {
+      ImGui::Checkbox("Object constants ring", &g_object_ring_enabled);
+      ImGui::Text("Ring: %u / %u KB, frames in flight: %u, fallbacks: %u", g_object_ring.used() / 1024,
+                  g_object_ring.capacity() / 1024, g_object_ring.frames_in_flight(), g_object_ring_fallbacks);
+    }
+    ImGui::Checkbox("Filter redundant state", &g_state_filtering);
+    if (g_state_filtering)
+      ImGui::Text("State calls issued: %u, skipped: %u", g_state_filter.issued(), g_state_filter.skipped());
+
+    ImGui::Text("Frame graph");
+    for (u32 i = 0; i < g_frame_graph.execution_order().size(); i++)
+    {
+      ImGui::SameLine();
+      ImGui::Text("%s", g_frame_graph.pass_name(g_frame_graph.execution_order()[i]));
+    }
+    ImGui::Text("Passes: %u, culled: %u", g_frame_graph.pass_count(),
+                g_frame_graph.pass_count() - g_frame_graph.execution_order().size());
+    ImGui::Text("Transient textures: %u, %.2f MB, %.2f MB without aliasing", g_frame_graph.physical_texture_count(),
+                g_frame_graph.transient_memory() / (1024.0 * 1024.0), g_frame_graph.unaliased_memory() / (1024.0 * 1024.0));
+
+    ImGui::Text("Level of detail");
+    ImGui::SliderFloat("Hysteresis", &g_lod_hysteresis, 0.0f, 0.5f);
+    ImGui::Text("LOD selection time: %5.3lf ms", g_lod_time * 1000.0);
+    ImGui::Text("LOD 0/1/2/3: %u/%u/%u/%u", g_lod_selection.counts[0], g_lod_selection.counts[1], g_lod_selection.counts[2],
+                g_lod_selection.counts[3]);
+    ImGui::Text("Triangles: %u", g_num_triangles);
+
+    ImGui::Text("Static batching");
+    {
+      ImGui::SliderFloat("Cell size", &g_bake_cell_size, 1.0f, 32.0f);
+      if (ImGui::Button("Bake static"))
+      {
+        const f64 bake_start_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency();
+        bake_static_entities(renderer, g_scene, g_bake_cell_size);
+        g_bake_time = (f64)SDL_GetPerformanceCounter() / (f64)SDL_GetPerformanceFrequency() - bake_start_time;
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Unbake"))
+        unbake_static_entities(g_scene);
+      ImGui::SameLine();
+      ImGui::Checkbox("Optimize batches", &g_optimize_meshes);
+      ImGui::Checkbox("Generate LODs", &g_generate_lods);
+      ImGui::SameLine();
+      ImGui::SliderFloat("LOD error (pixels)", &g_lod_error_pixels, 0.25f, 16.0f);
+      ImGui::Text("Batches: %u, baked entities: %u, bake time: %5.3lf ms",
+                  g_scene.static_batches.size(), g_num_baked_entities, g_bake_time * 1000.0);
+      if (g_bake_simplify_time > 0.0)
+      {
+        ImGui::Text("LOD generation: %5.3lf ms, %.2f M triangles/s", g_bake_simplify_time * 1000.0,
+                    g_bake_lod_triangles[0] / g_bake_simplify_time * 1e-6);
+        ImGui::Text("Level triangles: %u/%u/%u/%u", g_bake_lod_triangles[0], g_bake_lod_triangles[1],
+                    g_bake_lod_triangles[2], g_bake_lod_triangles[3]);
+      }
+      const mesh_optimization_stats& bo = g_bake_optimization;
+      if (bo.before.triangle_count > 0)
+      {
+        ImGui::Text("Batch optimization: %5.3lf ms, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                    g_bake_optimize_time * 1000.0, acmr(bo.before), acmr(bo.after), atvr(bo.before), atvr(bo.after));
+      }
+    }
+
+    ImGui::Text("Mesh arena");
+    {
+      const range_allocator& vr = g_mesh_arena.vertex_ranges;
+      const range_allocator& ir = g_mesh_arena.index_ranges;
+      ImGui::Text("Vertices: %u / %u, fragmentation: %.3f", vr.capacity() - vr.free_count(), vr.capacity(), vr.fragmentation());
+      ImGui::Text("Index slots: %u / %u, fragmentation: %.3f", ir.capacity() - ir.free_count(), ir.capacity(), ir.fragmentation());
+      const mesh_optimization_stats& mo = g_builtin_optimization;
+      ImGui::Text("Built-in meshes: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", acmr(mo.before), acmr(mo.after),
+                  atvr(mo.before), atvr(mo.after));
+      const mesh_load_stats& ls = g_mesh_loader.stats();
+      if (ls.meshes > 0)
+      {
+        ImGui::Text("Loaded meshes: %u, %llu KB in %.3f ms, %.2f GB/s", ls.meshes, ls.bytes / 1024, ls.time * 1000.0,
+                    (f64)ls.bytes / ls.time * 1e-9);
+        const mesh_registry_stats& rs = g_mesh_loader.registry_stats();
+        ImGui::Text("Shared loads: %u of %u, %llu KB and %u uploads saved, %u resident, %u hash collisions", rs.hits,
+                    rs.hits + rs.misses, rs.bytes_saved / 1024, rs.uploads_avoided, rs.meshes, rs.collisions);
+      }
+      if (ImGui::Button("Compact"))
+      {
+        compact_mesh_arena(renderer);
+        g_retained_valid = false;
+      }
+      ImGui::Text("Vertex format:");
+      static const char* const FORMAT_NAMES[VERTEX_FORMAT_COUNT] = { "float", "16-bit, normals 8", "16-bit, normals 16" };
+      for (u32 i = 0; i < VERTEX_FORMAT_COUNT; i++)
+      {
+        ImGui::SameLine();
+        if (ImGui::RadioButton(FORMAT_NAMES[i], g_mesh_arena.format == i) && g_mesh_arena.format != i)
+          set_vertex_format(renderer, i);
+      }
+      u64 float_bytes = 0;
+      u64 encoded_bytes = 0;
+      for (u32 i = 0; i < g_vds.size(); i++)
+      {
+        float_bytes += (u64)g_vds[i].vertex_count * sizeof(vertex);
+        encoded_bytes += (u64)g_vds[i].vertex_count * vertex_format_size(g_mesh_arena.format);
+      }
+      ImGui::Text("Vertex memory: %llu KB, %llu KB as float, %.1f%% saved", encoded_bytes / 1024, float_bytes / 1024,
+                  float_bytes > 0 ? 100.0 * (f64)(float_bytes - encoded_bytes) / (f64)float_bytes : 0.0);
+      if (ImGui::TreeNode("Encoding error per mesh"))
+      {
+        for (u32 i = 0; i < g_vds.size(); i++)
+        {
+          const vertex_data& vd = g_vds[i];
+          if (vd.vertex_count == 0)
+            continue;
+          const vertex_encoding_error& err = vd.encoding_error;
+          ImGui::Text("%u: %u vertices, %u -> %u bytes, position max %.2e rms %.2e, normal max %.3f mean %.3f deg", i,
+                      vd.vertex_count, vd.vertex_count * (u32)sizeof(vertex),
+                      vd.vertex_count * vertex_format_size(g_mesh_arena.format), err.max_position_error,
+                      err.rms_position_error, err.max_normal_error_degrees, err.mean_normal_error_degrees);
+        }
+        ImGui::TreePop();
+      }
+    }
+
+    ImGui::Text("Software renderer");
+    {
+      ImGui::Checkbox("Render on CPU", &g_soft_render_enabled);
+      ImGui::SameLine();
+      ImGui::Checkbox("Parallel", &g_soft_renderer.parallel);
+      if (ImGui::Button("Save CPU frame"))
+      {
+        soft_render_scene(g_scene);
+        if (!g_soft_renderer.write_png("cpu_frame.png"))
+        {
+          if (console::g_log.size() == console::g_log.capacity()) console::g_log.pop_front();
+          console::g_log.push_back({ "Failed to write cpu_frame.png" });
+        }
+      }
+      if (g_soft_render_time > 0.0)
+      {
+        ImGui::Text("%ux%u: %5.3lf ms, %.1f frames/s, threads: %u", SOFT_RENDER_WIDTH, SOFT_RENDER_HEIGHT,
+                    g_soft_render_time * 1000.0, 1.0 / g_soft_render_time,
+                    g_soft_renderer.parallel ? jobs::thread_count() : 1u);
+        ImGui::Text("Triangles: %u", g_soft_renderer.triangle_count());
+      }
+    }
+
+    ImGui::Text("Command capture");
+    {
+      ImGui::SliderInt("Frames to capture", &g_capture_frames, 1, 600);
+      if (g_capture_frames_left == 0 && ImGui::Button("Capture to capture.bin"))
+      {
+        // Mesh data uploaded earlier is not in the capture, only the buffers it lives in.
+        g_capture.begin();
+        g_capture.create_buffer(CAPTURE_BUFFER_VERTICES, MESH_ARENA_VERTEX_COUNT * vertex_format_size(g_mesh_arena.format),
+                                D3D11_BIND_VERTEX_BUFFER);
+        g_capture.create_buffer(CAPTURE_BUFFER_INDICES, MESH_ARENA_INDEX_COUNT * sizeof(u32), D3D11_BIND_INDEX_BUFFER);
+        g_capture.create_buffer(CAPTURE_BUFFER_SCENE_CONSTANTS, sizeof(g_scene_constants),
+                                D3D11_BIND_CONSTANT_BUFFER);
+        g_capture_frames_left = (u32)g_capture_frames;
+        g_capture_frame = 0;
+      }
+      if (g_capture_frames_left > 0)
+        ImGui::Text("Capturing, %u frames left", g_capture_frames_left);
+      else if (g_capture.data().size() > 0)
+        ImGui::Text("Last capture: %u frames, %u bytes", g_capture_frame, g_capture.data().size());
+    }
 
     ImGui::End();
 
@@ -1074,19 +2438,33 @@ void application::update(f64 delta_time)
       entity& e = *g_scene.entities[g_selected_entity];
       char name_buffer[console::MAX_ENTRY_SIZE];
       sprintf(name_buffer, "(%i)", g_selected_entity);
-      ImGui::InputFloat("tX", &e.tr.t.x);
-      ImGui::InputFloat("tY", &e.tr.t.y);
-      ImGui::InputFloat("tZ", &e.tr.t.z);
+      // Baked entities are drawn from a copy of their mesh in the batch, edits would not show until
+      // the next bake, so they are read-only.
+      const bool baked = e.batch != nullptr;
+      const ImGuiInputTextFlags flags = baked ? ImGuiInputTextFlags_ReadOnly : 0;
+      if (baked)
+      {
+        ImGui::TextWrapped("Baked into a static batch, unbake to edit.");
+        if (ImGui::Button("Unbake"))
+          unbake_static_entities(g_scene);
+      }
+      bool moved = false;
+      moved |= ImGui::InputFloat("tX", &e.tr.t.x, 0.0f, 0.0f, "%.3f", flags);
+      moved |= ImGui::InputFloat("tY", &e.tr.t.y, 0.0f, 0.0f, "%.3f", flags);
+      moved |= ImGui::InputFloat("tZ", &e.tr.t.z, 0.0f, 0.0f, "%.3f", flags);
       glm::vec3 euler = glm::degrees(glm::eulerAngles(e.tr.r));
-      if (ImGui::InputFloat("rX", &euler.x, 0.0f, 0.0f, "%8.3f")
-          | ImGui::InputFloat("rY", &euler.y, 0.0f, 0.0f, "%8.3f")
-          | ImGui::InputFloat("rZ", &euler.z, 0.0f, 0.0f, "%8.3f"))
+      if (ImGui::InputFloat("rX", &euler.x, 0.0f, 0.0f, "%8.3f", flags)
+          | ImGui::InputFloat("rY", &euler.y, 0.0f, 0.0f, "%8.3f", flags)
+          | ImGui::InputFloat("rZ", &euler.z, 0.0f, 0.0f, "%8.3f", flags))
       {
         e.tr.r = glm::quat{ glm::radians(euler) };
+        moved = true;
       }
-      ImGui::InputFloat("sX", &e.tr.s.x);
-      ImGui::InputFloat("sY", &e.tr.s.y);
-      ImGui::InputFloat("sZ", &e.tr.s.z);
+      moved |= ImGui::InputFloat("sX", &e.tr.s.x, 0.0f, 0.0f, "%.3f", flags);
+      moved |= ImGui::InputFloat("sY", &e.tr.s.y, 0.0f, 0.0f, "%.3f", flags);
+      moved |= ImGui::InputFloat("sZ", &e.tr.s.z, 0.0f, 0.0f, "%.3f", flags);
+      if (moved)
+        update_entity_bounds(g_scene, &e);
     }
     ImGui::End();
 
@@ -1130,25 +2508,68 @@ void application::update(f64 delta_time)
 
 void application::fixed_update(f64 delta_time)
 {
-  (void)delta_time;
+  call_script_hook(lua, "fixed_update", delta_time);
 }
 
-void application::render()
+static void scene_pass(frame_graph const& graph, void* ctx)
 {
+  const frame_pass_data& data = *static_cast<frame_pass_data*>(ctx);
+  d3d11_renderer& renderer = *data.renderer;
+  d3d11_fg_texture* back_buffer = static_cast<d3d11_fg_texture*>(graph.texture(data.back_buffer));
+  d3d11_fg_texture* depth = static_cast<d3d11_fg_texture*>(graph.texture(data.depth));
+
   const f32 color[] = { 0.0f, 0.0f, 0.0f, 1.0f };
-  renderer.ctx->ClearRenderTargetView(renderer.swapchain_rtv.Get(), color);
-  renderer.ctx->ClearDepthStencilView(renderer.dsv.Get(),
+  renderer.ctx->ClearRenderTargetView(back_buffer->rtv.Get(), color);
+  renderer.ctx->ClearDepthStencilView(depth->dsv.Get(),
                                       D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
                                       1.0f, 0);
-  renderer.ctx->OMSetRenderTargets(1, renderer.swapchain_rtv.GetAddressOf(),
-                                   renderer.dsv.Get());
+  renderer.ctx->OMSetRenderTargets(1, back_buffer->rtv.GetAddressOf(), depth->dsv.Get());
 
   g_scene.cam.aspect = (f32)renderer.swapchain_desc.BufferDesc.Width / (f32)renderer.swapchain_desc.BufferDesc.Height;
-  render_scene(renderer, g_scene, { 0, 0 }, { renderer.swapchain_desc.BufferDesc.Width, renderer.swapchain_desc.BufferDesc.Height });
+  render_scene(renderer, g_scene, back_buffer->rtv.Get(), depth->dsv.Get(),
+               { 0, 0 }, { renderer.swapchain_desc.BufferDesc.Width, renderer.swapchain_desc.BufferDesc.Height });
+}
 
+static void ui_pass(frame_graph const& graph, void* ctx)
+{
+  const frame_pass_data& data = *static_cast<frame_pass_data*>(ctx);
+  d3d11_fg_texture* back_buffer = static_cast<d3d11_fg_texture*>(graph.texture(data.back_buffer));
+  data.renderer->ctx->OMSetRenderTargets(1, back_buffer->rtv.GetAddressOf(), nullptr);
   ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
 
+void application::render()
+{
+  const DXGI_SWAP_CHAIN_DESC& sd = renderer.swapchain_desc;
+  g_back_buffer.rtv = renderer.swapchain_rtv;
+  g_depth_buffer.dsv = renderer.dsv;
+
+  g_frame_graph.reset();
+  const fg_texture_desc back_buffer_desc = { sd.BufferDesc.Width, sd.BufferDesc.Height, (u32)sd.BufferDesc.Format,
+                                             D3D11_BIND_RENDER_TARGET, 4, sd.SampleDesc.Count };
+  const fg_texture_desc depth_desc = { sd.BufferDesc.Width, sd.BufferDesc.Height, DXGI_FORMAT_D24_UNORM_S8_UINT,
+                                       D3D11_BIND_DEPTH_STENCIL, 4, sd.SampleDesc.Count };
+  g_frame_pass_data.renderer = &renderer;
+  g_frame_pass_data.back_buffer = g_frame_graph.import_texture("back buffer", back_buffer_desc, &g_back_buffer);
+  g_frame_pass_data.depth = g_frame_graph.import_texture("depth", depth_desc, &g_depth_buffer);
+
+  const u32 scene = g_frame_graph.add_pass("scene", scene_pass, &g_frame_pass_data);
+  g_frame_graph.write(scene, g_frame_pass_data.back_buffer);
+  g_frame_graph.write(scene, g_frame_pass_data.depth);
+  const u32 ui = g_frame_graph.add_pass("ui", ui_pass, &g_frame_pass_data);
+  g_frame_graph.read(ui, g_frame_pass_data.back_buffer);
+  g_frame_graph.write(ui, g_frame_pass_data.back_buffer);
+
+  g_frame_graph.compile(g_frame_graph_backend);
+  g_frame_graph.execute();
+
+  if (g_soft_render_enabled)
+    soft_render_scene(g_scene);
+
+  g_back_buffer.rtv.Reset();
+  g_depth_buffer.dsv.Reset();
+}
+
 // Things to do next:
 // * Material system mixing PBR and custom shaders. Refer to Unreal Engine ~2013 article.
 // * Support for clustered shading.
@@ -0,0 +1,445 @@
+#include <float.h>
+#include "bvh.hpp"
+#include "my_assert.hpp"
+
+u32 bvh::create_proxy(aabb const& box, void* user_data)
+{
+  const u32 leaf = alloc_node();
+  node& n = m_nodes[leaf];
+  n.box = { box.min - glm::vec3{ margin }, box.max + glm::vec3{ margin } };
+  n.user_data = user_data;
+  n.child[0] = NULL_NODE;
+  n.child[1] = NULL_NODE;
+  n.height = 0;
+  insert_leaf(leaf);
+  m_proxy_count++;
+  return leaf;
+}
+
+void bvh::destroy_proxy(u32 proxy)
+{
+  my_assert(proxy < m_nodes.size());
+  my_assert(m_nodes[proxy].is_leaf());
+  remove_leaf(proxy);
+  free_node(proxy);
+  m_proxy_count--;
+}
+
+bool bvh::move_proxy(u32 proxy, aabb const& box)
+{
+  my_assert(proxy < m_nodes.size());
+  my_assert(m_nodes[proxy].is_leaf());
+  if (aabb_contains(m_nodes[proxy].box, box))
+    return false;
+
+  remove_leaf(proxy);
+  m_nodes[proxy].box = { box.min - glm::vec3{ margin }, box.max + glm::vec3{ margin } };
+  insert_leaf(proxy);
+  return true;
+}
+
+void bvh::rebuild()
+{
+  vector<u32> leaves;
+  leaves.reserve(m_proxy_count);
+  for (u32 i = 0; i < m_nodes.size(); i++)
+  {
+    if (m_nodes[i].height == 0)
+      leaves.push_back(i);
+    else if (m_nodes[i].height > 0)
+      free_node(i);
+  }
+
+  m_root = NULL_NODE;
+  if (leaves.size() == 0)
+    return;
+  m_root = build_range(leaves.data(), leaves.size());
+  m_nodes[m_root].parent = NULL_NODE;
+}
+
+void bvh::clear()
+{
+  m_nodes.clear();
+  m_root = NULL_NODE;
+  m_free_list = NULL_NODE;
+  m_proxy_count = 0;
+}
+
+namespace
+{
+struct query_entry
+{
+  u32 idx;
+  u32 plane_mask;
+};
+} // namespace
+
+void bvh::query(frustum const& f, vector<void*>& out, query_stats* stats) const
+{
+  if (m_root == NULL_NODE)
+    return;
+
+  query_stats local_stats;
+  vector<query_entry> stack;
+  stack.push_back({ m_root, FRUSTUM_ALL_PLANES });
+  while (stack.size() > 0)
+  {
+    const query_entry entry = stack.back();
+    stack.pop_back();
+    const node& n = m_nodes[entry.idx];
+    local_stats.nodes_visited++;
+
+    u32 plane_mask;
+    const cull_result result = cull_aabb(f, n.box, entry.plane_mask, &plane_mask);
+    if (result == cull_result::outside)
+    {
+      local_stats.subtrees_rejected++;
+      continue;
+    }
+    if (n.is_leaf())
+    {
+      out.push_back(n.user_data);
+      continue;
+    }
+    if (result == cull_result::inside)
+    {
+      local_stats.subtrees_accepted++;
+      append_subtree(entry.idx, out);
+      continue;
+    }
+    stack.push_back({ n.child[0], plane_mask });
+    stack.push_back({ n.child[1], plane_mask });
+  }
+
+  if (stats)
+    *stats = local_stats;
+}
+
+void bvh::append_subtree(u32 idx, vector<void*>& out) const
+{
+  vector<u32> stack;
+  stack.push_back(idx);
+  while (stack.size() > 0)
+  {
+    const node& n = m_nodes[stack.back()];
+    stack.pop_back();
+    if (n.is_leaf())
+    {
+      out.push_back(n.user_data);
+    }
+    else
+    {
+      stack.push_back(n.child[0]);
+      stack.push_back(n.child[1]);
+    }
+  }
+}
+
+u32 bvh::alloc_node()
+{
+  if (m_free_list == NULL_NODE)
+  {
+    m_nodes.push_back({});
+    m_free_list = m_nodes.size() - 1;
+    m_nodes.back().parent = NULL_NODE;
+  }
+
+  const u32 idx = m_free_list;
+  m_free_list = m_nodes[idx].parent;
+  m_nodes[idx].parent = NULL_NODE;
+  m_nodes[idx].user_data = nullptr;
+  m_nodes[idx].height = 0;
+  return idx;
+}
+
+void bvh::free_node(u32 idx)
+{
+  m_nodes[idx].parent = m_free_list;
+  m_nodes[idx].height = -1;
+  m_free_list = idx;
+}
+
+void bvh::insert_leaf(u32 leaf)
+{
+  if (m_root == NULL_NODE)
+  {
+    m_root = leaf;
+    m_nodes[leaf].parent = NULL_NODE;
+    return;
+  }
+
+  // Descend to the sibling which increases total area of the tree the least.
+  const aabb box = m_nodes[leaf].box;
+  u32 idx = m_root;
+  while (m_nodes[idx].is_leaf() == false)
+  {
+    const node& n = m_nodes[idx];
+    const f32 area = aabb_area(n.box);
+    const f32 combined_area = aabb_area(aabb_union(n.box, box));
+
+    // Cost of making a new parent for this node and the leaf.
+    const f32 cost = 2.0f * combined_area;
+    // Minimum cost of pushing the leaf further down the tree.
+    const f32 inheritance_cost = 2.0f * (combined_area - area);
+
+    f32 child_costs[2];
+    for (u32 i = 0; i < 2; i++)
+    {
+      const node& c = m_nodes[n.child[i]];
+      const f32 union_area = aabb_area(aabb_union(c.box, box));
+      child_costs[i] = inheritance_cost + (c.is_leaf() ? union_area : union_area - aabb_area(c.box));
+    }
+
+    if (cost < child_costs[0] && cost < child_costs[1])
+      break;
+    idx = child_costs[0] < child_costs[1] ? n.child[0] : n.child[1];
+  }
+
+  const u32 sibling = idx;
+  const u32 old_parent = m_nodes[sibling].parent;
+  const u32 new_parent = alloc_node();
+  {
+    node& p = m_nodes[new_parent];
+    p.parent = old_parent;
+    p.child[0] = sibling;
+    p.child[1] = leaf;
+  }
+  m_nodes[sibling].parent = new_parent;
+  m_nodes[leaf].parent = new_parent;
+
+  if (old_parent != NULL_NODE)
+  {
+    node& op = m_nodes[old_parent];
+    op.child[op.child[0] == sibling ? 0 : 1] = new_parent;
+  }
+  else
+  {
+    m_root = new_parent;
+  }
+
+  refit_ancestors(new_parent);
+}
+
+void bvh::remove_leaf(u32 leaf)
+{
+  if (leaf == m_root)
+  {
+    m_root = NULL_NODE;
+    return;
+  }
+
+  const u32 parent = m_nodes[leaf].parent;
+  const u32 grand_parent = m_nodes[parent].parent;
+  const u32 sibling = m_nodes[parent].child[m_nodes[parent].child[0] == leaf ? 1 : 0];
+
+  if (grand_parent != NULL_NODE)
+  {
+    node& gp = m_nodes[grand_parent];
+    gp.child[gp.child[0] == parent ? 0 : 1] = sibling;
+    m_nodes[sibling].parent = grand_parent;
+    free_node(parent);
+    refit_ancestors(grand_parent);
+  }
+  else
+  {
+    m_root = sibling;
+    m_nodes[sibling].parent = NULL_NODE;
+    free_node(parent);
+  }
+  m_nodes[leaf].parent = NULL_NODE;
+}
+
+void bvh::refit_ancestors(u32 idx)
+{
+  while (idx != NULL_NODE)
+  {
+    update_node(idx);
+    rotate(idx);
+    idx = m_nodes[idx].parent;
+  }
+}
+
+void bvh::update_node(u32 idx)
+{
+  node& n = m_nodes[idx];
+  const node& c0 = m_nodes[n.child[0]];
+  const node& c1 = m_nodes[n.child[1]];
+  n.box = aabb_union(c0.box, c1.box);
+  n.height = 1 + (c0.height > c1.height ? c0.height : c1.height);
+}
+
+void bvh::rotate(u32 idx)
+{
+  // Swap a child of the node with a grandchild from the other side
+  // if that shrinks the area of the other child.
+  // Box of the node itself doesn't change.
+  if (m_nodes[idx].height < 2)
+    return;
+
+  const u32 b = m_nodes[idx].child[0];
+  const u32 c = m_nodes[idx].child[1];
+  const node& nb = m_nodes[b];
+  const node& nc = m_nodes[c];
+
+  // Candidate: child slot of idx to give away, and grandchild (parent, slot) to take in.
+  f32 best_delta = 0.0f;
+  u32 best_child_slot = 0;
+  u32 best_grandchild_parent = NULL_NODE;
+  u32 best_grandchild_slot = 0;
+
+  if (nc.is_leaf() == false)
+  {
+    // Swap b with one of c's children.
+    const f32 area_c = aabb_area(nc.box);
+    for (u32 slot = 0; slot < 2; slot++)
+    {
+      const node& remaining = m_nodes[nc.child[1 - slot]];
+      const f32 delta = aabb_area(aabb_union(nb.box, remaining.box)) - area_c;
+      if (delta < best_delta)
+      {
+        best_delta = delta;
+        best_child_slot = 0;
+        best_grandchild_parent = c;
+        best_grandchild_slot = slot;
+      }
+    }
+  }
+
+  if (nb.is_leaf() == false)
+  {
+    // Swap c with one of b's children.
+    const f32 area_b = aabb_area(nb.box);
+    for (u32 slot = 0; slot < 2; slot++)
+    {
+      const node& remaining = m_nodes[nb.child[1 - slot]];
+      const f32 delta = aabb_area(aabb_union(nc.box, remaining.box)) - area_b;
+      if (delta < best_delta)
+      {
+        best_delta = delta;
+        best_child_slot = 1;
+        best_grandchild_parent = b;
+        best_grandchild_slot = slot;
+      }
+    }
+  }
+
+  if (best_grandchild_parent == NULL_NODE)
+    return;
+
+  const u32 child = m_nodes[idx].child[best_child_slot];
+  const u32 grandchild = m_nodes[best_grandchild_parent].child[best_grandchild_slot];
+  m_nodes[idx].child[best_child_slot] = grandchild;
+  m_nodes[grandchild].parent = idx;
+  m_nodes[best_grandchild_parent].child[best_grandchild_slot] = child;
+  m_nodes[child].parent = best_grandchild_parent;
+  update_node(best_grandchild_parent);
+  update_node(idx);
+}
+
+u32 bvh::build_range(u32* leaves, u32 count)
+{
+  if (count == 1)
+    return leaves[0];
+
+  glm::vec3 centroid_min = glm::vec3{ +FLT_MAX };
+  glm::vec3 centroid_max = glm::vec3{ -FLT_MAX };
+  for (u32 i = 0; i < count; i++)
+  {
+    const aabb& box = m_nodes[leaves[i]].box;
+    const glm::vec3 centroid = 0.5f * (box.min + box.max);
+    centroid_min = glm::min(centroid_min, centroid);
+    centroid_max = glm::max(centroid_max, centroid);
+  }
+
+  u32 axis = 0;
+  const glm::vec3 centroid_extent = centroid_max - centroid_min;
+  if (centroid_extent.y > centroid_extent[axis]) axis = 1;
+  if (centroid_extent.z > centroid_extent[axis]) axis = 2;
+
+  u32 split = count / 2;
+  if (centroid_extent[axis] > 0.0f)
+  {
+    // Binned SAH: bucket centroids along the axis, pick split plane between buckets
+    // which minimizes count * area of both sides.
+    constexpr u32 NUM_BINS = 16;
+    struct bin
+    {
+      aabb box;
+      u32 count;
+    };
+    bin bins[NUM_BINS];
+    for (u32 i = 0; i < NUM_BINS; i++)
+    {
+      bins[i].box = { glm::vec3{ +FLT_MAX }, glm::vec3{ -FLT_MAX } };
+      bins[i].count = 0;
+    }
+
+    const f32 scale = (f32)NUM_BINS / centroid_extent[axis];
+    const auto bin_of = [&](u32 leaf)
+    {
+      const aabb& box = m_nodes[leaf].box;
+      const f32 centroid = 0.5f * (box.min[axis] + box.max[axis]);
+      const u32 b = (u32)((centroid - centroid_min[axis]) * scale);
+      return b < NUM_BINS ? b : NUM_BINS - 1;
+    };
+
+    for (u32 i = 0; i < count; i++)
+    {
+      bin& b = bins[bin_of(leaves[i])];
+      b.box = aabb_union(b.box, m_nodes[leaves[i]].box);
+      b.count++;
+    }
+
+    f32 right_costs[NUM_BINS];
+    {
+      aabb box = bins[NUM_BINS - 1].box;
+      u32 right_count = bins[NUM_BINS - 1].count;
+      for (u32 i = NUM_BINS - 1; i > 0; i--)
+      {
+        right_costs[i] = right_count > 0 ? (f32)right_count * aabb_area(box) : 0.0f;
+        box = aabb_union(box, bins[i - 1].box);
+        right_count += bins[i - 1].count;
+      }
+    }
+
+    f32 best_cost = FLT_MAX;
+    u32 best_bin = 0;
+    {
+      aabb box = bins[0].box;
+      u32 left_count = bins[0].count;
+      for (u32 i = 1; i < NUM_BINS; i++)
+      {
+        const f32 cost = (left_count > 0 ? (f32)left_count * aabb_area(box) : 0.0f) + right_costs[i];
+        if (cost < best_cost)
+        {
+          best_cost = cost;
+          best_bin = i;
+        }
+        box = aabb_union(box, bins[i].box);
+        left_count += bins[i].count;
+      }
+    }
+
+    u32 left = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+      if (bin_of(leaves[i]) < best_bin)
+      {
+        util::swap(leaves[i], leaves[left]);
+        left++;
+      }
+    }
+    if (left > 0 && left < count)
+      split = left;
+  }
+
+  const u32 left_child = build_range(leaves, split);
+  const u32 right_child = build_range(leaves + split, count - split);
+  const u32 idx = alloc_node();
+  m_nodes[idx].child[0] = left_child;
+  m_nodes[idx].child[1] = right_child;
+  m_nodes[left_child].parent = idx;
+  m_nodes[right_child].parent = idx;
+  update_node(idx);
+  return idx;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "culling.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Dynamic AABB tree over world bounds of scene objects.
+// Every leaf is a proxy for one object. Leaves store fattened boxes,
+// so small motion of an object doesn't touch the tree at all.
+// Insertion descends to the sibling with the least SAH cost increase,
+// ancestors are refitted and rotated on the way back to keep the tree shallow.
+// rebuild() rebuilds internal nodes from scratch with binned SAH,
+// proxy ids stay valid across rebuilds.
+class bvh
+{
+public:
+  static constexpr u32 NULL_NODE = (u32)-1;
+
+  struct query_stats
+  {
+    u32 nodes_visited = 0;
+    u32 subtrees_accepted = 0;
+    u32 subtrees_rejected = 0;
+  };
+
+  u32 create_proxy(aabb const& box, void* user_data);
+  void destroy_proxy(u32 proxy);
+  // Returns true if proxy had to be reinserted.
+  bool move_proxy(u32 proxy, aabb const& box);
+  void rebuild();
+  void clear();
+
+  // Appends user data of proxies whose boxes intersect the frustum.
+  // Subtrees completely inside or outside of the frustum are not traversed any further.
+  void query(frustum const& f, vector<void*>& out, query_stats* stats = nullptr) const;
+
+  void* user_data(u32 proxy) const
+  {
+    return m_nodes[proxy].user_data;
+  }
+
+  aabb const& fat_aabb(u32 proxy) const
+  {
+    return m_nodes[proxy].box;
+  }
+
+  u32 height() const
+  {
+    return m_root == NULL_NODE ? 0 : (u32)m_nodes[m_root].height;
+  }
+
+  u32 proxy_count() const
+  {
+    return m_proxy_count;
+  }
+
+  // Margin added to boxes of the proxies, in world units.
+  f32 margin = 0.1f;
+
+private:
+  struct node
+  {
+    aabb box;
+    void* user_data;
+    // Next free node when node is in a free list.
+    u32 parent;
+    u32 child[2];
+    // 0 for leaves, -1 for free nodes.
+    i32 height;
+
+    bool is_leaf() const
+    {
+      return height == 0;
+    }
+  };
+
+  u32 alloc_node();
+  void free_node(u32 idx);
+  void insert_leaf(u32 leaf);
+  void remove_leaf(u32 leaf);
+  void refit_ancestors(u32 idx);
+  void rotate(u32 idx);
+  void update_node(u32 idx);
+  u32 build_range(u32* leaves, u32 count);
+  void append_subtree(u32 idx, vector<void*>& out) const;
+
+  vector<node> m_nodes;
+  u32 m_root = NULL_NODE;
+  u32 m_free_list = NULL_NODE;
+  u32 m_proxy_count = 0;
+};
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "capture.hpp"
+#include "my_assert.hpp"
+#include "platform.hpp"
+
+void command_capture::begin()
+{
+  m_data.clear();
+  put_u32(CAPTURE_MAGIC);
+  put_u32(CAPTURE_VERSION);
+}
+
+void command_capture::begin_frame(u32 frame)
+{
+  put_op(capture_op::begin_frame);
+  put_u32(frame);
+}
+
+void command_capture::end_frame()
+{
+  put_op(capture_op::end_frame);
+}
+
+void command_capture::create_buffer(u32 buffer, u32 size, u32 bind_flags)
+{
+  put_op(capture_op::create_buffer);
+  put_u32(buffer);
+  put_u32(size);
+  put_u32(bind_flags);
+}
+
+void command_capture::upload(u32 buffer, u32 offset, void const* data, u32 size)
+{
+  put_op(capture_op::upload);
+  put_u32(buffer);
+  put_u32(offset);
+  put_u32(size);
+  put_bytes(data, size);
+}
+
+bool command_capture::write_file(const char* path) const
+{
+  FILE* f = fopen(path, "wb");
+  if (f == nullptr)
+    return false;
+  const bool ok = fwrite(m_data.data(), 1, m_data.size(), f) == m_data.size();
+  return fclose(f) == 0 && ok;
+}
+
+void command_capture::begin_pass(u32 pass)
+{
+  put_op(capture_op::begin_pass);
+  put_u32(pass);
+  if (target)
+    target->begin_pass(pass);
+}
+
+void command_capture::set_pipeline(u32 pipeline)
+{
+  put_op(capture_op::set_pipeline);
+  put_u32(pipeline);
+  if (target)
+    target->set_pipeline(pipeline);
+}
+
+void command_capture::set_mesh(u32 mesh)
+{
+  put_op(capture_op::set_mesh);
+  put_u32(mesh);
+  if (target)
+    target->set_mesh(mesh);
+}
+
+void command_capture::set_object_constants(void const* data, u32 size)
+{
+  put_op(capture_op::set_object_constants);
+  put_u32(size);
+  put_bytes(data, size);
+  if (target)
+    target->set_object_constants(data, size);
+}
+
+void command_capture::draw_indexed(u32 index_count, u32 first_index, i32 base_vertex)
+{
+  put_op(capture_op::draw_indexed);
+  put_u32(index_count);
+  put_u32(first_index);
+  put_u32((u32)base_vertex);
+  if (target)
+    target->draw_indexed(index_count, first_index, base_vertex);
+}
+
+void command_capture::set_instance_data(void const* data, u32 stride, u32 count)
+{
+  put_op(capture_op::set_instance_data);
+  put_u32(stride);
+  put_u32(count);
+  put_bytes(data, stride * count);
+  if (target)
+    target->set_instance_data(data, stride, count);
+}
+
+void command_capture::draw_indexed_instanced(u32 index_count, u32 first_index, i32 base_vertex,
+                                             u32 instance_count, u32 first_instance)
+{
+  put_op(capture_op::draw_indexed_instanced);
+  put_u32(index_count);
+  put_u32(first_index);
+  put_u32((u32)base_vertex);
+  put_u32(instance_count);
+  put_u32(first_instance);
+  if (target)
+    target->draw_indexed_instanced(index_count, first_index, base_vertex, instance_count, first_instance);
+}
+
+void command_capture::put_op(capture_op op)
+{
+  m_data.push_back((u8)op);
+}
+
+void command_capture::put_u32(u32 value)
+{
+  put_bytes(&value, sizeof(value));
+}
+
+void command_capture::put_bytes(void const* data, u32 size)
+{
+  const u32 offset = m_data.size();
+  m_data.resize(offset + size, 0);
+  if (size > 0)
+    memcpy(m_data.data() + offset, data, size);
+}
+
+namespace
+{
+struct stream_reader
+{
+  u8 const* data;
+  u32 size;
+  u32 pos;
+
+  bool read_u32(u32& out)
+  {
+    if (size - pos < sizeof(u32))
+      return false;
+    memcpy(&out, data + pos, sizeof(u32));
+    pos += sizeof(u32);
+    return true;
+  }
+
+  // Returns payload in place, nullptr if the stream is too short.
+  u8 const* read_bytes(u32 count)
+  {
+    if (size - pos < count)
+      return nullptr;
+    u8 const* ret = data + pos;
+    pos += count;
+    return ret;
+  }
+};
+} // namespace
+
+bool replay_capture(u8 const* data, u32 size, render_backend& backend, vector<replay_frame_stats>& frames)
+{
+  stream_reader r = { data, size, 0 };
+  u32 magic;
+  u32 version;
+  if (!r.read_u32(magic) || !r.read_u32(version) || magic != CAPTURE_MAGIC || version != CAPTURE_VERSION)
+    return false;
+
+  replay_frame_stats stats;
+  bool in_frame = false;
+  f64 frame_start_time = platform::seconds();
+  while (r.pos < r.size)
+  {
+    const u8 op = r.data[r.pos++];
+    if (op >= (u8)capture_op::count)
+      return false;
+    stats.commands[op]++;
+
+    u32 args[5];
+    switch ((capture_op)op)
+    {
+      case capture_op::begin_frame:
+      {
+        if (in_frame || !r.read_u32(stats.frame))
+          return false;
+        in_frame = true;
+        frame_start_time = platform::seconds();
+        break;
+      }
+      case capture_op::end_frame:
+      {
+        if (in_frame == false)
+          return false;
+        in_frame = false;
+        stats.cpu_time = platform::seconds() - frame_start_time;
+        frames.push_back(stats);
+        stats = {};
+        frame_start_time = platform::seconds();
+        break;
+      }
+      case capture_op::create_buffer:
+      {
+        if (!r.read_u32(args[0]) || !r.read_u32(args[1]) || !r.read_u32(args[2]))
+          return false;
+        break;
+      }
+      case capture_op::upload:
+      {
+        if (!r.read_u32(args[0]) || !r.read_u32(args[1]) || !r.read_u32(args[2]) || !r.read_bytes(args[2]))
+          return false;
+        stats.upload_bytes += args[2];
+        break;
+      }
+      case capture_op::begin_pass:
+      {
+        if (!r.read_u32(args[0]))
+          return false;
+        backend.begin_pass(args[0]);
+        break;
+      }
+      case capture_op::set_pipeline:
+      {
+        if (!r.read_u32(args[0]))
+          return false;
+        backend.set_pipeline(args[0]);
+        break;
+      }
+      case capture_op::set_mesh:
+      {
+        if (!r.read_u32(args[0]))
+          return false;
+        backend.set_mesh(args[0]);
+        break;
+      }
+      case capture_op::set_object_constants:
+      {
+        u8 const* payload;
+        if (!r.read_u32(args[0]) || (payload = r.read_bytes(args[0])) == nullptr)
+          return false;
+        backend.set_object_constants(payload, args[0]);
+        stats.upload_bytes += args[0];
+        break;
+      }
+      case capture_op::draw_indexed:
+      {
+        if (!r.read_u32(args[0]) || !r.read_u32(args[1]) || !r.read_u32(args[2]))
+          return false;
+        backend.draw_indexed(args[0], args[1], (i32)args[2]);
+        break;
+      }
+      case capture_op::set_instance_data:
+      {
+        u8 const* payload;
+        if (!r.read_u32(args[0]) || !r.read_u32(args[1]) || (u64)args[0] * args[1] > r.size
+            || (payload = r.read_bytes(args[0] * args[1])) == nullptr)
+          return false;
+        backend.set_instance_data(payload, args[0], args[1]);
+        stats.upload_bytes += args[0] * args[1];
+        break;
+      }
+      case capture_op::draw_indexed_instanced:
+      {
+        for (u32 i = 0; i < 5; i++)
+        {
+          if (!r.read_u32(args[i]))
+            return false;
+        }
+        backend.draw_indexed_instanced(args[0], args[1], (i32)args[2], args[3], args[4]);
+        break;
+      }
+      default:
+      {
+        my_assert(false);
+        return false;
+      }
+    }
+  }
+  return in_frame == false;
+}
+
+bool read_capture_file(const char* path, vector<u8>& out)
+{
+  FILE* f = fopen(path, "rb");
+  if (f == nullptr)
+    return false;
+  out.clear();
+  u8 buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+  {
+    const u32 offset = out.size();
+    out.resize(offset + (u32)read, 0);
+    memcpy(out.data() + offset, buffer, read);
+  }
+  const bool ok = ferror(f) == 0;
+  fclose(f);
+  return ok;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "render_commands.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Capture of renderer commands into a binary stream and its replay.
+// Stream is a header followed by records: one opcode byte, fixed u32 fields, then payload bytes.
+// Every backend call is recorded with its data, together with buffer creation and uploads
+// which happen outside of command buffers. Buffer ids are defined by the caller.
+// Fields are written as they are in memory, a capture replays on machines of the same byte order.
+
+static constexpr u32 CAPTURE_MAGIC = 0x43525353; // "SSRC"
+static constexpr u32 CAPTURE_VERSION = 1;
+
+enum class capture_op : u8
+{
+  begin_frame,
+  end_frame,
+  create_buffer,
+  upload,
+  begin_pass,
+  set_pipeline,
+  set_mesh,
+  set_object_constants,
+  draw_indexed,
+  set_instance_data,
+  draw_indexed_instanced,
+  count
+};
+
+// Records every call and forwards it to the target backend, if there is one.
+class command_capture : public render_backend
+{
+public:
+  // Drops recorded stream and starts a new one.
+  void begin();
+  void begin_frame(u32 frame);
+  void end_frame();
+  void create_buffer(u32 buffer, u32 size, u32 bind_flags);
+  void upload(u32 buffer, u32 offset, void const* data, u32 size);
+  bool write_file(const char* path) const;
+
+  void begin_pass(u32 pass) override;
+  void set_pipeline(u32 pipeline) override;
+  void set_mesh(u32 mesh) override;
+  void set_object_constants(void const* data, u32 size) override;
+  void draw_indexed(u32 index_count, u32 first_index, i32 base_vertex) override;
+  void set_instance_data(void const* data, u32 stride, u32 count) override;
+  void draw_indexed_instanced(u32 index_count, u32 first_index, i32 base_vertex,
+                              u32 instance_count, u32 first_instance) override;
+
+  vector<u8> const& data() const
+  {
+    return m_data;
+  }
+
+  render_backend* target = nullptr;
+
+private:
+  void put_op(capture_op op);
+  void put_u32(u32 value);
+  void put_bytes(void const* data, u32 size);
+
+  vector<u8> m_data;
+};
+
+struct replay_frame_stats
+{
+  u32 frame = 0;
+  u32 commands[(u32)capture_op::count] = {};
+  // Buffer uploads, object constants and instance data.
+  u64 upload_bytes = 0;
+  // Time spent decoding the frame and in the backend.
+  f64 cpu_time = 0.0;
+};
+
+// Feeds captured commands to the backend, appends statistics of every frame.
+// Buffer creation and uploads are only counted. Returns false if the stream is malformed
+// or ends inside a frame, as a truncated file does.
+bool replay_capture(u8 const* data, u32 size, render_backend& backend, vector<replay_frame_stats>& frames);
+
+bool read_capture_file(const char* path, vector<u8>& out);
@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include "content_hash.hpp"
+
+namespace
+{
+inline u64 rotl(u64 x, u32 r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline u64 fmix(u64 k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return k;
+}
+
+constexpr u64 C1 = 0x87c37b91114253d5ull;
+constexpr u64 C2 = 0x4cf5ad432745937full;
+} // namespace
+
+content_hash hash_content(void const* data, u64 size, content_hash seed)
+{
+  const u8* bytes = static_cast<const u8*>(data);
+  const u64 block_count = size / 16;
+  u64 h1 = seed.lo;
+  u64 h2 = seed.hi;
+
+  for (u64 i = 0; i < block_count; i++)
+  {
+    u64 k1;
+    u64 k2;
+    memcpy(&k1, bytes + i * 16, 8);
+    memcpy(&k2, bytes + i * 16 + 8, 8);
+
+    k1 *= C1;
+    k1 = rotl(k1, 31);
+    k1 *= C2;
+    h1 ^= k1;
+    h1 = rotl(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= C2;
+    k2 = rotl(k2, 33);
+    k2 *= C1;
+    h2 ^= k2;
+    h2 = rotl(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  // Tail of up to 15 bytes, little-endian like the blocks.
+  const u8* tail = bytes + block_count * 16;
+  const u32 tail_size = (u32)(size & 15);
+  u64 k1 = 0;
+  u64 k2 = 0;
+  for (u32 i = tail_size; i > 8; i--)
+    k2 = (k2 << 8) | tail[i - 1];
+  for (u32 i = tail_size < 8 ? tail_size : 8; i > 0; i--)
+    k1 = (k1 << 8) | tail[i - 1];
+  if (tail_size > 8)
+  {
+    k2 *= C2;
+    k2 = rotl(k2, 33);
+    k2 *= C1;
+    h2 ^= k2;
+  }
+  if (tail_size > 0)
+  {
+    k1 *= C1;
+    k1 = rotl(k1, 31);
+    k1 *= C2;
+    h1 ^= k1;
+  }
+
+  h1 ^= size;
+  h2 ^= size;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+  h1 += h2;
+  h2 += h1;
+
+  content_hash ret;
+  ret.lo = h1;
+  ret.hi = h2;
+  return ret;
+}
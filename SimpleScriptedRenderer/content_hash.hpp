@@ -0,0 +1,24 @@
+#pragma once
+#include "types.hpp"
+
+// 128-bit hash of byte streams for content addressing, MurmurHash3 x64_128 by Austin Appleby.
+// Not cryptographic, but collisions of distinct content are out of reach in practice.
+// Streams are chained by passing the hash of the previous one as seed.
+
+struct content_hash
+{
+  u64 lo = 0;
+  u64 hi = 0;
+};
+
+inline bool operator==(content_hash const& a, content_hash const& b)
+{
+  return a.lo == b.lo && a.hi == b.hi;
+}
+
+inline bool operator!=(content_hash const& a, content_hash const& b)
+{
+  return !(a == b);
+}
+
+content_hash hash_content(void const* data, u64 size, content_hash seed = {});
@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cooked_mesh.hpp"
+#include "hash_map.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "my_assert.hpp"
+#include "platform.hpp"
+
+static_assert(sizeof(cooked_mesh_header) % 16 == 0, "header is followed by aligned streams");
+
+namespace
+{
+u32 align_up(u32 value)
+{
+  return (value + COOKED_MESH_ALIGNMENT - 1) & ~(COOKED_MESH_ALIGNMENT - 1);
+}
+
+void put_bytes(vector<u8>& out, u32 offset, void const* data, u32 size)
+{
+  if (size > 0)
+    memcpy(out.data() + offset, data, size);
+}
+
+bool read_text_file(const char* path, vector<char>& out)
+{
+  FILE* f = fopen(path, "rb");
+  if (f == nullptr)
+    return false;
+  out.clear();
+  char buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+  {
+    const u32 offset = out.size();
+    out.resize(offset + (u32)read, 0);
+    memcpy(out.data() + offset, buffer, read);
+  }
+  const bool ok = ferror(f) == 0;
+  fclose(f);
+  // Terminated, so numbers at the very end parse.
+  out.push_back('\0');
+  return ok;
+}
+
+const char* skip_spaces(const char* p)
+{
+  while (*p == ' ' || *p == '\t')
+    p++;
+  return p;
+}
+
+const char* skip_line(const char* p)
+{
+  while (*p != '\0' && *p != '\n')
+    p++;
+  return *p == '\n' ? p + 1 : p;
+}
+
+u32 max_index(u8 const* indices, u32 index_size, u32 first, u32 count)
+{
+  u32 ret = 0;
+  if (index_size == 2)
+  {
+    const u16* p = reinterpret_cast<const u16*>(indices) + first;
+    for (u32 i = 0; i < count; i++)
+      ret = p[i] > ret ? p[i] : ret;
+  }
+  else
+  {
+    const u32* p = reinterpret_cast<const u32*>(indices) + first;
+    for (u32 i = 0; i < count; i++)
+      ret = p[i] > ret ? p[i] : ret;
+  }
+  return ret;
+}
+
+// Converts a one-based or negative relative OBJ index, returns false if it's out of range.
+bool resolve_index(long index, u32 count, u32& out)
+{
+  if (index > 0 && (u32)index <= count)
+  {
+    out = (u32)index - 1;
+    return true;
+  }
+  if (index < 0 && (u32)-index <= count)
+  {
+    out = count - (u32)-index;
+    return true;
+  }
+  return false;
+}
+} // namespace
+
+void cook_mesh(mesh_lod const* lods, u32 lod_count, vector<u8>& out)
+{
+  const vertex_data vd = make_vertex_data(lods, lod_count);
+
+  cooked_mesh_header header = {};
+  header.magic = COOKED_MESH_MAGIC;
+  header.version = COOKED_MESH_VERSION;
+  header.lod_count = vd.lod_count;
+  header.vertex_count = vd.vertex_count;
+  header.index_count = vd.index_count;
+  header.index_size = vd.index_size;
+  header.meshlet_count = vd.meshlets.size();
+  header.vertex_stream_offset = align_up(sizeof(cooked_mesh_header));
+  header.index_stream_offset = align_up(header.vertex_stream_offset + vd.vertex_count * sizeof(vertex));
+  header.meshlet_stream_offset = align_up(header.index_stream_offset + vd.index_count * vd.index_size);
+  header.flags = vd.generated_lods ? COOKED_MESH_FLAG_GENERATED_LODS : 0;
+  header.file_size = header.meshlet_stream_offset + header.meshlet_count * sizeof(meshlet);
+  header.aabb_center = vd.aabb_center;
+  header.aabb_extent = vd.aabb_extent;
+  header.quantization = vd.quantization;
+  for (u32 i = 0; i < vd.lod_count; i++)
+  {
+    cooked_mesh_lod& l = header.lods[i];
+    l.first_index = vd.lods[i].first_index;
+    l.index_count = vd.lods[i].index_count;
+    l.base_vertex = vd.lods[i].base_vertex;
+    l.min_screen_size = vd.lod_min_screen_sizes[i];
+    l.error = vd.lod_errors[i];
+    l.first_meshlet = vd.lod_first_meshlet[i];
+    l.meshlet_count = vd.lod_meshlet_count[i];
+  }
+
+  out.clear();
+  out.resize(header.file_size, 0);
+  put_bytes(out, 0, &header, sizeof(header));
+  put_bytes(out, header.vertex_stream_offset, vd.vertices.data(), vd.vertex_count * sizeof(vertex));
+  u32 offset = header.index_stream_offset;
+  for (u32 i = 0; i < lod_count; i++)
+  {
+    const vector<u32>& indices = lods[i].indices;
+    if (vd.index_size == 2)
+    {
+      u16* dst = reinterpret_cast<u16*>(out.data() + offset);
+      for (u32 j = 0; j < indices.size(); j++)
+        dst[j] = (u16)indices[j];
+    }
+    else
+    {
+      put_bytes(out, offset, indices.data(), indices.size() * sizeof(u32));
+    }
+    offset += indices.size() * vd.index_size;
+  }
+  put_bytes(out, header.meshlet_stream_offset, vd.meshlets.data(), header.meshlet_count * sizeof(meshlet));
+}
+
+bool write_cooked_mesh(const char* path, mesh_lod const* lods, u32 lod_count)
+{
+  vector<u8> blob;
+  cook_mesh(lods, lod_count, blob);
+  FILE* f = fopen(path, "wb");
+  if (f == nullptr)
+    return false;
+  const bool ok = fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+  return fclose(f) == 0 && ok;
+}
+
+bool view_cooked_mesh(u8 const* data, u64 size, cooked_mesh& out)
+{
+  if (size < sizeof(cooked_mesh_header))
+    return false;
+  const cooked_mesh_header* h = reinterpret_cast<const cooked_mesh_header*>(data);
+  if (h->magic != COOKED_MESH_MAGIC || h->version != COOKED_MESH_VERSION || h->file_size != size)
+    return false;
+  if (h->vertex_count == 0 || h->index_count == 0 || h->lod_count == 0 || h->lod_count > MAX_LODS || (h->index_size != 2 && h->index_size != 4))
+    return false;
+  if ((h->flags & ~COOKED_MESH_FLAG_GENERATED_LODS) != 0
+      || ((h->flags & COOKED_MESH_FLAG_GENERATED_LODS) != 0 && h->lod_count < 2))
+    return false;
+  // Streams are checked in 64 bits, counts come from the file. They follow the header and each other
+  // without overlapping.
+  if (h->vertex_stream_offset % COOKED_MESH_ALIGNMENT != 0 || h->index_stream_offset % COOKED_MESH_ALIGNMENT != 0
+      || h->meshlet_stream_offset % COOKED_MESH_ALIGNMENT != 0 || h->vertex_stream_offset < sizeof(cooked_mesh_header)
+      || h->vertex_stream_offset + (u64)h->vertex_count * sizeof(vertex) > h->index_stream_offset
+      || h->index_stream_offset + (u64)h->index_count * h->index_size > h->meshlet_stream_offset
+      || h->meshlet_stream_offset + (u64)h->meshlet_count * sizeof(meshlet) > size)
+    return false;
+  const u8* indices = data + h->index_stream_offset;
+  const meshlet* meshlets = reinterpret_cast<const meshlet*>(data + h->meshlet_stream_offset);
+  for (u32 i = 0; i < h->lod_count; i++)
+  {
+    const cooked_mesh_lod& l = h->lods[i];
+    if (l.index_count == 0 || l.index_count % 3 != 0 || (u64)l.first_index + l.index_count > h->index_count
+        || (u64)l.first_meshlet + l.meshlet_count > h->meshlet_count)
+      return false;
+    // Levels follow each other in the vertex stream, so every level has vertices and the count of the
+    // last one doesn't underflow.
+    const i64 end = i + 1 < h->lod_count ? h->lods[i + 1].base_vertex : (i64)h->vertex_count;
+    if (l.base_vertex < 0 || l.base_vertex >= end)
+      return false;
+    const u32 vertex_count = (u32)(end - l.base_vertex);
+    if (max_index(indices, h->index_size, l.first_index, l.index_count) >= vertex_count)
+      return false;
+    for (u32 m = l.first_meshlet; m < l.first_meshlet + l.meshlet_count; m++)
+    {
+      if ((u64)meshlets[m].first_index + meshlets[m].index_count > l.index_count)
+        return false;
+    }
+  }
+
+  out.header = h;
+  out.vertices = reinterpret_cast<vertex const*>(data + h->vertex_stream_offset);
+  out.indices = indices;
+  out.meshlets = meshlets;
+  return true;
+}
+
+content_hash hash_cooked_mesh(cooked_mesh const& mesh)
+{
+  const cooked_mesh_header& h = *mesh.header;
+  content_hash hash = hash_content(mesh.vertices, (u64)h.vertex_count * sizeof(vertex));
+  hash = hash_content(mesh.indices, (u64)h.index_count * h.index_size, hash);
+  hash = hash_content(&h.flags, sizeof(h.flags), hash);
+  return hash_content(h.lods, h.lod_count * sizeof(cooked_mesh_lod), hash);
+}
+
+vertex_data make_vertex_data(cooked_mesh const& mesh)
+{
+  const cooked_mesh_header& h = *mesh.header;
+  vertex_data ret;
+  ret.vertex_offset = 0;
+  ret.vertex_count = h.vertex_count;
+  ret.index_offset = 0;
+  ret.index_count = h.index_count;
+  ret.index_size = h.index_size;
+  ret.lod_count = h.lod_count;
+  ret.generated_lods = (h.flags & COOKED_MESH_FLAG_GENERATED_LODS) != 0;
+  for (u32 i = 0; i < h.lod_count; i++)
+  {
+    const cooked_mesh_lod& l = h.lods[i];
+    ret.lods[i].first_index = l.first_index;
+    ret.lods[i].index_count = l.index_count;
+    ret.lods[i].base_vertex = l.base_vertex;
+    ret.lod_min_screen_sizes[i] = l.min_screen_size;
+    ret.lod_errors[i] = l.error;
+    ret.lod_first_meshlet[i] = l.first_meshlet;
+    ret.lod_meshlet_count[i] = l.meshlet_count;
+  }
+  ret.aabb_center = h.aabb_center;
+  ret.aabb_extent = h.aabb_extent;
+  ret.quantization = h.quantization;
+  ret.mapped_vertices = mesh.vertices;
+  ret.mapped_indices = mesh.indices;
+  ret.mapped_meshlets = mesh.meshlets;
+
+  const u32 lod0_vertex_count = lod_vertex_count(ret, 0);
+  ret.occluder_positions.reserve(lod0_vertex_count);
+  for (u32 i = 0; i < lod0_vertex_count; i++)
+    ret.occluder_positions.push_back(mesh.vertices[i].position);
+  const cooked_mesh_lod& lod0 = h.lods[0];
+  ret.occluder_indices.reserve(lod0.index_count);
+  for (u32 i = lod0.first_index; i < lod0.first_index + lod0.index_count; i++)
+  {
+    ret.occluder_indices.push_back(h.index_size == 2 ? (u32) static_cast<u16 const*>(mesh.indices)[i]
+                                                     : static_cast<u32 const*>(mesh.indices)[i]);
+  }
+  return ret;
+}
+
+bool same_cooked_content(cooked_mesh const& mesh, vertex_data const& vd)
+{
+  const cooked_mesh_header& h = *mesh.header;
+  if (vd.vertex_count != h.vertex_count || vd.index_count != h.index_count || vd.index_size != h.index_size
+      || vd.lod_count != h.lod_count || vd.generated_lods != ((h.flags & COOKED_MESH_FLAG_GENERATED_LODS) != 0)
+      || vd.mapped_indices == nullptr || meshlet_count(vd) != h.meshlet_count)
+    return false;
+  // Placing a mesh moves its levels by the arena offsets.
+  const u32 first_index = vd.index_offset * (4 / vd.index_size);
+  for (u32 i = 0; i < h.lod_count; i++)
+  {
+    const cooked_mesh_lod& l = h.lods[i];
+    if (vd.lods[i].first_index - first_index != l.first_index || vd.lods[i].index_count != l.index_count
+        || vd.lods[i].base_vertex - (i32)vd.vertex_offset != l.base_vertex || vd.lod_errors[i] != l.error
+        || vd.lod_first_meshlet[i] != l.first_meshlet || vd.lod_meshlet_count[i] != l.meshlet_count
+        || (vd.generated_lods == false && vd.lod_min_screen_sizes[i] != l.min_screen_size))
+      return false;
+  }
+  return memcmp(vd.mapped_vertices, mesh.vertices, (u64)h.vertex_count * sizeof(vertex)) == 0
+         && memcmp(vd.mapped_indices, mesh.indices, (u64)h.index_count * h.index_size) == 0
+         && memcmp(vd.mapped_meshlets, mesh.meshlets, (u64)h.meshlet_count * sizeof(meshlet)) == 0;
+}
+
+bool import_obj(const char* path, mesh_lod& out)
+{
+  vector<char> text;
+  if (read_text_file(path, text) == false)
+    return false;
+
+  vector<glm::vec3> positions;
+  vector<glm::vec3> normals;
+  // Vertex of every distinct pair of position and normal, normal + 1 so that 0 is none.
+  hash_map<u64, u32, util::mixing_hasher<u64>> vertex_of_pair;
+  vector<u32> polygon;
+  bool has_normals = true;
+  out.vertices.clear();
+  out.indices.clear();
+  out.min_screen_size = 0.0f;
+  out.error = 0.0f;
+  out.generated = false;
+
+  const char* p = text.data();
+  while (*p != '\0')
+  {
+    p = skip_spaces(p);
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+    {
+      char* end;
+      glm::vec3 v;
+      v.x = strtof(p + 2, &end);
+      v.y = strtof(end, &end);
+      v.z = strtof(end, &end);
+      positions.push_back(v);
+      p = end;
+    }
+    else if (p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+    {
+      char* end;
+      glm::vec3 n;
+      n.x = strtof(p + 3, &end);
+      n.y = strtof(end, &end);
+      n.z = strtof(end, &end);
+      const f32 l = glm::length(n);
+      normals.push_back(l > 0.0f ? n / l : glm::vec3{ 0.0f, 0.0f, 1.0f });
+      p = end;
+    }
+    else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+    {
+      polygon.clear();
+      p = skip_spaces(p + 1);
+      while (*p != '\0' && *p != '\n' && *p != '\r' && *p != '#')
+      {
+        // Corner is position[/texcoord][/normal], texture coordinates are not used.
+        char* end;
+        u32 position;
+        if (resolve_index(strtol(p, &end, 10), positions.size(), position) == false)
+          return false;
+        u32 normal = (u32)-1;
+        if (*end == '/')
+        {
+          p = end + 1;
+          end = const_cast<char*>(p);
+          if (*p != '/')
+            strtol(p, &end, 10);
+          if (*end == '/')
+          {
+            if (resolve_index(strtol(end + 1, &end, 10), normals.size(), normal) == false)
+              return false;
+          }
+        }
+        has_normals = has_normals && normal != (u32)-1;
+
+        const u64 key = ((u64)position << 32) | (u32)(normal + 1);
+        auto it = vertex_of_pair.find(key);
+        if (it == vertex_of_pair.end())
+        {
+          vertex v;
+          v.position = positions[position];
+          v.normal = normal != (u32)-1 ? normals[normal] : glm::vec3{ 0.0f };
+          vertex_of_pair.insert(u64{ key }, out.vertices.size());
+          polygon.push_back(out.vertices.size());
+          out.vertices.push_back(v);
+        }
+        else
+        {
+          polygon.push_back(it->value);
+        }
+        p = skip_spaces(end);
+      }
+      for (u32 i = 1; i + 1 < polygon.size(); i++)
+      {
+        out.indices.push_back(polygon[0]);
+        out.indices.push_back(polygon[i + 1]);
+        out.indices.push_back(polygon[i]);
+      }
+    }
+    p = skip_line(p);
+  }
+  if (out.indices.size() == 0)
+    return false;
+
+  if (has_normals == false)
+  {
+    // Area-weighted face normals, outward for clockwise triangles.
+    for (u32 i = 0; i < out.vertices.size(); i++)
+      out.vertices[i].normal = glm::vec3{ 0.0f };
+    for (u32 i = 0; i < out.indices.size(); i += 3)
+    {
+      vertex& v0 = out.vertices[out.indices[i + 0]];
+      vertex& v1 = out.vertices[out.indices[i + 1]];
+      vertex& v2 = out.vertices[out.indices[i + 2]];
+      const glm::vec3 n = glm::cross(v2.position - v0.position, v1.position - v0.position);
+      v0.normal += n;
+      v1.normal += n;
+      v2.normal += n;
+    }
+    for (u32 i = 0; i < out.vertices.size(); i++)
+    {
+      const f32 l = glm::length(out.vertices[i].normal);
+      out.vertices[i].normal = l > 0.0f ? out.vertices[i].normal / l : glm::vec3{ 0.0f, 0.0f, 1.0f };
+    }
+  }
+  return true;
+}
+
+bool cook_obj(const char* obj_path, const char* mesh_path)
+{
+  mesh_lod lods[MAX_LODS];
+  if (import_obj(obj_path, lods[0]) == false)
+    return false;
+  const u32 lod_count = generate_lod_chain(lods, LOD_CHAIN_RATIOS, LOD_CHAIN_LEVELS);
+  for (u32 i = 0; i < lod_count; i++)
+    optimize_mesh(lods[i]);
+  return write_cooked_mesh(mesh_path, lods, lod_count);
+}
+
+bool open_cooked_mesh(const char* path, mapped_file& file, cooked_mesh& out)
+{
+  const size_t length = strlen(path);
+  if (length < 4 || strcmp(path + length - 4, ".obj") != 0)
+    return file.open(path) && view_cooked_mesh(file.data(), file.size(), out);
+
+  char mesh_path[1024];
+  if (length + 2 > sizeof(mesh_path))
+    return false;
+  memcpy(mesh_path, path, length - 4);
+  memcpy(mesh_path + length - 4, ".mesh", 6);
+  if (file.open(mesh_path) && view_cooked_mesh(file.data(), file.size(), out))
+    return true;
+  // Unmapped before writing, Windows doesn't allow replacing a mapped file.
+  file.close();
+  return cook_obj(path, mesh_path) && file.open(mesh_path) && view_cooked_mesh(file.data(), file.size(), out);
+}
+
+namespace
+{
+struct content_check
+{
+  cooked_mesh const* mesh;
+  mesh_store const* store;
+};
+
+// Confirms a registry hit.
+bool same_loaded_content(void* ctx, u32 id)
+{
+  const content_check& check = *static_cast<const content_check*>(ctx);
+  return same_cooked_content(*check.mesh, *check.store->get(check.store->ctx, id));
+}
+} // namespace
+
+mesh_loader::~mesh_loader()
+{
+  for (u32 i = 0; i < m_files.size(); i++)
+    delete m_files[i];
+}
+
+i32 mesh_loader::load(const char* path, mesh_store const& store)
+{
+  const f64 start_time = platform::seconds();
+  mapped_file file;
+  cooked_mesh mesh;
+  if (open_cooked_mesh(path, file, mesh) == false)
+    return -1;
+
+  const content_hash hash = hash_cooked_mesh(mesh);
+  const cooked_mesh_header& h = *mesh.header;
+  const u64 bytes = (u64)h.vertex_count * store.vertex_size + (u64)h.index_count * h.index_size;
+  content_check check = { &mesh, &store };
+  const u32 shared = m_registry.acquire(hash, bytes, 2, same_loaded_content, &check);
+  if (shared != mesh_registry::INVALID_ID)
+    return (i32)shared;
+
+  const u32 id = store.allocate(store.ctx);
+  if (id == mesh_registry::INVALID_ID || store.create(store.ctx, id, mesh) == false)
+    return -1;
+  m_registry.insert(hash, id);
+  m_stats.meshes++;
+  m_stats.bytes += file.size();
+  m_stats.time += platform::seconds() - start_time;
+  if (id >= m_files.size())
+    m_files.resize(id + 1, nullptr);
+  my_assert(m_files[id] == nullptr);
+  m_files[id] = new mapped_file;
+  m_files[id]->swap(file);
+  return (i32)id;
+}
+
+bool mesh_loader::release(u32 id, mesh_store const& store)
+{
+  if (m_registry.reference_count(id) == 0)
+    return false;
+  if (m_registry.release(id))
+  {
+    store.destroy(store.ctx, id);
+    delete m_files[id];
+    m_files[id] = nullptr;
+  }
+  return true;
+}
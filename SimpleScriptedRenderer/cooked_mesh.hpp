@@ -0,0 +1,160 @@
+#pragma once
+#include "content_hash.hpp"
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "mesh_registry.hpp"
+#include "meshlet.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+#include "vertex.hpp"
+#include "vertex_quantization.hpp"
+
+// Cooked meshes, the internal format meshes are loaded from.
+// Blob is a header followed by streams in the layout they are used in: float vertices of all levels,
+// indices of all levels in the index size of the mesh, then meshlets. Streams start at aligned offsets,
+// so a memory-mapped blob is handed to buffer creation as is. Everything derived from the source,
+// like bounds, quantization and levels of detail, is computed when cooking.
+// Mapping a blob uses its structures in place, it is only valid for the byte order it was cooked on.
+
+static constexpr u32 COOKED_MESH_MAGIC = 0x4D525353; // "SSRM"
+static constexpr u32 COOKED_MESH_VERSION = 2;
+static constexpr u32 COOKED_MESH_ALIGNMENT = 64;
+
+// Levels after the first were generated, see vertex_data::generated_lods.
+static constexpr u32 COOKED_MESH_FLAG_GENERATED_LODS = 1;
+
+struct cooked_mesh_lod
+{
+  u32 first_index;
+  u32 index_count;
+  i32 base_vertex;
+  f32 min_screen_size;
+  f32 error;
+  u32 first_meshlet;
+  u32 meshlet_count;
+  u32 _pad0;
+};
+
+struct cooked_mesh_header
+{
+  u32 magic;
+  u32 version;
+  u32 file_size;
+  u32 lod_count;
+  u32 vertex_count;
+  u32 index_count;
+  u32 index_size;
+  u32 meshlet_count;
+  // Byte offsets of streams from the start of the blob.
+  u32 vertex_stream_offset;
+  u32 index_stream_offset;
+  u32 meshlet_stream_offset;
+  // COOKED_MESH_FLAG_ values.
+  u32 flags;
+  glm::vec3 aabb_center;
+  f32 _pad1;
+  glm::vec3 aabb_extent;
+  f32 _pad2;
+  vertex_quantization quantization;
+  cooked_mesh_lod lods[MAX_LODS];
+};
+
+// Writes levels of a mesh, see make_vertex_data for what they need to be.
+void cook_mesh(mesh_lod const* lods, u32 lod_count, vector<u8>& out);
+bool write_cooked_mesh(const char* path, mesh_lod const* lods, u32 lod_count);
+
+// Pointers into a cooked blob.
+struct cooked_mesh
+{
+  cooked_mesh_header const* header;
+  vertex const* vertices;
+  // u16 or u32 by header->index_size, relative to the base vertex of their level.
+  void const* indices;
+  meshlet const* meshlets;
+};
+
+// Checks the header, bounds of streams, level ranges, every index and every meshlet range.
+// Returns false for other versions and damaged blobs.
+bool view_cooked_mesh(u8 const* data, u64 size, cooked_mesh& out);
+
+// Hash of vertex and index streams and of level ranges, for looking up meshes with the same content.
+content_hash hash_cooked_mesh(cooked_mesh const& mesh);
+
+// The same mesh as make_vertex_data of the source levels gives. Streams are not copied, the mesh points
+// into the blob, which has to outlive it. Only triangles of the finest level are copied for occlusion.
+vertex_data make_vertex_data(cooked_mesh const& mesh);
+
+// Compares streams and levels byte for byte with a mesh made by make_vertex_data from a cooked one,
+// wherever it was placed since. Meshes made from levels never compare equal. Switch sizes derived by set_lod_screen_error are not compared.
+bool same_cooked_content(cooked_mesh const& mesh, vertex_data const& vd);
+
+// Reads positions, normals and faces of a Wavefront OBJ file, other records are skipped.
+// Polygons are split into fans, winding is reversed to the clockwise front faces of the renderer.
+// Normals are averaged from faces when the file has none.
+bool import_obj(const char* path, mesh_lod& out);
+
+// Imports an OBJ file, generates levels of detail, optimizes them and writes the cooked mesh.
+bool cook_obj(const char* obj_path, const char* mesh_path);
+
+// Maps a cooked mesh. For a path ending in ".obj" the mesh next to it with the extension ".mesh" is used,
+// it is cooked first when missing or written by another version.
+bool open_cooked_mesh(const char* path, mapped_file& file, cooked_mesh& out);
+
+// Where loaded meshes live, implemented by their owner. ctx is passed to every function.
+struct mesh_store
+{
+  void* ctx;
+  // Returns a free mesh id, mesh_registry::INVALID_ID when there is none.
+  u32 (*allocate)(void* ctx);
+  // Creates mesh id from a cooked one. Returns false when there is no room for its data, the id stays free.
+  bool (*create)(void* ctx, u32 id, cooked_mesh const& mesh);
+  // Destroys mesh id together with entities drawn with it, the id becomes free.
+  void (*destroy)(void* ctx, u32 id);
+  vertex_data const* (*get)(void* ctx, u32 id);
+  // Of the format meshes are uploaded in, for the savings of shared loads.
+  u32 vertex_size;
+};
+
+struct mesh_load_stats
+{
+  // Meshes created from files, bytes of the files and time spent on mapping, validation,
+  // occluder copies and upload.
+  u32 meshes = 0;
+  u64 bytes = 0;
+  f64 time = 0.0;
+};
+
+// Loads mesh files through open_cooked_mesh once per content, see mesh_registry.hpp.
+// Used by the application and the headless runner, which differ in their stores.
+// Files stay mapped while their mesh is resident, the mesh points into them.
+class mesh_loader
+{
+public:
+  mesh_loader() = default;
+  mesh_loader(mesh_loader const&) = delete;
+  mesh_loader& operator=(mesh_loader const&) = delete;
+  ~mesh_loader();
+
+  // Returns the id of a resident mesh with the same content, with one more reference,
+  // or of a new one. -1 when the file can't be loaded or the store is full.
+  i32 load(const char* path, mesh_store const& store);
+  // Drops a reference taken by load, the last one destroys the mesh.
+  // Returns false for ids which load didn't return.
+  bool release(u32 id, mesh_store const& store);
+
+  mesh_load_stats const& stats() const
+  {
+    return m_stats;
+  }
+
+  mesh_registry_stats const& registry_stats() const
+  {
+    return m_registry.stats();
+  }
+
+private:
+  mesh_registry m_registry;
+  // By mesh id, null for ids which are not loaded.
+  vector<mapped_file*> m_files;
+  mesh_load_stats m_stats;
+};
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cooked_texture.hpp"
+#include "jobs.hpp"
+#include "mapped_file.hpp"
+#include "platform.hpp"
+#include "vector.hpp"
+
+#pragma warning(push)
+#pragma warning(disable : 4996 4244 4100)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize.h"
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+#pragma warning(pop)
+
+static_assert(sizeof(cooked_texture_header) % 16 == 0, "header is followed by aligned levels");
+
+namespace
+{
+// Decoded files of a group are held in memory until their blocks are compressed.
+constexpr u32 TEXTURE_COOK_GROUP_SIZE = 32;
+// Block rows are compressed in chunks of this many.
+constexpr u32 BLOCK_ROW_CHUNK = 8;
+
+u32 align_up(u32 value)
+{
+  return (value + COOKED_TEXTURE_ALIGNMENT - 1) & ~(COOKED_TEXTURE_ALIGNMENT - 1);
+}
+
+u32 level_dimension(u32 size, u32 level)
+{
+  const u32 d = size >> level;
+  return d > 0 ? d : 1;
+}
+
+struct texture_job
+{
+  const char* source_path;
+  const char* output_path;
+  bool up_to_date;
+  bool failed;
+  // RGBA8 pixels of all levels, level i starts at pixel_offsets[i].
+  vector<u8> pixels;
+  u32 pixel_offsets[MAX_TEXTURE_LEVELS];
+  vector<u8> blob;
+};
+
+struct block_row
+{
+  u32 job;
+  u32 level;
+  u32 row;
+};
+
+// Hash seed, so that changed settings cook again.
+content_hash settings_seed(texture_cook_settings const& settings)
+{
+  content_hash seed;
+  seed.lo = COOKED_TEXTURE_VERSION;
+  seed.hi = (settings.srgb ? 1 : 0) | (settings.high_quality ? 2 : 0);
+  return seed;
+}
+
+bool is_up_to_date(const char* output_path, content_hash const& source_hash)
+{
+  mapped_file file;
+  if (file.open(output_path) == false)
+    return false;
+  const cooked_texture_header* h = view_cooked_texture(file.data(), file.size());
+  return h != nullptr && h->source_hash == source_hash;
+}
+
+// Decodes the source, builds the mip chain and lays out the output blob with the header filled in.
+void prepare_texture(texture_job& job, texture_cook_settings const& settings)
+{
+  mapped_file source;
+  if (source.open(job.source_path) == false || source.size() > 0x7FFFFFFF)
+  {
+    job.failed = true;
+    return;
+  }
+  const content_hash source_hash = hash_content(source.data(), source.size(), settings_seed(settings));
+  if (is_up_to_date(job.output_path, source_hash))
+  {
+    job.up_to_date = true;
+    return;
+  }
+
+  int width;
+  int height;
+  int channels;
+  stbi_uc* image = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4);
+  if (image == nullptr || width > (1 << (MAX_TEXTURE_LEVELS - 1)) || height > (1 << (MAX_TEXTURE_LEVELS - 1)))
+  {
+    stbi_image_free(image);
+    job.failed = true;
+    return;
+  }
+
+  cooked_texture_header header = {};
+  header.magic = COOKED_TEXTURE_MAGIC;
+  header.version = COOKED_TEXTURE_VERSION;
+  header.width = (u32)width;
+  header.height = (u32)height;
+  header.srgb = settings.srgb ? 1 : 0;
+  header.source_hash = source_hash;
+  header.format = TEXTURE_FORMAT_BC1;
+  for (u32 i = 0; i < header.width * header.height; i++)
+  {
+    if (image[i * 4 + 3] != 255)
+    {
+      header.format = TEXTURE_FORMAT_BC3;
+      break;
+    }
+  }
+
+  u32 pixel_count = 0;
+  u32 offset = align_up(sizeof(cooked_texture_header));
+  while (true)
+  {
+    const u32 level = header.level_count++;
+    const u32 w = level_dimension(header.width, level);
+    const u32 h = level_dimension(header.height, level);
+    cooked_texture_level& l = header.levels[level];
+    l.width = w;
+    l.height = h;
+    l.offset = offset;
+    l.size = ((w + 3) / 4) * ((h + 3) / 4) * texture_block_size(header.format);
+    offset = align_up(offset + l.size);
+    job.pixel_offsets[level] = pixel_count * 4;
+    pixel_count += w * h;
+    if (w == 1 && h == 1)
+      break;
+  }
+  header.file_size = offset;
+
+  job.pixels.resize(pixel_count * 4, 0);
+  memcpy(job.pixels.data(), image, header.width * header.height * 4);
+  stbi_image_free(image);
+  const stbir_colorspace colorspace = settings.srgb ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+  for (u32 i = 1; i < header.level_count; i++)
+  {
+    const cooked_texture_level& src = header.levels[i - 1];
+    const cooked_texture_level& dst = header.levels[i];
+    // Each level is filtered from the previous one, alpha is channel 3.
+    stbir_resize_uint8_generic(job.pixels.data() + job.pixel_offsets[i - 1], (int)src.width, (int)src.height, 0,
+                               job.pixels.data() + job.pixel_offsets[i], (int)dst.width, (int)dst.height, 0, 4, 3, 0,
+                               STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, colorspace, nullptr);
+  }
+
+  job.blob.resize(header.file_size, 0);
+  memcpy(job.blob.data(), &header, sizeof(header));
+}
+
+void compress_block_row(texture_job& job, u32 level, u32 row, int mode)
+{
+  const cooked_texture_header& header = *reinterpret_cast<const cooked_texture_header*>(job.blob.data());
+  const cooked_texture_level& l = header.levels[level];
+  const u8* pixels = job.pixels.data() + job.pixel_offsets[level];
+  const u32 block_size = texture_block_size(header.format);
+  const u32 blocks_x = (l.width + 3) / 4;
+  u8* dst = job.blob.data() + l.offset + row * blocks_x * block_size;
+  u8 block[4 * 4 * 4];
+  for (u32 bx = 0; bx < blocks_x; bx++)
+  {
+    // Edges of levels smaller than a block are repeated.
+    for (u32 y = 0; y < 4; y++)
+    {
+      const u32 py = row * 4 + y < l.height ? row * 4 + y : l.height - 1;
+      for (u32 x = 0; x < 4; x++)
+      {
+        const u32 px = bx * 4 + x < l.width ? bx * 4 + x : l.width - 1;
+        memcpy(block + (y * 4 + x) * 4, pixels + (py * l.width + px) * 4, 4);
+      }
+    }
+    stb_compress_dxt_block(dst + bx * block_size, block, header.format == TEXTURE_FORMAT_BC3 ? 1 : 0, mode);
+  }
+}
+
+bool write_blob(const char* path, vector<u8> const& blob)
+{
+  FILE* f = fopen(path, "wb");
+  if (f == nullptr)
+    return false;
+  const bool ok = fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+  return fclose(f) == 0 && ok;
+}
+} // namespace
+
+cooked_texture_header const* view_cooked_texture(u8 const* data, u64 size)
+{
+  if (size < sizeof(cooked_texture_header))
+    return nullptr;
+  const cooked_texture_header* h = reinterpret_cast<const cooked_texture_header*>(data);
+  if (h->magic != COOKED_TEXTURE_MAGIC || h->version != COOKED_TEXTURE_VERSION || h->file_size != size)
+    return nullptr;
+  if ((h->format != TEXTURE_FORMAT_BC1 && h->format != TEXTURE_FORMAT_BC3) || h->level_count == 0
+      || h->level_count > MAX_TEXTURE_LEVELS)
+    return nullptr;
+  for (u32 i = 0; i < h->level_count; i++)
+  {
+    const cooked_texture_level& l = h->levels[i];
+    if (l.offset % COOKED_TEXTURE_ALIGNMENT != 0 || (u64)l.offset + l.size > size
+        || l.size != ((l.width + 3) / 4) * ((l.height + 3) / 4) * texture_block_size(h->format))
+      return nullptr;
+  }
+  return h;
+}
+
+void cook_textures(const char* const* source_paths, const char* const* output_paths, u32 count,
+                   texture_cook_settings const& settings, texture_cook_stats& stats)
+{
+  const int mode = settings.high_quality ? STB_DXT_HIGHQUAL : STB_DXT_NORMAL;
+  vector<texture_job> textures;
+  vector<block_row> rows;
+  for (u32 first = 0; first < count; first += TEXTURE_COOK_GROUP_SIZE)
+  {
+    const u32 group_count = count - first < TEXTURE_COOK_GROUP_SIZE ? count - first : TEXTURE_COOK_GROUP_SIZE;
+    textures.clear();
+    for (u32 i = 0; i < group_count; i++)
+    {
+      texture_job job = {};
+      job.source_path = source_paths[first + i];
+      job.output_path = output_paths[first + i];
+      textures.push_back(util::move(job));
+    }
+
+    f64 t = platform::seconds();
+    jobs::parallel_for(group_count, 1, [&](u32 begin, u32 end, u32)
+    {
+      for (u32 i = begin; i < end; i++)
+        prepare_texture(textures[i], settings);
+    });
+    const f64 decoded = platform::seconds();
+    stats.decode_time += decoded - t;
+
+    rows.clear();
+    for (u32 i = 0; i < group_count; i++)
+    {
+      if (textures[i].blob.size() == 0)
+        continue;
+      const cooked_texture_header& header = *reinterpret_cast<const cooked_texture_header*>(textures[i].blob.data());
+      for (u32 level = 0; level < header.level_count; level++)
+      {
+        for (u32 row = 0; row < (header.levels[level].height + 3) / 4; row++)
+          rows.push_back({ i, level, row });
+      }
+    }
+    jobs::parallel_for(rows.size(), BLOCK_ROW_CHUNK, [&](u32 begin, u32 end, u32)
+    {
+      for (u32 i = begin; i < end; i++)
+        compress_block_row(textures[rows[i].job], rows[i].level, rows[i].row, mode);
+    });
+    const f64 compressed = platform::seconds();
+    stats.compress_time += compressed - decoded;
+
+    for (u32 i = 0; i < group_count; i++)
+    {
+      const texture_job& job = textures[i];
+      if (job.up_to_date)
+      {
+        stats.skipped++;
+        continue;
+      }
+      if (job.failed || write_blob(job.output_path, job.blob) == false)
+      {
+        stats.failed++;
+        continue;
+      }
+      const cooked_texture_header& header = *reinterpret_cast<const cooked_texture_header*>(job.blob.data());
+      stats.cooked++;
+      stats.source_bytes += (u64)header.width * header.height * 4;
+      stats.output_bytes += job.blob.size();
+    }
+    stats.write_time += platform::seconds() - compressed;
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "content_hash.hpp"
+#include "types.hpp"
+
+// Cooked textures, the internal format textures are loaded from.
+// Images stb_image can decode are converted to RGBA8, filtered down to a full mip chain and every level
+// is compressed to BC1, or to BC3 when the image has transparent pixels.
+// Blob is a header followed by levels from the largest one, each at an aligned offset and stored as
+// rows of 4x4 blocks, the layout D3D11 takes as initial data of a BC texture.
+// The header keeps a hash of the source file and cook settings, outputs which match are not cooked again.
+
+static constexpr u32 COOKED_TEXTURE_MAGIC = 0x54525353; // "SSRT"
+static constexpr u32 COOKED_TEXTURE_VERSION = 1;
+static constexpr u32 COOKED_TEXTURE_ALIGNMENT = 64;
+static constexpr u32 MAX_TEXTURE_LEVELS = 16;
+
+static constexpr u32 TEXTURE_FORMAT_BC1 = 0;
+static constexpr u32 TEXTURE_FORMAT_BC3 = 1;
+
+inline u32 texture_block_size(u32 format)
+{
+  return format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+struct cooked_texture_level
+{
+  u32 width;
+  u32 height;
+  // Byte offset from the start of the blob.
+  u32 offset;
+  u32 size;
+};
+
+struct cooked_texture_header
+{
+  u32 magic;
+  u32 version;
+  u32 file_size;
+  u32 format;
+  u32 width;
+  u32 height;
+  u32 level_count;
+  // Colors are sRGB encoded, sample through an _SRGB format.
+  u32 srgb;
+  content_hash source_hash;
+  cooked_texture_level levels[MAX_TEXTURE_LEVELS];
+};
+
+// Checks the header and bounds of levels, returns nullptr for other versions and damaged blobs.
+cooked_texture_header const* view_cooked_texture(u8 const* data, u64 size);
+
+struct texture_cook_settings
+{
+  // Color textures are sRGB, mips are filtered in linear space. Turn off for normal maps and masks.
+  bool srgb = true;
+  // Two refinement steps of stb_dxt instead of one, slower.
+  bool high_quality = false;
+};
+
+struct texture_cook_stats
+{
+  u32 cooked = 0;
+  u32 skipped = 0;
+  u32 failed = 0;
+  // RGBA8 size of the largest levels of cooked textures.
+  u64 source_bytes = 0;
+  u64 output_bytes = 0;
+  // Wall times of stages.
+  f64 decode_time = 0.0;
+  f64 compress_time = 0.0;
+  f64 write_time = 0.0;
+};
+
+// Cooks images to output files, up-to-date outputs are skipped. Files are decoded and filtered on job
+// threads one per file, then blocks of all levels of all files are compressed in one parallel loop.
+// Files go in groups to bound memory.
+void cook_textures(const char* const* source_paths, const char* const* output_paths, u32 count,
+                   texture_cook_settings const& settings, texture_cook_stats& stats);
@@ -0,0 +1,153 @@
+#include <xmmintrin.h>
+
+#include "culling.hpp"
+#include "my_assert.hpp"
+
+frustum make_frustum(glm::mat4x4 const& world_to_screen)
+{
+  // Clip space: -w <= x <= w, -w <= y <= w, 0 <= z <= w.
+  // Planes are combinations of rows of the world to screen matrix.
+  const glm::mat4x4& m = world_to_screen;
+  const glm::vec4 r0 = { m[0][0], m[1][0], m[2][0], m[3][0] };
+  const glm::vec4 r1 = { m[0][1], m[1][1], m[2][1], m[3][1] };
+  const glm::vec4 r2 = { m[0][2], m[1][2], m[2][2], m[3][2] };
+  const glm::vec4 r3 = { m[0][3], m[1][3], m[2][3], m[3][3] };
+
+  frustum f;
+  f.planes[0] = r3 + r0;
+  f.planes[1] = r3 - r0;
+  f.planes[2] = r3 + r1;
+  f.planes[3] = r3 - r1;
+  f.planes[4] = r2;
+  f.planes[5] = r3 - r2;
+  for (u32 i = 0; i < 6; i++)
+  {
+    f.planes[i] /= glm::length(glm::vec3{ f.planes[i] });
+  }
+  return f;
+}
+
+aabb transform_aabb(glm::vec3 const& center, glm::vec3 const& extent, glm::mat4x4 const& local_to_world)
+{
+  // Extent of transformed box is the sum of absolute values of transformed basis vectors.
+  const glm::vec3 c = glm::vec3{ local_to_world * glm::vec4{ center, 1.0f } };
+  const glm::vec3 e =
+    glm::abs(glm::vec3{ local_to_world[0] }) * extent.x +
+    glm::abs(glm::vec3{ local_to_world[1] }) * extent.y +
+    glm::abs(glm::vec3{ local_to_world[2] }) * extent.z;
+  return { c - e, c + e };
+}
+
+aabb aabb_union(aabb const& a, aabb const& b)
+{
+  return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+f32 aabb_area(aabb const& box)
+{
+  const glm::vec3 d = box.max - box.min;
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool aabb_contains(aabb const& outer, aabb const& inner)
+{
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+    && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+cull_result cull_aabb(frustum const& f, aabb const& box, u32 plane_mask, u32* out_plane_mask)
+{
+  // Compare distance from box center to plane against projected extent of the box.
+  const glm::vec3 c = 0.5f * (box.max + box.min);
+  const glm::vec3 e = 0.5f * (box.max - box.min);
+  u32 straddling = 0;
+  for (u32 plane = 0; plane < 6; plane++)
+  {
+    if ((plane_mask & (1u << plane)) == 0)
+      continue;
+    const glm::vec4& p = f.planes[plane];
+    const f32 d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+    const f32 r = e.x * glm::abs(p.x) + e.y * glm::abs(p.y) + e.z * glm::abs(p.z);
+    if (d + r < 0.0f)
+    {
+      *out_plane_mask = 0;
+      return cull_result::outside;
+    }
+    if (d - r < 0.0f)
+      straddling |= 1u << plane;
+  }
+  *out_plane_mask = straddling;
+  return straddling ? cull_result::intersecting : cull_result::inside;
+}
+
+void cull_aabbs_multi_view(frustum const* frusta, u32 view_count, aabb const* boxes, u32 count, u8* out_masks)
+{
+  my_assert(view_count > 0 && view_count <= MAX_VIEWS);
+
+  // Plane components and their absolute values, broadcast once for all boxes.
+  struct plane_x4
+  {
+    __m128 x, y, z, w;
+    __m128 abs_x, abs_y, abs_z;
+  };
+  plane_x4 planes[MAX_VIEWS * 6];
+  for (u32 v = 0; v < view_count; v++)
+  {
+    for (u32 i = 0; i < 6; i++)
+    {
+      const glm::vec4& p = frusta[v].planes[i];
+      plane_x4& dst = planes[v * 6 + i];
+      dst.x = _mm_set1_ps(p.x);
+      dst.y = _mm_set1_ps(p.y);
+      dst.z = _mm_set1_ps(p.z);
+      dst.w = _mm_set1_ps(p.w);
+      dst.abs_x = _mm_set1_ps(glm::abs(p.x));
+      dst.abs_y = _mm_set1_ps(glm::abs(p.y));
+      dst.abs_z = _mm_set1_ps(glm::abs(p.z));
+    }
+  }
+
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  for (u32 i = 0; i < count; i += 4)
+  {
+    // Tail is padded by repeating the last box, its lanes are not written.
+    const aabb& b0 = boxes[i];
+    const aabb& b1 = boxes[i + 1 < count ? i + 1 : count - 1];
+    const aabb& b2 = boxes[i + 2 < count ? i + 2 : count - 1];
+    const aabb& b3 = boxes[i + 3 < count ? i + 3 : count - 1];
+    const __m128 min_x = _mm_setr_ps(b0.min.x, b1.min.x, b2.min.x, b3.min.x);
+    const __m128 min_y = _mm_setr_ps(b0.min.y, b1.min.y, b2.min.y, b3.min.y);
+    const __m128 min_z = _mm_setr_ps(b0.min.z, b1.min.z, b2.min.z, b3.min.z);
+    const __m128 max_x = _mm_setr_ps(b0.max.x, b1.max.x, b2.max.x, b3.max.x);
+    const __m128 max_y = _mm_setr_ps(b0.max.y, b1.max.y, b2.max.y, b3.max.y);
+    const __m128 max_z = _mm_setr_ps(b0.max.z, b1.max.z, b2.max.z, b3.max.z);
+    const __m128 cx = _mm_mul_ps(_mm_add_ps(max_x, min_x), half);
+    const __m128 cy = _mm_mul_ps(_mm_add_ps(max_y, min_y), half);
+    const __m128 cz = _mm_mul_ps(_mm_add_ps(max_z, min_z), half);
+    const __m128 ex = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+    const __m128 ey = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+    const __m128 ez = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+    u32 masks[4] = {};
+    for (u32 v = 0; v < view_count; v++)
+    {
+      __m128 outside = zero;
+      for (u32 j = 0; j < 6; j++)
+      {
+        const plane_x4& p = planes[v * 6 + j];
+        const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p.x, cx), _mm_mul_ps(p.y, cy)),
+                                    _mm_add_ps(_mm_mul_ps(p.z, cz), p.w));
+        const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p.abs_x, ex), _mm_mul_ps(p.abs_y, ey)),
+                                    _mm_mul_ps(p.abs_z, ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+      }
+      const u32 visible = ~(u32)_mm_movemask_ps(outside);
+      for (u32 lane = 0; lane < 4; lane++)
+        masks[lane] |= ((visible >> lane) & 1u) << v;
+    }
+
+    for (u32 lane = 0; lane < 4 && i + lane < count; lane++)
+      out_masks[i + lane] = (u8)masks[lane];
+  }
+}
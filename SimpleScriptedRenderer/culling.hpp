@@ -0,0 +1,48 @@
+#pragma once
+#include "my_glm.hpp"
+#include "types.hpp"
+
+// Axis-aligned bounding box.
+struct aabb
+{
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// View frustum as six world space planes: left, right, bottom, top, near, far.
+// Plane normals are pointed inside the view frustum,
+// point p is inside when dot(plane.xyz, p) + plane.w >= 0.
+struct frustum
+{
+  glm::vec4 planes[6];
+};
+
+static constexpr u32 FRUSTUM_ALL_PLANES = 0x3F;
+
+enum class cull_result
+{
+  outside,
+  intersecting,
+  inside
+};
+
+frustum make_frustum(glm::mat4x4 const& world_to_screen);
+
+// Bounds of a local space box (center + extent) after transformation.
+aabb transform_aabb(glm::vec3 const& center, glm::vec3 const& extent, glm::mat4x4 const& local_to_world);
+
+aabb aabb_union(aabb const& a, aabb const& b);
+f32 aabb_area(aabb const& box);
+bool aabb_contains(aabb const& outer, aabb const& inner);
+
+// Tests box against planes set in plane_mask.
+// Planes which the box straddles are written to out_plane_mask,
+// so children of the box only have to be tested against those.
+cull_result cull_aabb(frustum const& f, aabb const& box, u32 plane_mask, u32* out_plane_mask);
+
+static constexpr u32 MAX_VIEWS = 8;
+
+// Culls boxes against several frusta at once.
+// Bit v of out_masks[i] is set when boxes[i] intersects frusta[v].
+// Each box is loaded once for all views, four boxes are tested at a time.
+void cull_aabbs_multi_view(frustum const* frusta, u32 view_count, aabb const* boxes, u32 count, u8* out_masks);
@@ -26,6 +26,7 @@ void d3d11_renderer::init(HWND hwnd)
     hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, feature_levels, 1,
                            D3D11_SDK_VERSION, device.ReleaseAndGetAddressOf(), nullptr, ctx.ReleaseAndGetAddressOf());
     my_assert(SUCCEEDED(hr));
+    ctx.As(&ctx1);
   }
 
   swapchain_desc = {};
@@ -46,6 +47,7 @@ void d3d11_renderer::init(HWND hwnd)
 void d3d11_renderer::shutdown()
 {
   destroy_swapchain();
+  ctx1.Reset();
   ctx.Reset();
   device.Reset();
 }
@@ -136,3 +138,126 @@ void d3d11_renderer::set_multisample_count(u32 sample_count)
     create_swapchain();
   }
 }
+
+void d3d11_context::set_render_target(void* rtv, void* dsv)
+{
+  ID3D11RenderTargetView* rtvs[1] = { static_cast<ID3D11RenderTargetView*>(rtv) };
+  ctx->OMSetRenderTargets(1, rtvs, static_cast<ID3D11DepthStencilView*>(dsv));
+}
+
+void d3d11_context::set_viewport(viewport const& vp)
+{
+  D3D11_VIEWPORT d3d_vp = {};
+  d3d_vp.TopLeftX = vp.x;
+  d3d_vp.TopLeftY = vp.y;
+  d3d_vp.Width = vp.width;
+  d3d_vp.Height = vp.height;
+  d3d_vp.MinDepth = vp.min_depth;
+  d3d_vp.MaxDepth = vp.max_depth;
+  ctx->RSSetViewports(1, &d3d_vp);
+}
+
+void d3d11_context::set_blend_state(void* state)
+{
+  ctx->OMSetBlendState(static_cast<ID3D11BlendState*>(state), nullptr, 0xFFFFFFFu);
+}
+
+void d3d11_context::set_depth_stencil_state(void* state)
+{
+  ctx->OMSetDepthStencilState(static_cast<ID3D11DepthStencilState*>(state), 0);
+}
+
+void d3d11_context::set_rasterizer_state(void* state)
+{
+  ctx->RSSetState(static_cast<ID3D11RasterizerState*>(state));
+}
+
+void d3d11_context::set_input_layout(void* layout)
+{
+  ctx->IASetInputLayout(static_cast<ID3D11InputLayout*>(layout));
+}
+
+void d3d11_context::set_primitive_topology(u32 topology)
+{
+  ctx->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void d3d11_context::set_vertex_buffer(u32 slot, void* buffer, u32 stride, u32 offset)
+{
+  ID3D11Buffer* buffers[1] = { static_cast<ID3D11Buffer*>(buffer) };
+  ctx->IASetVertexBuffers(slot, 1, buffers, &stride, &offset);
+}
+
+void d3d11_context::set_index_buffer(void* buffer, u32 format, u32 offset)
+{
+  ctx->IASetIndexBuffer(static_cast<ID3D11Buffer*>(buffer), (DXGI_FORMAT)format, offset);
+}
+
+void d3d11_context::set_vertex_shader(void* shader)
+{
+  ctx->VSSetShader(static_cast<ID3D11VertexShader*>(shader), nullptr, 0);
+}
+
+void d3d11_context::set_pixel_shader(void* shader)
+{
+  ctx->PSSetShader(static_cast<ID3D11PixelShader*>(shader), nullptr, 0);
+}
+
+void d3d11_context::set_vs_constant_buffer(u32 slot, void* buffer)
+{
+  ID3D11Buffer* buffers[1] = { static_cast<ID3D11Buffer*>(buffer) };
+  ctx->VSSetConstantBuffers(slot, 1, buffers);
+}
+
+void d3d11_context::set_vs_constant_buffer_range(u32 slot, void* buffer, u32 first_constant, u32 constant_count)
+{
+  my_assert(ctx1);
+  ID3D11Buffer* buffers[1] = { static_cast<ID3D11Buffer*>(buffer) };
+  ctx1->VSSetConstantBuffers1(slot, 1, buffers, &first_constant, &constant_count);
+}
+
+void d3d11_context::set_ps_constant_buffer(u32 slot, void* buffer)
+{
+  ID3D11Buffer* buffers[1] = { static_cast<ID3D11Buffer*>(buffer) };
+  ctx->PSSetConstantBuffers(slot, 1, buffers);
+}
+
+void* d3d11_frame_graph_backend::create_texture(fg_texture_desc const& desc)
+{
+  d3d11_fg_texture* ret = m_textures.construct();
+  HRESULT hr;
+
+  D3D11_TEXTURE2D_DESC tex_desc = {};
+  tex_desc.Width = desc.width;
+  tex_desc.Height = desc.height;
+  tex_desc.MipLevels = 1;
+  tex_desc.ArraySize = 1;
+  tex_desc.Format = (DXGI_FORMAT)desc.format;
+  tex_desc.SampleDesc.Count = desc.sample_count;
+  tex_desc.Usage = D3D11_USAGE_DEFAULT;
+  tex_desc.BindFlags = desc.bind_flags;
+  hr = device->CreateTexture2D(&tex_desc, nullptr, ret->texture.ReleaseAndGetAddressOf());
+  my_assert(SUCCEEDED(hr));
+
+  if (desc.bind_flags & D3D11_BIND_RENDER_TARGET)
+  {
+    hr = device->CreateRenderTargetView(ret->texture.Get(), nullptr, ret->rtv.ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+  }
+  if (desc.bind_flags & D3D11_BIND_DEPTH_STENCIL)
+  {
+    hr = device->CreateDepthStencilView(ret->texture.Get(), nullptr, ret->dsv.ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+  }
+  if (desc.bind_flags & D3D11_BIND_SHADER_RESOURCE)
+  {
+    hr = device->CreateShaderResourceView(ret->texture.Get(), nullptr, ret->srv.ReleaseAndGetAddressOf());
+    my_assert(SUCCEEDED(hr));
+  }
+  return ret;
+}
+
+void d3d11_frame_graph_backend::destroy_texture(void* texture)
+{
+  m_textures.destroy(static_cast<d3d11_fg_texture*>(texture));
+}
@@ -1,6 +1,9 @@
 #pragma once
-#include <d3d11.h>
+#include <d3d11_1.h>
 #include <wrl.h>
+#include "frame_graph.hpp"
+#include "object_pool.hpp"
+#include "state_filter.hpp"
 #include "types.hpp"
 
 template <class T>
@@ -14,6 +17,8 @@ struct d3d11_renderer
   DXGI_SWAP_CHAIN_DESC swapchain_desc;
   com_ptr<IDXGISwapChain> swapchain;
   com_ptr<ID3D11DeviceContext> ctx;
+  // Null when D3D11.1 runtime is not available.
+  com_ptr<ID3D11DeviceContext1> ctx1;
   com_ptr<ID3D11RenderTargetView> swapchain_rtv;
   com_ptr<ID3D11Texture2D> depth_stencil_buffer;
   com_ptr<ID3D11DepthStencilView> dsv;
@@ -24,4 +29,52 @@ struct d3d11_renderer
   void resize_swapchain(i32 width, i32 height);
   void destroy_swapchain();
   void set_multisample_count(u32 sample_count);
-};
\ No newline at end of file
+};
+
+// Forwards state binding calls to a D3D11 device context.
+class d3d11_context : public render_context
+{
+public:
+  ID3D11DeviceContext* ctx = nullptr;
+  ID3D11DeviceContext1* ctx1 = nullptr;
+
+  void set_render_target(void* rtv, void* dsv) override;
+  void set_viewport(viewport const& vp) override;
+  void set_blend_state(void* state) override;
+  void set_depth_stencil_state(void* state) override;
+  void set_rasterizer_state(void* state) override;
+  void set_input_layout(void* layout) override;
+  void set_primitive_topology(u32 topology) override;
+  void set_vertex_buffer(u32 slot, void* buffer, u32 stride, u32 offset) override;
+  void set_index_buffer(void* buffer, u32 format, u32 offset) override;
+  void set_vertex_shader(void* shader) override;
+  void set_pixel_shader(void* shader) override;
+  void set_vs_constant_buffer(u32 slot, void* buffer) override;
+  void set_vs_constant_buffer_range(u32 slot, void* buffer, u32 first_constant, u32 constant_count) override;
+  void set_ps_constant_buffer(u32 slot, void* buffer) override;
+};
+
+// Frame graph texture with views for its bind flags.
+// Imported textures are described the same way, with only the views they are used through.
+struct d3d11_fg_texture
+{
+  com_ptr<ID3D11Texture2D> texture;
+  com_ptr<ID3D11RenderTargetView> rtv;
+  com_ptr<ID3D11DepthStencilView> dsv;
+  com_ptr<ID3D11ShaderResourceView> srv;
+};
+
+// Format of texture descriptions is DXGI_FORMAT, bind flags are D3D11_BIND_FLAG.
+class d3d11_frame_graph_backend : public frame_graph_backend
+{
+public:
+  static constexpr u32 MAX_TEXTURES = 64;
+
+  ID3D11Device* device = nullptr;
+
+  void* create_texture(fg_texture_desc const& desc) override;
+  void destroy_texture(void* texture) override;
+
+private:
+  object_pool<d3d11_fg_texture> m_textures = { MAX_TEXTURES };
+};
@@ -0,0 +1,287 @@
+#include <stddef.h>
+
+#include "frame_graph.hpp"
+#include "my_assert.hpp"
+
+static bool same_desc(fg_texture_desc const& a, fg_texture_desc const& b)
+{
+  return a.width == b.width && a.height == b.height && a.format == b.format && a.bind_flags == b.bind_flags
+    && a.bytes_per_pixel == b.bytes_per_pixel && a.sample_count == b.sample_count;
+}
+
+static u64 texture_size(fg_texture_desc const& desc)
+{
+  return (u64)desc.width * desc.height * desc.bytes_per_pixel * desc.sample_count;
+}
+
+void* null_frame_graph_backend::create_texture(fg_texture_desc const&)
+{
+  live_textures++;
+  created_textures++;
+  // Any non-null handle will do.
+  return reinterpret_cast<void*>((size_t)created_textures);
+}
+
+void null_frame_graph_backend::destroy_texture(void*)
+{
+  my_assert(live_textures > 0);
+  live_textures--;
+}
+
+void frame_graph::reset()
+{
+  m_resources.clear();
+  m_passes.clear();
+  m_accesses.clear();
+  m_order.clear();
+}
+
+void frame_graph::release(frame_graph_backend& backend)
+{
+  for (u32 i = 0; i < m_physical.size(); i++)
+    backend.destroy_texture(m_physical[i].handle);
+  m_physical.clear();
+  m_transient_memory = 0;
+  reset();
+}
+
+u32 frame_graph::create_texture(const char* name, fg_texture_desc const& desc)
+{
+  m_resources.push_back({ name, desc, nullptr, INVALID, INVALID, INVALID });
+  return m_resources.size() - 1;
+}
+
+u32 frame_graph::import_texture(const char* name, fg_texture_desc const& desc, void* texture)
+{
+  my_assert(texture != nullptr);
+  m_resources.push_back({ name, desc, texture, INVALID, INVALID, INVALID });
+  return m_resources.size() - 1;
+}
+
+u32 frame_graph::add_pass(const char* name, execute_function fn, void* ctx)
+{
+  m_passes.push_back({ name, fn, ctx, false, false });
+  return m_passes.size() - 1;
+}
+
+void frame_graph::read(u32 pass, u32 texture)
+{
+  my_assert(pass < m_passes.size() && texture < m_resources.size());
+  m_accesses.push_back({ pass, texture, false });
+}
+
+void frame_graph::write(u32 pass, u32 texture)
+{
+  my_assert(pass < m_passes.size() && texture < m_resources.size());
+  m_accesses.push_back({ pass, texture, true });
+}
+
+void frame_graph::set_side_effects(u32 pass)
+{
+  m_passes[pass].side_effects = true;
+}
+
+void frame_graph::compile(frame_graph_backend& backend)
+{
+  cull_passes();
+  sort_passes();
+  assign_physical_textures(backend);
+}
+
+void frame_graph::execute() const
+{
+  for (u32 i = 0; i < m_order.size(); i++)
+  {
+    const pass& p = m_passes[m_order[i]];
+    p.fn(*this, p.ctx);
+  }
+}
+
+void* frame_graph::texture(u32 texture) const
+{
+  const resource& r = m_resources[texture];
+  if (r.imported)
+    return r.imported;
+  my_assert(r.physical != INVALID);
+  return m_physical[r.physical].handle;
+}
+
+void frame_graph::cull_passes()
+{
+  // Passes with outputs are live, and so are writers of everything live passes read.
+  vector<u32> stack;
+  for (u32 i = 0; i < m_passes.size(); i++)
+    m_passes[i].live = m_passes[i].side_effects;
+  for (u32 i = 0; i < m_accesses.size(); i++)
+  {
+    const access& a = m_accesses[i];
+    if (a.write && m_resources[a.resource].imported)
+      m_passes[a.pass].live = true;
+  }
+  for (u32 i = 0; i < m_passes.size(); i++)
+  {
+    if (m_passes[i].live)
+      stack.push_back(i);
+  }
+
+  while (stack.size() > 0)
+  {
+    const u32 p = stack.back();
+    stack.pop_back();
+    for (u32 i = 0; i < m_accesses.size(); i++)
+    {
+      const access& r = m_accesses[i];
+      if (r.pass != p || r.write)
+        continue;
+      for (u32 j = 0; j < m_accesses.size(); j++)
+      {
+        const access& w = m_accesses[j];
+        if (w.write && w.resource == r.resource && m_passes[w.pass].live == false)
+        {
+          m_passes[w.pass].live = true;
+          stack.push_back(w.pass);
+        }
+      }
+    }
+  }
+}
+
+void frame_graph::sort_passes()
+{
+  const u32 count = m_passes.size();
+  // Dependency matrix, deps[a * count + b] means a runs before b.
+  vector<u8> deps;
+  deps.resize(count * count, 0);
+  vector<u8> writes;
+  writes.resize(count * m_resources.size(), 0);
+  for (u32 i = 0; i < m_accesses.size(); i++)
+  {
+    if (m_accesses[i].write)
+      writes[m_accesses[i].pass * m_resources.size() + m_accesses[i].resource] = 1;
+  }
+  for (u32 i = 0; i < m_accesses.size(); i++)
+  {
+    const access& w = m_accesses[i];
+    if (w.write == false || m_passes[w.pass].live == false)
+      continue;
+    for (u32 j = 0; j < m_accesses.size(); j++)
+    {
+      const access& a = m_accesses[j];
+      if (a.resource != w.resource || a.pass == w.pass || m_passes[a.pass].live == false)
+        continue;
+      const bool other_writes = writes[a.pass * m_resources.size() + a.resource] != 0;
+      // Writers keep the order they were added in, pure readers go after all writers.
+      if (other_writes ? w.pass < a.pass : true)
+        deps[w.pass * count + a.pass] = 1;
+    }
+  }
+
+  vector<u32> in_degree;
+  in_degree.resize(count, 0);
+  u32 live_count = 0;
+  for (u32 a = 0; a < count; a++)
+  {
+    live_count += m_passes[a].live;
+    for (u32 b = 0; b < count; b++)
+      in_degree[b] += deps[a * count + b];
+  }
+
+  // Kahn's algorithm, ties go to the pass added first.
+  m_order.clear();
+  vector<u8> done;
+  done.resize(count, 0);
+  while (m_order.size() < live_count)
+  {
+    u32 next = INVALID;
+    for (u32 i = 0; i < count && next == INVALID; i++)
+    {
+      if (m_passes[i].live && done[i] == 0 && in_degree[i] == 0)
+        next = i;
+    }
+    my_assert(next != INVALID); // dependency cycle
+    done[next] = 1;
+    m_order.push_back(next);
+    for (u32 b = 0; b < count; b++)
+      in_degree[b] -= deps[next * count + b];
+  }
+}
+
+void frame_graph::assign_physical_textures(frame_graph_backend& backend)
+{
+  for (u32 i = 0; i < m_order.size(); i++)
+  {
+    for (u32 j = 0; j < m_accesses.size(); j++)
+    {
+      const access& a = m_accesses[j];
+      if (a.pass != m_order[i])
+        continue;
+      resource& r = m_resources[a.resource];
+      if (r.first_use == INVALID)
+        r.first_use = i;
+      r.last_use = i;
+    }
+  }
+
+  // Transient textures in order of their first use.
+  vector<u32> transients;
+  for (u32 i = 0; i < m_resources.size(); i++)
+  {
+    if (m_resources[i].imported == nullptr && m_resources[i].first_use != INVALID)
+      transients.push_back(i);
+  }
+  for (u32 i = 1; i < transients.size(); i++)
+  {
+    const u32 t = transients[i];
+    u32 j = i;
+    for (; j > 0 && m_resources[transients[j - 1]].first_use > m_resources[t].first_use; j--)
+      transients[j] = transients[j - 1];
+    transients[j] = t;
+  }
+
+  for (u32 i = 0; i < m_physical.size(); i++)
+    m_physical[i].used = false;
+  m_unaliased_memory = 0;
+  for (u32 i = 0; i < transients.size(); i++)
+  {
+    resource& r = m_resources[transients[i]];
+    m_unaliased_memory += texture_size(r.desc);
+    r.physical = INVALID;
+    for (u32 p = 0; p < m_physical.size() && r.physical == INVALID; p++)
+    {
+      const physical_texture& pt = m_physical[p];
+      if (same_desc(pt.desc, r.desc) && (pt.used == false || pt.busy_until < r.first_use))
+        r.physical = p;
+    }
+    if (r.physical == INVALID)
+    {
+      m_physical.push_back({ r.desc, backend.create_texture(r.desc), false, 0 });
+      r.physical = m_physical.size() - 1;
+    }
+    m_physical[r.physical].used = true;
+    m_physical[r.physical].busy_until = r.last_use;
+  }
+
+  // Textures not needed this frame are released, indices of the rest are remapped.
+  vector<u32> remap;
+  remap.resize(m_physical.size(), INVALID);
+  u32 kept = 0;
+  m_transient_memory = 0;
+  for (u32 i = 0; i < m_physical.size(); i++)
+  {
+    if (m_physical[i].used == false)
+    {
+      backend.destroy_texture(m_physical[i].handle);
+      continue;
+    }
+    m_transient_memory += texture_size(m_physical[i].desc);
+    remap[i] = kept;
+    m_physical[kept++] = m_physical[i];
+  }
+  while (m_physical.size() > kept)
+    m_physical.pop_back();
+  for (u32 i = 0; i < transients.size(); i++)
+  {
+    resource& r = m_resources[transients[i]];
+    r.physical = remap[r.physical];
+  }
+}
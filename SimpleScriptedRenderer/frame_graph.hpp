@@ -0,0 +1,160 @@
+#pragma once
+#include "types.hpp"
+#include "vector.hpp"
+
+// Frame graph.
+// Passes declare textures they read and write, then the graph is compiled:
+// passes which contribute nothing to imported textures are culled, the rest are ordered
+// by a topological sort of their dependencies, and transient textures with disjoint lifetimes
+// and compatible descriptions share one physical texture.
+// The graph is rebuilt every frame, physical textures are kept across frames while they are used.
+
+struct fg_texture_desc
+{
+  u32 width;
+  u32 height;
+  // Format and bind flags are interpreted by the backend.
+  u32 format;
+  u32 bind_flags;
+  u32 bytes_per_pixel;
+  u32 sample_count;
+};
+
+// Creates physical textures, handles are opaque to the graph.
+class frame_graph_backend
+{
+public:
+  virtual ~frame_graph_backend() = default;
+  virtual void* create_texture(fg_texture_desc const& desc) = 0;
+  virtual void destroy_texture(void* texture) = 0;
+};
+
+// Backend without a GPU, compiles graphs and reports memory.
+class null_frame_graph_backend : public frame_graph_backend
+{
+public:
+  void* create_texture(fg_texture_desc const& desc) override;
+  void destroy_texture(void* texture) override;
+
+  u32 live_textures = 0;
+  u32 created_textures = 0;
+};
+
+class frame_graph
+{
+public:
+  static constexpr u32 INVALID = (u32)-1;
+
+  using execute_function = void (*)(frame_graph const& graph, void* ctx);
+
+  // Forgets passes and resources of the previous frame, physical textures stay.
+  void reset();
+  // Destroys all physical textures.
+  void release(frame_graph_backend& backend);
+
+  // Texture owned by the graph, only alive between its first and last use.
+  u32 create_texture(const char* name, fg_texture_desc const& desc);
+  // Texture owned outside of the graph, e.g. back buffer. Writes to it are the outputs of the graph.
+  u32 import_texture(const char* name, fg_texture_desc const& desc, void* texture);
+
+  // Context must stay valid until execute().
+  u32 add_pass(const char* name, execute_function fn, void* ctx);
+  void read(u32 pass, u32 texture);
+  void write(u32 pass, u32 texture);
+  // Pass affects something outside of the graph and is never culled.
+  void set_side_effects(u32 pass);
+
+  // Readers of a texture depend on all its other writers, writers of the same texture
+  // keep the order in which they were added.
+  void compile(frame_graph_backend& backend);
+  void execute() const;
+
+  // Physical texture, valid after compile().
+  void* texture(u32 texture) const;
+
+  vector<u32> const& execution_order() const
+  {
+    return m_order;
+  }
+
+  bool culled(u32 pass) const
+  {
+    return m_passes[pass].live == false;
+  }
+
+  const char* pass_name(u32 pass) const
+  {
+    return m_passes[pass].name;
+  }
+
+  u32 pass_count() const
+  {
+    return m_passes.size();
+  }
+
+  u32 physical_texture_count() const
+  {
+    return m_physical.size();
+  }
+
+  // Memory of physical transient textures used by the frame.
+  u64 transient_memory() const
+  {
+    return m_transient_memory;
+  }
+
+  // Memory transient textures would take without aliasing.
+  u64 unaliased_memory() const
+  {
+    return m_unaliased_memory;
+  }
+
+private:
+  struct resource
+  {
+    const char* name;
+    fg_texture_desc desc;
+    // Imported handle or index of physical texture.
+    void* imported;
+    u32 physical;
+    u32 first_use;
+    u32 last_use;
+  };
+
+  struct pass
+  {
+    const char* name;
+    execute_function fn;
+    void* ctx;
+    bool side_effects;
+    bool live;
+  };
+
+  struct access
+  {
+    u32 pass;
+    u32 resource;
+    bool write;
+  };
+
+  struct physical_texture
+  {
+    fg_texture_desc desc;
+    void* handle;
+    bool used;
+    // Last position in execution order at which the texture is in use.
+    u32 busy_until;
+  };
+
+  void cull_passes();
+  void sort_passes();
+  void assign_physical_textures(frame_graph_backend& backend);
+
+  vector<resource> m_resources;
+  vector<pass> m_passes;
+  vector<access> m_accesses;
+  vector<u32> m_order;
+  vector<physical_texture> m_physical;
+  u64 m_transient_memory = 0;
+  u64 m_unaliased_memory = 0;
+};
@@ -1,4 +1,8 @@
 #pragma once
+#include <stdlib.h>
+
+#include "my_assert.hpp"
+#include "my_new.hpp"
 #include "types.hpp"
 #include "util.hpp"
 
@@ -273,9 +277,9 @@ private:
       return;
     }
     m_buffer = reinterpret_cast<kv_pair*>(malloc(new_capacity * sizeof(kv_pair)));
-    my_assert(m_buffer);
+    my_assert(m_buffer != nullptr);
     m_hashes = new u32[new_capacity];
-    my_assert(m_hashes);
+    my_assert(m_hashes != nullptr);
     for (u32 i = 0; i < new_capacity; i++)
     {
       m_hashes[i] = 0;
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cooked_mesh.hpp"
+#include "headless.hpp"
+#include "lod.hpp"
+#include "mesh.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_registry.hpp"
+#include "meshlet.hpp"
+#include "platform.hpp"
+#include "scene.hpp"
+#include "scripting.hpp"
+#include "tools.hpp"
+#include "vector.hpp"
+
+namespace
+{
+enum stage : u32
+{
+  STAGE_FIXED_UPDATE,
+  STAGE_UPDATE_SCRIPTS,
+  STAGE_CAMERA,
+  STAGE_CULL,
+  STAGE_LOD,
+  STAGE_CLUSTERS,
+  STAGE_COUNT
+};
+
+// Entities point into g_meshes, loaded meshes can't grow it past this.
+constexpr u32 MAX_HEADLESS_MESHES = 256;
+
+const char* const STAGE_NAMES[STAGE_COUNT] = { "fixed_update", "update scripts", "camera", "cull", "lod", "cluster cull" };
+
+struct stage_timing
+{
+  f64 total = 0.0;
+  f64 min = 1e30;
+  f64 max = 0.0;
+};
+
+scene g_scene = {};
+vector<vertex_data> g_meshes;
+mesh_loader g_mesh_loader;
+script_bindings g_script_bindings = {};
+camera_motion g_camera_motion;
+vector<void*> g_visible;
+lod_selection g_lod_selection;
+vector<index_range> g_ranges;
+
+// Exported function to print to standard output.
+int luaexport_print(lua_State* lua)
+{
+  const int nargs = lua_gettop(lua);
+  for (int i = 1; i <= nargs; i++)
+  {
+    const char* s = luaL_tolstring(lua, i, nullptr);
+    if (s == nullptr)
+    {
+      lua_pushstring(lua, "print: conversion of argument to string failed");
+      lua_error(lua);
+    }
+    printf(i > 1 ? "\t%s" : "%s", s);
+    lua_pop(lua, 1);
+  }
+  printf("\n");
+  return 0;
+}
+
+// Loaded meshes follow the built-in ones in g_meshes, released ones leave holes without vertices.
+u32 allocate_mesh(void*)
+{
+  u32 id = BUILTIN_MESH_COUNT;
+  while (id < g_meshes.size() && g_meshes[id].vertex_count > 0)
+    id++;
+  if (id == g_meshes.size())
+  {
+    if (g_meshes.size() == g_meshes.capacity())
+      return mesh_registry::INVALID_ID;
+    g_meshes.push_back({});
+  }
+  return id;
+}
+
+// Levels switch as in the application at a 720 pixel high viewport.
+bool create_mesh(void*, u32 id, cooked_mesh const& mesh)
+{
+  g_meshes[id] = make_vertex_data(mesh);
+  set_lod_screen_error(g_meshes[id], 1.0f / 720.0f);
+  return true;
+}
+
+void destroy_mesh(void*, u32 id)
+{
+  destroy_entities_with_mesh(g_scene, &g_meshes[id]);
+  g_meshes[id] = vertex_data{};
+}
+
+vertex_data const* get_mesh(void*, u32 id)
+{
+  return &g_meshes[id];
+}
+
+// Savings are counted in float vertices, the default format of the application.
+const mesh_store g_mesh_store = { nullptr, allocate_mesh, create_mesh, destroy_mesh, get_mesh, sizeof(vertex) };
+
+// Called from scripts.
+i32 load_mesh(void*, const char* path)
+{
+  return g_mesh_loader.load(path, g_mesh_store);
+}
+
+bool release_mesh(void*, u32 id)
+{
+  return g_mesh_loader.release(id, g_mesh_store);
+}
+
+// Settings of the application by default.
+void cull_clusters(const scene& sc, const frustum& f, const vector<void*>& visible, meshlet_cull_stats& stats)
+{
+  for (u32 i = 0; i < visible.size(); i++)
+  {
+    const entity* e = static_cast<const entity*>(visible[i]);
+    if (uses_cluster_culling(*e, DEFAULT_CLUSTER_MIN_MESHLETS) == false)
+      continue;
+    g_ranges.clear();
+    cull_entity_meshlets(sc, *e, f, true, g_ranges, stats);
+  }
+}
+} // namespace
+
+int run_headless(headless_settings const& settings)
+{
+  g_meshes.reserve(MAX_HEADLESS_MESHES);
+  for (u32 i = 0; i < BUILTIN_MESH_COUNT; i++)
+  {
+    mesh_lod lods[MAX_LODS];
+    const u32 lod_count = create_builtin_mesh(i, lods);
+    for (u32 l = 0; l < lod_count; l++)
+      optimize_mesh(lods[l]);
+    g_meshes.push_back(make_vertex_data(lods, lod_count));
+  }
+
+  lua_State* lua = nullptr;
+  g_script_bindings = { &g_scene, &g_meshes, load_mesh, release_mesh, nullptr };
+  setup_lua(&lua, &g_script_bindings, luaexport_print);
+  setup_scene(g_scene, &g_meshes[MESH_CUBE]);
+  g_scene.cam.aspect = 16.0f / 9.0f;
+
+  if (settings.script_path && luaL_dofile(lua, settings.script_path))
+  {
+    fprintf(stderr, "error: %s\n", lua_tostring(lua, -1));
+    lua_close(lua);
+    return 1;
+  }
+
+  stage_timing timings[STAGE_COUNT];
+  u64 visible_total = 0;
+  meshlet_cull_stats meshlet_stats;
+  const f64 dt = settings.seconds_per_update;
+  const f64 run_start_time = platform::seconds();
+  for (u32 frame = 0; frame < settings.frame_count; frame++)
+  {
+    f64 stage_times[STAGE_COUNT];
+    f64 t = platform::seconds();
+
+    call_script_hook(lua, "fixed_update", dt);
+    stage_times[STAGE_FIXED_UPDATE] = platform::seconds() - t;
+    t += stage_times[STAGE_FIXED_UPDATE];
+
+    call_script_hook(lua, "update", dt);
+    stage_times[STAGE_UPDATE_SCRIPTS] = platform::seconds() - t;
+    t += stage_times[STAGE_UPDATE_SCRIPTS];
+
+    f32 camera_angle;
+    flythrough_camera((f64)frame * dt, g_scene.cam.tr.t, camera_angle);
+    g_scene.cam.tr.r = glm::angleAxis(camera_angle, glm::vec3{ 0.0f, -1.0f, 0.0f });
+    stage_times[STAGE_CAMERA] = platform::seconds() - t;
+    t += stage_times[STAGE_CAMERA];
+
+    cull_stats stats;
+    const frustum view_frustum = make_frustum(g_scene.cam.world_to_screen());
+    track_camera_motion(g_camera_motion, g_scene.cam);
+    g_visible.clear();
+    cull_scene(g_scene, view_frustum, CULL_MODE_BVH, true, g_camera_motion,
+               g_visible, stats);
+    visible_total += g_visible.size();
+    stage_times[STAGE_CULL] = platform::seconds() - t;
+    t += stage_times[STAGE_CULL];
+
+    select_lods(g_scene, g_visible, lod::DEFAULT_HYSTERESIS, g_lod_selection);
+    g_scene.moved.clear();
+    stage_times[STAGE_LOD] = platform::seconds() - t;
+    t += stage_times[STAGE_LOD];
+
+    cull_clusters(g_scene, view_frustum, g_visible, meshlet_stats);
+    stage_times[STAGE_CLUSTERS] = platform::seconds() - t;
+
+    for (u32 i = 0; i < STAGE_COUNT; i++)
+    {
+      stage_timing& st = timings[i];
+      st.total += stage_times[i];
+      st.min = stage_times[i] < st.min ? stage_times[i] : st.min;
+      st.max = stage_times[i] > st.max ? stage_times[i] : st.max;
+    }
+  }
+  const f64 run_time = platform::seconds() - run_start_time;
+
+  const u32 frames = settings.frame_count > 0 ? settings.frame_count : 1;
+  printf("%u frames, %u entities, %.1f visible per frame\n", settings.frame_count, g_scene.entities.size(),
+         (f64)visible_total / frames);
+  printf("%-16s %10s %10s %10s %10s\n", "stage", "total ms", "avg ms", "min ms", "max ms");
+  for (u32 i = 0; i < STAGE_COUNT; i++)
+  {
+    const stage_timing& st = timings[i];
+    printf("%-16s %10.3f %10.4f %10.4f %10.4f\n", STAGE_NAMES[i], st.total * 1000.0, st.total * 1000.0 / frames,
+           settings.frame_count > 0 ? st.min * 1000.0 : 0.0, st.max * 1000.0);
+  }
+  if (meshlet_stats.meshlets > 0)
+  {
+    printf("meshlets: %u, frustum culled: %u, backface culled: %u\n", meshlet_stats.meshlets,
+           meshlet_stats.frustum_culled, meshlet_stats.backface_culled);
+    printf("cluster triangles: %u submitted, %u culled (%.1f%%)\n", meshlet_stats.triangles_submitted,
+           meshlet_stats.triangles_culled,
+           100.0 * meshlet_stats.triangles_culled / (meshlet_stats.triangles_submitted + meshlet_stats.triangles_culled));
+  }
+  const mesh_registry_stats& rs = g_mesh_loader.registry_stats();
+  if (rs.hits + rs.misses > 0)
+  {
+    printf("mesh loads: %u, shared: %u, %llu bytes and %u uploads saved, %u resident, %u hash collisions\n",
+           rs.hits + rs.misses, rs.hits, (unsigned long long)rs.bytes_saved, rs.uploads_avoided, rs.meshes, rs.collisions);
+  }
+  printf("frame: %.4f ms average, %.1f frames/s\n", run_time * 1000.0 / frames, frames / run_time);
+
+  lua_close(lua);
+  return 0;
+}
+
+int run_command_line(int argc, char** argv)
+{
+  // Usage: --headless [frames] [script.lua]
+  if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+  {
+    headless_settings settings;
+    if (argc > 2)
+      settings.frame_count = (u32)atoi(argv[2]);
+    if (argc > 3)
+      settings.script_path = argv[3];
+    return run_headless(settings);
+  }
+
+  return run_tool(argc, argv);
+}
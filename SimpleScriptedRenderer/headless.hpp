@@ -0,0 +1,23 @@
+#pragma once
+#include "types.hpp"
+
+// Headless mode.
+// Runs scene, scripts and culling without a window or a graphics device, so they can be profiled
+// on machines without a GPU. Frames are stepped as fast as possible with a fixed time step,
+// per-stage timings are printed at the end.
+
+struct headless_settings
+{
+  u32 frame_count = 1000;
+  f64 seconds_per_update = 1.0 / 60.0;
+  // Lua file executed before the first frame. Can spawn entities and define update/fixed_update.
+  const char* script_path = nullptr;
+};
+
+// Returns process exit code.
+int run_headless(headless_settings const& settings);
+
+// Runs headless mode for --headless, otherwise the tool named by the first argument, see tools.hpp.
+// Shared by the application and the headless executable. Returns the exit code, or -1 when the
+// arguments name neither.
+int run_command_line(int argc, char** argv);
@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+#include "headless.hpp"
+
+// Entry point of the headless executable of the CMake build. Links no window, graphics device or SDL,
+// main.cpp is the entry point of the application.
+int main(int argc, char** argv)
+{
+  const int result = run_command_line(argc, argv);
+  if (result >= 0)
+    return result;
+
+  fprintf(stderr, "usage: %s --headless [frames] [script.lua]\n"
+                  "       or any ssr_tools arguments, see tools.hpp\n",
+          argv[0]);
+  return 1;
+}
@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+#include "jobs.hpp"
+#include "my_assert.hpp"
+#include "platform.hpp"
+
+namespace
+{
+constexpr u32 MAX_WORKERS = 63;
+
+struct job
+{
+  jobs::range_function fn;
+  void* ctx;
+  u32 count;
+  u32 chunk_size;
+  volatile i32 next;
+};
+
+platform::thread* g_workers[MAX_WORKERS] = {};
+u32 g_num_workers = 0;
+platform::semaphore* g_start = nullptr;
+platform::semaphore* g_done = nullptr;
+volatile i32 g_busy = 0;
+bool g_quit = false;
+job g_job = {};
+
+void run_chunks(u32 thread_idx)
+{
+  for (;;)
+  {
+    const u32 begin = (u32)platform::atomic_add(&g_job.next, (i32)g_job.chunk_size);
+    if (begin >= g_job.count)
+      break;
+    const u32 end = g_job.count - begin < g_job.chunk_size ? g_job.count : begin + g_job.chunk_size;
+    g_job.fn(g_job.ctx, begin, end, thread_idx);
+  }
+}
+
+void worker_main(void* data)
+{
+  const u32 thread_idx = (u32)(uintptr_t)data;
+  for (;;)
+  {
+    platform::wait(g_start);
+    if (g_quit)
+      break;
+    run_chunks(thread_idx);
+    platform::post(g_done);
+  }
+}
+} // namespace
+
+void jobs::init(u32 num_workers)
+{
+  my_assert(g_num_workers == 0);
+  if (num_workers == 0)
+  {
+    num_workers = platform::cpu_count() - 1;
+  }
+  if (num_workers > MAX_WORKERS)
+    num_workers = MAX_WORKERS;
+
+  g_quit = false;
+  g_start = platform::create_semaphore();
+  g_done = platform::create_semaphore();
+  for (u32 i = 0; i < num_workers; i++)
+  {
+    g_workers[i] = platform::create_thread(worker_main, (void*)(uintptr_t)(i + 1));
+  }
+  g_num_workers = num_workers;
+}
+
+void jobs::shutdown()
+{
+  g_quit = true;
+  for (u32 i = 0; i < g_num_workers; i++)
+    platform::post(g_start);
+  for (u32 i = 0; i < g_num_workers; i++)
+    platform::join_thread(g_workers[i]);
+  g_num_workers = 0;
+  if (g_start) platform::destroy_semaphore(g_start);
+  if (g_done) platform::destroy_semaphore(g_done);
+  g_start = nullptr;
+  g_done = nullptr;
+}
+
+u32 jobs::thread_count()
+{
+  return g_num_workers + 1;
+}
+
+void jobs::parallel_for(u32 count, u32 chunk_size, range_function fn, void* ctx)
+{
+  my_assert(chunk_size > 0);
+  if (count == 0)
+    return;
+
+  const u32 num_chunks = (count + chunk_size - 1) / chunk_size;
+  if (num_chunks == 1 || g_num_workers == 0 || platform::atomic_compare_exchange(&g_busy, 0, 1) == false)
+  {
+    for (u32 begin = 0; begin < count; begin += chunk_size)
+      fn(ctx, begin, count - begin < chunk_size ? count : begin + chunk_size, 0);
+    return;
+  }
+
+  g_job.fn = fn;
+  g_job.ctx = ctx;
+  g_job.count = count;
+  g_job.chunk_size = chunk_size;
+  platform::atomic_store(&g_job.next, 0);
+
+  const u32 num_woken = num_chunks - 1 < g_num_workers ? num_chunks - 1 : g_num_workers;
+  for (u32 i = 0; i < num_woken; i++)
+    platform::post(g_start);
+  run_chunks(0);
+  for (u32 i = 0; i < num_woken; i++)
+    platform::wait(g_done);
+
+  platform::atomic_store(&g_busy, 0);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "types.hpp"
+
+// Worker threads for data parallel loops.
+// Calling thread takes part in the loop as thread 0, workers are threads 1..thread_count()-1.
+// parallel_for is meant to be called from the main thread only, nested calls run serially.
+namespace jobs
+{
+using range_function = void (*)(void* ctx, u32 begin, u32 end, u32 thread_idx);
+
+// num_workers == 0 picks one worker per logical core except the calling one.
+void init(u32 num_workers = 0);
+void shutdown();
+u32 thread_count();
+
+// Splits [0, count) into chunks of chunk_size and returns when all of them are processed.
+void parallel_for(u32 count, u32 chunk_size, range_function fn, void* ctx);
+
+template <class F>
+inline void parallel_for(u32 count, u32 chunk_size, F const& f)
+{
+  parallel_for(count, chunk_size, [](void* ctx, u32 begin, u32 end, u32 thread_idx)
+  {
+    (*static_cast<F const*>(ctx))(begin, end, thread_idx);
+  }, const_cast<F*>(&f));
+}
+} // namespace jobs
@@ -0,0 +1,44 @@
+#include <math.h>
+#include <xmmintrin.h>
+
+#include "lod.hpp"
+
+void lod::compute_screen_sizes(f32 const* x, f32 const* y, f32 const* z, f32 const* radius, u32 count,
+                               glm::vec3 const& cam_pos, f32 fov_degrees, f32* out_sizes)
+{
+  // Diameter 2r at distance d covers 2r / (2d * tan(fov / 2)) of the screen height.
+  const f32 scale = 1.0f / tanf(glm::radians(fov_degrees) * 0.5f);
+  const __m128 cx = _mm_set1_ps(cam_pos.x);
+  const __m128 cy = _mm_set1_ps(cam_pos.y);
+  const __m128 cz = _mm_set1_ps(cam_pos.z);
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 min_dist_sq = _mm_set1_ps(1e-12f);
+
+  u32 i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), cx);
+    const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), cy);
+    const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), cz);
+    __m128 dist_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz)));
+    dist_sq = _mm_max_ps(dist_sq, min_dist_sq);
+    const __m128 size = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(radius + i), s), _mm_sqrt_ps(dist_sq));
+    _mm_storeu_ps(out_sizes + i, size);
+  }
+  for (; i < count; i++)
+  {
+    const glm::vec3 d = glm::vec3{ x[i], y[i], z[i] } - cam_pos;
+    const f32 dist = sqrtf(glm::max(glm::dot(d, d), 1e-12f));
+    out_sizes[i] = radius[i] * scale / dist;
+  }
+}
+
+u32 lod::select(f32 size, u32 current, f32 const* min_sizes, u32 lod_count, f32 hysteresis)
+{
+  u32 level = current < lod_count ? current : lod_count - 1;
+  while (level + 1 < lod_count && size < min_sizes[level] * (1.0f - hysteresis))
+    level++;
+  while (level > 0 && size >= min_sizes[level - 1] * (1.0f + hysteresis))
+    level--;
+  return level;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "my_glm.hpp"
+#include "types.hpp"
+
+// Level of detail selection by projected size of bounding spheres.
+namespace lod
+{
+static constexpr f32 DEFAULT_HYSTERESIS = 0.1f;
+
+// Writes projected diameter of each sphere as a fraction of screen height.
+// Spheres are given as separate arrays of coordinates and radii, processed four at a time.
+void compute_screen_sizes(f32 const* x, f32 const* y, f32 const* z, f32 const* radius, u32 count,
+                          glm::vec3 const& cam_pos, f32 fov_degrees, f32* out_sizes);
+
+// Picks level for the given size starting from the current one.
+// Level i is left for coarser one when size falls below min_sizes[i] * (1 - hysteresis),
+// and coarser level is left for level i when size rises above min_sizes[i] * (1 + hysteresis).
+u32 select(f32 size, u32 current, f32 const* min_sizes, u32 lod_count, f32 hysteresis);
+} // namespace lod
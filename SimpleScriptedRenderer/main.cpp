@@ -1,9 +1,16 @@
 #include <SDL.h>
 
 #include "application.hpp"
+#include "headless.hpp"
 
-extern "C" int main(int, char**)
+extern "C" int main(int argc, char** argv)
 {
+  const int tool_result = run_command_line(argc, argv);
+  if (tool_result >= 0)
+  {
+    return tool_result;
+  }
+
   if (SDL_Init(SDL_INIT_VIDEO) != 0)
   {
     return 1;
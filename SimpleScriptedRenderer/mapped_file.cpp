@@ -0,0 +1,106 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+#include "util.hpp"
+
+mapped_file::~mapped_file()
+{
+  close();
+}
+
+void mapped_file::swap(mapped_file& other)
+{
+  util::swap(m_data, other.m_data);
+  util::swap(m_size, other.m_size);
+#ifdef _WIN32
+  util::swap(m_file, other.m_file);
+  util::swap(m_mapping, other.m_mapping);
+#endif
+}
+
+#ifdef _WIN32
+bool mapped_file::open(const char* path)
+{
+  close();
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_file = file;
+  m_mapping = mapping;
+  m_data = static_cast<u8 const*>(data);
+  m_size = (u64)size.QuadPart;
+  return true;
+}
+
+void mapped_file::close()
+{
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file)
+    CloseHandle(m_file);
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_file = nullptr;
+}
+#else
+bool mapped_file::open(const char* path)
+{
+  close();
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  // Mapping stays valid after the descriptor is closed.
+  void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  m_data = static_cast<u8 const*>(data);
+  m_size = (u64)st.st_size;
+  return true;
+}
+
+void mapped_file::close()
+{
+  if (m_data)
+    munmap(const_cast<u8*>(m_data), (size_t)m_size);
+  m_data = nullptr;
+  m_size = 0;
+}
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#include "types.hpp"
+
+// Read-only memory mapping of a whole file.
+// Pages are read by the OS on first access, data can be handed to consumers without copying.
+class mapped_file
+{
+public:
+  mapped_file() = default;
+  mapped_file(mapped_file const&) = delete;
+  mapped_file& operator=(mapped_file const&) = delete;
+  ~mapped_file();
+
+  // Unmaps previous file. Returns false if the file can't be opened or is empty.
+  bool open(const char* path);
+  void close();
+  // Exchanges mappings, hands one over to a longer lived owner.
+  void swap(mapped_file& other);
+
+  u8 const* data() const
+  {
+    return m_data;
+  }
+
+  u64 size() const
+  {
+    return m_size;
+  }
+
+private:
+  u8 const* m_data = nullptr;
+  u64 m_size = 0;
+#ifdef _WIN32
+  void* m_file = nullptr;
+  void* m_mapping = nullptr;
+#endif
+};
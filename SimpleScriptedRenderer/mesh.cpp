@@ -0,0 +1,242 @@
+#include <math.h>
+
+#include "mesh.hpp"
+#include "my_assert.hpp"
+
+vertex_data make_vertex_data(mesh_lod const* lods, u32 lod_count)
+{
+  my_assert(lod_count > 0 && lod_count <= MAX_LODS);
+  vertex_data ret;
+  ret.lod_count = lod_count;
+  ret.vertex_offset = 0;
+  ret.index_offset = 0;
+
+  u32 vertex_offset = 0;
+  u32 index_offset = 0;
+  ret.index_size = 2;
+  ret.generated_lods = lod_count > 1;
+  for (u32 i = 0; i < lod_count; i++)
+  {
+    const mesh_lod& lod = lods[i];
+    // Indices are relative to the base vertex of their level.
+    if (lod.vertices.size() > 0x10000)
+      ret.index_size = 4;
+    ret.lods[i].first_index = index_offset;
+    ret.lods[i].index_count = lod.indices.size();
+    ret.lods[i].base_vertex = (i32)vertex_offset;
+    ret.lod_min_screen_sizes[i] = i + 1 < lod_count ? lod.min_screen_size : 0.0f;
+    ret.lod_errors[i] = lod.error;
+    ret.generated_lods = ret.generated_lods && (i == 0 || lod.generated);
+    vertex_offset += lod.vertices.size();
+    index_offset += lod.indices.size();
+  }
+  ret.vertex_count = vertex_offset;
+  ret.index_count = index_offset;
+
+  const vector<vertex>& vertices = lods[0].vertices;
+  glm::vec3 aabb_min = vertices[0].position;
+  glm::vec3 aabb_max = vertices[0].position;
+  for (u32 i = 0; i < vertices.size(); i++)
+  {
+    aabb_min = glm::min(aabb_min, vertices[i].position);
+    aabb_max = glm::max(aabb_max, vertices[i].position);
+  }
+  ret.aabb_center = 0.5f * (aabb_max + aabb_min);
+  ret.aabb_extent = 0.5f * (aabb_max - aabb_min);
+
+  ret.occluder_positions.reserve(vertices.size());
+  for (u32 i = 0; i < vertices.size(); i++)
+    ret.occluder_positions.push_back(vertices[i].position);
+  ret.occluder_indices = lods[0].indices;
+  ret.vertices.reserve(ret.vertex_count);
+  for (u32 i = 0; i < lod_count; i++)
+  {
+    for (u32 v = 0; v < lods[i].vertices.size(); v++)
+      ret.vertices.push_back(lods[i].vertices[v]);
+  }
+  ret.quantization = make_vertex_quantization(ret.vertices.data(), ret.vertices.size());
+
+  for (u32 i = 0; i < lod_count; i++)
+  {
+    ret.lod_first_meshlet[i] = ret.meshlets.size();
+    build_meshlets(lods[i].vertices.data(), lods[i].indices.data(), lods[i].indices.size(), ret.meshlets);
+    ret.lod_meshlet_count[i] = ret.meshlets.size() - ret.lod_first_meshlet[i];
+  }
+
+  return ret;
+}
+
+void set_lod_screen_error(vertex_data& vd, f32 max_screen_error)
+{
+  if (vd.generated_lods == false)
+    return;
+  // Screen size is the projected diameter r * s / d, see lod.hpp. Error e at the same distance
+  // covers e * s / (2 * d), that is size * e / (2 * r). Levels simplified without error
+  // switch as soon as they are smaller than a millionth of the mesh.
+  const f32 radius = glm::length(vd.aabb_extent);
+  for (u32 i = 0; i + 1 < vd.lod_count; i++)
+  {
+    const f32 error = glm::max(vd.lod_errors[i + 1], radius * 1e-6f);
+    vd.lod_min_screen_sizes[i] = 2.0f * radius * max_screen_error / error;
+  }
+}
+
+namespace
+{
+mesh_lod create_triangle_lod()
+{
+  mesh_lod ret;
+  ret.min_screen_size = 0.0f;
+  ret.vertices.push_back({ {-sqrt(3.0f) * 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, +1.0f} });
+  ret.vertices.push_back({ {+0.0f, +sqrt(3.0f) * 0.5f, 0.0f}, {0.0f, 0.0f, +1.0f} });
+  ret.vertices.push_back({ {+sqrt(3.0f) * 0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, +1.0f} });
+  ret.indices.push_back(0);
+  ret.indices.push_back(1);
+  ret.indices.push_back(2);
+  return ret;
+}
+
+mesh_lod create_cube_lod()
+{
+  mesh_lod ret;
+  ret.min_screen_size = 0.0f;
+  vector<vertex>& verts = ret.vertices;
+  vector<u32>& indices = ret.indices;
+
+  // left side
+  verts.push_back({ {-0.5f, +0.5f, -0.5f}, {-1.0f, 0.0f, 0.0f} });
+  verts.push_back({ {-0.5f, +0.5f, +0.5f}, {-1.0f, 0.0f, 0.0f} });
+  verts.push_back({ {-0.5f, -0.5f, +0.5f}, {-1.0f, 0.0f, 0.0f} });
+  verts.push_back({ {-0.5f, -0.5f, -0.5f}, {-1.0f, 0.0f, 0.0f} });
+  indices.push_back(0);
+  indices.push_back(1);
+  indices.push_back(2);
+  indices.push_back(0);
+  indices.push_back(2);
+  indices.push_back(3);
+  // right side
+  verts.push_back({ {+0.5f, +0.5f, +0.5f}, {+1.0f, 0.0f, 0.0f} });
+  verts.push_back({ {+0.5f, +0.5f, -0.5f}, {+1.0f, 0.0f, 0.0f} });
+  verts.push_back({ {+0.5f, -0.5f, -0.5f}, {+1.0f, 0.0f, 0.0f} });
+  verts.push_back({ {+0.5f, -0.5f, +0.5f}, {+1.0f, 0.0f, 0.0f} });
+  indices.push_back(4);
+  indices.push_back(5);
+  indices.push_back(6);
+  indices.push_back(4);
+  indices.push_back(6);
+  indices.push_back(7);
+  // top side
+  verts.push_back({ {-0.5f, +0.5f, -0.5f}, {0.0f, +1.0f, 0.0f} });
+  verts.push_back({ {+0.5f, +0.5f, -0.5f}, {0.0f, +1.0f, 0.0f} });
+  verts.push_back({ {+0.5f, +0.5f, +0.5f}, {0.0f, +1.0f, 0.0f} });
+  verts.push_back({ {-0.5f, +0.5f, +0.5f}, {0.0f, +1.0f, 0.0f} });
+  indices.push_back(8);
+  indices.push_back(9);
+  indices.push_back(10);
+  indices.push_back(8);
+  indices.push_back(10);
+  indices.push_back(11);
+  // bottom side
+  verts.push_back({ {-0.5f, -0.5f, +0.5f}, {0.0f, -1.0f, 0.0f} });
+  verts.push_back({ {+0.5f, -0.5f, +0.5f}, {0.0f, -1.0f, 0.0f} });
+  verts.push_back({ {+0.5f, -0.5f, -0.5f}, {0.0f, -1.0f, 0.0f} });
+  verts.push_back({ {-0.5f, -0.5f, -0.5f}, {0.0f, -1.0f, 0.0f} });
+  indices.push_back(12);
+  indices.push_back(13);
+  indices.push_back(14);
+  indices.push_back(12);
+  indices.push_back(14);
+  indices.push_back(15);
+  // face side
+  verts.push_back({ {-0.5f, +0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
+  verts.push_back({ {+0.5f, +0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
+  verts.push_back({ {+0.5f, -0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
+  verts.push_back({ {-0.5f, -0.5f, +0.5f}, {0.0f, 0.0f, +1.0f} });
+  indices.push_back(16);
+  indices.push_back(17);
+  indices.push_back(18);
+  indices.push_back(16);
+  indices.push_back(18);
+  indices.push_back(19);
+  // back side
+  verts.push_back({ {+0.5f, +0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
+  verts.push_back({ {-0.5f, +0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
+  verts.push_back({ {-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
+  verts.push_back({ {+0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f} });
+  indices.push_back(20);
+  indices.push_back(21);
+  indices.push_back(22);
+  indices.push_back(20);
+  indices.push_back(22);
+  indices.push_back(23);
+  return ret;
+}
+
+// UV sphere of unit diameter.
+mesh_lod create_sphere_lod(u32 rings, u32 segments, f32 min_screen_size)
+{
+  mesh_lod ret;
+  ret.min_screen_size = min_screen_size;
+  for (u32 i = 0; i <= rings; i++)
+  {
+    const f32 theta = glm::pi<f32>() * (f32)i / (f32)rings;
+    for (u32 j = 0; j <= segments; j++)
+    {
+      const f32 phi = 2.0f * glm::pi<f32>() * (f32)j / (f32)segments;
+      const glm::vec3 n = { sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi) };
+      ret.vertices.push_back({ 0.5f * n, n });
+    }
+  }
+  for (u32 i = 0; i < rings; i++)
+  {
+    for (u32 j = 0; j < segments; j++)
+    {
+      const u32 a = i * (segments + 1) + j;
+      const u32 b = a + 1;
+      const u32 c = a + segments + 1;
+      const u32 d = c + 1;
+      // Skip triangles collapsed at the poles.
+      if (i > 0)
+      {
+        ret.indices.push_back(a);
+        ret.indices.push_back(c);
+        ret.indices.push_back(b);
+      }
+      if (i + 1 < rings)
+      {
+        ret.indices.push_back(b);
+        ret.indices.push_back(c);
+        ret.indices.push_back(d);
+      }
+    }
+  }
+  return ret;
+}
+} // namespace
+
+u32 create_builtin_mesh(u32 mesh, mesh_lod* out_lods)
+{
+  switch (mesh)
+  {
+    case MESH_TRIANGLE:
+    {
+      out_lods[0] = create_triangle_lod();
+      return 1;
+    }
+    case MESH_CUBE:
+    {
+      out_lods[0] = create_cube_lod();
+      return 1;
+    }
+    case MESH_SPHERE:
+    {
+      out_lods[0] = create_sphere_lod(32, 64, 0.25f);
+      out_lods[1] = create_sphere_lod(16, 32, 0.1f);
+      out_lods[2] = create_sphere_lod(8, 16, 0.04f);
+      out_lods[3] = create_sphere_lod(4, 8, 0.0f);
+      return 4;
+    }
+  }
+  my_assert(false);
+  return 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "meshlet.hpp"
+#include "my_glm.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+#include "vertex.hpp"
+#include "vertex_quantization.hpp"
+
+static constexpr u32 MAX_LODS = 4;
+
+// Range of vertex-index data for one level of detail.
+// Offsets are absolute positions in the mesh arena.
+struct vertex_data_lod
+{
+  u32 first_index;
+  u32 index_count;
+  i32 base_vertex;
+};
+
+// All mesh-related data.
+// Ranges of vertices and indices in the mesh arena, all levels of detail are within them.
+// AABB for frustum culling, computed from the finest level.
+// CPU copy of triangles of the finest level for software occlusion culling.
+// Vertices of all levels for static batching and re-encoding into another vertex format, and meshlets,
+// are either owned or point into the mapped file of a cooked mesh, see vertices_of and meshlets_of.
+struct vertex_data
+{
+  u32 vertex_offset;
+  u32 vertex_count;
+  // Range of 32-bit slots of the index arena, 16-bit indices take two per slot.
+  u32 index_offset;
+  u32 index_count;
+  // 2 when every level has at most 65536 vertices, 4 otherwise.
+  // First indices of levels count indices of this size.
+  u32 index_size;
+  u32 lod_count;
+  vertex_data_lod lods[MAX_LODS];
+  // Level i is used while projected size of the mesh is above lod_min_screen_sizes[i].
+  f32 lod_min_screen_sizes[MAX_LODS];
+  // Geometric errors of generated levels, zero for authored ones, see mesh_lod::error.
+  f32 lod_errors[MAX_LODS];
+  // Levels after the first were generated, their switch sizes follow from their errors.
+  bool generated_lods;
+  glm::vec3 aabb_center;
+  glm::vec3 aabb_extent;
+  vector<glm::vec3> occluder_positions;
+  vector<u32> occluder_indices;
+  // Levels in arena order, the finest level first. Empty for meshes made from cooked ones.
+  vector<vertex> vertices;
+  // Streams of meshes made from cooked ones, in their mapped file, which has to outlive the mesh.
+  // Null for others.
+  vertex const* mapped_vertices = nullptr;
+  void const* mapped_indices = nullptr;
+  meshlet const* mapped_meshlets = nullptr;
+  // Bounds of vertices of all levels, for quantized vertex formats.
+  vertex_quantization quantization;
+  // Of the vertex format the mesh was last uploaded in.
+  vertex_encoding_error encoding_error;
+  // Meshlets of all levels, those of level i start at lod_first_meshlet[i]. Empty for meshes made
+  // from cooked ones.
+  vector<meshlet> meshlets;
+  u32 lod_first_meshlet[MAX_LODS];
+  u32 lod_meshlet_count[MAX_LODS];
+};
+
+inline u32 index_slot_count(const vertex_data& vd)
+{
+  return vd.index_size == 2 ? (vd.index_count + 1) / 2 : vd.index_count;
+}
+
+// Number of vertices of a level, they start at vertex lods[lod].base_vertex - vertex_offset.
+inline u32 lod_vertex_count(const vertex_data& vd, u32 lod)
+{
+  const u32 end = lod + 1 < vd.lod_count ? (u32)vd.lods[lod + 1].base_vertex : vd.vertex_offset + vd.vertex_count;
+  return end - (u32)vd.lods[lod].base_vertex;
+}
+
+inline vertex const* vertices_of(const vertex_data& vd)
+{
+  return vd.mapped_vertices != nullptr ? vd.mapped_vertices : vd.vertices.data();
+}
+
+inline meshlet const* meshlets_of(const vertex_data& vd)
+{
+  return vd.mapped_meshlets != nullptr ? vd.mapped_meshlets : vd.meshlets.data();
+}
+
+// Of all levels, those of the last level come last.
+inline u32 meshlet_count(const vertex_data& vd)
+{
+  return vd.lod_first_meshlet[vd.lod_count - 1] + vd.lod_meshlet_count[vd.lod_count - 1];
+}
+
+// TODO: Skeleton + skeleton pose.
+
+// Source data for one level of detail.
+struct mesh_lod
+{
+  vector<vertex> vertices;
+  vector<u32> indices;
+  f32 min_screen_size;
+  // Largest distance of the surface from the source level, in mesh units, of generated levels.
+  // It is zero for authored levels and for lossless simplification.
+  f32 error = 0.0f;
+  // Set by the simplifier. Authored levels switch at min_screen_size.
+  bool generated = false;
+};
+
+// Fills everything but GPU data. Levels are laid out one after another from offset 0,
+// placing the mesh into an arena moves them by its vertex and index offsets.
+// Meshlets follow the triangle order of levels, optimize them first.
+vertex_data make_vertex_data(mesh_lod const* lods, u32 lod_count);
+
+// Derives switch sizes of generated levels from their errors, so that a level is used
+// once its error projects to at most max_screen_error of the screen height.
+// Meshes with authored levels, generated_lods unset, are left as they are.
+void set_lod_screen_error(vertex_data& vd, f32 max_screen_error);
+
+// Built-in meshes, in the order of their ids.
+static constexpr u32 MESH_TRIANGLE = 0;
+static constexpr u32 MESH_CUBE = 1;
+static constexpr u32 MESH_SPHERE = 2;
+static constexpr u32 BUILTIN_MESH_COUNT = 3;
+
+// Writes levels of detail of a built-in mesh, returns their number.
+u32 create_builtin_mesh(u32 mesh, mesh_lod* out_lods);
@@ -0,0 +1,340 @@
+#include <string.h>
+
+#include "jobs.hpp"
+#include "mesh_optimizer.hpp"
+#include "my_assert.hpp"
+#include "vector.hpp"
+
+namespace
+{
+// FIFO cache of vertex indices, a vertex is in the cache while its insertion time is recent enough.
+struct fifo_cache
+{
+  vector<u32> timestamps;
+  u32 time = VERTEX_CACHE_SIZE + 1;
+
+  void reset(u32 vertex_count)
+  {
+    timestamps.clear();
+    timestamps.resize(vertex_count, 0);
+    time = VERTEX_CACHE_SIZE + 1;
+  }
+
+  // Returns true on miss.
+  bool access(u32 v)
+  {
+    if (time - timestamps[v] > VERTEX_CACHE_SIZE)
+    {
+      timestamps[v] = time++;
+      return true;
+    }
+    return false;
+  }
+};
+} // namespace
+
+void radix_sort(vector<u32> const& keys, vector<u32>& order)
+{
+  const u32 count = keys.size();
+  vector<u32> tmp;
+  order.resize(count, 0);
+  tmp.resize(count, 0);
+  for (u32 i = 0; i < count; i++)
+    order[i] = i;
+  for (u32 shift = 0; shift < 32; shift += 8)
+  {
+    u32 offsets[256] = {};
+    for (u32 i = 0; i < count; i++)
+      offsets[(keys[i] >> shift) & 0xFF]++;
+    u32 sum = 0;
+    for (u32 b = 0; b < 256; b++)
+    {
+      const u32 c = offsets[b];
+      offsets[b] = sum;
+      sum += c;
+    }
+    for (u32 i = 0; i < count; i++)
+    {
+      const u32 item = order[i];
+      tmp[offsets[(keys[item] >> shift) & 0xFF]++] = item;
+    }
+    order.swap(tmp);
+  }
+}
+
+u32 float_order_bits(f32 value)
+{
+  u32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+vertex_cache_stats analyze_vertex_cache(u32 const* indices, u32 index_count, u32 vertex_count)
+{
+  vertex_cache_stats ret;
+  ret.triangle_count = index_count / 3;
+  fifo_cache cache;
+  cache.reset(vertex_count);
+  vector<u8> used;
+  used.resize(vertex_count, 0);
+  for (u32 i = 0; i < index_count; i++)
+  {
+    const u32 v = indices[i];
+    my_assert(v < vertex_count);
+    ret.transform_count += cache.access(v) ? 1 : 0;
+    ret.vertex_count += used[v] ? 0 : 1;
+    used[v] = 1;
+  }
+  return ret;
+}
+
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count)
+{
+  const u32 triangle_count = index_count / 3;
+  if (triangle_count == 0)
+    return;
+
+  // Triangles of every vertex, and the number of them not emitted yet.
+  vector<u32> live_counts;
+  vector<u32> adjacency_offsets;
+  vector<u32> adjacency;
+  live_counts.resize(vertex_count, 0);
+  adjacency_offsets.resize(vertex_count + 1, 0);
+  adjacency.resize(index_count, 0);
+  for (u32 i = 0; i < index_count; i++)
+    live_counts[indices[i]]++;
+  for (u32 v = 0; v < vertex_count; v++)
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + live_counts[v];
+  {
+    vector<u32> cursors = adjacency_offsets;
+    for (u32 i = 0; i < index_count; i++)
+      adjacency[cursors[indices[i]]++] = i / 3;
+  }
+
+  vector<u32> output;
+  vector<u32> dead_end;
+  vector<u32> candidates;
+  vector<u8> emitted;
+  vector<u32> timestamps;
+  output.reserve(index_count);
+  dead_end.reserve(index_count);
+  emitted.resize(triangle_count, 0);
+  timestamps.resize(vertex_count, 0);
+  u32 time = VERTEX_CACHE_SIZE + 1;
+  u32 cursor = 0;
+  i32 fanning = (i32)indices[0];
+
+  while (fanning >= 0)
+  {
+    candidates.clear();
+    const u32 f = (u32)fanning;
+    for (u32 a = adjacency_offsets[f]; a < adjacency_offsets[f + 1]; a++)
+    {
+      const u32 t = adjacency[a];
+      if (emitted[t])
+        continue;
+      emitted[t] = 1;
+      for (u32 k = 0; k < 3; k++)
+      {
+        const u32 v = indices[t * 3 + k];
+        output.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        live_counts[v]--;
+        if (time - timestamps[v] > VERTEX_CACHE_SIZE)
+          timestamps[v] = time++;
+      }
+    }
+
+    // Next fanning vertex is a candidate with live triangles which stays in the cache after
+    // emitting all of them, the one which entered the cache first. Otherwise any which is still in the cache.
+    fanning = -1;
+    i32 best_priority = -1;
+    for (u32 i = 0; i < candidates.size(); i++)
+    {
+      const u32 v = candidates[i];
+      if (live_counts[v] == 0)
+        continue;
+      i32 priority = 0;
+      if (time - timestamps[v] + 2 * live_counts[v] <= VERTEX_CACHE_SIZE)
+        priority = (i32)(time - timestamps[v]);
+      if (priority > best_priority)
+      {
+        best_priority = priority;
+        fanning = (i32)v;
+      }
+    }
+
+    // Dead end, go back to recently used vertices, then scan for any vertex with live triangles.
+    while (fanning < 0 && dead_end.size() > 0)
+    {
+      const u32 v = dead_end.back();
+      dead_end.pop_back();
+      if (live_counts[v] > 0)
+        fanning = (i32)v;
+    }
+    while (fanning < 0 && cursor < vertex_count)
+    {
+      if (live_counts[cursor] > 0)
+        fanning = (i32)cursor;
+      cursor++;
+    }
+  }
+
+  my_assert(output.size() == triangle_count * 3);
+  memcpy(indices, output.data(), triangle_count * 3 * sizeof(u32));
+}
+
+void optimize_overdraw(u32* indices, u32 index_count, vertex const* vertices, u32 vertex_count, f32 threshold)
+{
+  const u32 triangle_count = index_count / 3;
+  if (triangle_count == 0)
+    return;
+
+  // Hard boundaries, triangles which miss all three vertices.
+  vector<u32> hard;
+  fifo_cache cache;
+  cache.reset(vertex_count);
+  vector<u32> misses;
+  misses.resize(triangle_count, 0);
+  for (u32 t = 0; t < triangle_count; t++)
+  {
+    for (u32 k = 0; k < 3; k++)
+      misses[t] += cache.access(indices[t * 3 + k]) ? 1 : 0;
+    if (t == 0 || misses[t] == 3)
+      hard.push_back(t);
+  }
+  hard.push_back(triangle_count);
+
+  // Soft boundaries, where the cluster so far has low enough miss ratio with a cache which starts empty.
+  vector<u32> clusters;
+  for (u32 h = 0; h + 1 < hard.size(); h++)
+  {
+    const u32 begin = hard[h];
+    const u32 end = hard[h + 1];
+    u32 run_misses = 0;
+    for (u32 t = begin; t < end; t++)
+      run_misses += misses[t];
+    const f32 run_acmr = (f32)run_misses / (f32)(end - begin);
+
+    clusters.push_back(begin);
+    cache.reset(vertex_count);
+    u32 cluster_begin = begin;
+    u32 cluster_misses = 0;
+    for (u32 t = begin; t + 1 < end; t++)
+    {
+      for (u32 k = 0; k < 3; k++)
+        cluster_misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+      if ((f32)cluster_misses <= run_acmr * threshold * (f32)(t + 1 - cluster_begin))
+      {
+        clusters.push_back(t + 1);
+        cache.reset(vertex_count);
+        cluster_begin = t + 1;
+        cluster_misses = 0;
+      }
+    }
+  }
+  clusters.push_back(triangle_count);
+  const u32 cluster_count = clusters.size() - 1;
+  if (cluster_count < 2)
+    return;
+
+  // Area weighted centroids and normals.
+  glm::vec3 mesh_centroid = { 0.0f, 0.0f, 0.0f };
+  f32 mesh_area = 0.0f;
+  vector<glm::vec3> centroids;
+  vector<glm::vec3> normals;
+  centroids.resize(cluster_count, glm::vec3{ 0.0f });
+  normals.resize(cluster_count, glm::vec3{ 0.0f });
+  for (u32 c = 0; c < cluster_count; c++)
+  {
+    f32 area = 0.0f;
+    for (u32 t = clusters[c]; t < clusters[c + 1]; t++)
+    {
+      const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+      const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+      const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      const f32 a = glm::length(n);
+      centroids[c] += a * (p0 + p1 + p2) / 3.0f;
+      normals[c] += n;
+      area += a;
+    }
+    mesh_centroid += centroids[c];
+    mesh_area += area;
+    centroids[c] = area > 0.0f ? centroids[c] / area : centroids[c];
+  }
+  mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : mesh_centroid;
+
+  // Clusters which face outward the most go first.
+  vector<u32> keys;
+  keys.resize(cluster_count, 0);
+  for (u32 c = 0; c < cluster_count; c++)
+  {
+    const f32 l = glm::length(normals[c]);
+    const f32 facing = l > 0.0f ? glm::dot(centroids[c] - mesh_centroid, normals[c] / l) : 0.0f;
+    keys[c] = ~float_order_bits(facing);
+  }
+  vector<u32> order;
+  radix_sort(keys, order);
+
+  vector<u32> output;
+  output.reserve(triangle_count * 3);
+  for (u32 i = 0; i < cluster_count; i++)
+  {
+    const u32 c = order[i];
+    for (u32 t = clusters[c]; t < clusters[c + 1]; t++)
+    {
+      output.push_back(indices[t * 3 + 0]);
+      output.push_back(indices[t * 3 + 1]);
+      output.push_back(indices[t * 3 + 2]);
+    }
+  }
+  memcpy(indices, output.data(), triangle_count * 3 * sizeof(u32));
+}
+
+u32 optimize_vertex_fetch(vertex* vertices, u32* indices, u32 index_count, u32 vertex_count)
+{
+  vector<u32> remap;
+  remap.resize(vertex_count, (u32)-1);
+  vector<vertex> reordered;
+  reordered.reserve(vertex_count);
+  for (u32 i = 0; i < index_count; i++)
+  {
+    const u32 v = indices[i];
+    if (remap[v] == (u32)-1)
+    {
+      remap[v] = reordered.size();
+      reordered.push_back(vertices[v]);
+    }
+    indices[i] = remap[v];
+  }
+  memcpy(vertices, reordered.data(), reordered.size() * sizeof(vertex));
+  return reordered.size();
+}
+
+mesh_optimization_stats optimize_mesh(mesh_lod& lod)
+{
+  // Overdraw ordering may raise cache misses by this factor.
+  static constexpr f32 OVERDRAW_THRESHOLD = 1.05f;
+
+  mesh_optimization_stats ret;
+  const u32 index_count = lod.indices.size();
+  ret.before = analyze_vertex_cache(lod.indices.data(), index_count, lod.vertices.size());
+  optimize_vertex_cache(lod.indices.data(), index_count, lod.vertices.size());
+  optimize_overdraw(lod.indices.data(), index_count, lod.vertices.data(), lod.vertices.size(), OVERDRAW_THRESHOLD);
+  const u32 vertex_count = optimize_vertex_fetch(lod.vertices.data(), lod.indices.data(), index_count,
+                                                 lod.vertices.size());
+  lod.vertices.resize(vertex_count, {});
+  ret.after = analyze_vertex_cache(lod.indices.data(), index_count, vertex_count);
+  return ret;
+}
+
+void optimize_meshes(mesh_lod* const* lods, u32 count, mesh_optimization_stats* out_stats)
+{
+  jobs::parallel_for(count, 1, [&](u32 begin, u32 end, u32)
+  {
+    for (u32 i = begin; i < end; i++)
+      out_stats[i] = optimize_mesh(*lods[i]);
+  });
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "mesh.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Mesh processing before upload.
+// Triangles are reordered for the post-transform vertex cache (Tipsify), then clusters of them
+// are reordered to draw outward-facing parts first, which reduces overdraw, and vertices are
+// reordered by first use so that vertex fetch walks memory linearly.
+
+// Size of the FIFO cache which the ordering targets and which statistics simulate.
+static constexpr u32 VERTEX_CACHE_SIZE = 16;
+
+struct vertex_cache_stats
+{
+  u32 triangle_count = 0;
+  u32 vertex_count = 0;
+  // Vertices transformed, cache misses of a simulated FIFO cache.
+  u32 transform_count = 0;
+};
+
+// Average cache miss ratio, vertices transformed per triangle. 0.5 is the ideal for large meshes, 3 the worst.
+inline f32 acmr(const vertex_cache_stats& s)
+{
+  return s.triangle_count > 0 ? (f32)s.transform_count / (f32)s.triangle_count : 0.0f;
+}
+
+// Average transform to vertex ratio, 1 is the ideal.
+inline f32 atvr(const vertex_cache_stats& s)
+{
+  return s.vertex_count > 0 ? (f32)s.transform_count / (f32)s.vertex_count : 0.0f;
+}
+
+inline void accumulate(vertex_cache_stats& sum, const vertex_cache_stats& s)
+{
+  sum.triangle_count += s.triangle_count;
+  sum.vertex_count += s.vertex_count;
+  sum.transform_count += s.transform_count;
+}
+
+vertex_cache_stats analyze_vertex_cache(u32 const* indices, u32 index_count, u32 vertex_count);
+
+// Tipsify, Sander et al. "Fast triangle reordering for vertex locality and reduced overdraw".
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count);
+
+// Splits cache-optimized triangles into clusters where the order restarts anyway, or where
+// the cluster so far misses the cache at most threshold times as often as the whole run,
+// and draws clusters facing away from the center of the mesh first.
+void optimize_overdraw(u32* indices, u32 index_count, vertex const* vertices, u32 vertex_count, f32 threshold);
+
+// Orders vertices by first use and drops unused ones, returns the new vertex count.
+u32 optimize_vertex_fetch(vertex* vertices, u32* indices, u32 index_count, u32 vertex_count);
+
+struct mesh_optimization_stats
+{
+  vertex_cache_stats before;
+  vertex_cache_stats after;
+};
+
+mesh_optimization_stats optimize_mesh(mesh_lod& lod);
+// Optimizes meshes on job threads.
+void optimize_meshes(mesh_lod* const* lods, u32 count, mesh_optimization_stats* out_stats);
+
+// Radix sort of 32-bit keys, returns indices of items in increasing key order.
+void radix_sort(vector<u32> const& keys, vector<u32>& order);
+// Maps floats to unsigned integers of the same order.
+u32 float_order_bits(f32 value);
@@ -0,0 +1,54 @@
+#include "mesh_registry.hpp"
+#include "my_assert.hpp"
+
+u32 mesh_registry::acquire(content_hash const& hash, u64 bytes, u32 uploads, same_content_function same_content,
+                           void* ctx)
+{
+  auto it = m_ids.find(hash.lo);
+  if (it == m_ids.end() || m_hashes[it->value] != hash)
+  {
+    m_stats.misses++;
+    return INVALID_ID;
+  }
+  // The new mesh is inserted with the same hash and stays unshared.
+  if (same_content(ctx, it->value) == false)
+  {
+    m_stats.collisions++;
+    m_stats.misses++;
+    return INVALID_ID;
+  }
+  const u32 id = it->value;
+  m_references[id]++;
+  m_stats.hits++;
+  m_stats.bytes_saved += bytes;
+  m_stats.uploads_avoided += uploads;
+  return id;
+}
+
+void mesh_registry::insert(content_hash const& hash, u32 id)
+{
+  if (id >= m_references.size())
+  {
+    m_hashes.resize(id + 1, {});
+    m_references.resize(id + 1, 0);
+  }
+  my_assert(m_references[id] == 0);
+  m_hashes[id] = hash;
+  m_references[id] = 1;
+  m_stats.meshes++;
+  // Content whose low half or content collides with another mesh stays unshared.
+  if (m_ids.find(hash.lo) == m_ids.end())
+    m_ids.insert(u64{ hash.lo }, u32{ id });
+}
+
+bool mesh_registry::release(u32 id)
+{
+  my_assert(reference_count(id) > 0);
+  if (--m_references[id] > 0)
+    return false;
+  auto it = m_ids.find(m_hashes[id].lo);
+  if (it != m_ids.end() && it->value == id)
+    m_ids.erase(m_hashes[id].lo);
+  m_stats.meshes--;
+  return true;
+}
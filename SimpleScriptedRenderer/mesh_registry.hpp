@@ -0,0 +1,58 @@
+#pragma once
+#include "content_hash.hpp"
+#include "hash_map.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Content-addressed registry of loaded meshes.
+// Meshes are keyed by the hash of their vertex and index streams, loading content which is
+// already resident returns the same mesh id with one more reference instead of a new copy.
+// The hash only finds a candidate, the owner compares the content before it is shared.
+// Ids belong to the owner of the meshes, the registry only counts references to them.
+
+struct mesh_registry_stats
+{
+  u32 meshes = 0;
+  u32 hits = 0;
+  u32 misses = 0;
+  // Hash matches whose content differed, counted as misses too.
+  u32 collisions = 0;
+  // Sizes reported by the owner for content which was not loaded again.
+  u64 bytes_saved = 0;
+  u32 uploads_avoided = 0;
+};
+
+class mesh_registry
+{
+public:
+  static constexpr u32 INVALID_ID = (u32)-1;
+
+  // Returns true when the resident mesh has the content being loaded, byte for byte.
+  using same_content_function = bool (*)(void* ctx, u32 id);
+
+  // Returns the id of the mesh with the content and takes a reference, INVALID_ID when there is none.
+  // Bytes and uploads are what loading the content again would have cost.
+  u32 acquire(content_hash const& hash, u64 bytes, u32 uploads, same_content_function same_content, void* ctx);
+  // Registers a new mesh with one reference, call after a failed acquire.
+  void insert(content_hash const& hash, u32 id);
+  // Drops a reference. Returns true when it was the last one, the owner destroys the mesh then.
+  bool release(u32 id);
+
+  u32 reference_count(u32 id) const
+  {
+    return id < m_references.size() ? m_references[id] : 0;
+  }
+
+  mesh_registry_stats const& stats() const
+  {
+    return m_stats;
+  }
+
+private:
+  // By the low half of the hash, the high half is compared on lookup.
+  hash_map<u64, u32> m_ids;
+  // By mesh id.
+  vector<content_hash> m_hashes;
+  vector<u32> m_references;
+  mesh_registry_stats m_stats;
+};
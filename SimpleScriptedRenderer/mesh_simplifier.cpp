@@ -0,0 +1,499 @@
+#include <math.h>
+#include <string.h>
+
+#include "jobs.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "my_assert.hpp"
+#include "util.hpp"
+#include "vector.hpp"
+
+namespace
+{
+// Normals closer than this are the same, positions with different normals lie on hard edges.
+static constexpr f32 SAME_NORMAL_COS = 0.999f;
+// Collapses may turn a remaining triangle by less than this angle.
+static constexpr f32 MAX_FLIP_COS = 0.25f;
+// Weight of normal change against squared distance, scaled by squared edge length.
+static constexpr f32 NORMAL_WEIGHT = 1.0f;
+// Every pass collapses edges up to this factor of the cost at one third of the sorted candidates.
+static constexpr f32 PASS_COST_FACTOR = 1.5f;
+// Level has to drop at least this share of triangles of the previous one.
+static constexpr f32 MIN_LEVEL_REDUCTION = 0.1f;
+
+// Sum of squared distances to planes, p^T A p + 2 b^T p + c.
+struct quadric
+{
+  f64 a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+  f64 b0 = 0.0, b1 = 0.0, b2 = 0.0;
+  f64 c = 0.0;
+
+  void add_plane(const glm::dvec3& n, f64 d)
+  {
+    a00 += n.x * n.x;
+    a01 += n.x * n.y;
+    a02 += n.x * n.z;
+    a11 += n.y * n.y;
+    a12 += n.y * n.z;
+    a22 += n.z * n.z;
+    b0 += n.x * d;
+    b1 += n.y * d;
+    b2 += n.z * d;
+    c += d * d;
+  }
+
+  void add(const quadric& q)
+  {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a11 += q.a11;
+    a12 += q.a12;
+    a22 += q.a22;
+    b0 += q.b0;
+    b1 += q.b1;
+    b2 += q.b2;
+    c += q.c;
+  }
+
+  f64 evaluate(const glm::vec3& p) const
+  {
+    const f64 x = p.x;
+    const f64 y = p.y;
+    const f64 z = p.z;
+    const f64 r = x * (a00 * x + 2.0 * (a01 * y + a02 * z + b0)) + y * (a11 * y + 2.0 * (a12 * z + b1))
+      + z * (a22 * z + 2.0 * b2) + c;
+    return r > 0.0 ? r : 0.0;
+  }
+};
+
+struct collapse
+{
+  u32 from;
+  u32 to;
+  f32 cost;
+};
+
+class simplifier
+{
+public:
+  simplifier(const mesh_lod& src) : m_src(src)
+  {
+    weld();
+    m_indices = src.indices;
+    m_vertex_remap.resize(src.vertices.size(), 0);
+    for (u32 i = 0; i < m_vertex_remap.size(); i++)
+      m_vertex_remap[i] = i;
+    compute_quadrics();
+    lock_borders();
+  }
+
+  u32 triangle_count() const
+  {
+    return m_indices.size() / 3;
+  }
+
+  f32 error() const
+  {
+    return (f32)sqrt(m_max_error);
+  }
+
+  // Runs one pass of independent collapses, returns false when nothing could be collapsed.
+  bool collapse_pass(u32 target_triangle_count)
+  {
+    build_adjacency();
+    collect_collapses();
+    if (m_collapses.size() == 0)
+      return false;
+
+    vector<u32> keys;
+    keys.resize(m_collapses.size(), 0);
+    for (u32 i = 0; i < m_collapses.size(); i++)
+      keys[i] = float_order_bits(m_collapses[i].cost);
+    vector<u32> order;
+    radix_sort(keys, order);
+    const f32 cost_limit = PASS_COST_FACTOR * m_collapses[order[order.size() / 3]].cost;
+
+    // Collapses of a pass don't touch the same triangles, so each is checked against current positions.
+    m_touched.clear();
+    m_touched.resize(m_positions.size(), 0);
+    u32 triangles = triangle_count();
+    u32 collapsed = 0;
+    for (u32 i = 0; i < order.size() && triangles > target_triangle_count; i++)
+    {
+      const collapse& c = m_collapses[order[i]];
+      if (c.cost > cost_limit)
+        break;
+      if (m_touched[c.from] || m_touched[c.to])
+        continue;
+      u32 removed;
+      if (check_collapse(c.from, c.to, removed) == false)
+        continue;
+      apply_collapse(c);
+      triangles -= removed;
+      collapsed++;
+    }
+    if (collapsed == 0)
+      return false;
+    remove_degenerate_triangles();
+    return true;
+  }
+
+  // Writes current triangles with vertices they use.
+  void write_level(mesh_lod& out) const
+  {
+    vector<u32> new_index;
+    new_index.resize(m_src.vertices.size(), (u32)-1);
+    out.vertices.clear();
+    out.indices.clear();
+    out.indices.reserve(m_indices.size());
+    for (u32 i = 0; i < m_indices.size(); i++)
+    {
+      const u32 v = m_indices[i];
+      if (new_index[v] == (u32)-1)
+      {
+        new_index[v] = out.vertices.size();
+        out.vertices.push_back(m_src.vertices[v]);
+      }
+      out.indices.push_back(new_index[v]);
+    }
+    out.min_screen_size = 0.0f;
+    out.error = error();
+    out.generated = true;
+  }
+
+private:
+  // Groups vertices by position: sorted by a hash of position bits, equal ones compared exactly.
+  void weld()
+  {
+    const u32 vertex_count = m_src.vertices.size();
+    vector<u32> keys;
+    keys.resize(vertex_count, 0);
+    for (u32 i = 0; i < vertex_count; i++)
+    {
+      u32 bits[3];
+      memcpy(bits, &m_src.vertices[i].position, sizeof(bits));
+      keys[i] = util::xorshift_32(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+    }
+    vector<u32> order;
+    radix_sort(keys, order);
+
+    // Sort is stable, the first equal vertex of a run has the lowest index.
+    vector<u32> first_equal;
+    first_equal.resize(vertex_count, 0);
+    u32 run_begin = 0;
+    for (u32 i = 0; i < vertex_count; i++)
+    {
+      const u32 v = order[i];
+      if (i > 0 && keys[v] != keys[order[i - 1]])
+        run_begin = i;
+      first_equal[v] = v;
+      for (u32 j = run_begin; j < i; j++)
+      {
+        if (m_src.vertices[order[j]].position == m_src.vertices[v].position)
+        {
+          first_equal[v] = order[j];
+          break;
+        }
+      }
+    }
+    // Positions are numbered in vertex order, which keeps their data as local as the vertices.
+    m_position_of.resize(vertex_count, 0);
+    for (u32 v = 0; v < vertex_count; v++)
+    {
+      if (first_equal[v] == v)
+      {
+        m_position_of[v] = m_positions.size();
+        m_positions.push_back(m_src.vertices[v].position);
+      }
+      else
+      {
+        m_position_of[v] = m_position_of[first_equal[v]];
+      }
+    }
+
+    // Vertices of every position, which differ in normals or colors.
+    m_first_variant.resize(m_positions.size() + 1, 0);
+    for (u32 v = 0; v < vertex_count; v++)
+      m_first_variant[m_position_of[v] + 1]++;
+    for (u32 p = 0; p < m_positions.size(); p++)
+      m_first_variant[p + 1] += m_first_variant[p];
+    m_variants.resize(vertex_count, 0);
+    vector<u32> cursors = m_first_variant;
+    for (u32 v = 0; v < vertex_count; v++)
+      m_variants[cursors[m_position_of[v]]++] = v;
+
+    m_hard.resize(m_positions.size(), 0);
+    for (u32 p = 0; p < m_positions.size(); p++)
+    {
+      const glm::vec3& n = m_src.vertices[m_variants[m_first_variant[p]]].normal;
+      for (u32 i = m_first_variant[p] + 1; i < m_first_variant[p + 1]; i++)
+      {
+        if (glm::dot(m_src.vertices[m_variants[i]].normal, n) < SAME_NORMAL_COS)
+          m_hard[p] = 1;
+      }
+    }
+  }
+
+  void compute_quadrics()
+  {
+    m_quadrics.resize(m_positions.size(), {});
+    for (u32 i = 0; i < m_indices.size(); i += 3)
+    {
+      const glm::dvec3 p0 = m_positions[m_position_of[m_indices[i + 0]]];
+      const glm::dvec3 p1 = m_positions[m_position_of[m_indices[i + 1]]];
+      const glm::dvec3 p2 = m_positions[m_position_of[m_indices[i + 2]]];
+      const glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+      const f64 l = glm::length(n);
+      if (l == 0.0)
+        continue;
+      quadric q;
+      q.add_plane(n / l, -glm::dot(n / l, p0));
+      for (u32 k = 0; k < 3; k++)
+        m_quadrics[m_position_of[m_indices[i + k]]].add(q);
+    }
+  }
+
+  // Positions on edges which don't have exactly two triangles of opposite winding never move.
+  void lock_borders()
+  {
+    build_adjacency();
+    m_locked.resize(m_positions.size(), 0);
+    for (u32 p = 0; p < m_positions.size(); p++)
+    {
+      for (u32 t = m_first_triangle[p]; t < m_first_triangle[p + 1] && m_locked[p] == 0; t++)
+      {
+        // Edge from p to the next corner has to be once in each direction around p.
+        const u32 next = corner_after(m_triangles[t], p, 1);
+        u32 forward = 0;
+        u32 backward = 0;
+        for (u32 o = m_first_triangle[p]; o < m_first_triangle[p + 1]; o++)
+        {
+          forward += corner_after(m_triangles[o], p, 1) == next ? 1 : 0;
+          backward += corner_after(m_triangles[o], p, 2) == next ? 1 : 0;
+        }
+        if (forward != 1 || backward != 1)
+        {
+          m_locked[p] = 1;
+          m_locked[next] = 1;
+        }
+      }
+    }
+  }
+
+  // Position of the corner of the triangle offset places after position p.
+  u32 corner_after(u32 triangle, u32 p, u32 offset) const
+  {
+    for (u32 k = 0; k < 3; k++)
+    {
+      if (position(triangle * 3 + k) == p)
+        return position(triangle * 3 + (k + offset) % 3);
+    }
+    my_assert(false);
+    return p;
+  }
+
+  u32 position(u32 corner) const
+  {
+    return m_position_of[m_indices[corner]];
+  }
+
+  // Triangles around every position.
+  void build_adjacency()
+  {
+    m_first_triangle.clear();
+    m_first_triangle.resize(m_positions.size() + 1, 0);
+    for (u32 i = 0; i < m_indices.size(); i++)
+      m_first_triangle[position(i) + 1]++;
+    for (u32 p = 0; p < m_positions.size(); p++)
+      m_first_triangle[p + 1] += m_first_triangle[p];
+    m_triangles.resize(m_indices.size(), 0);
+    vector<u32> cursors = m_first_triangle;
+    for (u32 i = 0; i < m_indices.size(); i++)
+      m_triangles[cursors[position(i)]++] = i / 3;
+  }
+
+  // Variant of position to which vertex v moves when its position collapses there, with the normal change.
+  u32 match_variant(u32 v, u32 to, f32& out_cos) const
+  {
+    const glm::vec3& n = m_src.vertices[v].normal;
+    u32 best = m_variants[m_first_variant[to]];
+    out_cos = -2.0f;
+    for (u32 i = m_first_variant[to]; i < m_first_variant[to + 1]; i++)
+    {
+      const f32 c = glm::dot(m_src.vertices[m_variants[i]].normal, n);
+      if (c > out_cos)
+      {
+        out_cos = c;
+        best = m_variants[i];
+      }
+    }
+    return best;
+  }
+
+  // Cost of moving position from onto position to, negative if not allowed.
+  f32 collapse_cost(u32 from, u32 to) const
+  {
+    if (m_locked[from])
+      return -1.0f;
+    // Hard edges only collapse along themselves, every normal has to be there at the target.
+    f32 min_cos = 1.0f;
+    for (u32 i = m_first_variant[from]; i < m_first_variant[from + 1]; i++)
+    {
+      f32 c;
+      match_variant(m_variants[i], to, c);
+      if (m_hard[from] && c < SAME_NORMAL_COS)
+        return -1.0f;
+      min_cos = glm::min(min_cos, c);
+    }
+    // Quadrics are linear, the sum of both is evaluated without adding them up.
+    const glm::vec3& p = m_positions[to];
+    const glm::vec3 edge = p - m_positions[from];
+    return (f32)(m_quadrics[from].evaluate(p) + m_quadrics[to].evaluate(p))
+      + NORMAL_WEIGHT * (1.0f - min_cos) * glm::dot(edge, edge);
+  }
+
+  // Every edge of live triangles in its cheaper allowed direction.
+  void collect_collapses()
+  {
+    m_collapses.clear();
+    for (u32 i = 0; i < m_indices.size(); i += 3)
+    {
+      for (u32 k = 0; k < 3; k++)
+      {
+        const u32 a = position(i + k);
+        const u32 b = position(i + (k + 1) % 3);
+        // Interior edges are visited from both triangles, each direction once.
+        if (a > b)
+          continue;
+        const f32 ab = collapse_cost(a, b);
+        const f32 ba = collapse_cost(b, a);
+        if (ab < 0.0f && ba < 0.0f)
+          continue;
+        if (ba < 0.0f || (ab >= 0.0f && ab <= ba))
+          m_collapses.push_back({ a, b, ab });
+        else
+          m_collapses.push_back({ b, a, ba });
+      }
+    }
+  }
+
+  // Rejects collapses which flip or fold remaining triangles, counts triangles removed.
+  bool check_collapse(u32 from, u32 to, u32& out_removed) const
+  {
+    out_removed = 0;
+    for (u32 t = m_first_triangle[from]; t < m_first_triangle[from + 1]; t++)
+    {
+      const u32 tri = m_triangles[t];
+      glm::vec3 p[3];
+      bool has_to = false;
+      for (u32 k = 0; k < 3; k++)
+      {
+        const u32 pos = position(tri * 3 + k);
+        has_to = has_to || pos == to;
+        p[k] = m_positions[pos];
+      }
+      if (has_to)
+      {
+        out_removed++;
+        continue;
+      }
+      const glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+      for (u32 k = 0; k < 3; k++)
+      {
+        if (position(tri * 3 + k) == from)
+          p[k] = m_positions[to];
+      }
+      const glm::vec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+      const f32 l = glm::length(n0) * glm::length(n1);
+      if (l == 0.0f || glm::dot(n0, n1) < MAX_FLIP_COS * l)
+        return false;
+    }
+    return true;
+  }
+
+  void apply_collapse(const collapse& c)
+  {
+    for (u32 i = m_first_variant[c.from]; i < m_first_variant[c.from + 1]; i++)
+    {
+      f32 normal_cos;
+      m_vertex_remap[m_variants[i]] = match_variant(m_variants[i], c.to, normal_cos);
+    }
+    m_quadrics[c.to].add(m_quadrics[c.from]);
+    m_max_error = glm::max(m_max_error, m_quadrics[c.to].evaluate(m_positions[c.to]));
+    // Neighbours see changed triangles, they wait for the next pass.
+    for (u32 t = m_first_triangle[c.from]; t < m_first_triangle[c.from + 1]; t++)
+    {
+      for (u32 k = 0; k < 3; k++)
+        m_touched[position(m_triangles[t] * 3 + k)] = 1;
+    }
+  }
+
+  void remove_degenerate_triangles()
+  {
+    u32 out = 0;
+    for (u32 i = 0; i < m_indices.size(); i += 3)
+    {
+      const u32 v0 = m_vertex_remap[m_indices[i + 0]];
+      const u32 v1 = m_vertex_remap[m_indices[i + 1]];
+      const u32 v2 = m_vertex_remap[m_indices[i + 2]];
+      const u32 p0 = m_position_of[v0];
+      const u32 p1 = m_position_of[v1];
+      const u32 p2 = m_position_of[v2];
+      if (p0 == p1 || p1 == p2 || p2 == p0)
+        continue;
+      m_indices[out++] = v0;
+      m_indices[out++] = v1;
+      m_indices[out++] = v2;
+    }
+    m_indices.resize(out, 0);
+  }
+
+  const mesh_lod& m_src;
+  // Current triangles, as indices of source vertices.
+  vector<u32> m_indices;
+  vector<u32> m_vertex_remap;
+  vector<glm::vec3> m_positions;
+  vector<u32> m_position_of;
+  vector<u32> m_first_variant;
+  vector<u32> m_variants;
+  vector<u8> m_hard;
+  vector<u8> m_locked;
+  vector<quadric> m_quadrics;
+  vector<u32> m_first_triangle;
+  vector<u32> m_triangles;
+  vector<collapse> m_collapses;
+  vector<u8> m_touched;
+  f64 m_max_error = 0.0;
+};
+} // namespace
+
+u32 generate_lod_chain(mesh_lod* lods, f32 const* ratios, u32 ratio_count)
+{
+  my_assert(ratio_count < MAX_LODS);
+  if (lods[0].indices.size() < 3)
+    return 1;
+  simplifier s{ lods[0] };
+  u32 lod_count = 1;
+  for (u32 i = 0; i < ratio_count; i++)
+  {
+    const u32 target = (u32)(ratios[i] * (lods[0].indices.size() / 3));
+    while (s.triangle_count() > target && s.collapse_pass(target))
+    {
+    }
+    const u32 previous = lods[lod_count - 1].indices.size() / 3;
+    if (s.triangle_count() == 0 || s.triangle_count() > (u32)((1.0f - MIN_LEVEL_REDUCTION) * previous))
+      break;
+    s.write_level(lods[lod_count++]);
+  }
+  return lod_count;
+}
+
+void generate_lod_chains(mesh_lod* lods, u32 count, u32* out_lod_counts)
+{
+  jobs::parallel_for(count, 1, [&](u32 begin, u32 end, u32)
+  {
+    for (u32 i = begin; i < end; i++)
+      out_lod_counts[i] = generate_lod_chain(lods + i * MAX_LODS, LOD_CHAIN_RATIOS, LOD_CHAIN_LEVELS);
+  });
+}
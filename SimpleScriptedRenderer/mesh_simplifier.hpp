@@ -0,0 +1,21 @@
+#pragma once
+#include "mesh.hpp"
+#include "types.hpp"
+
+// Generation of levels of detail by edge collapses ordered by quadric error metrics,
+// Garland and Heckbert "Surface simplification using quadric error metrics".
+// Vertices with the same position are welded for the collapses, their normals are kept:
+// a vertex moves onto a neighbour and takes over its normal with the closest direction.
+// Hard edges only collapse along themselves and vertices on open borders never move.
+
+// Triangle counts of generated levels relative to the source.
+static constexpr u32 LOD_CHAIN_LEVELS = MAX_LODS - 1;
+static constexpr f32 LOD_CHAIN_RATIOS[LOD_CHAIN_LEVELS] = { 0.5f, 0.25f, 0.125f };
+
+// Simplifies lods[0] down to every ratio of its triangles and writes levels from lods[1],
+// each with its error set and marked generated. A level which can't get well below the previous one ends the chain.
+// Returns the number of levels including the source one.
+u32 generate_lod_chain(mesh_lod* lods, f32 const* ratios, u32 ratio_count);
+
+// Generates chains on job threads, chain i starts at lods[i * MAX_LODS].
+void generate_lod_chains(mesh_lod* lods, u32 count, u32* out_lod_counts);
@@ -0,0 +1,154 @@
+#include "meshlet.hpp"
+#include "my_assert.hpp"
+
+namespace
+{
+void finish_meshlet(vertex const* vertices, u32 const* indices, meshlet& m)
+{
+  glm::vec3 min = vertices[indices[m.first_index]].position;
+  glm::vec3 max = min;
+  glm::vec3 normal_sum = { 0.0f, 0.0f, 0.0f };
+  for (u32 i = m.first_index; i < m.first_index + m.index_count; i += 3)
+  {
+    const glm::vec3& p0 = vertices[indices[i + 0]].position;
+    const glm::vec3& p1 = vertices[indices[i + 1]].position;
+    const glm::vec3& p2 = vertices[indices[i + 2]].position;
+    min = glm::min(min, glm::min(p0, glm::min(p1, p2)));
+    max = glm::max(max, glm::max(p0, glm::max(p1, p2)));
+    // Front faces wind clockwise, see soft_renderer.cpp.
+    const glm::vec3 n = glm::cross(p2 - p0, p1 - p0);
+    const f32 l = glm::length(n);
+    if (l > 0.0f)
+      normal_sum += n / l;
+  }
+
+  m.center = 0.5f * (min + max);
+  m.radius = 0.0f;
+  for (u32 i = m.first_index; i < m.first_index + m.index_count; i++)
+    m.radius = glm::max(m.radius, glm::length(vertices[indices[i]].position - m.center));
+
+  m.cone_axis = { 0.0f, 0.0f, 1.0f };
+  m.cone_cos = -1.0f;
+  m.cone_sin = 0.0f;
+  const f32 axis_length = glm::length(normal_sum);
+  if (axis_length == 0.0f)
+    return;
+  m.cone_axis = normal_sum / axis_length;
+  f32 min_dot = 1.0f;
+  for (u32 i = m.first_index; i < m.first_index + m.index_count; i += 3)
+  {
+    const glm::vec3& p0 = vertices[indices[i + 0]].position;
+    const glm::vec3& p1 = vertices[indices[i + 1]].position;
+    const glm::vec3& p2 = vertices[indices[i + 2]].position;
+    const glm::vec3 n = glm::cross(p2 - p0, p1 - p0);
+    const f32 l = glm::length(n);
+    if (l > 0.0f)
+      min_dot = glm::min(min_dot, glm::dot(n / l, m.cone_axis));
+  }
+  m.cone_cos = min_dot;
+  m.cone_sin = glm::sqrt(glm::max(1.0f - min_dot * min_dot, 0.0f));
+}
+} // namespace
+
+void build_meshlets(vertex const* vertices, u32 const* indices, u32 index_count, vector<meshlet>& out)
+{
+  if (index_count < 3)
+    return;
+  u32 max_index = 0;
+  for (u32 i = 0; i < index_count; i++)
+    max_index = glm::max(max_index, indices[i]);
+
+  // Number of the meshlet which last used the vertex, plus one.
+  vector<u32> stamps;
+  stamps.resize(max_index + 1, 0);
+  u32 stamp = 1;
+  meshlet current = {};
+  u32 vertex_count = 0;
+  for (u32 i = 0; i + 2 < index_count; i += 3)
+  {
+    u32 new_vertices = 0;
+    for (u32 k = 0; k < 3; k++)
+      new_vertices += stamps[indices[i + k]] != stamp ? 1 : 0;
+    if (vertex_count + new_vertices > MESHLET_MAX_VERTICES || current.index_count == MESHLET_MAX_TRIANGLES * 3)
+    {
+      finish_meshlet(vertices, indices, current);
+      out.push_back(current);
+      current = {};
+      current.first_index = i;
+      vertex_count = 0;
+      stamp++;
+    }
+    for (u32 k = 0; k < 3; k++)
+    {
+      if (stamps[indices[i + k]] != stamp)
+      {
+        stamps[indices[i + k]] = stamp;
+        vertex_count++;
+      }
+    }
+    current.index_count += 3;
+  }
+  finish_meshlet(vertices, indices, current);
+  out.push_back(current);
+}
+
+void cull_meshlets(meshlet const* meshlets, u32 count, frustum const& f, glm::vec3 camera_position,
+                   glm::mat4x4 const& local_to_world, bool backface_culling, vector<index_range>& out,
+                   meshlet_cull_stats& stats)
+{
+  // Planes go to local space by the transpose, distances are then measured in local units.
+  frustum local;
+  const glm::mat4x4 t = glm::transpose(local_to_world);
+  for (u32 p = 0; p < 6; p++)
+  {
+    local.planes[p] = t * f.planes[p];
+    local.planes[p] /= glm::length(glm::vec3{ local.planes[p] });
+  }
+  const glm::vec3 camera = glm::vec3{ glm::inverse(local_to_world) * glm::vec4{ camera_position, 1.0f } };
+  // Mirroring flips faces, the cone test would be inverted.
+  const bool cone_test = backface_culling && glm::determinant(glm::mat3x3{ local_to_world }) > 0.0f;
+
+  const u32 first_range = out.size();
+  stats.meshlets += count;
+  for (u32 i = 0; i < count; i++)
+  {
+    const meshlet& m = meshlets[i];
+    bool visible = true;
+    for (u32 p = 0; p < 6 && visible; p++)
+    {
+      const glm::vec4& plane = local.planes[p];
+      visible = glm::dot(glm::vec3{ plane }, m.center) + plane.w >= -m.radius;
+    }
+    if (visible == false)
+    {
+      stats.frustum_culled++;
+      stats.triangles_culled += m.index_count / 3;
+      continue;
+    }
+
+    // Back-facing if every point of the sphere is behind every normal of the cone: with angle t between
+    // the axis and the direction to the center at distance d, cos(t + cone angle) * d > radius.
+    if (cone_test && m.cone_cos > 0.0f)
+    {
+      const glm::vec3 to_center = m.center - camera;
+      const f32 d = glm::length(to_center);
+      const f32 cos_t = d > 0.0f ? glm::dot(to_center, m.cone_axis) / d : 0.0f;
+      if (cos_t > 0.0f)
+      {
+        const f32 sin_t = glm::sqrt(glm::max(1.0f - cos_t * cos_t, 0.0f));
+        if ((cos_t * m.cone_cos - sin_t * m.cone_sin) * d > m.radius)
+        {
+          stats.backface_culled++;
+          stats.triangles_culled += m.index_count / 3;
+          continue;
+        }
+      }
+    }
+
+    stats.triangles_submitted += m.index_count / 3;
+    if (out.size() > first_range && out.back().first_index + out.back().index_count == m.first_index)
+      out.back().index_count += m.index_count;
+    else
+      out.push_back({ m.first_index, m.index_count });
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "culling.hpp"
+#include "my_glm.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+#include "vertex.hpp"
+
+// Meshlets, small clusters of triangles of a mesh level culled one by one.
+// A meshlet is a run of consecutive triangles of the level, so visible meshlets are drawn
+// straight from the index buffer as ranges and no indices are rewritten.
+// Triangles should be ordered for locality first, see mesh_optimizer.hpp.
+
+static constexpr u32 MESHLET_MAX_VERTICES = 64;
+static constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+
+struct meshlet
+{
+  // Range of indices relative to the first index of the level.
+  u32 first_index;
+  u32 index_count;
+  // Bounding sphere.
+  glm::vec3 center;
+  f32 radius;
+  // Normal cone of front faces, cosine and sine of its half angle.
+  // cone_cos <= 0 when the cone is too wide to be ever back-facing.
+  glm::vec3 cone_axis;
+  f32 cone_cos;
+  f32 cone_sin;
+};
+
+// Appends meshlets of triangles in index order.
+void build_meshlets(vertex const* vertices, u32 const* indices, u32 index_count, vector<meshlet>& out);
+
+struct index_range
+{
+  u32 first_index;
+  u32 index_count;
+};
+
+struct meshlet_cull_stats
+{
+  u32 meshlets = 0;
+  u32 frustum_culled = 0;
+  u32 backface_culled = 0;
+  u32 triangles_submitted = 0;
+  u32 triangles_culled = 0;
+};
+
+inline void accumulate(meshlet_cull_stats& sum, const meshlet_cull_stats& s)
+{
+  sum.meshlets += s.meshlets;
+  sum.frustum_culled += s.frustum_culled;
+  sum.backface_culled += s.backface_culled;
+  sum.triangles_submitted += s.triangles_submitted;
+  sum.triangles_culled += s.triangles_culled;
+}
+
+// Culls meshlets of a mesh placed by local_to_world against the frustum and the camera position
+// in world space. Appends ranges of visible indices, adjacent ones merged.
+// Tests run in the local space of the mesh, so non-uniform scale is handled exactly.
+// Normal cones are only tested with backface_culling, i.e. when the rasterizer culls back faces too.
+void cull_meshlets(meshlet const* meshlets, u32 count, frustum const& f, glm::vec3 camera_position,
+                   glm::mat4x4 const& local_to_world, bool backface_culling, vector<index_range>& out,
+                   meshlet_cull_stats& stats);
@@ -0,0 +1,7 @@
+#pragma once
+#pragma warning(push)
+#pragma warning(disable: 4201)
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#pragma warning(pop)
@@ -1,14 +1,15 @@
 #pragma once
+#include <stddef.h>
 #include "types.hpp"
 
 static struct placement_new_tag
 {} placement_new;
 
-inline void* operator new(u64, void* place, placement_new_tag)
+inline void* operator new(size_t, void* place, placement_new_tag)
 {
   return place;
 }
-inline void* operator new[](u64, void* place, placement_new_tag)
+inline void* operator new[](size_t, void* place, placement_new_tag)
 {
   return place;
 }
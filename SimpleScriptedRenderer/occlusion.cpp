@@ -0,0 +1,213 @@
+#include <float.h>
+#include <math.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include "jobs.hpp"
+#include "my_assert.hpp"
+#include "occlusion.hpp"
+
+occlusion_buffer::occlusion_buffer()
+{
+  m_depth = static_cast<f32*>(_mm_malloc(sizeof(f32) * WIDTH * HEIGHT, 16));
+  for (u32 i = 0; i < WIDTH * HEIGHT; i++)
+    m_depth[i] = 1.0f;
+}
+
+occlusion_buffer::~occlusion_buffer()
+{
+  _mm_free(m_depth);
+}
+
+void occlusion_buffer::begin_frame(glm::mat4x4 const& world_to_screen)
+{
+  m_world_to_screen = world_to_screen;
+  m_triangles.clear();
+  for (u32 i = 0; i < TILES_X * TILES_Y; i++)
+    m_bins[i].clear();
+
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (u32 i = 0; i < WIDTH * HEIGHT; i += 4)
+    _mm_store_ps(m_depth + i, one);
+}
+
+void occlusion_buffer::add_occluder(glm::mat4x4 const& local_to_world, glm::vec3 const* positions, u32 const* indices, u32 index_count)
+{
+  const glm::mat4x4 local_to_screen = m_world_to_screen * local_to_world;
+  for (u32 i = 0; i + 2 < index_count; i += 3)
+  {
+    f32 x[3];
+    f32 y[3];
+    f32 z[3];
+    bool clipped = false;
+    for (u32 v = 0; v < 3; v++)
+    {
+      const glm::vec4 p = local_to_screen * glm::vec4{ positions[indices[i + v]], 1.0f };
+      if (p.z < 0.0f || p.w <= 0.0f)
+      {
+        clipped = true;
+        break;
+      }
+      const f32 inv_w = 1.0f / p.w;
+      x[v] = (p.x * inv_w * 0.5f + 0.5f) * (f32)WIDTH;
+      y[v] = (0.5f - p.y * inv_w * 0.5f) * (f32)HEIGHT;
+      z[v] = p.z * inv_w;
+    }
+    if (clipped)
+      continue;
+
+    f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (fabsf(area) < 1e-6f)
+      continue;
+    if (area < 0.0f)
+    {
+      // Occluders are rasterized regardless of winding.
+      util::swap(x[1], x[2]);
+      util::swap(y[1], y[2]);
+      util::swap(z[1], z[2]);
+      area = -area;
+    }
+
+    screen_triangle tri;
+    tri.min_x = (i32)floorf(glm::min(x[0], glm::min(x[1], x[2])));
+    tri.min_y = (i32)floorf(glm::min(y[0], glm::min(y[1], y[2])));
+    tri.max_x = (i32)floorf(glm::max(x[0], glm::max(x[1], x[2])));
+    tri.max_y = (i32)floorf(glm::max(y[0], glm::max(y[1], y[2])));
+    tri.min_x = tri.min_x < 0 ? 0 : tri.min_x;
+    tri.min_y = tri.min_y < 0 ? 0 : tri.min_y;
+    tri.max_x = tri.max_x > (i32)WIDTH - 1 ? (i32)WIDTH - 1 : tri.max_x;
+    tri.max_y = tri.max_y > (i32)HEIGHT - 1 ? (i32)HEIGHT - 1 : tri.max_y;
+    if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+      continue;
+
+    for (u32 e = 0; e < 3; e++)
+    {
+      const u32 i0 = e;
+      const u32 i1 = (e + 1) % 3;
+      tri.a[e] = -(y[i1] - y[i0]);
+      tri.b[e] = x[i1] - x[i0];
+      tri.c[e] = (y[i1] - y[i0]) * x[i0] - (x[i1] - x[i0]) * y[i0];
+    }
+    const f32 inv_area = 1.0f / area;
+    tri.za = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * inv_area;
+    tri.zb = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * inv_area;
+    tri.zc = z[0] - tri.za * x[0] - tri.zb * y[0];
+
+    const u32 tri_idx = m_triangles.size();
+    m_triangles.push_back(tri);
+    for (u32 ty = (u32)tri.min_y / TILE_HEIGHT; ty <= (u32)tri.max_y / TILE_HEIGHT; ty++)
+      for (u32 tx = (u32)tri.min_x / TILE_WIDTH; tx <= (u32)tri.max_x / TILE_WIDTH; tx++)
+        m_bins[ty * TILES_X + tx].push_back(tri_idx);
+  }
+}
+
+void occlusion_buffer::rasterize()
+{
+  jobs::parallel_for(TILES_X * TILES_Y, 1, [this](u32 begin, u32 end, u32)
+  {
+    for (u32 tile = begin; tile < end; tile++)
+      rasterize_tile(tile);
+  });
+}
+
+void occlusion_buffer::rasterize_tile(u32 tile)
+{
+  const i32 tile_x0 = (i32)((tile % TILES_X) * TILE_WIDTH);
+  const i32 tile_y0 = (i32)((tile / TILES_X) * TILE_HEIGHT);
+  const i32 tile_x1 = tile_x0 + (i32)TILE_WIDTH - 1;
+  const i32 tile_y1 = tile_y0 + (i32)TILE_HEIGHT - 1;
+  const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+
+  const vector<u32>& bin = m_bins[tile];
+  for (u32 i = 0; i < bin.size(); i++)
+  {
+    const screen_triangle& tri = m_triangles[bin[i]];
+    const i32 x0 = (tri.min_x > tile_x0 ? tri.min_x : tile_x0) & ~3;
+    const i32 x1 = tri.max_x < tile_x1 ? tri.max_x : tile_x1;
+    const i32 y0 = tri.min_y > tile_y0 ? tri.min_y : tile_y0;
+    const i32 y1 = tri.max_y < tile_y1 ? tri.max_y : tile_y1;
+
+    const __m128 a0 = _mm_set1_ps(tri.a[0]);
+    const __m128 a1 = _mm_set1_ps(tri.a[1]);
+    const __m128 a2 = _mm_set1_ps(tri.a[2]);
+    const __m128 za = _mm_set1_ps(tri.za);
+    for (i32 y = y0; y <= y1; y++)
+    {
+      const f32 py = (f32)y + 0.5f;
+      const __m128 row0 = _mm_set1_ps(tri.b[0] * py + tri.c[0]);
+      const __m128 row1 = _mm_set1_ps(tri.b[1] * py + tri.c[1]);
+      const __m128 row2 = _mm_set1_ps(tri.b[2] * py + tri.c[2]);
+      const __m128 row_z = _mm_set1_ps(tri.zb * py + tri.zc);
+      f32* depth_row = m_depth + y * WIDTH;
+      for (i32 x = x0; x <= x1; x += 4)
+      {
+        const __m128 px = _mm_add_ps(_mm_set1_ps((f32)x), lane_offsets);
+        const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+        const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+        const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+        const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                         _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+        if (_mm_movemask_ps(inside) == 0)
+          continue;
+        const __m128 z = _mm_add_ps(_mm_mul_ps(za, px), row_z);
+        const __m128 old_z = _mm_load_ps(depth_row + x);
+        const __m128 write = _mm_and_ps(inside, _mm_cmplt_ps(z, old_z));
+        _mm_store_ps(depth_row + x, _mm_or_ps(_mm_and_ps(write, z), _mm_andnot_ps(write, old_z)));
+      }
+    }
+  }
+}
+
+bool occlusion_buffer::is_visible(aabb const& box) const
+{
+  f32 min_x = +FLT_MAX;
+  f32 min_y = +FLT_MAX;
+  f32 max_x = -FLT_MAX;
+  f32 max_y = -FLT_MAX;
+  f32 min_z = +FLT_MAX;
+  for (u32 corner = 0; corner < 8; corner++)
+  {
+    const glm::vec4 p = m_world_to_screen * glm::vec4{
+      corner & 1 ? box.max.x : box.min.x,
+      corner & 2 ? box.max.y : box.min.y,
+      corner & 4 ? box.max.z : box.min.z,
+      1.0f };
+    // Box crosses the near plane, its screen bounds are unbounded.
+    if (p.z < 0.0f || p.w <= 0.0f)
+      return true;
+    const f32 inv_w = 1.0f / p.w;
+    const f32 x = (p.x * inv_w * 0.5f + 0.5f) * (f32)WIDTH;
+    const f32 y = (0.5f - p.y * inv_w * 0.5f) * (f32)HEIGHT;
+    min_x = x < min_x ? x : min_x;
+    max_x = x > max_x ? x : max_x;
+    min_y = y < min_y ? y : min_y;
+    max_y = y > max_y ? y : max_y;
+    min_z = p.z * inv_w < min_z ? p.z * inv_w : min_z;
+  }
+
+  const i32 x0 = min_x < 0.0f ? 0 : (i32)min_x;
+  const i32 y0 = min_y < 0.0f ? 0 : (i32)min_y;
+  const i32 x1 = max_x >= (f32)WIDTH ? (i32)WIDTH - 1 : (i32)floorf(max_x);
+  const i32 y1 = max_y >= (f32)HEIGHT ? (i32)HEIGHT - 1 : (i32)floorf(max_y);
+  if (x0 > x1 || y0 > y1)
+    return false;
+
+  const __m128 z = _mm_set1_ps(min_z);
+  const __m128i first = _mm_set1_epi32(x0 - 1);
+  const __m128i last = _mm_set1_epi32(x1 + 1);
+  const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+  for (i32 y = y0; y <= y1; y++)
+  {
+    const f32* depth_row = m_depth + y * WIDTH;
+    for (i32 x = x0 & ~3; x <= x1; x += 4)
+    {
+      const __m128i xs = _mm_add_epi32(_mm_set1_epi32(x), lanes);
+      const __m128i in_rect = _mm_and_si128(_mm_cmpgt_epi32(xs, first), _mm_cmplt_epi32(xs, last));
+      const __m128 closer = _mm_cmplt_ps(z, _mm_load_ps(depth_row + x));
+      if (_mm_movemask_ps(_mm_and_ps(_mm_castsi128_ps(in_rect), closer)) != 0)
+        return true;
+    }
+  }
+  return false;
+}
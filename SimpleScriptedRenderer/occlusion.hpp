@@ -0,0 +1,64 @@
+#pragma once
+#include "culling.hpp"
+#include "my_glm.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Software occlusion culling.
+// Occluder triangles are binned into screen tiles and rasterized on CPU
+// into a small depth buffer, four pixels at a time. Tiles are independent
+// and are rasterized in parallel. Screen space bounds of occludees are then
+// tested against the buffer: box is occluded if its nearest depth is behind
+// every covered pixel.
+class occlusion_buffer
+{
+public:
+  static constexpr u32 WIDTH = 256;
+  static constexpr u32 HEIGHT = 128;
+  static constexpr u32 TILE_WIDTH = 64;
+  static constexpr u32 TILE_HEIGHT = 32;
+  static constexpr u32 TILES_X = WIDTH / TILE_WIDTH;
+  static constexpr u32 TILES_Y = HEIGHT / TILE_HEIGHT;
+
+  occlusion_buffer();
+  ~occlusion_buffer();
+  occlusion_buffer(occlusion_buffer const&) = delete;
+  occlusion_buffer& operator=(occlusion_buffer const&) = delete;
+
+  void begin_frame(glm::mat4x4 const& world_to_screen);
+  // Triangles crossing the near plane are dropped, they can't be rasterized
+  // without clipping and dropping an occluder triangle is always safe.
+  void add_occluder(glm::mat4x4 const& local_to_world, glm::vec3 const* positions, u32 const* indices, u32 index_count);
+  void rasterize();
+  bool is_visible(aabb const& box) const;
+
+  u32 triangle_count() const
+  {
+    return m_triangles.size();
+  }
+
+private:
+  struct screen_triangle
+  {
+    // Edge functions e(x, y) = a * x + b * y + c, positive inside.
+    f32 a[3];
+    f32 b[3];
+    f32 c[3];
+    // Depth plane z(x, y) = za * x + zb * y + zc.
+    f32 za;
+    f32 zb;
+    f32 zc;
+    i32 min_x;
+    i32 min_y;
+    i32 max_x;
+    i32 max_y;
+  };
+
+  void rasterize_tile(u32 tile);
+
+  // Depth of the nearest occluder, 1.0 where nothing is rasterized.
+  f32* m_depth;
+  glm::mat4x4 m_world_to_screen;
+  vector<screen_triangle> m_triangles;
+  vector<u32> m_bins[TILES_X * TILES_Y];
+};
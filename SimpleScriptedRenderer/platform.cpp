@@ -0,0 +1,218 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "my_assert.hpp"
+#include "platform.hpp"
+
+namespace
+{
+struct thread_start
+{
+  platform::thread_function fn;
+  void* data;
+};
+} // namespace
+
+#ifdef _WIN32
+struct platform::thread
+{
+  HANDLE handle;
+  thread_start start;
+};
+
+struct platform::semaphore
+{
+  HANDLE handle;
+};
+
+namespace
+{
+DWORD WINAPI thread_main(LPVOID param)
+{
+  const thread_start* start = static_cast<const thread_start*>(param);
+  start->fn(start->data);
+  return 0;
+}
+} // namespace
+
+f64 platform::seconds()
+{
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (f64)counter.QuadPart / (f64)frequency.QuadPart;
+}
+
+u32 platform::cpu_count()
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (u32)info.dwNumberOfProcessors : 1;
+}
+
+platform::thread* platform::create_thread(thread_function fn, void* data)
+{
+  thread* t = new thread;
+  t->start.fn = fn;
+  t->start.data = data;
+  t->handle = CreateThread(nullptr, 0, thread_main, &t->start, 0, nullptr);
+  my_assert(t->handle != nullptr);
+  return t;
+}
+
+void platform::join_thread(thread* t)
+{
+  WaitForSingleObject(t->handle, INFINITE);
+  CloseHandle(t->handle);
+  delete t;
+}
+
+platform::semaphore* platform::create_semaphore()
+{
+  semaphore* s = new semaphore;
+  s->handle = CreateSemaphoreA(nullptr, 0, 0x7FFFFFFF, nullptr);
+  my_assert(s->handle != nullptr);
+  return s;
+}
+
+void platform::destroy_semaphore(semaphore* s)
+{
+  CloseHandle(s->handle);
+  delete s;
+}
+
+void platform::post(semaphore* s)
+{
+  ReleaseSemaphore(s->handle, 1, nullptr);
+}
+
+void platform::wait(semaphore* s)
+{
+  WaitForSingleObject(s->handle, INFINITE);
+}
+
+i32 platform::atomic_add(volatile i32* value, i32 addend)
+{
+  return (i32)InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(value), (LONG)addend);
+}
+
+bool platform::atomic_compare_exchange(volatile i32* value, i32 expected, i32 desired)
+{
+  return InterlockedCompareExchange(reinterpret_cast<volatile LONG*>(value), (LONG)desired, (LONG)expected)
+         == (LONG)expected;
+}
+
+void platform::atomic_store(volatile i32* value, i32 desired)
+{
+  InterlockedExchange(reinterpret_cast<volatile LONG*>(value), (LONG)desired);
+}
+#else
+struct platform::thread
+{
+  pthread_t handle;
+  thread_start start;
+};
+
+// Unnamed POSIX semaphores are missing on some systems, a counter under a mutex works everywhere.
+struct platform::semaphore
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  u32 count;
+};
+
+namespace
+{
+void* thread_main(void* param)
+{
+  const thread_start* start = static_cast<const thread_start*>(param);
+  start->fn(start->data);
+  return nullptr;
+}
+} // namespace
+
+f64 platform::seconds()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+u32 platform::cpu_count()
+{
+  const long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (u32)count : 1;
+}
+
+platform::thread* platform::create_thread(thread_function fn, void* data)
+{
+  thread* t = new thread;
+  t->start.fn = fn;
+  t->start.data = data;
+  const int result = pthread_create(&t->handle, nullptr, thread_main, &t->start);
+  my_assert(result == 0);
+  (void)result;
+  return t;
+}
+
+void platform::join_thread(thread* t)
+{
+  pthread_join(t->handle, nullptr);
+  delete t;
+}
+
+platform::semaphore* platform::create_semaphore()
+{
+  semaphore* s = new semaphore;
+  pthread_mutex_init(&s->mutex, nullptr);
+  pthread_cond_init(&s->cond, nullptr);
+  s->count = 0;
+  return s;
+}
+
+void platform::destroy_semaphore(semaphore* s)
+{
+  pthread_cond_destroy(&s->cond);
+  pthread_mutex_destroy(&s->mutex);
+  delete s;
+}
+
+void platform::post(semaphore* s)
+{
+  pthread_mutex_lock(&s->mutex);
+  s->count++;
+  pthread_mutex_unlock(&s->mutex);
+  pthread_cond_signal(&s->cond);
+}
+
+void platform::wait(semaphore* s)
+{
+  pthread_mutex_lock(&s->mutex);
+  while (s->count == 0)
+    pthread_cond_wait(&s->cond, &s->mutex);
+  s->count--;
+  pthread_mutex_unlock(&s->mutex);
+}
+
+i32 platform::atomic_add(volatile i32* value, i32 addend)
+{
+  return __atomic_fetch_add(value, addend, __ATOMIC_SEQ_CST);
+}
+
+bool platform::atomic_compare_exchange(volatile i32* value, i32 expected, i32 desired)
+{
+  return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void platform::atomic_store(volatile i32* value, i32 desired)
+{
+  __atomic_store_n(value, desired, __ATOMIC_SEQ_CST);
+}
+#endif
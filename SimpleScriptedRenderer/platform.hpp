@@ -0,0 +1,30 @@
+#pragma once
+#include "types.hpp"
+
+// Operating system services of the engine core: timer, threads, semaphores and atomics.
+// Windows and POSIX implementations, so the core builds and runs without SDL.
+namespace platform
+{
+// Monotonic, in seconds from an unspecified start.
+f64 seconds();
+u32 cpu_count();
+
+struct thread;
+using thread_function = void (*)(void* data);
+
+thread* create_thread(thread_function fn, void* data);
+// Waits for the thread to return and frees it.
+void join_thread(thread* t);
+
+struct semaphore;
+
+semaphore* create_semaphore();
+void destroy_semaphore(semaphore* s);
+void post(semaphore* s);
+void wait(semaphore* s);
+
+// Full barriers. atomic_add returns the previous value.
+i32 atomic_add(volatile i32* value, i32 addend);
+bool atomic_compare_exchange(volatile i32* value, i32 expected, i32 desired);
+void atomic_store(volatile i32* value, i32 desired);
+} // namespace platform
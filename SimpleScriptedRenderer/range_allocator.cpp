@@ -0,0 +1,116 @@
+#include "my_assert.hpp"
+#include "range_allocator.hpp"
+
+void range_allocator::init(u32 capacity)
+{
+  m_capacity = capacity;
+  m_free_count = capacity;
+  m_free.clear();
+  if (capacity > 0)
+    m_free.push_back({ 0, capacity });
+}
+
+u32 range_allocator::allocate(u32 count)
+{
+  my_assert(count > 0);
+  u32 best = INVALID_OFFSET;
+  for (u32 i = 0; i < m_free.size(); i++)
+  {
+    if (m_free[i].count >= count && (best == INVALID_OFFSET || m_free[i].count < m_free[best].count))
+    {
+      best = i;
+      if (m_free[i].count == count)
+        break;
+    }
+  }
+  if (best == INVALID_OFFSET)
+    return INVALID_OFFSET;
+
+  free_range& r = m_free[best];
+  const u32 offset = r.offset;
+  r.offset += count;
+  r.count -= count;
+  if (r.count == 0)
+  {
+    for (u32 i = best; i + 1 < m_free.size(); i++)
+      m_free[i] = m_free[i + 1];
+    m_free.pop_back();
+  }
+  m_free_count -= count;
+  return offset;
+}
+
+void range_allocator::release(u32 offset, u32 count)
+{
+  my_assert(count > 0 && offset + count <= m_capacity);
+  u32 idx = 0;
+  while (idx < m_free.size() && m_free[idx].offset < offset)
+    idx++;
+  my_assert(idx == 0 || m_free[idx - 1].offset + m_free[idx - 1].count <= offset);
+  my_assert(idx == m_free.size() || offset + count <= m_free[idx].offset);
+  m_free_count += count;
+
+  const bool merge_prev = idx > 0 && m_free[idx - 1].offset + m_free[idx - 1].count == offset;
+  const bool merge_next = idx < m_free.size() && offset + count == m_free[idx].offset;
+  if (merge_prev && merge_next)
+  {
+    m_free[idx - 1].count += count + m_free[idx].count;
+    for (u32 i = idx; i + 1 < m_free.size(); i++)
+      m_free[i] = m_free[i + 1];
+    m_free.pop_back();
+  }
+  else if (merge_prev)
+  {
+    m_free[idx - 1].count += count;
+  }
+  else if (merge_next)
+  {
+    m_free[idx].offset = offset;
+    m_free[idx].count += count;
+  }
+  else
+  {
+    m_free.push_back({});
+    for (u32 i = m_free.size() - 1; i > idx; i--)
+      m_free[i] = m_free[i - 1];
+    m_free[idx] = { offset, count };
+  }
+}
+
+void range_allocator::compact(vector<range_move>& out_moves)
+{
+  out_moves.clear();
+  // Allocated ranges are the gaps between free ranges, each is slid down by the free space before it.
+  u32 dst = 0;
+  u32 src = 0;
+  for (u32 i = 0; i <= m_free.size(); i++)
+  {
+    const u32 gap_end = i < m_free.size() ? m_free[i].offset : m_capacity;
+    if (gap_end > src)
+    {
+      if (dst != src)
+        out_moves.push_back({ src, dst, gap_end - src });
+      dst += gap_end - src;
+    }
+    if (i < m_free.size())
+      src = m_free[i].offset + m_free[i].count;
+  }
+  m_free.clear();
+  if (m_free_count > 0)
+    m_free.push_back({ m_capacity - m_free_count, m_free_count });
+}
+
+u32 range_allocator::largest_free_range() const
+{
+  u32 ret = 0;
+  for (u32 i = 0; i < m_free.size(); i++)
+    ret = m_free[i].count > ret ? m_free[i].count : ret;
+  return ret;
+}
+
+f32 range_allocator::fragmentation() const
+{
+  if (m_free_count == 0)
+    return 0.0f;
+  return 1.0f - (f32)largest_free_range() / (f32)m_free_count;
+}
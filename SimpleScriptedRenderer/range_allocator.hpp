@@ -0,0 +1,59 @@
+#pragma once
+#include "types.hpp"
+#include "vector.hpp"
+
+// Allocator of ranges of elements in a fixed size arena, e.g. vertices of a shared vertex buffer.
+// Free ranges are kept sorted by offset and coalesced on release, allocation is best fit.
+// compact() moves allocated ranges to the start of the arena and reports the moves,
+// so the owner can move the data and patch its range descriptors.
+class range_allocator
+{
+public:
+  static constexpr u32 INVALID_OFFSET = (u32)-1;
+
+  struct range_move
+  {
+    u32 src;
+    u32 dst;
+    u32 count;
+  };
+
+  void init(u32 capacity);
+
+  // Returns INVALID_OFFSET if no free range is large enough.
+  u32 allocate(u32 count);
+  void release(u32 offset, u32 count);
+  // Leaves a single free range at the end of the arena.
+  // Moves are listed in increasing order of source offset, destinations never exceed sources.
+  void compact(vector<range_move>& out_moves);
+
+  u32 capacity() const
+  {
+    return m_capacity;
+  }
+
+  u32 free_count() const
+  {
+    return m_free_count;
+  }
+
+  u32 largest_free_range() const;
+  // 0 when all free space is one range, close to 1 when it is scattered over many small ones.
+  f32 fragmentation() const;
+
+  u32 free_range_count() const
+  {
+    return m_free.size();
+  }
+
+private:
+  struct free_range
+  {
+    u32 offset;
+    u32 count;
+  };
+
+  u32 m_capacity = 0;
+  u32 m_free_count = 0;
+  vector<free_range> m_free;
+};
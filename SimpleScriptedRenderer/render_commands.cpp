@@ -0,0 +1,298 @@
+#include <string.h>
+
+#include "my_assert.hpp"
+#include "render_commands.hpp"
+
+u64 make_sort_key(u32 pass, u32 pipeline, u32 mesh, f32 depth)
+{
+  my_assert(pass < (1u << SORT_KEY_PASS_BITS));
+  my_assert(pipeline < (1u << SORT_KEY_PIPELINE_BITS));
+  my_assert(mesh < (1u << SORT_KEY_MESH_BITS));
+  u32 depth_bits;
+  depth = depth > 0.0f ? depth : 0.0f;
+  memcpy(&depth_bits, &depth, sizeof(depth_bits));
+  return ((u64)pass << (64 - SORT_KEY_PASS_BITS))
+    | ((u64)pipeline << (32 + SORT_KEY_MESH_BITS))
+    | ((u64)mesh << 32)
+    | (u64)depth_bits;
+}
+
+void command_buffer::clear()
+{
+  m_packets.clear();
+  m_entries.clear();
+  m_constants.clear();
+  m_batches.clear();
+  m_instance_data.clear();
+  m_instance_indices.clear();
+}
+
+u32 command_buffer::push_constants(void const* data, u32 size)
+{
+  // Keep constants 16-byte aligned relative to the start of the buffer.
+  const u32 offset = (m_constants.size() + 15) & ~15u;
+  m_constants.resize(offset + size, 0);
+  memcpy(m_constants.data() + offset, data, size);
+  return offset;
+}
+
+void command_buffer::push_draw(u64 key, draw_packet const& packet)
+{
+  m_entries.push_back({ key, m_packets.size() });
+  m_packets.push_back(packet);
+}
+
+void command_buffer::sort()
+{
+  const u32 count = m_entries.size();
+  if (count < 2)
+    return;
+
+  // Bytes which are equal in every key don't affect the order.
+  u64 all_and = ~0ull;
+  u64 all_or = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    all_and &= m_entries[i].key;
+    all_or |= m_entries[i].key;
+  }
+  const u64 varying = all_and ^ all_or;
+
+  m_scratch.resize(count, {});
+  for (u32 shift = 0; shift < 64; shift += 8)
+  {
+    if (((varying >> shift) & 0xFF) == 0)
+      continue;
+
+    u32 offsets[256] = {};
+    for (u32 i = 0; i < count; i++)
+      offsets[(m_entries[i].key >> shift) & 0xFF]++;
+    u32 sum = 0;
+    for (u32 i = 0; i < 256; i++)
+    {
+      const u32 c = offsets[i];
+      offsets[i] = sum;
+      sum += c;
+    }
+    for (u32 i = 0; i < count; i++)
+      m_scratch[offsets[(m_entries[i].key >> shift) & 0xFF]++] = m_entries[i];
+    m_entries.swap(m_scratch);
+  }
+}
+
+void command_buffer::merge(command_buffer const* buffers, u32 count)
+{
+  clear();
+  m_merge_bases.clear();
+  m_merge_cursors.clear();
+  for (u32 i = 0; i < count; i++)
+  {
+    const command_buffer& b = buffers[i];
+    // Offsets within every buffer are 16-byte aligned, so are the rebased ones.
+    const u32 constants_base = (m_constants.size() + 15) & ~15u;
+    m_constants.resize(constants_base + b.m_constants.size(), 0);
+    if (b.m_constants.size() > 0)
+      memcpy(m_constants.data() + constants_base, b.m_constants.data(), b.m_constants.size());
+    m_merge_bases.push_back(m_packets.size());
+    m_merge_cursors.push_back(0);
+    for (u32 j = 0; j < b.m_packets.size(); j++)
+    {
+      draw_packet p = b.m_packets[j];
+      p.constants_offset += constants_base;
+      m_packets.push_back(p);
+    }
+  }
+
+  const u32 total = m_packets.size();
+  m_entries.reserve(total);
+  for (u32 n = 0; n < total; n++)
+  {
+    // Few buffers are merged, linear search for the smallest head is fine.
+    u32 best = (u32)-1;
+    u64 best_key = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+      const command_buffer& b = buffers[i];
+      if (m_merge_cursors[i] == b.m_entries.size())
+        continue;
+      const u64 key = b.m_entries[m_merge_cursors[i]].key;
+      if (best == (u32)-1 || key < best_key)
+      {
+        best = i;
+        best_key = key;
+      }
+    }
+    const sort_entry& e = buffers[best].m_entries[m_merge_cursors[best]++];
+    m_entries.push_back({ e.key, m_merge_bases[best] + e.packet });
+  }
+}
+
+void command_buffer::submit(render_backend& backend, submit_stats* stats) const
+{
+  submit_stats s;
+  u32 pass = (u32)-1;
+  u32 pipeline = (u32)-1;
+  u32 mesh = (u32)-1;
+  for (u32 i = 0; i < m_entries.size(); i++)
+  {
+    const draw_packet& p = m_packets[m_entries[i].packet];
+    if (p.pass != pass)
+    {
+      pass = p.pass;
+      // New pass invalidates all bound state.
+      pipeline = (u32)-1;
+      mesh = (u32)-1;
+      backend.begin_pass(pass);
+      s.pass_changes++;
+    }
+    if (p.pipeline != pipeline)
+    {
+      pipeline = p.pipeline;
+      backend.set_pipeline(pipeline);
+      s.pipeline_changes++;
+    }
+    if (p.mesh != mesh)
+    {
+      mesh = p.mesh;
+      backend.set_mesh(mesh);
+      s.mesh_changes++;
+    }
+    if (p.constants_size > 0)
+      backend.set_object_constants(m_constants.data() + p.constants_offset, p.constants_size);
+    backend.draw_indexed(p.index_count, p.first_index, p.base_vertex);
+    s.draws++;
+    s.instances++;
+  }
+  if (stats)
+    *stats = s;
+}
+
+void command_buffer::build_instance_batches()
+{
+  m_batches.clear();
+  m_instance_data.clear();
+  m_instance_indices.clear();
+  if (m_entries.size() == 0)
+    return;
+
+  m_instance_stride = m_packets[m_entries[0].packet].constants_size;
+  m_instance_data.resize(m_entries.size() * m_instance_stride, 0);
+  m_instance_indices.resize(m_packets.size(), 0);
+  for (u32 i = 0; i < m_entries.size(); i++)
+  {
+    m_instance_indices[m_entries[i].packet] = i;
+    const draw_packet& p = m_packets[m_entries[i].packet];
+    my_assert(p.constants_size == m_instance_stride);
+    memcpy(m_instance_data.data() + i * m_instance_stride, m_constants.data() + p.constants_offset, m_instance_stride);
+
+    if (m_batches.size() > 0)
+    {
+      instance_batch& b = m_batches.back();
+      const draw_packet& first = m_packets[m_entries[b.packet].packet];
+      if (first.pass == p.pass && first.pipeline == p.pipeline && first.mesh == p.mesh
+          && first.index_count == p.index_count && first.first_index == p.first_index && first.base_vertex == p.base_vertex)
+      {
+        b.instance_count++;
+        continue;
+      }
+    }
+    m_batches.push_back({ i, i, 1 });
+  }
+}
+
+void command_buffer::submit_instanced(render_backend& backend, submit_stats* stats) const
+{
+  submit_stats s;
+  if (m_batches.size() > 0)
+    backend.set_instance_data(m_instance_data.data(), m_instance_stride, m_entries.size());
+  u32 pass = (u32)-1;
+  u32 pipeline = (u32)-1;
+  u32 mesh = (u32)-1;
+  for (u32 i = 0; i < m_batches.size(); i++)
+  {
+    const instance_batch& b = m_batches[i];
+    const draw_packet& p = m_packets[m_entries[b.packet].packet];
+    if (p.pass != pass)
+    {
+      pass = p.pass;
+      pipeline = (u32)-1;
+      mesh = (u32)-1;
+      backend.begin_pass(pass);
+      s.pass_changes++;
+    }
+    if (p.pipeline != pipeline)
+    {
+      pipeline = p.pipeline;
+      backend.set_pipeline(pipeline);
+      s.pipeline_changes++;
+    }
+    if (p.mesh != mesh)
+    {
+      mesh = p.mesh;
+      backend.set_mesh(mesh);
+      s.mesh_changes++;
+    }
+    backend.draw_indexed_instanced(p.index_count, p.first_index, p.base_vertex, b.instance_count, b.first_instance);
+    s.draws++;
+    s.instances += b.instance_count;
+  }
+  if (stats)
+    *stats = s;
+}
+
+void command_buffer::patch_constants(u32 packet, void const* data, u32 size)
+{
+  const draw_packet& p = m_packets[packet];
+  my_assert(size == p.constants_size);
+  memcpy(m_constants.data() + p.constants_offset, data, size);
+  if (m_instance_indices.size() > 0)
+    memcpy(m_instance_data.data() + m_instance_indices[packet] * m_instance_stride, data, size);
+}
+
+void recording_backend::begin_pass(u32 pass)
+{
+  commands.push_back({ command_type::begin_pass, { pass } });
+}
+
+void recording_backend::set_pipeline(u32 pipeline)
+{
+  commands.push_back({ command_type::set_pipeline, { pipeline } });
+}
+
+void recording_backend::set_mesh(u32 mesh)
+{
+  commands.push_back({ command_type::set_mesh, { mesh } });
+}
+
+void recording_backend::set_object_constants(void const*, u32 size)
+{
+  commands.push_back({ command_type::set_object_constants, { size } });
+}
+
+void recording_backend::draw_indexed(u32 index_count, u32 first_index, i32 base_vertex)
+{
+  commands.push_back({ command_type::draw_indexed, { index_count, first_index, (u32)base_vertex } });
+}
+
+void recording_backend::set_instance_data(void const*, u32 stride, u32 count)
+{
+  commands.push_back({ command_type::set_instance_data, { stride, count } });
+}
+
+void recording_backend::draw_indexed_instanced(u32 index_count, u32 first_index, i32 base_vertex,
+                                               u32 instance_count, u32 first_instance)
+{
+  commands.push_back({ command_type::draw_indexed_instanced,
+                       { index_count, first_index, (u32)base_vertex, instance_count, first_instance } });
+}
+
+u32 recording_backend::count(command_type type) const
+{
+  u32 ret = 0;
+  for (u32 i = 0; i < commands.size(); i++)
+  {
+    if (commands[i].type == type)
+      ret++;
+  }
+  return ret;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include "types.hpp"
+#include "vector.hpp"
+
+// Backend agnostic draw commands.
+// Draws are recorded as packets with a 64-bit sort key, sorted with a radix sort
+// and submitted to a backend which translates them into graphics API calls.
+// State is only changed between packets which differ in the corresponding part of the key.
+
+// Sort key layout, from most to least significant bits:
+// pass (4 bits), pipeline (12 bits), mesh (16 bits), depth (32 bits).
+static constexpr u32 SORT_KEY_PASS_BITS = 4;
+static constexpr u32 SORT_KEY_PIPELINE_BITS = 12;
+static constexpr u32 SORT_KEY_MESH_BITS = 16;
+
+// Depth is expected to be non-negative, so its bits sort as an unsigned integer.
+u64 make_sort_key(u32 pass, u32 pipeline, u32 mesh, f32 depth);
+
+struct draw_packet
+{
+  u32 pass;
+  u32 pipeline;
+  u32 mesh;
+  u32 index_count;
+  u32 first_index;
+  i32 base_vertex;
+  // Range of per-object constants in the command buffer.
+  u32 constants_offset;
+  u32 constants_size;
+  // Caller-defined id of the drawn object, used to find its packet again.
+  u32 object;
+};
+
+// Receives sorted commands. State setters are only called when state changes.
+class render_backend
+{
+public:
+  virtual ~render_backend() = default;
+  virtual void begin_pass(u32 pass) = 0;
+  virtual void set_pipeline(u32 pipeline) = 0;
+  virtual void set_mesh(u32 mesh) = 0;
+  virtual void set_object_constants(void const* data, u32 size) = 0;
+  virtual void draw_indexed(u32 index_count, u32 first_index, i32 base_vertex) = 0;
+  // Per-instance constants of all instanced draws of the submit, uploaded once before the draws.
+  virtual void set_instance_data(void const* data, u32 stride, u32 count) = 0;
+  virtual void draw_indexed_instanced(u32 index_count, u32 first_index, i32 base_vertex,
+                                      u32 instance_count, u32 first_instance) = 0;
+};
+
+struct submit_stats
+{
+  u32 pass_changes = 0;
+  u32 pipeline_changes = 0;
+  u32 mesh_changes = 0;
+  u32 draws = 0;
+  u32 instances = 0;
+};
+
+// Run of sorted packets which differ only in their constants.
+struct instance_batch
+{
+  // First packet of the run, in sorted order.
+  u32 packet;
+  u32 first_instance;
+  u32 instance_count;
+};
+
+class command_buffer
+{
+public:
+  void clear();
+  // Copies per-object constants into the buffer, returns their offset.
+  u32 push_constants(void const* data, u32 size);
+  void push_draw(u64 key, draw_packet const& packet);
+  // Stable radix sort of packets by key. Byte passes where all keys agree are skipped.
+  void sort();
+  // Replaces contents with packets of several sorted buffers, merged by key.
+  // Used to combine buffers recorded on different threads.
+  void merge(command_buffer const* buffers, u32 count);
+  void submit(render_backend& backend, submit_stats* stats = nullptr) const;
+
+  // Groups sorted packets into instance batches and packs their constants
+  // into one array in instance order. Constants of all packets must have the same size.
+  void build_instance_batches();
+  // Issues one instanced draw per batch, build_instance_batches() must be called first.
+  void submit_instanced(render_backend& backend, submit_stats* stats = nullptr) const;
+
+  // Overwrites constants of a recorded packet, also in instance data if batches are built.
+  // Lets a retained buffer be submitted again after objects have moved.
+  void patch_constants(u32 packet, void const* data, u32 size);
+
+  // Packets in recording order, for merged buffers in order of the source buffers.
+  u32 packet_count() const
+  {
+    return m_packets.size();
+  }
+
+  draw_packet const& packet(u32 idx) const
+  {
+    return m_packets[idx];
+  }
+
+  vector<instance_batch> const& instance_batches() const
+  {
+    return m_batches;
+  }
+
+  vector<u8> const& instance_data() const
+  {
+    return m_instance_data;
+  }
+
+  u32 size() const
+  {
+    return m_entries.size();
+  }
+
+private:
+  struct sort_entry
+  {
+    u64 key;
+    u32 packet;
+  };
+
+  vector<draw_packet> m_packets;
+  vector<sort_entry> m_entries;
+  vector<sort_entry> m_scratch;
+  vector<u32> m_merge_bases;
+  vector<u32> m_merge_cursors;
+  vector<u8> m_constants;
+  vector<instance_batch> m_batches;
+  vector<u8> m_instance_data;
+  // Position of every packet in instance data.
+  vector<u32> m_instance_indices;
+  u32 m_instance_stride = 0;
+};
+
+// Backend which only records commands.
+// Used to inspect the command stream and count state changes without a GPU.
+class recording_backend : public render_backend
+{
+public:
+  enum class command_type : u8
+  {
+    begin_pass,
+    set_pipeline,
+    set_mesh,
+    set_object_constants,
+    draw_indexed,
+    set_instance_data,
+    draw_indexed_instanced
+  };
+
+  struct command
+  {
+    command_type type;
+    u32 args[5];
+  };
+
+  void clear()
+  {
+    commands.clear();
+  }
+
+  void begin_pass(u32 pass) override;
+  void set_pipeline(u32 pipeline) override;
+  void set_mesh(u32 mesh) override;
+  void set_object_constants(void const* data, u32 size) override;
+  void draw_indexed(u32 index_count, u32 first_index, i32 base_vertex) override;
+  void set_instance_data(void const* data, u32 stride, u32 count) override;
+  void draw_indexed_instanced(u32 index_count, u32 first_index, i32 base_vertex,
+                              u32 instance_count, u32 first_instance) override;
+
+  u32 count(command_type type) const;
+
+  vector<command> commands;
+};
@@ -0,0 +1,291 @@
+#include <float.h>
+#include <math.h>
+
+#include "lod.hpp"
+#include "my_assert.hpp"
+#include "scene.hpp"
+#include "util.hpp"
+
+void track_camera_motion(camera_motion& m, const camera& cam)
+{
+  m.translation += glm::length(cam.tr.t - m.last.tr.t);
+  const f32 cos_half_angle = glm::min(glm::abs(glm::dot(cam.tr.r, m.last.tr.r)), 1.0f);
+  m.rotation += 2.0 * acos(cos_half_angle);
+  if (cam.fov_degrees != m.last.fov_degrees || cam.aspect != m.last.aspect
+      || cam.z_near != m.last.z_near || cam.z_far != m.last.z_far)
+  {
+    m.epoch++;
+  }
+  m.last = cam;
+}
+
+namespace
+{
+// Conservative check that box is still inside by the margin recorded earlier.
+// Signed distance of a point to a frustum plane changes by at most camera translation
+// plus rotation angle times distance of the point from the camera.
+bool still_inside_frustum(const camera_motion& motion, const cull_coherence& state)
+{
+  if (state.epoch != motion.epoch || state.inside_margin <= 0.0f)
+    return false;
+  const f64 dt = motion.translation - state.translation_stamp;
+  const f64 dr = motion.rotation - state.rotation_stamp;
+  return dt + dr * (state.max_distance + dt) < state.inside_margin;
+}
+
+bool aabb_view_frustum_intersection(const frustum& f, const glm::vec3& cam_pos, const aabb& box, bool temporal_coherence,
+                                    const camera_motion& motion, cull_coherence& state, cull_stats& stats)
+{
+  // Compare distance from box center to plane against projected extent of the box.
+  const glm::vec3 c = 0.5f * (box.max + box.min);
+  const glm::vec3 e = 0.5f * (box.max - box.min);
+  const u32 first_plane = temporal_coherence ? state.last_plane : 0;
+  f32 margin = FLT_MAX;
+  for (u32 i = 0; i < 6; i++)
+  {
+    const u32 plane = (first_plane + i) % 6;
+    const glm::vec4& p = f.planes[plane];
+    const f32 d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+    const f32 r = e.x * glm::abs(p.x) + e.y * glm::abs(p.y) + e.z * glm::abs(p.z);
+    stats.plane_tests++;
+    if (d + r < 0.0f)
+    {
+      state.last_plane = (u8)plane;
+      state.inside_margin = 0.0f;
+      return false; // box is outside of the plane
+    }
+    margin = glm::min(margin, d - r);
+  }
+
+  state.inside_margin = margin;
+  if (margin > 0.0f)
+  {
+    state.epoch = motion.epoch;
+    state.max_distance = glm::length(c - cam_pos) + glm::length(e);
+    state.translation_stamp = motion.translation;
+    state.rotation_stamp = motion.rotation;
+  }
+  return true;
+}
+} // namespace
+
+glm::mat4x4 entity_local_to_world(const entity& e)
+{
+  glm::mat4x4 ltw = e.tr.local_to_world();
+  entity* pe = e.parent;
+  while (pe)
+  {
+    ltw = pe->tr.local_to_world() * ltw;
+    pe = pe->parent;
+  }
+  return ltw;
+}
+
+void update_entity_bounds(scene& sc, entity* e)
+{
+  if (e->vd == nullptr || e->batch != nullptr)
+  {
+    if (e->bvh_proxy != bvh::NULL_NODE)
+    {
+      sc.tree.destroy_proxy(e->bvh_proxy);
+      e->bvh_proxy = bvh::NULL_NODE;
+      sc.structure_epoch++;
+    }
+    return;
+  }
+
+  e->coherence.inside_margin = 0.0f;
+  const aabb bounds = transform_aabb(e->vd->aabb_center, e->vd->aabb_extent, entity_local_to_world(*e));
+  if (e->bvh_proxy == bvh::NULL_NODE)
+  {
+    e->bvh_proxy = sc.tree.create_proxy(bounds, e);
+    sc.structure_epoch++;
+  }
+  else
+  {
+    sc.tree.move_proxy(e->bvh_proxy, bounds);
+    sc.moved.push_back(e);
+  }
+}
+
+void destroy_entities_with_mesh(scene& sc, const vertex_data* vd)
+{
+  for (u32 i = 0; i < sc.entities.size(); i++)
+  {
+    entity* e = sc.entities[i];
+    if (e->parent != nullptr && e->parent->vd == vd)
+      e->parent = nullptr;
+  }
+  for (u32 i = 0; i < sc.moved.size();)
+  {
+    if (sc.moved[i]->vd == vd)
+    {
+      sc.moved[i] = sc.moved.back();
+      sc.moved.pop_back();
+      continue;
+    }
+    i++;
+  }
+
+  u32 destroyed = 0;
+  for (u32 i = 0; i < sc.entities.size();)
+  {
+    entity* e = sc.entities[i];
+    if (e->vd != vd)
+    {
+      i++;
+      continue;
+    }
+    my_assert(e->batch == nullptr);
+    e->vd = nullptr;
+    update_entity_bounds(sc, e);
+    sc.entity_pool.destroy(e);
+    sc.entities[i] = sc.entities.back();
+    sc.entities.pop_back();
+    destroyed++;
+  }
+  if (destroyed > 0)
+    sc.tree.rebuild();
+}
+
+// Function to set up default scene.
+// Redo in terms of components and entities.
+
+void setup_scene(scene& sc, const vertex_data* cube)
+{
+  sc.light_dir = glm::normalize(glm::vec3{ 1.0f, 0.5f, 0.75f });
+  sc.cam.tr.t = { 0.0f, 0.0f, 24.0f };
+  const f32 r = 8.0f;
+  const f32 s = 1.0f;
+  for (f32 x = -r; x <= r; x += s)
+  {
+    for (f32 y = -r; y <= r; y += s)
+    {
+      for (f32 z = -r; z <= r; z += s)
+      {
+        if (sc.entity_pool.size() == sc.entity_pool.capacity())
+        {
+          return;
+        }
+        sc.entities.push_back(sc.entity_pool.construct());
+        entity* e = sc.entities.back();
+        e->vd = cube;
+        e->tr.t.x = x;
+        e->tr.t.y = y;
+        e->tr.t.z = z;
+        e->tr.s.x = 0.5f;
+        e->tr.s.y = 0.5f;
+        e->tr.s.z = 0.5f;
+        e->color.x = (x + r) / (r * 2.0f);
+        e->color.y = (y + r) / (r * 2.0f);
+        e->color.z = (z + r) / (r * 2.0f);
+        e->is_static = true;
+        update_entity_bounds(sc, e);
+      }
+    }
+  }
+  sc.tree.rebuild();
+}
+
+void spawn_random(scene& sc, i32 count, f32 radius, const vertex_data* vd)
+{
+  u32 seed = 0x12345678u + sc.entities.size();
+  const auto random = [&seed]()
+  {
+    seed = util::xorshift_32(seed);
+    return (f32)(seed & 0xFFFFFF) / (f32)0xFFFFFF;
+  };
+  for (i32 i = 0; i < count; i++)
+  {
+    if (sc.entity_pool.size() == sc.entity_pool.capacity())
+      break;
+    sc.entities.push_back(sc.entity_pool.construct());
+    entity* e = sc.entities.back();
+    e->vd = vd;
+    e->tr.t = radius * (2.0f * glm::vec3{ random(), random(), random() } - 1.0f);
+    e->tr.s = glm::vec3{ 0.5f };
+    e->color = { random(), random(), random() };
+    update_entity_bounds(sc, e);
+  }
+  sc.tree.rebuild();
+}
+
+void cull_scene(const scene& sc, frustum const& f, i32 mode, bool temporal_coherence, camera_motion const& motion,
+                vector<void*>& visible, cull_stats& stats)
+{
+  stats = {};
+  if (mode == CULL_MODE_BVH)
+  {
+    sc.tree.query(f, visible, &stats.bvh_stats);
+    return;
+  }
+
+  for (u32 i = 0; i < sc.entities.size(); i++)
+  {
+    entity* e = sc.entities[i];
+    if (e->vd == nullptr || e->batch != nullptr)
+      continue;
+    if (temporal_coherence && still_inside_frustum(motion, e->coherence))
+    {
+      stats.coherent_skips++;
+      visible.push_back(e);
+      continue;
+    }
+    const aabb bounds = transform_aabb(e->vd->aabb_center, e->vd->aabb_extent, entity_local_to_world(*e));
+    if (aabb_view_frustum_intersection(f, sc.cam.tr.t, bounds, temporal_coherence, motion, e->coherence, stats) == false)
+      continue;
+    visible.push_back(e);
+  }
+}
+
+void flythrough_camera(f64 time, glm::vec3& position, f32& angle)
+{
+  const f32 phi = (f32)time * 0.25f;
+  const f32 radius = 24.0f + 8.0f * sin(phi * 3.0f);
+  position = { radius * sin(phi), 4.0f * sin(phi * 2.0f), radius * cos(phi) };
+  angle = -phi;
+}
+
+void entity_lod_sphere(const scene& sc, const entity& e, glm::vec3& center, f32& radius)
+{
+  const aabb& box = sc.tree.fat_aabb(e.bvh_proxy);
+  center = 0.5f * (box.max + box.min);
+  radius = glm::max(0.5f * glm::length(box.max - box.min) - sc.tree.margin, 0.0f);
+}
+
+void select_lods(const scene& sc, const vector<void*>& visible, f32 hysteresis, lod_selection& out)
+{
+  const u32 count = visible.size();
+  out.x.resize(count, 0.0f);
+  out.y.resize(count, 0.0f);
+  out.z.resize(count, 0.0f);
+  out.radius.resize(count, 0.0f);
+  out.sizes.resize(count, 0.0f);
+  for (u32 i = 0; i < count; i++)
+  {
+    glm::vec3 center;
+    entity_lod_sphere(sc, *static_cast<const entity*>(visible[i]), center, out.radius[i]);
+    out.x[i] = center.x;
+    out.y[i] = center.y;
+    out.z[i] = center.z;
+  }
+  lod::compute_screen_sizes(out.x.data(), out.y.data(), out.z.data(), out.radius.data(), count, sc.cam.tr.t,
+                            sc.cam.fov_degrees, out.sizes.data());
+
+  for (u32 i = 0; i < MAX_LODS; i++)
+    out.counts[i] = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    entity* e = static_cast<entity*>(visible[i]);
+    e->lod = lod::select(out.sizes[i], e->lod, e->vd->lod_min_screen_sizes, e->vd->lod_count, hysteresis);
+    out.counts[e->lod]++;
+  }
+}
+
+void cull_entity_meshlets(const scene& sc, const entity& e, frustum const& f, bool backface_culling,
+                          vector<index_range>& out, meshlet_cull_stats& stats)
+{
+  const vertex_data& vd = *e.vd;
+  cull_meshlets(meshlets_of(vd) + vd.lod_first_meshlet[e.lod], vd.lod_meshlet_count[e.lod], f, sc.cam.tr.t,
+                entity_local_to_world(e), backface_culling, out, stats);
+}
@@ -0,0 +1,228 @@
+#pragma once
+#include "affine.hpp"
+#include "bvh.hpp"
+#include "culling.hpp"
+#include "mesh.hpp"
+#include "my_glm.hpp"
+#include "object_pool.hpp"
+#include "static_string.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Scene: entities, their transforms, camera and frustum culling.
+// Nothing here depends on a window or a graphics API, the headless runner uses it as is.
+
+// This is transform component.
+
+struct transform
+{
+  glm::vec3 t = { 0.0f, 0.0f, 0.0f };
+  glm::quat r = { 0.0f, 0.0f, 0.0f, 1.0f };
+  glm::vec3 s = { 1.0f, 1.0f, 1.0f };
+
+  glm::mat4x4 local_to_world() const
+  {
+    glm::mat4x4 m;
+    m[0] = s.x * 2.0f * glm::vec4{ r.x * r.x + r.w * r.w - 0.5f, r.x * r.y + r.z * r.w, r.x * r.z - r.y * r.w, 0.0f };
+    m[1] = s.y * 2.0f * glm::vec4{ r.y * r.x - r.z * r.w, r.y * r.y + r.w * r.w - 0.5f, r.y * r.z + r.x * r.w, 0.0f };
+    m[2] = s.z * 2.0f * glm::vec4{ r.z * r.x + r.y * r.w, r.z * r.y - r.x * r.w, r.z * r.z + r.w * r.w - 0.5f, 0.0f };
+    m[3] = { t.x, t.y, t.z, 1.0f };
+    return m;
+  }
+
+  affine local_to_world_affine() const
+  {
+    return affine_from_trs(t, r, s);
+  }
+
+  glm::mat4x4 world_to_local_transposed() const
+  {
+    // omit translation because this matrix is used to transform vectors
+    glm::mat4x4 m;
+    m[0] = (2.0f / s.x) * glm::vec4{ r.x * r.x + r.w * r.w - 0.5f, r.x * r.y + r.z * r.w, r.x * r.z - r.y * r.w, 0.0f };
+    m[1] = (2.0f / s.y) * glm::vec4{ r.y * r.x - r.z * r.w, r.y * r.y + r.w * r.w - 0.5f, r.y * r.z + r.x * r.w, 0.0f };
+    m[2] = (2.0f / s.z) * glm::vec4{ r.z * r.x + r.y * r.w, r.z * r.y - r.x * r.w, r.z * r.z + r.w * r.w - 0.5f, 0.0f };
+    m[3] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return m;
+  }
+};
+
+// This is camera component.
+
+struct camera
+{
+  transform tr = {};
+  float fov_degrees = 45.0f;
+  float z_near = 0.1f;
+  float z_far = 80.0f;
+  float aspect = 1.0f;
+
+  glm::mat4x4 world_to_view() const
+  {
+    const glm::vec3& t = tr.t;
+    const glm::quat& r = tr.r;
+    glm::mat4x4 m;
+    m[0] = 2.0f * glm::vec4{ r.x * r.x + r.w * r.w - 0.5f, r.x * r.y - r.z * r.w, r.x * r.z + r.y * r.w, 0.0f };
+    m[1] = 2.0f * glm::vec4{ r.y * r.x + r.z * r.w, r.y * r.y + r.w * r.w - 0.5f, r.y * r.z - r.x * r.w, 0.0f };
+    m[2] = 2.0f * glm::vec4{ r.z * r.x - r.y * r.w, r.z * r.y + r.x * r.w, r.z * r.z + r.w * r.w - 0.5f, 0.0f };
+    m[3] = {
+      -(m[0][0] * t.x + m[1][0] * t.y + m[2][0] * t.z),
+      -(m[0][1] * t.x + m[1][1] * t.y + m[2][1] * t.z),
+      -(m[0][2] * t.x + m[1][2] * t.y + m[2][2] * t.z),
+      1.0f };
+    return m;
+  }
+
+  glm::mat4x4 view_to_screen() const
+  {
+    const f32 h = 1.0f / tan(glm::radians(fov_degrees) * 0.5f);
+    const f32 f = z_far / (z_near - z_far);
+    glm::mat4x4 p = {};
+    p[0][0] = h / aspect;
+    p[1][1] = h;
+    p[2][2] = f;
+    p[2][3] = -1.0f;
+    p[3][2] = z_near * f;
+    return p;
+  }
+
+  glm::mat4x4 world_to_screen() const
+  {
+    return view_to_screen() * world_to_view();
+  }
+};
+
+// Render system uses this for frustum culling.
+// Camera moves little between frames, so the plane which rejected an entity
+// last frame is likely to reject it again, and an entity which was inside the
+// frustum with some margin stays inside until the camera moves by that margin.
+
+struct cull_coherence
+{
+  u32 epoch = 0;
+  u8 last_plane = 0;
+  // Minimum distance from the box to frustum planes when it was last found inside.
+  f32 inside_margin = 0.0f;
+  // Distance from the camera to the farthest point of the box at that time.
+  f32 max_distance = 0.0f;
+  f64 translation_stamp = 0.0;
+  f64 rotation_stamp = 0.0;
+};
+
+// Camera motion accumulated since startup.
+// Epoch changes when projection changes, which invalidates all margins.
+struct camera_motion
+{
+  camera last = {};
+  u32 epoch = 1;
+  f64 translation = 0.0;
+  f64 rotation = 0.0;
+};
+
+void track_camera_motion(camera_motion& m, const camera& cam);
+
+// Entity. Hello there. Root object has a pool of these.
+
+struct entity
+{
+  static_string<32> name = {};
+  transform tr = {};
+  const vertex_data* vd = nullptr;
+  glm::vec3 color = { 0.5f, 0.8f, 0.5f };
+  entity* parent = nullptr;
+  u32 bvh_proxy = bvh::NULL_NODE;
+  cull_coherence coherence = {};
+  u32 lod = 0;
+  // Transform never changes after creation, entity can be baked into a static batch.
+  bool is_static = false;
+  // Static batch which draws this entity instead of it, set while baked.
+  entity* batch = nullptr;
+};
+
+glm::mat4x4 entity_local_to_world(const entity& e);
+
+// This is a root object.
+
+struct scene
+{
+  glm::vec3 light_dir = glm::normalize(glm::vec3{ 1.0f, 1.0f, 1.0f });
+  glm::vec3 light_color = glm::vec3{ 1.0f, 1.0f, 1.0f };
+  glm::vec3 ambient_color = glm::vec3{ 0.05f, 0.05f, 0.05f };
+  camera cam = {};
+  vector<entity*> entities;
+  // Entities which draw baked static entities, also listed in entities.
+  vector<entity*> static_batches;
+  object_pool<entity> entity_pool = { 1024 * 1024 };
+  // Bumped when an entity enters or leaves the spatial index.
+  u64 structure_epoch = 0;
+  // Entities moved since the last frame was rendered.
+  vector<entity*> moved;
+  // Spatial index over world bounds of entities with vertex data.
+  bvh tree;
+};
+
+// Call after entity is created or moved to keep it in the spatial index.
+// Children are not updated, call it for them as well.
+// Baked static entities are culled through their batch and stay out of the index.
+void update_entity_bounds(scene& sc, entity* e);
+
+// Destroys entities drawn with the mesh, e.g. before it is unloaded. Children of them lose their parent.
+// Unbake static batches first, they don't know which of their entities are gone.
+void destroy_entities_with_mesh(scene& sc, const vertex_data* vd);
+
+// Default scene, a grid of static cubes.
+void setup_scene(scene& sc, const vertex_data* cube);
+// Fills the scene with randomly placed copies of the mesh.
+void spawn_random(scene& sc, i32 count, f32 radius, const vertex_data* vd);
+
+static constexpr i32 CULL_MODE_FLAT = 0;
+static constexpr i32 CULL_MODE_BVH = 1;
+
+struct cull_stats
+{
+  u32 plane_tests = 0;
+  u32 coherent_skips = 0;
+  bvh::query_stats bvh_stats = {};
+};
+
+// Appends entities which intersect the frustum to visible.
+// Flat mode tests bounds of every entity, with temporal coherence it starts from the plane which
+// rejected the entity last time and skips entities which are still inside by their recorded margin.
+void cull_scene(const scene& sc, frustum const& f, i32 mode, bool temporal_coherence, camera_motion const& motion,
+                vector<void*>& visible, cull_stats& stats);
+
+// Fly-through path around the default scene: camera position and its angle around the vertical axis
+// at the given time, in seconds.
+void flythrough_camera(f64 time, glm::vec3& position, f32& angle);
+
+// Level of detail selection for visible entities.
+// Bounding spheres are gathered into separate arrays so projected sizes are computed four at a time.
+struct lod_selection
+{
+  vector<f32> x;
+  vector<f32> y;
+  vector<f32> z;
+  vector<f32> radius;
+  vector<f32> sizes;
+  // Visible entities at each level.
+  u32 counts[MAX_LODS] = {};
+};
+
+// Sphere levels are selected by, from bounds of the entity in the spatial index.
+void entity_lod_sphere(const scene& sc, const entity& e, glm::vec3& center, f32& radius);
+
+// Picks levels of visible entities, see lod::select. Arrays of the selection are reused between calls.
+void select_lods(const scene& sc, const vector<void*>& visible, f32 hysteresis, lod_selection& out);
+
+// Levels with at least this many meshlets are drawn as ranges of the meshlets which pass
+// frustum and normal cone tests, smaller ones are drawn whole.
+static constexpr u32 DEFAULT_CLUSTER_MIN_MESHLETS = 8;
+
+inline bool uses_cluster_culling(const entity& e, u32 min_meshlets)
+{
+  return e.vd->lod_meshlet_count[e.lod] >= min_meshlets;
+}
+
+// Appends index ranges of meshlets of the current level of the entity which pass culling, see cull_meshlets.
+void cull_entity_meshlets(const scene& sc, const entity& e, frustum const& f, bool backface_culling,
+                          vector<index_range>& out, meshlet_cull_stats& stats);
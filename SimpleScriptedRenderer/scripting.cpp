@@ -0,0 +1,136 @@
+#include "scripting.hpp"
+
+namespace
+{
+script_bindings& bindings(lua_State* lua)
+{
+  return *static_cast<script_bindings*>(lua_touserdata(lua, lua_upvalueindex(1)));
+}
+
+// Exported function to manipulate scene. Make more of these to extend console capabilities.
+
+int luaexport_set_light_dir(lua_State* lua)
+{
+  glm::vec3 dir;
+  dir[0] = (f32)luaL_checknumber(lua, 1);
+  dir[1] = (f32)luaL_checknumber(lua, 2);
+  dir[2] = (f32)luaL_checknumber(lua, 3);
+  if (dir[0] == 0.0f && dir[1] == 0.0f && dir[2] == 0.0f)
+  {
+    lua_pushstring(lua, "nonzero vector expected");
+    return lua_error(lua);
+  }
+  bindings(lua).sc->light_dir = glm::normalize(dir);
+  return 0;
+}
+
+// Exported function to fill the scene with randomly placed cubes.
+// Used to profile culling on large scenes.
+int luaexport_spawn_cubes(lua_State* lua)
+{
+  const i32 count = (i32)luaL_checkinteger(lua, 1);
+  const f32 radius = (f32)luaL_optnumber(lua, 2, 1000.0);
+  script_bindings& b = bindings(lua);
+  spawn_random(*b.sc, count, radius, &(*b.meshes)[MESH_CUBE]);
+  return 0;
+}
+
+// Exported function to fill the scene with randomly placed spheres.
+// Used to profile level of detail selection.
+int luaexport_spawn_spheres(lua_State* lua)
+{
+  const i32 count = (i32)luaL_checkinteger(lua, 1);
+  const f32 radius = (f32)luaL_optnumber(lua, 2, 1000.0);
+  script_bindings& b = bindings(lua);
+  spawn_random(*b.sc, count, radius, &(*b.meshes)[MESH_SPHERE]);
+  return 0;
+}
+
+// Exported function to load a mesh file, returns its mesh id.
+int luaexport_load_mesh(lua_State* lua)
+{
+  const char* path = luaL_checkstring(lua, 1);
+  script_bindings& b = bindings(lua);
+  const i32 id = b.load_mesh(b.host, path);
+  if (id < 0)
+  {
+    lua_pushfstring(lua, "can't load mesh '%s'", path);
+    return lua_error(lua);
+  }
+  lua_pushinteger(lua, id);
+  return 1;
+}
+
+// Exported function to release a mesh returned by load_mesh.
+int luaexport_release_mesh(lua_State* lua)
+{
+  const i64 id = (i64)luaL_checkinteger(lua, 1);
+  script_bindings& b = bindings(lua);
+  if (id < 0 || id >= (i64)b.meshes->size() || b.release_mesh(b.host, (u32)id) == false)
+  {
+    lua_pushstring(lua, "invalid mesh id");
+    return lua_error(lua);
+  }
+  return 0;
+}
+
+// Exported function to fill the scene with randomly placed copies of a mesh.
+int luaexport_spawn_meshes(lua_State* lua)
+{
+  const i64 id = (i64)luaL_checkinteger(lua, 1);
+  const i32 count = (i32)luaL_checkinteger(lua, 2);
+  const f32 radius = (f32)luaL_optnumber(lua, 3, 1000.0);
+  script_bindings& b = bindings(lua);
+  if (id < 0 || id >= (i64)b.meshes->size() || (*b.meshes)[(u32)id].vertex_count == 0)
+  {
+    lua_pushstring(lua, "invalid mesh id");
+    return lua_error(lua);
+  }
+  spawn_random(*b.sc, count, radius, &(*b.meshes)[(u32)id]);
+  return 0;
+}
+
+void register_function(lua_State* lua, const char* name, lua_CFunction fn, script_bindings* b)
+{
+  lua_pushlightuserdata(lua, b);
+  lua_pushcclosure(lua, fn, 1);
+  lua_setfield(lua, -2, name);
+}
+} // namespace
+
+// Scripting state. Table per entity? Not sure...
+// Engine table for engine API to be used in scripting components.
+// Scripting component = object + functions + reference to owner entity.
+
+void setup_lua(lua_State** pLua, script_bindings* bindings, lua_CFunction print)
+{
+  *pLua = luaL_newstate();
+  lua_State* lua = *pLua;
+  luaL_openlibs(lua);
+  lua_pushglobaltable(lua);
+  lua_pushcfunction(lua, print);
+  lua_setfield(lua, -2, "print");
+  register_function(lua, "set_light_dir", luaexport_set_light_dir, bindings);
+  register_function(lua, "spawn_cubes", luaexport_spawn_cubes, bindings);
+  register_function(lua, "spawn_spheres", luaexport_spawn_spheres, bindings);
+  register_function(lua, "load_mesh", luaexport_load_mesh, bindings);
+  register_function(lua, "release_mesh", luaexport_release_mesh, bindings);
+  register_function(lua, "spawn_meshes", luaexport_spawn_meshes, bindings);
+  lua_pop(lua, 1);
+}
+
+void call_script_hook(lua_State* lua, const char* name, f64 delta_time)
+{
+  if (lua_getglobal(lua, name) != LUA_TFUNCTION)
+  {
+    lua_pop(lua, 1);
+    return;
+  }
+  lua_pushnumber(lua, delta_time);
+  if (lua_pcall(lua, 1, 0, 0) != LUA_OK)
+  {
+    lua_getglobal(lua, "print");
+    lua_insert(lua, -2);
+    lua_pcall(lua, 1, 0, 0);
+  }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "lua.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+// Lua state with engine functions, used by the application and the headless runner.
+// Exported functions reach engine objects through an upvalue.
+
+struct script_bindings
+{
+  scene* sc;
+  // Indexed by mesh id, built-in meshes first. Storage is reserved by the host, entities point into it.
+  const vector<vertex_data>* meshes;
+  // Loads a cooked mesh or an OBJ file, see open_cooked_mesh. Returns the mesh id, -1 on failure.
+  // Loading content which is already loaded returns the same id with one more reference, see mesh_registry.hpp.
+  i32 (*load_mesh)(void* host, const char* path);
+  // Drops a reference taken by load_mesh, the last one destroys the mesh and entities drawn with it.
+  // Returns false for ids which load_mesh didn't return.
+  bool (*release_mesh)(void* host, u32 id);
+  void* host;
+};
+
+// Load necessary libraries and register engine functions.
+// Print is provided by the host, which knows where text goes.
+void setup_lua(lua_State** pLua, script_bindings* bindings, lua_CFunction print);
+
+// Calls global function name(delta_time) when scripts define one. Errors are printed.
+void call_script_hook(lua_State* lua, const char* name, f64 delta_time);
@@ -1,5 +1,9 @@
 #pragma once
 #include "types.hpp"
 using BYTE = u8;
+// Compiled from the .hlsl files by FxCompile of the project before C++ sources, not in git.
 #include "vs_bytecode.h"
-#include "ps_bytecode.h"
\ No newline at end of file
+#include "ps_bytecode.h"
+#include "vs_instanced_bytecode.h"
+#include "vs_quantized_bytecode.h"
+#include "vs_instanced_quantized_bytecode.h"
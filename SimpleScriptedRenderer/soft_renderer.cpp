@@ -0,0 +1,403 @@
+#include <math.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include "jobs.hpp"
+#include "my_assert.hpp"
+#include "soft_renderer.hpp"
+
+#pragma warning(push)
+#pragma warning(disable : 4996)
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#pragma warning(pop)
+
+namespace
+{
+// Clip space vertex: position, world normal, color.
+constexpr u32 CLIP_X = 0;
+constexpr u32 CLIP_Y = 1;
+constexpr u32 CLIP_Z = 2;
+constexpr u32 CLIP_W = 3;
+constexpr u32 CLIP_NORMAL = 4;
+constexpr u32 CLIP_COLOR = 7;
+constexpr u32 CLIP_SIZE = 10;
+
+glm::vec3 unpack_color(u32 c)
+{
+  return glm::vec3{ (f32)(c & 0xFF), (f32)((c >> 8) & 0xFF), (f32)((c >> 16) & 0xFF) } / 255.0f;
+}
+
+// Same as transform_normal() in vs.hlsl.
+glm::mat3x3 normal_matrix(affine const& m)
+{
+  const glm::vec3 a{ m.rows[0].x, m.rows[1].x, m.rows[2].x };
+  const glm::vec3 b{ m.rows[0].y, m.rows[1].y, m.rows[2].y };
+  const glm::vec3 c{ m.rows[0].z, m.rows[1].z, m.rows[2].z };
+  const glm::vec3 bc = glm::cross(b, c);
+  const f32 sign = glm::dot(a, bc) < 0.0f ? -1.0f : 1.0f;
+  return glm::mat3x3{ bc * sign, glm::cross(c, a) * sign, glm::cross(a, b) * sign };
+}
+
+__m128 plane(f32 const* pa, f32 const* pb, f32 const* pc, u32 attr, __m128 px, f32 py)
+{
+  return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pa[attr]), px), _mm_set1_ps(pb[attr] * py + pc[attr]));
+}
+} // namespace
+
+soft_renderer::~soft_renderer()
+{
+  _mm_free(m_color);
+  _mm_free(m_depth);
+}
+
+void soft_renderer::resize(u32 width, u32 height)
+{
+  if (width == m_width && height == m_height)
+    return;
+
+  _mm_free(m_color);
+  _mm_free(m_depth);
+  m_width = width;
+  m_height = height;
+  m_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+  const u32 pixels = m_tiles_x * m_tiles_y * TILE_SIZE * TILE_SIZE;
+  m_color = static_cast<u32*>(_mm_malloc(sizeof(u32) * pixels, 16));
+  m_depth = static_cast<f32*>(_mm_malloc(sizeof(f32) * pixels, 16));
+  m_bins.resize(m_tiles_x * m_tiles_y, {});
+}
+
+void soft_renderer::render(frame_constants const& constants, draw const* draws, u32 draw_count)
+{
+  my_assert(m_color != nullptr);
+  m_constants = constants;
+  m_draws = draws;
+
+  m_draw_first_triangles.clear();
+  u32 total = 0;
+  for (u32 i = 0; i < draw_count; i++)
+  {
+    m_draw_first_triangles.push_back(total);
+    total += draws[i].index_count / 3;
+  }
+  m_draw_first_triangles.push_back(total);
+
+  // Chunks keep their arrays across frames.
+  const u32 chunk_count = (total + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES;
+  if (m_chunks.size() < chunk_count)
+    m_chunks.resize(chunk_count, {});
+  if (parallel)
+  {
+    jobs::parallel_for(chunk_count, 1, [this](u32 begin, u32 end, u32)
+    {
+      for (u32 i = begin; i < end; i++)
+        setup_chunk(i);
+    });
+  }
+  else
+  {
+    for (u32 i = 0; i < chunk_count; i++)
+      setup_chunk(i);
+  }
+
+  // Gathered in chunk order, so triangles of a tile are drawn in submission order.
+  for (u32 i = 0; i < m_bins.size(); i++)
+    m_bins[i].clear();
+  m_triangle_count = 0;
+  for (u32 i = 0; i < chunk_count; i++)
+  {
+    const chunk& c = m_chunks[i];
+    const u32 base = i * 2 * CHUNK_TRIANGLES;
+    for (u32 j = 0; j < c.bins.size(); j += 2)
+      m_bins[c.bins[j]].push_back(base + c.bins[j + 1]);
+    m_triangle_count += c.triangles.size();
+  }
+
+  if (parallel)
+  {
+    jobs::parallel_for(m_tiles_x * m_tiles_y, 1, [this](u32 begin, u32 end, u32)
+    {
+      for (u32 tile = begin; tile < end; tile++)
+        rasterize_tile(tile);
+    });
+  }
+  else
+  {
+    for (u32 tile = 0; tile < m_tiles_x * m_tiles_y; tile++)
+      rasterize_tile(tile);
+  }
+}
+
+void soft_renderer::setup_chunk(u32 chunk_idx)
+{
+  chunk& c = m_chunks[chunk_idx];
+  c.triangles.clear();
+  c.bins.clear();
+
+  const u32 first = chunk_idx * CHUNK_TRIANGLES;
+  const u32 total = m_draw_first_triangles.back();
+  const u32 last = first + CHUNK_TRIANGLES < total ? first + CHUNK_TRIANGLES : total;
+
+  // Last draw which starts at or before the first triangle.
+  u32 lo = 0;
+  u32 hi = m_draw_first_triangles.size() - 1;
+  while (hi - lo > 1)
+  {
+    const u32 mid = (lo + hi) / 2;
+    if (m_draw_first_triangles[mid] <= first)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  u32 draw_idx = (u32)-1;
+  glm::mat3x3 normals;
+  glm::vec3 object_color;
+  for (u32 t = first; t < last; t++)
+  {
+    while (t >= m_draw_first_triangles[lo + 1])
+      lo++;
+    if (draw_idx != lo)
+    {
+      draw_idx = lo;
+      normals = normal_matrix(m_draws[draw_idx].local_to_world);
+      object_color = unpack_color(m_draws[draw_idx].object_color);
+    }
+    const draw& d = m_draws[draw_idx];
+    const u32 local = t - m_draw_first_triangles[draw_idx];
+
+    f32 in[3][CLIP_SIZE];
+    for (u32 v = 0; v < 3; v++)
+    {
+      const vertex& src = d.vertices[d.indices[local * 3 + v]];
+      const glm::vec3 world = affine_transform_point(d.local_to_world, src.position);
+      const glm::vec4 p = m_constants.world_to_screen * glm::vec4{ world, 1.0f };
+      const glm::vec3 n = glm::normalize(normals * src.normal);
+      const glm::vec3 color = object_color * unpack_color(src.color);
+      in[v][CLIP_X] = p.x;
+      in[v][CLIP_Y] = p.y;
+      in[v][CLIP_Z] = p.z;
+      in[v][CLIP_W] = p.w;
+      for (u32 k = 0; k < 3; k++)
+      {
+        in[v][CLIP_NORMAL + k] = n[k];
+        in[v][CLIP_COLOR + k] = color[k];
+      }
+    }
+
+    // Sutherland-Hodgman against the near plane z >= 0, gives a polygon of at most 4 vertices.
+    f32 out[4][CLIP_SIZE];
+    u32 out_count = 0;
+    for (u32 v = 0; v < 3; v++)
+    {
+      const f32* p0 = in[v];
+      const f32* p1 = in[(v + 1) % 3];
+      const f32 d0 = p0[CLIP_Z];
+      const f32 d1 = p1[CLIP_Z];
+      if (d0 >= 0.0f)
+      {
+        for (u32 k = 0; k < CLIP_SIZE; k++)
+          out[out_count][k] = p0[k];
+        out_count++;
+      }
+      if ((d0 >= 0.0f) != (d1 >= 0.0f))
+      {
+        const f32 s = d0 / (d0 - d1);
+        for (u32 k = 0; k < CLIP_SIZE; k++)
+          out[out_count][k] = p0[k] + (p1[k] - p0[k]) * s;
+        out_count++;
+      }
+    }
+    for (u32 v = 2; v < out_count; v++)
+    {
+      f32 tri[3 * CLIP_SIZE];
+      for (u32 k = 0; k < CLIP_SIZE; k++)
+      {
+        tri[k] = out[0][k];
+        tri[CLIP_SIZE + k] = out[v - 1][k];
+        tri[2 * CLIP_SIZE + k] = out[v][k];
+      }
+      setup_triangle(c, tri);
+    }
+  }
+}
+
+void soft_renderer::setup_triangle(chunk& c, f32 const* clip_vertices)
+{
+  f32 x[3];
+  f32 y[3];
+  f32 values[ATTR_COUNT][3];
+  for (u32 v = 0; v < 3; v++)
+  {
+    const f32* p = clip_vertices + v * CLIP_SIZE;
+    // Only reachable through a degenerate transform, z >= 0 implies w > 0 for perspective projections.
+    if (p[CLIP_W] <= 0.0f)
+      return;
+    const f32 inv_w = 1.0f / p[CLIP_W];
+    x[v] = (p[CLIP_X] * inv_w * 0.5f + 0.5f) * (f32)m_width;
+    y[v] = (0.5f - p[CLIP_Y] * inv_w * 0.5f) * (f32)m_height;
+    values[ATTR_DEPTH][v] = p[CLIP_Z] * inv_w;
+    values[ATTR_INV_W][v] = inv_w;
+    for (u32 k = 0; k < 3; k++)
+    {
+      values[ATTR_NORMAL_X + k][v] = p[CLIP_NORMAL + k] * inv_w;
+      values[ATTR_COLOR_R + k][v] = p[CLIP_COLOR + k] * inv_w;
+    }
+  }
+
+  // Clockwise on screen is positive, counter-clockwise triangles are back faces.
+  const f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (area < 1e-6f)
+    return;
+
+  screen_triangle tri;
+  tri.min_x = (i32)floorf(glm::min(x[0], glm::min(x[1], x[2])));
+  tri.min_y = (i32)floorf(glm::min(y[0], glm::min(y[1], y[2])));
+  tri.max_x = (i32)floorf(glm::max(x[0], glm::max(x[1], x[2])));
+  tri.max_y = (i32)floorf(glm::max(y[0], glm::max(y[1], y[2])));
+  tri.min_x = tri.min_x < 0 ? 0 : tri.min_x;
+  tri.min_y = tri.min_y < 0 ? 0 : tri.min_y;
+  tri.max_x = tri.max_x > (i32)m_width - 1 ? (i32)m_width - 1 : tri.max_x;
+  tri.max_y = tri.max_y > (i32)m_height - 1 ? (i32)m_height - 1 : tri.max_y;
+  if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+    return;
+
+  for (u32 e = 0; e < 3; e++)
+  {
+    const u32 i0 = e;
+    const u32 i1 = (e + 1) % 3;
+    tri.a[e] = -(y[i1] - y[i0]);
+    tri.b[e] = x[i1] - x[i0];
+    tri.c[e] = (y[i1] - y[i0]) * x[i0] - (x[i1] - x[i0]) * y[i0];
+  }
+  const f32 inv_area = 1.0f / area;
+  for (u32 i = 0; i < ATTR_COUNT; i++)
+  {
+    const f32* v = values[i];
+    tri.pa[i] = ((v[1] - v[0]) * (y[2] - y[0]) - (v[2] - v[0]) * (y[1] - y[0])) * inv_area;
+    tri.pb[i] = ((v[2] - v[0]) * (x[1] - x[0]) - (v[1] - v[0]) * (x[2] - x[0])) * inv_area;
+    tri.pc[i] = v[0] - tri.pa[i] * x[0] - tri.pb[i] * y[0];
+  }
+
+  const u32 local = c.triangles.size();
+  my_assert(local < 2 * CHUNK_TRIANGLES);
+  c.triangles.push_back(tri);
+  for (u32 ty = (u32)tri.min_y / TILE_SIZE; ty <= (u32)tri.max_y / TILE_SIZE; ty++)
+  {
+    for (u32 tx = (u32)tri.min_x / TILE_SIZE; tx <= (u32)tri.max_x / TILE_SIZE; tx++)
+    {
+      c.bins.push_back(ty * m_tiles_x + tx);
+      c.bins.push_back(local);
+    }
+  }
+}
+
+void soft_renderer::rasterize_tile(u32 tile)
+{
+  const u32 stride = m_tiles_x * TILE_SIZE;
+  const i32 tile_x0 = (i32)((tile % m_tiles_x) * TILE_SIZE);
+  const i32 tile_y0 = (i32)((tile / m_tiles_x) * TILE_SIZE);
+  const i32 tile_x1 = tile_x0 + (i32)TILE_SIZE - 1;
+  const i32 tile_y1 = tile_y0 + (i32)TILE_SIZE - 1;
+
+  // Same as the clear color of the GPU path.
+  const __m128 far_depth = _mm_set1_ps(1.0f);
+  const __m128i black = _mm_set1_epi32((i32)0xFF000000);
+  for (i32 y = tile_y0; y <= tile_y1; y++)
+  {
+    for (i32 x = tile_x0; x <= tile_x1; x += 4)
+    {
+      _mm_store_ps(m_depth + y * stride + x, far_depth);
+      _mm_store_si128(reinterpret_cast<__m128i*>(m_color + y * stride + x), black);
+    }
+  }
+
+  const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 tiny = _mm_set1_ps(1e-20f);
+  const __m128 to_unorm = _mm_set1_ps(255.0f);
+  const __m128 round = _mm_set1_ps(0.5f);
+  const __m128 light_x = _mm_set1_ps(m_constants.light_dir.x);
+  const __m128 light_y = _mm_set1_ps(m_constants.light_dir.y);
+  const __m128 light_z = _mm_set1_ps(m_constants.light_dir.z);
+  __m128 light_color[3];
+  __m128 ambient[3];
+  for (u32 k = 0; k < 3; k++)
+  {
+    light_color[k] = _mm_set1_ps(m_constants.light_color[k]);
+    ambient[k] = _mm_set1_ps(m_constants.ambient_color[k]);
+  }
+
+  const vector<u32>& bin = m_bins[tile];
+  for (u32 i = 0; i < bin.size(); i++)
+  {
+    const u32 id = bin[i];
+    const screen_triangle& tri = m_chunks[id / (2 * CHUNK_TRIANGLES)].triangles[id % (2 * CHUNK_TRIANGLES)];
+    const i32 x0 = (tri.min_x > tile_x0 ? tri.min_x : tile_x0) & ~3;
+    const i32 x1 = tri.max_x < tile_x1 ? tri.max_x : tile_x1;
+    const i32 y0 = tri.min_y > tile_y0 ? tri.min_y : tile_y0;
+    const i32 y1 = tri.max_y < tile_y1 ? tri.max_y : tile_y1;
+
+    const __m128 a0 = _mm_set1_ps(tri.a[0]);
+    const __m128 a1 = _mm_set1_ps(tri.a[1]);
+    const __m128 a2 = _mm_set1_ps(tri.a[2]);
+    for (i32 y = y0; y <= y1; y++)
+    {
+      const f32 py = (f32)y + 0.5f;
+      const __m128 row0 = _mm_set1_ps(tri.b[0] * py + tri.c[0]);
+      const __m128 row1 = _mm_set1_ps(tri.b[1] * py + tri.c[1]);
+      const __m128 row2 = _mm_set1_ps(tri.b[2] * py + tri.c[2]);
+      f32* depth_row = m_depth + y * stride;
+      u32* color_row = m_color + y * stride;
+      for (i32 x = x0; x <= x1; x += 4)
+      {
+        const __m128 px = _mm_add_ps(_mm_set1_ps((f32)x), lane_offsets);
+        const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+        const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+        const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+        const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                         _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+        if (_mm_movemask_ps(inside) == 0)
+          continue;
+        const __m128 z = plane(tri.pa, tri.pb, tri.pc, ATTR_DEPTH, px, py);
+        const __m128 old_z = _mm_load_ps(depth_row + x);
+        const __m128 write = _mm_and_ps(inside, _mm_cmplt_ps(z, old_z));
+        if (_mm_movemask_ps(write) == 0)
+          continue;
+        _mm_store_ps(depth_row + x, _mm_or_ps(_mm_and_ps(write, z), _mm_andnot_ps(write, old_z)));
+
+        // Pixel shader, attributes are divided by interpolated 1/w.
+        const __m128 w = _mm_div_ps(one, plane(tri.pa, tri.pb, tri.pc, ATTR_INV_W, px, py));
+        const __m128 nx = _mm_mul_ps(plane(tri.pa, tri.pb, tri.pc, ATTR_NORMAL_X, px, py), w);
+        const __m128 ny = _mm_mul_ps(plane(tri.pa, tri.pb, tri.pc, ATTR_NORMAL_Y, px, py), w);
+        const __m128 nz = _mm_mul_ps(plane(tri.pa, tri.pb, tri.pc, ATTR_NORMAL_Z, px, py), w);
+        const __m128 length_sq = _mm_add_ps(_mm_mul_ps(nx, nx), _mm_add_ps(_mm_mul_ps(ny, ny), _mm_mul_ps(nz, nz)));
+        const __m128 n_dot_l = _mm_add_ps(_mm_mul_ps(nx, light_x), _mm_add_ps(_mm_mul_ps(ny, light_y), _mm_mul_ps(nz, light_z)));
+        const __m128 diffuse = _mm_max_ps(_mm_div_ps(n_dot_l, _mm_sqrt_ps(_mm_max_ps(length_sq, tiny))), zero);
+
+        __m128i channels[3];
+        for (u32 k = 0; k < 3; k++)
+        {
+          const __m128 albedo = _mm_mul_ps(plane(tri.pa, tri.pb, tri.pc, ATTR_COLOR_R + k, px, py), w);
+          __m128 c = _mm_add_ps(ambient[k], _mm_mul_ps(_mm_mul_ps(diffuse, light_color[k]), albedo));
+          c = _mm_min_ps(_mm_max_ps(c, zero), one);
+          channels[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, to_unorm), round));
+        }
+        const __m128i packed = _mm_or_si128(_mm_or_si128(channels[0], _mm_slli_epi32(channels[1], 8)),
+                                            _mm_or_si128(_mm_slli_epi32(channels[2], 16), black));
+        const __m128i mask = _mm_castps_si128(write);
+        __m128i* dst = reinterpret_cast<__m128i*>(color_row + x);
+        _mm_store_si128(dst, _mm_or_si128(_mm_and_si128(mask, packed), _mm_andnot_si128(mask, _mm_load_si128(dst))));
+      }
+    }
+  }
+}
+
+bool soft_renderer::write_png(const char* path) const
+{
+  if (m_color == nullptr)
+    return false;
+  return stbi_write_png(path, (int)m_width, (int)m_height, 4, m_color, (int)(m_tiles_x * TILE_SIZE * sizeof(u32))) != 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "affine.hpp"
+#include "my_glm.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+#include "vertex.hpp"
+
+// CPU renderer which reproduces vs.hlsl and ps.hlsl: Lambert lighting of interpolated normals,
+// vertex color times object color, depth test, back faces culled (clockwise triangles are front).
+// Triangles are transformed, clipped against the near plane and binned into screen tiles in
+// parallel chunks, then tiles are rasterized in parallel, four pixels of a row at a time.
+// Attributes are interpolated with plane equations, perspective correct through 1/w.
+class soft_renderer
+{
+public:
+  static constexpr u32 TILE_SIZE = 64;
+  static constexpr u32 CHUNK_TRIANGLES = 4096;
+
+  struct draw
+  {
+    vertex const* vertices;
+    u32 const* indices;
+    u32 index_count;
+    affine local_to_world;
+    // RGBA8.
+    u32 object_color;
+  };
+
+  struct frame_constants
+  {
+    glm::mat4x4 world_to_screen;
+    glm::vec3 light_dir;
+    glm::vec3 light_color;
+    glm::vec3 ambient_color;
+  };
+
+  soft_renderer() = default;
+  ~soft_renderer();
+  soft_renderer(soft_renderer const&) = delete;
+  soft_renderer& operator=(soft_renderer const&) = delete;
+
+  void resize(u32 width, u32 height);
+  // Clears buffers and renders draws, which must stay valid during the call.
+  void render(frame_constants const& constants, draw const* draws, u32 draw_count);
+  bool write_png(const char* path) const;
+
+  u32 width() const
+  {
+    return m_width;
+  }
+
+  u32 height() const
+  {
+    return m_height;
+  }
+
+  // Triangles which survived culling and clipping in the last render.
+  u32 triangle_count() const
+  {
+    return m_triangle_count;
+  }
+
+  // Spreads work over job threads, otherwise runs on the calling thread.
+  bool parallel = true;
+
+private:
+  // Attributes interpolated over a triangle, all but depth are divided by w.
+  enum attribute : u32
+  {
+    ATTR_DEPTH,
+    ATTR_INV_W,
+    ATTR_NORMAL_X,
+    ATTR_NORMAL_Y,
+    ATTR_NORMAL_Z,
+    ATTR_COLOR_R,
+    ATTR_COLOR_G,
+    ATTR_COLOR_B,
+    ATTR_COUNT
+  };
+
+  struct screen_triangle
+  {
+    // Edge functions e(x, y) = a * x + b * y + c, positive inside.
+    f32 a[3];
+    f32 b[3];
+    f32 c[3];
+    // Attribute planes v(x, y) = pa * x + pb * y + pc.
+    f32 pa[ATTR_COUNT];
+    f32 pb[ATTR_COUNT];
+    f32 pc[ATTR_COUNT];
+    i32 min_x;
+    i32 min_y;
+    i32 max_x;
+    i32 max_y;
+  };
+
+  // Clipping of one triangle gives at most two, so local indices fit into 2 * CHUNK_TRIANGLES.
+  struct chunk
+  {
+    vector<screen_triangle> triangles;
+    // Pairs of tile and local triangle index.
+    vector<u32> bins;
+  };
+
+  void setup_chunk(u32 chunk_idx);
+  void setup_triangle(chunk& c, f32 const* clip_vertices);
+  void rasterize_tile(u32 tile);
+
+  u32 m_width = 0;
+  u32 m_height = 0;
+  u32 m_tiles_x = 0;
+  u32 m_tiles_y = 0;
+  // Buffers are padded to whole tiles, rows are m_tiles_x * TILE_SIZE pixels long.
+  u32* m_color = nullptr;
+  f32* m_depth = nullptr;
+
+  frame_constants m_constants;
+  draw const* m_draws = nullptr;
+  // First triangle of every draw, one more entry for the total.
+  vector<u32> m_draw_first_triangles;
+  vector<chunk> m_chunks;
+  // Global triangle indices per tile, chunk * 2 * CHUNK_TRIANGLES + local.
+  vector<vector<u32>> m_bins;
+  u32 m_triangle_count = 0;
+};
@@ -0,0 +1,181 @@
+#include "my_assert.hpp"
+#include "state_filter.hpp"
+
+state_filter::state_filter(render_context& target) :
+  m_target{ target }
+{
+  invalidate();
+}
+
+void state_filter::invalidate()
+{
+  m_rtv_valid = false;
+  m_viewport_valid = false;
+  m_blend_state_valid = false;
+  m_depth_stencil_state_valid = false;
+  m_rasterizer_state_valid = false;
+  m_input_layout_valid = false;
+  m_topology_valid = false;
+  for (u32 i = 0; i < MAX_VERTEX_BUFFERS; i++)
+    m_vertex_buffers_valid[i] = false;
+  m_index_buffer_valid = false;
+  m_vertex_shader_valid = false;
+  m_pixel_shader_valid = false;
+  for (u32 i = 0; i < MAX_CONSTANT_BUFFERS; i++)
+  {
+    m_vs_constant_buffers_valid[i] = false;
+    m_ps_constant_buffers_valid[i] = false;
+  }
+}
+
+bool state_filter::changed(bool& valid, bool differs)
+{
+  if (valid && !differs)
+  {
+    m_skipped++;
+    return false;
+  }
+  valid = true;
+  m_issued++;
+  return true;
+}
+
+void state_filter::set_render_target(void* rtv, void* dsv)
+{
+  if (changed(m_rtv_valid, rtv != m_rtv || dsv != m_dsv))
+  {
+    m_rtv = rtv;
+    m_dsv = dsv;
+    m_target.set_render_target(rtv, dsv);
+  }
+}
+
+void state_filter::set_viewport(viewport const& vp)
+{
+  const bool differs = vp.x != m_viewport.x || vp.y != m_viewport.y
+    || vp.width != m_viewport.width || vp.height != m_viewport.height
+    || vp.min_depth != m_viewport.min_depth || vp.max_depth != m_viewport.max_depth;
+  if (changed(m_viewport_valid, differs))
+  {
+    m_viewport = vp;
+    m_target.set_viewport(vp);
+  }
+}
+
+void state_filter::set_blend_state(void* state)
+{
+  if (changed(m_blend_state_valid, state != m_blend_state))
+  {
+    m_blend_state = state;
+    m_target.set_blend_state(state);
+  }
+}
+
+void state_filter::set_depth_stencil_state(void* state)
+{
+  if (changed(m_depth_stencil_state_valid, state != m_depth_stencil_state))
+  {
+    m_depth_stencil_state = state;
+    m_target.set_depth_stencil_state(state);
+  }
+}
+
+void state_filter::set_rasterizer_state(void* state)
+{
+  if (changed(m_rasterizer_state_valid, state != m_rasterizer_state))
+  {
+    m_rasterizer_state = state;
+    m_target.set_rasterizer_state(state);
+  }
+}
+
+void state_filter::set_input_layout(void* layout)
+{
+  if (changed(m_input_layout_valid, layout != m_input_layout))
+  {
+    m_input_layout = layout;
+    m_target.set_input_layout(layout);
+  }
+}
+
+void state_filter::set_primitive_topology(u32 topology)
+{
+  if (changed(m_topology_valid, topology != m_topology))
+  {
+    m_topology = topology;
+    m_target.set_primitive_topology(topology);
+  }
+}
+
+void state_filter::set_vertex_buffer(u32 slot, void* buffer, u32 stride, u32 offset)
+{
+  my_assert(slot < MAX_VERTEX_BUFFERS);
+  vertex_buffer_binding& b = m_vertex_buffers[slot];
+  if (changed(m_vertex_buffers_valid[slot], buffer != b.buffer || stride != b.stride || offset != b.offset))
+  {
+    b = { buffer, stride, offset };
+    m_target.set_vertex_buffer(slot, buffer, stride, offset);
+  }
+}
+
+void state_filter::set_index_buffer(void* buffer, u32 format, u32 offset)
+{
+  index_buffer_binding& b = m_index_buffer;
+  if (changed(m_index_buffer_valid, buffer != b.buffer || format != b.format || offset != b.offset))
+  {
+    b = { buffer, format, offset };
+    m_target.set_index_buffer(buffer, format, offset);
+  }
+}
+
+void state_filter::set_vertex_shader(void* shader)
+{
+  if (changed(m_vertex_shader_valid, shader != m_vertex_shader))
+  {
+    m_vertex_shader = shader;
+    m_target.set_vertex_shader(shader);
+  }
+}
+
+void state_filter::set_pixel_shader(void* shader)
+{
+  if (changed(m_pixel_shader_valid, shader != m_pixel_shader))
+  {
+    m_pixel_shader = shader;
+    m_target.set_pixel_shader(shader);
+  }
+}
+
+void state_filter::set_vs_constant_buffer(u32 slot, void* buffer)
+{
+  my_assert(slot < MAX_CONSTANT_BUFFERS);
+  constant_buffer_binding& b = m_vs_constant_buffers[slot];
+  if (changed(m_vs_constant_buffers_valid[slot], buffer != b.buffer || b.constant_count != 0))
+  {
+    b = { buffer, 0, 0 };
+    m_target.set_vs_constant_buffer(slot, buffer);
+  }
+}
+
+void state_filter::set_vs_constant_buffer_range(u32 slot, void* buffer, u32 first_constant, u32 constant_count)
+{
+  my_assert(slot < MAX_CONSTANT_BUFFERS);
+  my_assert(constant_count > 0);
+  constant_buffer_binding& b = m_vs_constant_buffers[slot];
+  const bool differs = buffer != b.buffer || first_constant != b.first_constant || constant_count != b.constant_count;
+  if (changed(m_vs_constant_buffers_valid[slot], differs))
+  {
+    b = { buffer, first_constant, constant_count };
+    m_target.set_vs_constant_buffer_range(slot, buffer, first_constant, constant_count);
+  }
+}
+
+void state_filter::set_ps_constant_buffer(u32 slot, void* buffer)
+{
+  my_assert(slot < MAX_CONSTANT_BUFFERS);
+  if (changed(m_ps_constant_buffers_valid[slot], buffer != m_ps_constant_buffers[slot]))
+  {
+    m_ps_constant_buffers[slot] = buffer;
+    m_target.set_ps_constant_buffer(slot, buffer);
+  }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "types.hpp"
+
+// Pipeline state binding calls of a device context.
+// Objects are passed as opaque handles, so the interface has no graphics API dependency.
+class render_context
+{
+public:
+  static constexpr u32 MAX_CONSTANT_BUFFERS = 4;
+  static constexpr u32 MAX_VERTEX_BUFFERS = 2;
+
+  struct viewport
+  {
+    f32 x;
+    f32 y;
+    f32 width;
+    f32 height;
+    f32 min_depth;
+    f32 max_depth;
+  };
+
+  virtual ~render_context() = default;
+  virtual void set_render_target(void* rtv, void* dsv) = 0;
+  virtual void set_viewport(viewport const& vp) = 0;
+  virtual void set_blend_state(void* state) = 0;
+  virtual void set_depth_stencil_state(void* state) = 0;
+  virtual void set_rasterizer_state(void* state) = 0;
+  virtual void set_input_layout(void* layout) = 0;
+  virtual void set_primitive_topology(u32 topology) = 0;
+  virtual void set_vertex_buffer(u32 slot, void* buffer, u32 stride, u32 offset) = 0;
+  virtual void set_index_buffer(void* buffer, u32 format, u32 offset) = 0;
+  virtual void set_vertex_shader(void* shader) = 0;
+  virtual void set_pixel_shader(void* shader) = 0;
+  virtual void set_vs_constant_buffer(u32 slot, void* buffer) = 0;
+  // Binds part of a buffer, offset and size are in 16-byte constants.
+  virtual void set_vs_constant_buffer_range(u32 slot, void* buffer, u32 first_constant, u32 constant_count) = 0;
+  virtual void set_ps_constant_buffer(u32 slot, void* buffer) = 0;
+};
+
+// Shadows state bound through it and forwards only calls which change something.
+// State changed behind its back (e.g. by UI rendering) must be followed by invalidate().
+class state_filter : public render_context
+{
+public:
+  explicit state_filter(render_context& target);
+
+  // Forgets shadowed state, next call of every kind is forwarded.
+  void invalidate();
+
+  void reset_counters()
+  {
+    m_issued = 0;
+    m_skipped = 0;
+  }
+
+  u32 issued() const
+  {
+    return m_issued;
+  }
+
+  u32 skipped() const
+  {
+    return m_skipped;
+  }
+
+  void set_render_target(void* rtv, void* dsv) override;
+  void set_viewport(viewport const& vp) override;
+  void set_blend_state(void* state) override;
+  void set_depth_stencil_state(void* state) override;
+  void set_rasterizer_state(void* state) override;
+  void set_input_layout(void* layout) override;
+  void set_primitive_topology(u32 topology) override;
+  void set_vertex_buffer(u32 slot, void* buffer, u32 stride, u32 offset) override;
+  void set_index_buffer(void* buffer, u32 format, u32 offset) override;
+  void set_vertex_shader(void* shader) override;
+  void set_pixel_shader(void* shader) override;
+  void set_vs_constant_buffer(u32 slot, void* buffer) override;
+  void set_vs_constant_buffer_range(u32 slot, void* buffer, u32 first_constant, u32 constant_count) override;
+  void set_ps_constant_buffer(u32 slot, void* buffer) override;
+
+private:
+  struct vertex_buffer_binding
+  {
+    void* buffer;
+    u32 stride;
+    u32 offset;
+  };
+
+  // Range of zero constants stands for the whole buffer.
+  struct constant_buffer_binding
+  {
+    void* buffer;
+    u32 first_constant;
+    u32 constant_count;
+  };
+
+  struct index_buffer_binding
+  {
+    void* buffer;
+    u32 format;
+    u32 offset;
+  };
+
+  // Counts the call and returns true if it has to be forwarded.
+  bool changed(bool& valid, bool differs);
+
+  render_context& m_target;
+  u32 m_issued = 0;
+  u32 m_skipped = 0;
+
+  void* m_rtv;
+  void* m_dsv;
+  viewport m_viewport;
+  void* m_blend_state;
+  void* m_depth_stencil_state;
+  void* m_rasterizer_state;
+  void* m_input_layout;
+  u32 m_topology;
+  vertex_buffer_binding m_vertex_buffers[MAX_VERTEX_BUFFERS];
+  index_buffer_binding m_index_buffer;
+  void* m_vertex_shader;
+  void* m_pixel_shader;
+  constant_buffer_binding m_vs_constant_buffers[MAX_CONSTANT_BUFFERS];
+  void* m_ps_constant_buffers[MAX_CONSTANT_BUFFERS];
+
+  bool m_rtv_valid;
+  bool m_viewport_valid;
+  bool m_blend_state_valid;
+  bool m_depth_stencil_state_valid;
+  bool m_rasterizer_state_valid;
+  bool m_input_layout_valid;
+  bool m_topology_valid;
+  bool m_vertex_buffers_valid[MAX_VERTEX_BUFFERS];
+  bool m_index_buffer_valid;
+  bool m_vertex_shader_valid;
+  bool m_pixel_shader_valid;
+  bool m_vs_constant_buffers_valid[MAX_CONSTANT_BUFFERS];
+  bool m_ps_constant_buffers_valid[MAX_CONSTANT_BUFFERS];
+};
@@ -0,0 +1,214 @@
+#include <string.h>
+
+#include "capture.hpp"
+#include "test.hpp"
+
+namespace
+{
+constexpr u32 FRAME_COUNT = 3;
+constexpr u32 CONSTANTS_SIZE = 64;
+constexpr u32 INSTANCE_STRIDE = 16;
+constexpr u32 INSTANCE_COUNT = 4;
+constexpr u32 BUFFER_SIZE = 256;
+constexpr u32 FRAME_UPLOAD_SIZE = 32;
+
+// Also keeps payloads, which recording_backend drops.
+class payload_backend : public recording_backend
+{
+public:
+  void set_object_constants(void const* data, u32 size) override
+  {
+    recording_backend::set_object_constants(data, size);
+    append(data, size);
+  }
+
+  void set_instance_data(void const* data, u32 stride, u32 count) override
+  {
+    recording_backend::set_instance_data(data, stride, count);
+    append(data, stride * count);
+  }
+
+  vector<u8> payloads;
+
+private:
+  void append(void const* data, u32 size)
+  {
+    for (u32 i = 0; i < size; i++)
+      payloads.push_back(static_cast<u8 const*>(data)[i]);
+  }
+};
+
+struct recorded_capture
+{
+  vector<u8> stream;
+  // Stream sizes at which a capture may end: after every record outside of frames and after every frame.
+  vector<u32> ends;
+  vector<replay_frame_stats> expected;
+};
+
+// Setup records, then frames of two draws each, forwarded to the live backend.
+void record(recorded_capture& out, payload_backend& live)
+{
+  command_capture capture;
+  capture.target = &live;
+  capture.begin();
+  out.ends.push_back(capture.data().size());
+  u8 bytes[BUFFER_SIZE];
+  for (u32 i = 0; i < BUFFER_SIZE; i++)
+    bytes[i] = (u8)(i * 7);
+  capture.create_buffer(0, BUFFER_SIZE, 1);
+  out.ends.push_back(capture.data().size());
+  capture.upload(0, 0, bytes, BUFFER_SIZE);
+  out.ends.push_back(capture.data().size());
+
+  for (u32 f = 0; f < FRAME_COUNT; f++)
+  {
+    replay_frame_stats stats;
+    stats.frame = 10 + f;
+    capture.begin_frame(stats.frame);
+    capture.upload(0, 0, bytes + f, FRAME_UPLOAD_SIZE);
+    capture.begin_pass(f);
+    capture.set_pipeline(f + 1);
+    capture.set_mesh(f + 2);
+    capture.set_object_constants(bytes + f * 3, CONSTANTS_SIZE);
+    // Negative base vertices go through the stream as u32.
+    capture.draw_indexed(36, 6 * f, -(i32)f);
+    capture.set_instance_data(bytes + f * 5, INSTANCE_STRIDE, INSTANCE_COUNT);
+    capture.draw_indexed_instanced(12, f, (i32)f - 1, INSTANCE_COUNT, 0);
+    capture.end_frame();
+    out.ends.push_back(capture.data().size());
+
+    const capture_op ops[] = { capture_op::begin_frame, capture_op::upload, capture_op::begin_pass,
+                               capture_op::set_pipeline, capture_op::set_mesh, capture_op::set_object_constants,
+                               capture_op::draw_indexed, capture_op::set_instance_data,
+                               capture_op::draw_indexed_instanced, capture_op::end_frame };
+    for (capture_op op : ops)
+      stats.commands[(u32)op]++;
+    stats.upload_bytes = FRAME_UPLOAD_SIZE + CONSTANTS_SIZE + INSTANCE_STRIDE * INSTANCE_COUNT;
+    // Records between frames count toward the next one.
+    if (f == 0)
+    {
+      stats.commands[(u32)capture_op::create_buffer]++;
+      stats.commands[(u32)capture_op::upload]++;
+      stats.upload_bytes += BUFFER_SIZE;
+    }
+    out.expected.push_back(stats);
+  }
+  out.stream = capture.data();
+}
+
+bool same_commands(recording_backend const& a, recording_backend const& b)
+{
+  if (a.commands.size() != b.commands.size())
+    return false;
+  for (u32 i = 0; i < a.commands.size(); i++)
+  {
+    const recording_backend::command& ca = a.commands[i];
+    const recording_backend::command& cb = b.commands[i];
+    if (ca.type != cb.type || memcmp(ca.args, cb.args, sizeof(ca.args)) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool same_stats(replay_frame_stats const& a, replay_frame_stats const& b)
+{
+  return a.frame == b.frame && a.upload_bytes == b.upload_bytes
+         && memcmp(a.commands, b.commands, sizeof(a.commands)) == 0;
+}
+
+bool replay(vector<u8> const& stream, u32 size)
+{
+  payload_backend backend;
+  vector<replay_frame_stats> frames;
+  return replay_capture(stream.data(), size, backend, frames);
+}
+
+void test_round_trip(recorded_capture const& capture, payload_backend const& live)
+{
+  check(live.commands.size() == FRAME_COUNT * 7);
+  for (u32 run = 0; run < 2; run++)
+  {
+    payload_backend replayed;
+    vector<replay_frame_stats> frames;
+    check(replay_capture(capture.stream.data(), capture.stream.size(), replayed, frames));
+    check(same_commands(live, replayed));
+    check(live.payloads.size() == replayed.payloads.size());
+    check(memcmp(live.payloads.data(), replayed.payloads.data(), live.payloads.size()) == 0);
+    check(frames.size() == FRAME_COUNT);
+    for (u32 i = 0; i < frames.size() && i < FRAME_COUNT; i++)
+      check(same_stats(frames[i], capture.expected[i]));
+  }
+}
+
+// Cut anywhere, the stream is rejected unless it ends between records outside of frames.
+void test_truncated(recorded_capture const& capture)
+{
+  u32 wrong = 0;
+  for (u32 size = 0; size < capture.stream.size(); size++)
+  {
+    bool complete = false;
+    for (u32 i = 0; i < capture.ends.size(); i++)
+      complete = complete || capture.ends[i] == size;
+    if (replay(capture.stream, size) != complete)
+      wrong++;
+  }
+  check(wrong == 0);
+}
+
+void test_garbage(recorded_capture const& capture)
+{
+  const u32 setup_end = capture.ends[2];
+  vector<u8> stream = capture.stream;
+  stream[0] ^= 1;
+  check(replay(stream, stream.size()) == false);
+
+  stream = capture.stream;
+  stream[4]++;
+  check(replay(stream, stream.size()) == false);
+
+  // Unknown opcode at the first frame.
+  stream = capture.stream;
+  stream[setup_end] = (u8)capture_op::count;
+  check(replay(stream, stream.size()) == false);
+
+  // Frames which don't nest.
+  stream = capture.stream;
+  stream[setup_end] = (u8)capture_op::end_frame;
+  check(replay(stream, stream.size()) == false);
+
+  // Payload size past the end of the stream, opcode, buffer and offset precede the upload size.
+  stream = capture.stream;
+  const u32 size = 0xFFFFFFF0;
+  memcpy(stream.data() + 8 + 13 + 9, &size, sizeof(size));
+  check(replay(stream, stream.size()) == false);
+
+  // Random bytes after a valid header.
+  u32 random = 99;
+  u32 accepted = 0;
+  for (u32 i = 0; i < 200; i++)
+  {
+    stream = capture.stream;
+    stream.resize(8 + 64, 0);
+    for (u32 k = 8; k < stream.size(); k++)
+    {
+      random = random * 1664525u + 1013904223u;
+      stream[k] = (u8)(random >> 24);
+    }
+    if (replay(stream, stream.size()))
+      accepted++;
+  }
+  check(accepted == 0);
+}
+} // namespace
+
+int main()
+{
+  recorded_capture capture;
+  payload_backend live;
+  record(capture, live);
+  test_round_trip(capture, live);
+  test_truncated(capture);
+  test_garbage(capture);
+  return test_result();
+}
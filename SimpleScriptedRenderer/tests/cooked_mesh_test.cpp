@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cooked_mesh.hpp"
+#include "grid_mesh.hpp"
+#include "lod.hpp"
+#include "mesh_simplifier.hpp"
+#include "platform.hpp"
+#include "test.hpp"
+
+namespace
+{
+cooked_mesh_header& header_of(vector<u8>& blob)
+{
+  return *reinterpret_cast<cooked_mesh_header*>(blob.data());
+}
+
+bool view(vector<u8> const& blob)
+{
+  cooked_mesh mesh;
+  return view_cooked_mesh(blob.data(), blob.size(), mesh);
+}
+
+void set_index(vector<u8>& blob, u32 idx, u32 value)
+{
+  const cooked_mesh_header& h = header_of(blob);
+  u8* indices = blob.data() + h.index_stream_offset;
+  if (h.index_size == 2)
+    reinterpret_cast<u16*>(indices)[idx] = (u16)value;
+  else
+    reinterpret_cast<u32*>(indices)[idx] = value;
+}
+
+void test_valid(vector<u8> const& blob)
+{
+  cooked_mesh mesh;
+  check(view_cooked_mesh(blob.data(), blob.size(), mesh));
+  if (mesh.header == nullptr)
+    return;
+  const vertex_data vd = make_vertex_data(mesh);
+  check(vd.lod_count == 2);
+  check(vd.vertex_count == mesh.header->vertex_count);
+  check(lod_vertex_count(vd, 1) == mesh.header->vertex_count - (u32)mesh.header->lods[1].base_vertex);
+  check(vd.occluder_indices.size() == mesh.header->lods[0].index_count);
+  // Streams stay in the blob, only triangles of the finest level are copied.
+  check(vertices_of(vd) == mesh.vertices && meshlets_of(vd) == mesh.meshlets);
+  check(vd.vertices.size() == 0 && vd.meshlets.size() == 0);
+  check(meshlet_count(vd) == mesh.header->meshlet_count);
+}
+
+void test_header(vector<u8> const& source)
+{
+  vector<u8> blob = source;
+  blob.pop_back();
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).magic++;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).version++;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lod_count = 0;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lod_count = MAX_LODS + 1;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).index_size = 3;
+  check(view(blob) == false);
+
+  // Streams past the end or at unaligned offsets.
+  blob = source;
+  header_of(blob).vertex_count += 1000;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).index_stream_offset += 4;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).meshlet_count += 1;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).flags = 2;
+  check(view(blob) == false);
+}
+
+void test_levels(vector<u8> const& source)
+{
+  // Base vertices which don't increase would underflow the vertex count of a level.
+  vector<u8> blob = source;
+  header_of(blob).lods[1].base_vertex = header_of(blob).lods[0].base_vertex;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lods[1].base_vertex = header_of(blob).lods[0].base_vertex - 1;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lods[0].base_vertex = -1;
+  check(view(blob) == false);
+
+  // Last level would have no vertices.
+  blob = source;
+  header_of(blob).lods[1].base_vertex = (i32)header_of(blob).vertex_count;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lods[1].index_count += 3;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lods[0].index_count -= 1;
+  check(view(blob) == false);
+
+  blob = source;
+  header_of(blob).lods[1].first_meshlet = header_of(blob).meshlet_count;
+  check(view(blob) == false);
+}
+
+void test_indices(vector<u8> const& source)
+{
+  const cooked_mesh_header& h = *reinterpret_cast<const cooked_mesh_header*>(source.data());
+  const u32 lod0_vertex_count = (u32)(h.lods[1].base_vertex - h.lods[0].base_vertex);
+  const u32 lod1_vertex_count = h.vertex_count - (u32)h.lods[1].base_vertex;
+
+  // Largest valid index of every level is accepted, the next one is not.
+  vector<u8> blob = source;
+  set_index(blob, h.lods[0].first_index + 7, lod0_vertex_count - 1);
+  check(view(blob));
+  set_index(blob, h.lods[0].first_index + 7, lod0_vertex_count);
+  check(view(blob) == false);
+
+  // Indices of a level are checked against its own vertices, not against the whole stream.
+  blob = source;
+  set_index(blob, h.lods[1].first_index + h.lods[1].index_count - 1, lod1_vertex_count - 1);
+  check(view(blob));
+  set_index(blob, h.lods[1].first_index + h.lods[1].index_count - 1, lod1_vertex_count);
+  check(view(blob) == false);
+  set_index(blob, h.lods[1].first_index + h.lods[1].index_count - 1, lod0_vertex_count);
+  check(view(blob) == false);
+}
+
+void test_meshlets(vector<u8> const& source)
+{
+  const cooked_mesh_header& h = *reinterpret_cast<const cooked_mesh_header*>(source.data());
+  check(h.lods[1].meshlet_count > 0);
+
+  // Meshlet ranges are relative to their level and must stay inside it.
+  vector<u8> blob = source;
+  meshlet* meshlets = reinterpret_cast<meshlet*>(blob.data() + h.meshlet_stream_offset);
+  meshlet& last = meshlets[h.lods[1].first_meshlet + h.lods[1].meshlet_count - 1];
+  check(last.first_index + last.index_count == h.lods[1].index_count);
+  last.index_count += 3;
+  check(view(blob) == false);
+
+  blob = source;
+  meshlets = reinterpret_cast<meshlet*>(blob.data() + h.meshlet_stream_offset);
+  meshlets[h.lods[0].first_meshlet].first_index = h.lods[0].index_count;
+  check(view(blob) == false);
+
+  blob = source;
+  meshlets = reinterpret_cast<meshlet*>(blob.data() + h.meshlet_stream_offset);
+  meshlets[h.lods[0].first_meshlet].first_index = 0xFFFFFFFF;
+  check(view(blob) == false);
+}
+
+// Random damage to the header and the index stream is either rejected or leaves every index inside its level.
+void test_random_damage(vector<u8> const& source)
+{
+  const cooked_mesh_header& h = *reinterpret_cast<const cooked_mesh_header*>(source.data());
+  const u32 damaged_end = h.index_stream_offset + 64;
+  u32 random = 7;
+  u32 accepted = 0;
+  bool consistent = true;
+  for (u32 i = 0; i < 2000; i++)
+  {
+    vector<u8> blob = source;
+    for (u32 k = 0; k < 4; k++)
+    {
+      random = random * 1664525u + 1013904223u;
+      const u32 offset = (random >> 8) % damaged_end;
+      blob[offset] ^= (u8)(1u << (random & 7));
+    }
+    cooked_mesh mesh;
+    if (view_cooked_mesh(blob.data(), blob.size(), mesh) == false)
+      continue;
+    accepted++;
+    const cooked_mesh_header& d = *mesh.header;
+    for (u32 l = 0; l < d.lod_count; l++)
+    {
+      const u32 end = l + 1 < d.lod_count ? (u32)d.lods[l + 1].base_vertex : d.vertex_count;
+      for (u32 j = d.lods[l].first_index; j < d.lods[l].first_index + d.lods[l].index_count; j++)
+      {
+        const u32 index = d.index_size == 2 ? static_cast<const u16*>(mesh.indices)[j]
+                                            : static_cast<const u32*>(mesh.indices)[j];
+        consistent = consistent && (u32)d.lods[l].base_vertex + index < end;
+      }
+    }
+  }
+  check(consistent);
+  // Flips in padding, bounds and vertex data are harmless.
+  check(accepted > 0);
+}
+// A flat grid simplifies without error, its generated levels still switch by their sizes.
+void test_generated_levels()
+{
+  mesh_lod lods[MAX_LODS];
+  make_grid(64, 0.0f, lods[0]);
+  const u32 lod_count = generate_lod_chain(lods, LOD_CHAIN_RATIOS, LOD_CHAIN_LEVELS);
+  check(lod_count > 1);
+  check(lods[lod_count - 1].generated && lods[lod_count - 1].error == 0.0f);
+  vector<u8> blob;
+  cook_mesh(lods, lod_count, blob);
+  cooked_mesh mesh;
+  check(view_cooked_mesh(blob.data(), blob.size(), mesh));
+  if (mesh.header == nullptr)
+    return;
+  check(mesh.header->flags == COOKED_MESH_FLAG_GENERATED_LODS);
+  vertex_data vd = make_vertex_data(mesh);
+  check(vd.generated_lods);
+  set_lod_screen_error(vd, 1.0f / 720.0f);
+  for (u32 i = 0; i + 1 < lod_count; i++)
+    check(vd.lod_min_screen_sizes[i] > 0.0f);
+  check(lod::select(0.5f, 0, vd.lod_min_screen_sizes, vd.lod_count, 0.1f) == lod_count - 1);
+
+  // Authored levels keep their sizes.
+  cook_grids(9, 5, blob);
+  check(view_cooked_mesh(blob.data(), blob.size(), mesh));
+  check(mesh.header->flags == 0);
+  vd = make_vertex_data(mesh);
+  set_lod_screen_error(vd, 1.0f / 720.0f);
+  check(vd.generated_lods == false && vd.lod_min_screen_sizes[0] == 0.5f);
+}
+
+// Writes a grid of n by n positions without normals as an OBJ file.
+bool write_obj_grid(const char* path, u32 n)
+{
+  FILE* f = fopen(path, "w");
+  if (f == nullptr)
+    return false;
+  for (u32 y = 0; y < n; y++)
+  {
+    for (u32 x = 0; x < n; x++)
+      fprintf(f, "v %u %u 0\n", x, y);
+  }
+  for (u32 y = 0; y + 1 < n; y++)
+  {
+    for (u32 x = 0; x + 1 < n; x++)
+    {
+      const u32 i = y * n + x + 1;
+      fprintf(f, "f %u %u %u %u\n", i, i + n, i + n + 1, i + 1);
+    }
+  }
+  return fclose(f) == 0;
+}
+
+// Seconds of the fastest of a few imports.
+f64 time_import(const char* path, u32 expected_vertex_count)
+{
+  f64 best = 1e30;
+  for (u32 i = 0; i < 3; i++)
+  {
+    mesh_lod lod;
+    const f64 start = platform::seconds();
+    check(import_obj(path, lod));
+    const f64 t = platform::seconds() - start;
+    check(lod.vertices.size() == expected_vertex_count);
+    best = t < best ? t : best;
+  }
+  return best;
+}
+
+// Vertices are deduplicated through a hash map, import time grows with the vertex count.
+void test_import_scaling()
+{
+  const char* small_path = "cooked_mesh_test_small.obj";
+  const char* large_path = "cooked_mesh_test_large.obj";
+  check(write_obj_grid(small_path, 64));
+  check(write_obj_grid(large_path, 256));
+  const f64 small_time = time_import(small_path, 64 * 64);
+  const f64 large_time = time_import(large_path, 256 * 256);
+  remove(small_path);
+  remove(large_path);
+  // 16 times the vertices, quadratic time would take about 256 times longer.
+  check(large_time < 64.0 * small_time + 0.01);
+}
+} // namespace
+
+int main()
+{
+  vector<u8> blob16;
+  cook_grids(9, 5, blob16);
+  check(header_of(blob16).index_size == 2);
+  // More than 65536 vertices need 32-bit indices.
+  vector<u8> blob32;
+  cook_grids(257, 9, blob32);
+  check(header_of(blob32).index_size == 4);
+
+  vector<u8>* blobs[2] = { &blob16, &blob32 };
+  for (u32 i = 0; i < 2; i++)
+  {
+    test_valid(*blobs[i]);
+    test_header(*blobs[i]);
+    test_levels(*blobs[i]);
+    test_indices(*blobs[i]);
+    test_meshlets(*blobs[i]);
+  }
+  test_random_damage(blob16);
+  test_generated_levels();
+  test_import_scaling();
+  return test_result();
+}
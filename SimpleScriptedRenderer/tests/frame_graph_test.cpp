@@ -0,0 +1,218 @@
+#include "frame_graph.hpp"
+#include "test.hpp"
+
+namespace
+{
+vector<u32> g_executed;
+
+// Pass context is the index the pass logs when it runs.
+void log_pass(frame_graph const&, void* ctx)
+{
+  g_executed.push_back(*static_cast<const u32*>(ctx));
+}
+
+const u32 PASS_IDS[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+u32 add_pass(frame_graph& graph, const char* name)
+{
+  return graph.add_pass(name, log_pass, const_cast<u32*>(&PASS_IDS[graph.pass_count()]));
+}
+
+const fg_texture_desc COLOR = { 1280, 720, 1, 1, 4, 1 };
+const fg_texture_desc DEPTH = { 1280, 720, 2, 2, 4, 1 };
+const u64 COLOR_SIZE = 1280ull * 720 * 4;
+
+// Handle of the back buffer, never dereferenced.
+void* const BACK_BUFFER = reinterpret_cast<void*>((size_t)0x1000);
+
+bool same_order(vector<u32> const& order, const u32* expected, u32 count)
+{
+  if (order.size() != count)
+    return false;
+  for (u32 i = 0; i < count; i++)
+  {
+    if (order[i] != expected[i])
+      return false;
+  }
+  return true;
+}
+
+void test_culling()
+{
+  null_frame_graph_backend backend;
+  frame_graph graph;
+  const u32 back_buffer = graph.import_texture("back buffer", COLOR, BACK_BUFFER);
+  const u32 hdr = graph.create_texture("hdr", COLOR);
+  const u32 debug = graph.create_texture("debug", COLOR);
+  const u32 unused = graph.create_texture("unused", COLOR);
+
+  // Added before the pass it depends on.
+  const u32 tonemap = add_pass(graph, "tonemap");
+  graph.read(tonemap, hdr);
+  graph.write(tonemap, back_buffer);
+  const u32 scene = add_pass(graph, "scene");
+  graph.write(scene, hdr);
+  // Output nobody reads.
+  const u32 debug_view = add_pass(graph, "debug view");
+  graph.read(debug_view, hdr);
+  graph.write(debug_view, debug);
+  // Feeds only the culled pass.
+  const u32 debug_source = add_pass(graph, "debug source");
+  graph.write(debug_source, unused);
+  graph.read(debug_view, unused);
+  // Writes nothing, but must run.
+  const u32 readback = add_pass(graph, "readback");
+  graph.read(readback, hdr);
+  graph.set_side_effects(readback);
+
+  graph.compile(backend);
+  check(graph.culled(tonemap) == false);
+  check(graph.culled(scene) == false);
+  check(graph.culled(readback) == false);
+  check(graph.culled(debug_view));
+  check(graph.culled(debug_source));
+  const u32 expected[] = { scene, tonemap, readback };
+  check(same_order(graph.execution_order(), expected, 3));
+
+  g_executed.clear();
+  graph.execute();
+  check(same_order(g_executed, expected, 3));
+
+  // Textures of culled passes get no memory.
+  check(graph.physical_texture_count() == 1);
+  check(backend.created_textures == 1);
+  check(graph.texture(back_buffer) == BACK_BUFFER);
+  check(graph.transient_memory() == COLOR_SIZE);
+  check(graph.unaliased_memory() == COLOR_SIZE);
+
+  graph.release(backend);
+  check(backend.live_textures == 0);
+}
+
+void test_disjoint_lifetimes()
+{
+  null_frame_graph_backend backend;
+  frame_graph graph;
+  const u32 back_buffer = graph.import_texture("back buffer", COLOR, BACK_BUFFER);
+  const u32 a = graph.create_texture("a", COLOR);
+  const u32 b = graph.create_texture("b", COLOR);
+  const u32 c = graph.create_texture("c", COLOR);
+
+  // Chain where every texture is dead once the next one is written.
+  const u32 p0 = add_pass(graph, "write a");
+  graph.write(p0, a);
+  const u32 p1 = add_pass(graph, "a to b");
+  graph.read(p1, a);
+  graph.write(p1, b);
+  const u32 p2 = add_pass(graph, "b to c");
+  graph.read(p2, b);
+  graph.write(p2, c);
+  const u32 p3 = add_pass(graph, "present");
+  graph.read(p3, c);
+  graph.write(p3, back_buffer);
+
+  graph.compile(backend);
+  const u32 expected[] = { p0, p1, p2, p3 };
+  check(same_order(graph.execution_order(), expected, 4));
+  // a ends at the pass which writes b, so c takes the memory of a.
+  check(graph.physical_texture_count() == 2);
+  check(graph.texture(a) == graph.texture(c));
+  check(graph.texture(a) != graph.texture(b));
+  check(graph.transient_memory() == 2 * COLOR_SIZE);
+  check(graph.unaliased_memory() == 3 * COLOR_SIZE);
+
+  // The same graph next frame reuses the physical textures.
+  graph.reset();
+  const u32 back_buffer2 = graph.import_texture("back buffer", COLOR, BACK_BUFFER);
+  const u32 a2 = graph.create_texture("a", COLOR);
+  const u32 q0 = add_pass(graph, "write a");
+  graph.write(q0, a2);
+  const u32 q1 = add_pass(graph, "present");
+  graph.read(q1, a2);
+  graph.write(q1, back_buffer2);
+  graph.compile(backend);
+  check(backend.created_textures == 2);
+  // The texture not needed any more is released.
+  check(backend.live_textures == 1);
+  check(graph.physical_texture_count() == 1);
+  check(graph.transient_memory() == COLOR_SIZE);
+
+  graph.release(backend);
+  check(backend.live_textures == 0);
+}
+
+void test_overlapping_lifetimes()
+{
+  null_frame_graph_backend backend;
+  frame_graph graph;
+  const u32 back_buffer = graph.import_texture("back buffer", COLOR, BACK_BUFFER);
+  const u32 albedo = graph.create_texture("albedo", COLOR);
+  const u32 normals = graph.create_texture("normals", COLOR);
+  const u32 depth = graph.create_texture("depth", DEPTH);
+  const u32 lit = graph.create_texture("lit", COLOR);
+
+  const u32 gbuffer = add_pass(graph, "gbuffer");
+  graph.write(gbuffer, albedo);
+  graph.write(gbuffer, normals);
+  graph.write(gbuffer, depth);
+  const u32 lighting = add_pass(graph, "lighting");
+  graph.read(lighting, albedo);
+  graph.read(lighting, normals);
+  graph.write(lighting, lit);
+  // Depth is alive until here, so it overlaps lit.
+  const u32 composite = add_pass(graph, "composite");
+  graph.read(composite, lit);
+  graph.read(composite, depth);
+  graph.write(composite, back_buffer);
+
+  graph.compile(backend);
+  const u32 expected[] = { gbuffer, lighting, composite };
+  check(same_order(graph.execution_order(), expected, 3));
+  // Albedo and normals are read by the pass writing lit, none of the colors can share.
+  // Depth has another description and never aliases a color texture.
+  check(graph.physical_texture_count() == 4);
+  check(graph.texture(albedo) != graph.texture(normals));
+  check(graph.texture(albedo) != graph.texture(lit));
+  check(graph.texture(normals) != graph.texture(lit));
+  check(graph.transient_memory() == graph.unaliased_memory());
+  check(graph.unaliased_memory() == 4 * COLOR_SIZE);
+
+  graph.release(backend);
+  check(backend.live_textures == 0);
+}
+
+void test_writer_order()
+{
+  null_frame_graph_backend backend;
+  frame_graph graph;
+  const u32 back_buffer = graph.import_texture("back buffer", COLOR, BACK_BUFFER);
+  const u32 hdr = graph.create_texture("hdr", COLOR);
+
+  // Writers of one texture run in the order they were added, readers after all of them.
+  const u32 post = add_pass(graph, "post");
+  graph.read(post, hdr);
+  graph.write(post, back_buffer);
+  const u32 opaque = add_pass(graph, "opaque");
+  graph.write(opaque, hdr);
+  const u32 transparent = add_pass(graph, "transparent");
+  graph.write(transparent, hdr);
+  const u32 ui = add_pass(graph, "ui");
+  graph.write(ui, back_buffer);
+
+  graph.compile(backend);
+  const u32 expected[] = { opaque, transparent, post, ui };
+  check(same_order(graph.execution_order(), expected, 4));
+  check(graph.physical_texture_count() == 1);
+
+  graph.release(backend);
+}
+} // namespace
+
+int main()
+{
+  test_culling();
+  test_disjoint_lifetimes();
+  test_overlapping_lifetimes();
+  test_writer_order();
+  return test_result();
+}
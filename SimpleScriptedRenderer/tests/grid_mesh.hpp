@@ -0,0 +1,42 @@
+#pragma once
+#include "cooked_mesh.hpp"
+#include "mesh.hpp"
+
+// Mesh fixtures shared by the tests.
+
+// Grid of quads in the XY plane, n vertices on a side.
+inline void make_grid(u32 n, f32 min_screen_size, mesh_lod& out)
+{
+  out.vertices.clear();
+  out.indices.clear();
+  for (u32 y = 0; y < n; y++)
+  {
+    for (u32 x = 0; x < n; x++)
+    {
+      vertex v;
+      v.position = { (f32)x / (n - 1), (f32)y / (n - 1), 0.0f };
+      v.normal = { 0.0f, 0.0f, -1.0f };
+      out.vertices.push_back(v);
+    }
+  }
+  for (u32 y = 0; y + 1 < n; y++)
+  {
+    for (u32 x = 0; x + 1 < n; x++)
+    {
+      const u32 i = y * n + x;
+      const u32 quad[6] = { i, i + n, i + 1, i + 1, i + n, i + n + 1 };
+      for (u32 k = 0; k < 6; k++)
+        out.indices.push_back(quad[k]);
+    }
+  }
+  out.min_screen_size = min_screen_size;
+}
+
+// Two authored levels, grids of n0 and n1 vertices on a side, switching at half the screen.
+inline void cook_grids(u32 n0, u32 n1, vector<u8>& out)
+{
+  mesh_lod lods[2];
+  make_grid(n0, 0.5f, lods[0]);
+  make_grid(n1, 0.0f, lods[1]);
+  cook_mesh(lods, 2, out);
+}
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cooked_mesh.hpp"
+#include "grid_mesh.hpp"
+#include "mesh_registry.hpp"
+#include "test.hpp"
+
+namespace
+{
+// Resident content of mesh ids, compared by value.
+struct fake_owner
+{
+  u32 contents[8];
+  u32 loading;
+  u32 compares;
+};
+
+bool same_value(void* ctx, u32 id)
+{
+  fake_owner& owner = *static_cast<fake_owner*>(ctx);
+  owner.compares++;
+  return owner.contents[id] == owner.loading;
+}
+
+u32 load(mesh_registry& registry, fake_owner& owner, content_hash const& hash, u32 content, u32 id)
+{
+  owner.loading = content;
+  const u32 shared = registry.acquire(hash, 100, 2, same_value, &owner);
+  if (shared != mesh_registry::INVALID_ID)
+    return shared;
+  owner.contents[id] = content;
+  registry.insert(hash, id);
+  return id;
+}
+
+void test_sharing()
+{
+  mesh_registry registry;
+  fake_owner owner = {};
+  const content_hash a = { 1, 2 };
+  const content_hash b = { 3, 4 };
+  check(load(registry, owner, a, 10, 0) == 0);
+  check(owner.compares == 0);
+  check(load(registry, owner, a, 10, 1) == 0);
+  check(owner.compares == 1);
+  check(load(registry, owner, b, 20, 1) == 1);
+  check(registry.reference_count(0) == 2);
+
+  const mesh_registry_stats& s = registry.stats();
+  check(s.meshes == 2 && s.hits == 1 && s.misses == 2 && s.collisions == 0);
+  check(s.bytes_saved == 100 && s.uploads_avoided == 2);
+
+  check(registry.release(0) == false);
+  check(registry.release(0));
+  check(registry.reference_count(0) == 0);
+  // Released content is not found anymore.
+  check(load(registry, owner, a, 10, 2) == 2);
+  check(registry.stats().meshes == 2);
+}
+
+void test_collision()
+{
+  mesh_registry registry;
+  fake_owner owner = {};
+  const content_hash h = { 5, 6 };
+  check(load(registry, owner, h, 10, 0) == 0);
+  // Same hash, other content, is loaded on its own.
+  check(load(registry, owner, h, 11, 1) == 1);
+  check(registry.stats().collisions == 1);
+  check(registry.stats().hits == 0);
+  check(registry.reference_count(0) == 1 && registry.reference_count(1) == 1);
+  // The first mesh is still shared, releasing the colliding one keeps it registered.
+  check(load(registry, owner, h, 10, 2) == 0);
+  check(registry.release(1));
+  check(load(registry, owner, h, 10, 2) == 0);
+  check(registry.reference_count(0) == 3);
+  check(registry.stats().collisions == 1);
+}
+
+void test_cooked_content()
+{
+  vector<u8> blob;
+  cook_grids(9, 5, blob);
+  cooked_mesh mesh;
+  check(view_cooked_mesh(blob.data(), blob.size(), mesh));
+  if (mesh.header == nullptr)
+    return;
+  vertex_data vd = make_vertex_data(mesh);
+  check(vd.mapped_indices == mesh.indices);
+  check(same_cooked_content(mesh, vd));
+
+  // Placed into an arena as the application does.
+  const u32 vertex_offset = 1000;
+  const u32 index_offset = 300;
+  vd.vertex_offset = vertex_offset;
+  vd.index_offset = index_offset;
+  for (u32 i = 0; i < vd.lod_count; i++)
+  {
+    vd.lods[i].base_vertex += (i32)vertex_offset;
+    vd.lods[i].first_index += index_offset * (4 / vd.index_size);
+  }
+  check(same_cooked_content(mesh, vd));
+
+  // Content which hashes the same is not possible to build, damage copies of the blob instead.
+  vector<u8> other = blob;
+  cooked_mesh changed;
+  check(view_cooked_mesh(other.data(), other.size(), changed));
+  vertex* vertices = const_cast<vertex*>(changed.vertices);
+  vertices[changed.header->vertex_count - 1].position.x += 1.0f;
+  check(same_cooked_content(changed, vd) == false);
+
+  other = blob;
+  check(view_cooked_mesh(other.data(), other.size(), changed));
+  // Swaps two indices of the last triangle, the winding flips.
+  u8* indices = static_cast<u8*>(const_cast<void*>(changed.indices));
+  const u32 index_size = changed.header->index_size;
+  const u32 last = (changed.header->index_count - 1) * index_size;
+  u8 first[4];
+  memcpy(first, indices + last, index_size);
+  memcpy(indices + last, indices + last - index_size, index_size);
+  memcpy(indices + last - index_size, first, index_size);
+  check(same_cooked_content(changed, vd) == false);
+
+  other = blob;
+  check(view_cooked_mesh(other.data(), other.size(), changed));
+  const_cast<cooked_mesh_header*>(changed.header)->lods[0].min_screen_size = 0.25f;
+  check(same_cooked_content(changed, vd) == false);
+}
+
+// Meshes of a mesh_loader, ids are indices into a fixed array.
+struct fake_store
+{
+  vertex_data meshes[4];
+  u32 destroyed;
+};
+
+u32 allocate_fake(void* ctx)
+{
+  fake_store& store = *static_cast<fake_store*>(ctx);
+  for (u32 id = 0; id < 4; id++)
+  {
+    if (store.meshes[id].vertex_count == 0)
+      return id;
+  }
+  return mesh_registry::INVALID_ID;
+}
+
+bool create_fake(void* ctx, u32 id, cooked_mesh const& mesh)
+{
+  static_cast<fake_store*>(ctx)->meshes[id] = make_vertex_data(mesh);
+  return true;
+}
+
+void destroy_fake(void* ctx, u32 id)
+{
+  fake_store& store = *static_cast<fake_store*>(ctx);
+  store.meshes[id] = vertex_data{};
+  store.destroyed++;
+}
+
+vertex_data const* get_fake(void* ctx, u32 id)
+{
+  return &static_cast<fake_store*>(ctx)->meshes[id];
+}
+
+// Loaded meshes point into their files, which stay mapped until the last release.
+void test_loader()
+{
+  vector<u8> blob;
+  cook_grids(9, 5, blob);
+  cooked_mesh source;
+  check(view_cooked_mesh(blob.data(), blob.size(), source));
+  const char* path = "mesh_registry_test.mesh";
+  FILE* f = fopen(path, "wb");
+  check(f != nullptr && fwrite(blob.data(), 1, blob.size(), f) == blob.size() && fclose(f) == 0);
+
+  fake_store store = {};
+  const mesh_store callbacks = { &store, allocate_fake, create_fake, destroy_fake, get_fake, sizeof(vertex) };
+  mesh_loader loader;
+  const i32 id = loader.load(path, callbacks);
+  check(id == 0);
+  check(loader.load(path, callbacks) == id);
+  if (id == 0 && source.header != nullptr)
+  {
+    const vertex_data& vd = store.meshes[id];
+    check(vd.vertices.size() == 0 && vd.mapped_vertices != nullptr);
+    check(memcmp(vertices_of(vd), source.vertices, vd.vertex_count * sizeof(vertex)) == 0);
+    check(memcmp(meshlets_of(vd), source.meshlets, meshlet_count(vd) * sizeof(meshlet)) == 0);
+    check(loader.stats().meshes == 1 && loader.stats().bytes == blob.size());
+
+    check(loader.release(id, callbacks));
+    check(store.destroyed == 0);
+    check(loader.release(id, callbacks));
+    check(store.destroyed == 1);
+    check(loader.release(id, callbacks) == false);
+  }
+  remove(path);
+}
+} // namespace
+
+int main()
+{
+  test_sharing();
+  test_collision();
+  test_cooked_content();
+  test_loader();
+  return test_result();
+}
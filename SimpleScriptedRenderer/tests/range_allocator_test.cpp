@@ -0,0 +1,148 @@
+#include "range_allocator.hpp"
+#include "test.hpp"
+
+namespace
+{
+using range_move = range_allocator::range_move;
+
+void test_best_fit()
+{
+  range_allocator a;
+  a.init(100);
+  const u32 r0 = a.allocate(10);
+  const u32 r1 = a.allocate(30);
+  const u32 r2 = a.allocate(10);
+  const u32 r3 = a.allocate(20);
+  const u32 r4 = a.allocate(10);
+  check(r0 == 0 && r1 == 10 && r2 == 40 && r3 == 50 && r4 == 70);
+  check(a.free_count() == 20);
+
+  // Holes of 30, 20 and 20 at the end.
+  a.release(r1, 30);
+  a.release(r3, 20);
+  check(a.free_range_count() == 3);
+
+  // The smallest range which fits wins, the first one of equal ones.
+  check(a.allocate(15) == 50);
+  check(a.allocate(25) == 10);
+  check(a.allocate(20) == 80);
+  // Leftovers of 5 at 65 and 35.
+  check(a.free_count() == 10);
+  check(a.allocate(6) == range_allocator::INVALID_OFFSET);
+  check(a.allocate(5) == 35);
+  check(a.allocate(5) == 65);
+  check(a.free_count() == 0);
+  check(a.free_range_count() == 0);
+  check(a.allocate(1) == range_allocator::INVALID_OFFSET);
+}
+
+void test_coalescing()
+{
+  range_allocator a;
+  a.init(60);
+  u32 offsets[6];
+  for (u32 i = 0; i < 6; i++)
+    offsets[i] = a.allocate(10);
+  check(a.free_count() == 0);
+
+  // Out of order, merging with the next, the previous and both neighbours.
+  a.release(offsets[4], 10);
+  a.release(offsets[1], 10);
+  check(a.free_range_count() == 2);
+  a.release(offsets[3], 10);
+  check(a.free_range_count() == 2);
+  a.release(offsets[0], 10);
+  check(a.free_range_count() == 2);
+  check(a.largest_free_range() == 20);
+  a.release(offsets[2], 10);
+  check(a.free_range_count() == 1);
+  check(a.largest_free_range() == 50);
+  a.release(offsets[5], 10);
+  check(a.free_range_count() == 1);
+  check(a.free_count() == 60);
+  check(a.allocate(60) == 0);
+}
+
+void test_compact()
+{
+  range_allocator a;
+  a.init(100);
+  u32 offsets[10];
+  for (u32 i = 0; i < 10; i++)
+    offsets[i] = a.allocate(10);
+  a.release(offsets[0], 10);
+  a.release(offsets[3], 10);
+  a.release(offsets[4], 10);
+  a.release(offsets[8], 10);
+  check(a.free_range_count() == 3);
+
+  vector<range_move> moves;
+  a.compact(moves);
+  // [10, 30) to 0, [50, 80) to 20, [90, 100) to 50.
+  check(moves.size() == 3);
+  if (moves.size() == 3)
+  {
+    check(moves[0].src == 10 && moves[0].dst == 0 && moves[0].count == 20);
+    check(moves[1].src == 50 && moves[1].dst == 20 && moves[1].count == 30);
+    check(moves[2].src == 90 && moves[2].dst == 50 && moves[2].count == 10);
+  }
+  check(a.free_range_count() == 1);
+  check(a.free_count() == 40);
+  check(a.largest_free_range() == 40);
+  check(a.allocate(40) == 60);
+
+  // Packed arena moves nothing.
+  a.compact(moves);
+  check(moves.size() == 0);
+  check(a.free_range_count() == 0);
+
+  // Allocations already at the start stay where they are.
+  range_allocator b;
+  b.init(50);
+  b.allocate(20);
+  const u32 tail = b.allocate(10);
+  b.release(tail, 10);
+  b.compact(moves);
+  check(moves.size() == 0);
+  check(b.free_range_count() == 1);
+  check(b.allocate(30) == 20);
+}
+
+void test_fragmentation()
+{
+  range_allocator a;
+  a.init(100);
+  check(a.fragmentation() == 0.0f);
+  u32 offsets[10];
+  for (u32 i = 0; i < 10; i++)
+    offsets[i] = a.allocate(10);
+  // Full arena has no free space to scatter.
+  check(a.fragmentation() == 0.0f);
+
+  // Every other range free, 50 free in ranges of 10.
+  for (u32 i = 0; i < 10; i += 2)
+    a.release(offsets[i], 10);
+  check(a.free_count() == 50);
+  check(a.largest_free_range() == 10);
+  check(a.fragmentation() == 1.0f - 10.0f / 50.0f);
+
+  // One range of 50 and two of 10.
+  a.release(offsets[1], 10);
+  a.release(offsets[3], 10);
+  check(a.largest_free_range() == 50);
+  check(a.fragmentation() == 1.0f - 50.0f / 70.0f);
+
+  vector<range_move> moves;
+  a.compact(moves);
+  check(a.fragmentation() == 0.0f);
+}
+} // namespace
+
+int main()
+{
+  test_best_fit();
+  test_coalescing();
+  test_compact();
+  test_fragmentation();
+  return test_result();
+}
@@ -0,0 +1,273 @@
+#include "render_commands.hpp"
+#include "test.hpp"
+
+namespace
+{
+constexpr u32 PACKET_COUNT = 1000;
+constexpr u32 PASS_COUNT = 3;
+constexpr u32 PIPELINE_COUNT = 5;
+constexpr u32 MESH_COUNT = 7;
+
+using command_type = recording_backend::command_type;
+
+u32 g_random = 12345;
+
+u32 next_random()
+{
+  g_random = g_random * 1664525u + 1013904223u;
+  return g_random >> 8;
+}
+
+struct test_object
+{
+  u32 pass;
+  u32 pipeline;
+  u32 mesh;
+  f32 depth;
+  u64 key;
+};
+
+// Appends objects with many duplicate keys and pushes them in shuffled order. The first constant
+// holds the object id, and so does first_index unless draws are meant to be instanced,
+// so the draws the backend receives name their objects.
+void record(command_buffer& buffer, vector<test_object>& objects, u32 count, bool instanced)
+{
+  const u32 first = objects.size();
+  for (u32 i = 0; i < count; i++)
+  {
+    test_object o;
+    o.pass = next_random() % PASS_COUNT;
+    o.pipeline = next_random() % PIPELINE_COUNT;
+    o.mesh = next_random() % MESH_COUNT;
+    o.depth = (f32)(next_random() % 16) * 0.25f;
+    o.key = make_sort_key(o.pass, o.pipeline, o.mesh, o.depth);
+    objects.push_back(o);
+  }
+
+  vector<u32> shuffled;
+  for (u32 i = 0; i < count; i++)
+    shuffled.push_back(first + i);
+  for (u32 i = count; i > 1; i--)
+  {
+    const u32 j = next_random() % i;
+    const u32 t = shuffled[i - 1];
+    shuffled[i - 1] = shuffled[j];
+    shuffled[j] = t;
+  }
+
+  buffer.clear();
+  for (u32 i = 0; i < count; i++)
+  {
+    const test_object& o = objects[shuffled[i]];
+    const f32 constants[4] = { (f32)shuffled[i], 0.0f, 0.0f, 0.0f };
+    draw_packet p = {};
+    p.pass = o.pass;
+    p.pipeline = o.pipeline;
+    p.mesh = o.mesh;
+    p.index_count = 36;
+    p.first_index = instanced ? 0 : shuffled[i];
+    p.constants_offset = buffer.push_constants(constants, sizeof(constants));
+    p.constants_size = sizeof(constants);
+    p.object = shuffled[i];
+    buffer.push_draw(o.key, p);
+  }
+}
+
+// Object ids of draws in the order the backend received them.
+void drawn_objects(recording_backend const& backend, vector<u32>& out)
+{
+  out.clear();
+  for (u32 i = 0; i < backend.commands.size(); i++)
+  {
+    if (backend.commands[i].type == command_type::draw_indexed)
+      out.push_back(backend.commands[i].args[1]);
+  }
+}
+
+bool keys_sorted(vector<test_object> const& objects, vector<u32> const& order)
+{
+  for (u32 i = 1; i < order.size(); i++)
+  {
+    if (objects[order[i - 1]].key > objects[order[i]].key)
+      return false;
+  }
+  return true;
+}
+
+// Runs of equal state in an order sorted by key, the minimum number of changes.
+void count_runs(vector<test_object> const& objects, vector<u32> const& order, submit_stats& out)
+{
+  out = {};
+  for (u32 i = 0; i < order.size(); i++)
+  {
+    const test_object& o = objects[order[i]];
+    const test_object* prev = i > 0 ? &objects[order[i - 1]] : nullptr;
+    const bool new_pass = prev == nullptr || prev->pass != o.pass;
+    const bool new_pipeline = new_pass || prev->pipeline != o.pipeline;
+    out.pass_changes += new_pass;
+    out.pipeline_changes += new_pipeline;
+    out.mesh_changes += new_pipeline || prev->mesh != o.mesh;
+  }
+}
+
+void test_sort_and_submit()
+{
+  command_buffer buffer;
+  vector<test_object> objects;
+  record(buffer, objects, PACKET_COUNT, false);
+  buffer.sort();
+
+  recording_backend backend;
+  submit_stats stats;
+  buffer.submit(backend, &stats);
+
+  vector<u32> order;
+  drawn_objects(backend, order);
+  check(order.size() == PACKET_COUNT);
+  check(keys_sorted(objects, order));
+  // Every object is drawn exactly once.
+  vector<u8> seen;
+  seen.resize(PACKET_COUNT, 0);
+  bool once = true;
+  for (u32 i = 0; i < order.size(); i++)
+  {
+    once = once && order[i] < PACKET_COUNT && seen[order[i]] == 0;
+    if (order[i] < PACKET_COUNT)
+      seen[order[i]] = 1;
+  }
+  check(once);
+
+  submit_stats expected;
+  count_runs(objects, order, expected);
+  check(stats.pass_changes == expected.pass_changes);
+  check(stats.pipeline_changes == expected.pipeline_changes);
+  check(stats.mesh_changes == expected.mesh_changes);
+  check(stats.draws == PACKET_COUNT);
+  check(backend.count(command_type::begin_pass) == PASS_COUNT);
+  check(backend.count(command_type::set_pipeline) == expected.pipeline_changes);
+  check(backend.count(command_type::set_mesh) == expected.mesh_changes);
+  check(backend.count(command_type::set_object_constants) == PACKET_COUNT);
+  // Far fewer state changes than draws, and no more than one per distinct state.
+  check(expected.pipeline_changes <= PASS_COUNT * PIPELINE_COUNT);
+  check(expected.mesh_changes <= PASS_COUNT * PIPELINE_COUNT * MESH_COUNT);
+
+  // State is set before the draws which use it.
+  u32 pass = (u32)-1;
+  u32 pipeline = (u32)-1;
+  u32 mesh = (u32)-1;
+  bool state_matches = true;
+  for (u32 i = 0; i < backend.commands.size(); i++)
+  {
+    const recording_backend::command& c = backend.commands[i];
+    if (c.type == command_type::begin_pass)
+      pass = c.args[0];
+    else if (c.type == command_type::set_pipeline)
+      pipeline = c.args[0];
+    else if (c.type == command_type::set_mesh)
+      mesh = c.args[0];
+    else if (c.type == command_type::draw_indexed)
+    {
+      const test_object& o = objects[c.args[1]];
+      state_matches = state_matches && o.pass == pass && o.pipeline == pipeline && o.mesh == mesh;
+    }
+  }
+  check(state_matches);
+}
+
+void test_stable_sort()
+{
+  // Only the low byte of depth varies, equal keys keep the recording order.
+  command_buffer buffer;
+  for (u32 i = 0; i < 64; i++)
+  {
+    draw_packet p = {};
+    p.pass = 1;
+    p.pipeline = 2;
+    p.mesh = 3;
+    p.first_index = i;
+    buffer.push_draw(make_sort_key(1, 2, 3, 0.0f) | (u64)((63 - i) / 4), p);
+  }
+  buffer.sort();
+  recording_backend backend;
+  submit_stats stats;
+  buffer.submit(backend, &stats);
+  vector<u32> order;
+  drawn_objects(backend, order);
+  bool expected_order = order.size() == 64;
+  for (u32 i = 0; expected_order && i < 64; i++)
+  {
+    // Groups of 4 with descending keys, ascending ids within a group.
+    const u32 group = 15 - i / 4;
+    expected_order = order[i] == group * 4 + i % 4;
+  }
+  check(expected_order);
+  check(stats.pass_changes == 1 && stats.pipeline_changes == 1 && stats.mesh_changes == 1);
+}
+
+void test_merge()
+{
+  // Buffers recorded by different threads, sorted separately.
+  command_buffer buffers[3];
+  vector<test_object> objects;
+  for (u32 i = 0; i < 3; i++)
+  {
+    record(buffers[i], objects, 200 + i * 50, false);
+    buffers[i].sort();
+  }
+  command_buffer merged;
+  merged.merge(buffers, 3);
+  check(merged.packet_count() == objects.size());
+
+  recording_backend backend;
+  submit_stats stats;
+  merged.submit(backend, &stats);
+  vector<u32> order;
+  drawn_objects(backend, order);
+  check(order.size() == objects.size());
+  check(keys_sorted(objects, order));
+
+  submit_stats expected;
+  count_runs(objects, order, expected);
+  check(stats.pass_changes == PASS_COUNT);
+  check(stats.pipeline_changes == expected.pipeline_changes);
+  check(stats.mesh_changes == expected.mesh_changes);
+}
+
+void test_instanced()
+{
+  command_buffer buffer;
+  vector<test_object> objects;
+  record(buffer, objects, PACKET_COUNT, true);
+  buffer.sort();
+  buffer.build_instance_batches();
+
+  recording_backend backend;
+  submit_stats stats;
+  buffer.submit_instanced(backend, &stats);
+
+  // Instance data is in sorted order, draws only differ in state, so there is one batch per state.
+  vector<u32> order;
+  const f32* instances = reinterpret_cast<const f32*>(buffer.instance_data().data());
+  for (u32 i = 0; i < PACKET_COUNT; i++)
+    order.push_back((u32)instances[i * 4]);
+  check(keys_sorted(objects, order));
+  submit_stats expected;
+  count_runs(objects, order, expected);
+  check(buffer.instance_batches().size() == expected.mesh_changes);
+  check(stats.draws == expected.mesh_changes);
+  check(stats.instances == PACKET_COUNT);
+  check(stats.pipeline_changes == expected.pipeline_changes);
+  check(backend.count(command_type::set_instance_data) == 1);
+  check(backend.count(command_type::set_mesh) == expected.mesh_changes);
+  check(backend.count(command_type::draw_indexed_instanced) == expected.mesh_changes);
+}
+} // namespace
+
+int main()
+{
+  test_sort_and_submit();
+  test_stable_sort();
+  test_merge();
+  test_instanced();
+  return test_result();
+}
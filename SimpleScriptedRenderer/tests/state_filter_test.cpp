@@ -0,0 +1,235 @@
+#include "state_filter.hpp"
+#include "test.hpp"
+
+namespace
+{
+// Counts calls which reach the device context.
+class mock_context : public render_context
+{
+public:
+  void set_render_target(void*, void*) override
+  {
+    calls++;
+  }
+  void set_viewport(viewport const&) override
+  {
+    calls++;
+  }
+  void set_blend_state(void*) override
+  {
+    calls++;
+  }
+  void set_depth_stencil_state(void*) override
+  {
+    calls++;
+  }
+  void set_rasterizer_state(void*) override
+  {
+    calls++;
+  }
+  void set_input_layout(void*) override
+  {
+    calls++;
+  }
+  void set_primitive_topology(u32) override
+  {
+    calls++;
+  }
+  void set_vertex_buffer(u32, void*, u32, u32 offset) override
+  {
+    calls++;
+    last_offset = offset;
+  }
+  void set_index_buffer(void*, u32, u32) override
+  {
+    calls++;
+  }
+  void set_vertex_shader(void* shader) override
+  {
+    calls++;
+    last_shader = shader;
+  }
+  void set_pixel_shader(void*) override
+  {
+    calls++;
+  }
+  void set_vs_constant_buffer(u32, void*) override
+  {
+    calls++;
+    whole_buffer_binds++;
+  }
+  void set_vs_constant_buffer_range(u32, void*, u32, u32) override
+  {
+    calls++;
+    range_binds++;
+  }
+  void set_ps_constant_buffer(u32, void*) override
+  {
+    calls++;
+  }
+
+  u32 calls = 0;
+  u32 whole_buffer_binds = 0;
+  u32 range_binds = 0;
+  u32 last_offset = 0;
+  void* last_shader = nullptr;
+};
+
+// Distinct fake object handles, never dereferenced.
+void* handle(size_t value)
+{
+  return reinterpret_cast<void*>(value);
+}
+
+void test_repeated_binds()
+{
+  mock_context context;
+  state_filter filter{ context };
+
+  // First bind of every kind is forwarded, even of null.
+  filter.set_vertex_shader(nullptr);
+  check(context.calls == 1);
+  filter.set_vertex_shader(handle(1));
+  filter.set_vertex_shader(handle(1));
+  filter.set_vertex_shader(handle(1));
+  check(context.calls == 2);
+  check(context.last_shader == handle(1));
+  check(filter.issued() == 2);
+  check(filter.skipped() == 2);
+
+  filter.set_pixel_shader(handle(2));
+  filter.set_blend_state(handle(3));
+  filter.set_depth_stencil_state(handle(4));
+  filter.set_rasterizer_state(handle(5));
+  filter.set_input_layout(handle(6));
+  filter.set_primitive_topology(4);
+  filter.set_render_target(handle(7), handle(8));
+  filter.set_index_buffer(handle(9), 42, 0);
+  check(context.calls == 10);
+  for (u32 i = 0; i < 3; i++)
+  {
+    filter.set_pixel_shader(handle(2));
+    filter.set_blend_state(handle(3));
+    filter.set_depth_stencil_state(handle(4));
+    filter.set_rasterizer_state(handle(5));
+    filter.set_input_layout(handle(6));
+    filter.set_primitive_topology(4);
+    filter.set_render_target(handle(7), handle(8));
+    filter.set_index_buffer(handle(9), 42, 0);
+  }
+  check(context.calls == 10);
+  check(filter.issued() == 10);
+  check(filter.skipped() == 2 + 3 * 8);
+  check(filter.issued() == context.calls);
+}
+
+void test_changed_binds()
+{
+  mock_context context;
+  state_filter filter{ context };
+
+  filter.set_vertex_shader(handle(1));
+  filter.set_vertex_shader(handle(2));
+  filter.set_vertex_shader(handle(1));
+  check(context.calls == 3);
+  check(context.last_shader == handle(1));
+
+  // Any differing argument counts.
+  filter.set_vertex_buffer(0, handle(3), 32, 0);
+  filter.set_vertex_buffer(0, handle(3), 32, 64);
+  check(context.last_offset == 64);
+  filter.set_vertex_buffer(0, handle(3), 16, 64);
+  filter.set_vertex_buffer(0, handle(3), 16, 64);
+  check(context.calls == 6);
+  filter.set_render_target(handle(4), nullptr);
+  filter.set_render_target(handle(4), handle(5));
+  filter.set_index_buffer(handle(6), 1, 0);
+  filter.set_index_buffer(handle(6), 2, 0);
+  check(context.calls == 10);
+
+  render_context::viewport vp = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+  filter.set_viewport(vp);
+  filter.set_viewport(vp);
+  vp.max_depth = 0.5f;
+  filter.set_viewport(vp);
+  check(context.calls == 12);
+  check(filter.skipped() == 2);
+  check(filter.issued() == context.calls);
+}
+
+void test_slots()
+{
+  mock_context context;
+  state_filter filter{ context };
+
+  // Slots are shadowed separately.
+  filter.set_vertex_buffer(0, handle(1), 32, 0);
+  filter.set_vertex_buffer(1, handle(1), 32, 0);
+  filter.set_vertex_buffer(0, handle(1), 32, 0);
+  filter.set_vertex_buffer(1, handle(1), 32, 0);
+  check(context.calls == 2);
+  for (u32 slot = 0; slot < render_context::MAX_CONSTANT_BUFFERS; slot++)
+  {
+    filter.set_vs_constant_buffer(slot, handle(2));
+    filter.set_ps_constant_buffer(slot, handle(2));
+  }
+  check(context.calls == 2 + 2 * render_context::MAX_CONSTANT_BUFFERS);
+  filter.set_ps_constant_buffer(3, handle(2));
+  filter.set_ps_constant_buffer(3, handle(3));
+  check(context.calls == 3 + 2 * render_context::MAX_CONSTANT_BUFFERS);
+
+  // Ranges of one buffer are different bindings, and so is the whole buffer after a range.
+  context.calls = 0;
+  context.whole_buffer_binds = 0;
+  filter.reset_counters();
+  filter.set_vs_constant_buffer(0, handle(4));
+  filter.set_vs_constant_buffer_range(0, handle(4), 0, 16);
+  filter.set_vs_constant_buffer_range(0, handle(4), 0, 16);
+  filter.set_vs_constant_buffer_range(0, handle(4), 16, 16);
+  filter.set_vs_constant_buffer_range(0, handle(4), 16, 32);
+  filter.set_vs_constant_buffer(0, handle(4));
+  filter.set_vs_constant_buffer(0, handle(4));
+  check(context.whole_buffer_binds == 2);
+  check(context.range_binds == 3);
+  check(context.calls == 5);
+  check(filter.issued() == 5);
+  check(filter.skipped() == 2);
+}
+
+void test_invalidate()
+{
+  mock_context context;
+  state_filter filter{ context };
+  filter.set_vertex_shader(handle(1));
+  filter.set_primitive_topology(4);
+  filter.set_vs_constant_buffer_range(2, handle(2), 0, 16);
+  check(context.calls == 3);
+
+  // State changed behind the filter's back, everything is bound again.
+  filter.invalidate();
+  filter.set_vertex_shader(handle(1));
+  filter.set_primitive_topology(4);
+  filter.set_vs_constant_buffer_range(2, handle(2), 0, 16);
+  check(context.calls == 6);
+  filter.set_vertex_shader(handle(1));
+  filter.set_primitive_topology(4);
+  filter.set_vs_constant_buffer_range(2, handle(2), 0, 16);
+  check(context.calls == 6);
+
+  filter.reset_counters();
+  check(filter.issued() == 0);
+  check(filter.skipped() == 0);
+  filter.set_vertex_shader(handle(1));
+  check(filter.issued() == 0);
+  check(filter.skipped() == 1);
+}
+} // namespace
+
+int main()
+{
+  test_repeated_binds();
+  test_changed_binds();
+  test_slots();
+  test_invalidate();
+  return test_result();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdio.h>
+#include "types.hpp"
+
+// Checks of the test programs of the CMake build, which run with ctest.
+// Unlike my_assert they are active in every configuration. A failed check prints itself and
+// the test goes on, main returns test_result().
+
+namespace detail
+{
+  inline u32 g_test_failures = 0;
+
+  inline void test_failed(const char* expr, const char* file, int line)
+  {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    g_test_failures++;
+  }
+} // namespace detail
+
+#define check(x) \
+do { if (!(x)) { detail::test_failed(#x, __FILE__, __LINE__); } } while(0)
+
+inline int test_result()
+{
+  if (detail::g_test_failures > 0)
+  {
+    fprintf(stderr, "%u checks failed\n", detail::g_test_failures);
+    return 1;
+  }
+  return 0;
+}
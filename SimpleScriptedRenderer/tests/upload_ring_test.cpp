@@ -0,0 +1,176 @@
+#include "test.hpp"
+#include "upload_ring.hpp"
+#include "vector.hpp"
+
+namespace
+{
+constexpr u32 A = upload_ring::ALIGNMENT;
+
+void test_alignment()
+{
+  upload_ring ring;
+  ring.init(16 * A);
+  const u32 a = ring.allocate(1);
+  const u32 b = ring.allocate(A + 1);
+  const u32 c = ring.allocate(A);
+  check(a == 0);
+  check(b == A);
+  check(c == 3 * A);
+  check(ring.used() == 4 * A);
+  // Empty allocations take no space.
+  check(ring.allocate(0) == 4 * A);
+  check(ring.used() == 4 * A);
+}
+
+void test_wrap_around()
+{
+  upload_ring ring;
+  ring.init(8 * A);
+  check(ring.allocate(3 * A) == 0);
+  ring.end_frame(1);
+  check(ring.allocate(3 * A) == 3 * A);
+  ring.end_frame(2);
+  ring.retire(1);
+  check(ring.used() == 3 * A);
+
+  // Two blocks are left before the end, the allocation restarts from zero and the tail is skipped.
+  check(ring.allocate(3 * A) == 0);
+  check(ring.used() == 8 * A);
+  ring.end_frame(3);
+  ring.retire(2);
+  // The skipped tail is released with the frame which skipped it.
+  check(ring.used() == 5 * A);
+  ring.retire(3);
+  check(ring.used() == 0);
+
+  // Allocation which ends exactly at the end of the buffer doesn't skip anything.
+  upload_ring exact;
+  exact.init(4 * A);
+  check(exact.allocate(2 * A) == 0);
+  check(exact.allocate(2 * A) == 2 * A);
+  exact.end_frame(1);
+  exact.retire(1);
+  check(exact.allocate(4 * A) == 0);
+}
+
+void test_unretired_frames()
+{
+  upload_ring ring;
+  ring.init(8 * A);
+  check(ring.allocate(4 * A) == 0);
+  ring.end_frame(1);
+  check(ring.allocate(3 * A) == 4 * A);
+  ring.end_frame(2);
+  check(ring.frames_in_flight() == 2);
+
+  // One free block, anything larger would overwrite frame 1.
+  check(ring.allocate(2 * A) == upload_ring::INVALID_OFFSET);
+  check(ring.allocate(A) == 7 * A);
+  check(ring.allocate(1) == upload_ring::INVALID_OFFSET);
+  check(ring.used() == 8 * A);
+  // Fences older than both frames release nothing.
+  ring.retire(0);
+  check(ring.frames_in_flight() == 2);
+  check(ring.allocate(1) == upload_ring::INVALID_OFFSET);
+
+  // Retiring frame 1 makes its memory available, frame 2 stays.
+  ring.retire(1);
+  check(ring.frames_in_flight() == 1);
+  check(ring.used() == 4 * A);
+  check(ring.allocate(5 * A) == upload_ring::INVALID_OFFSET);
+  check(ring.allocate(4 * A) == 0);
+  ring.end_frame(3);
+
+  // One fence can retire several frames.
+  ring.retire(3);
+  check(ring.frames_in_flight() == 0);
+  check(ring.used() == 0);
+}
+
+void test_retire_frees_space()
+{
+  upload_ring ring;
+  ring.init(8 * A);
+  check(ring.allocate(3 * A) == 0);
+  ring.end_frame(1);
+  ring.retire(1);
+  check(ring.used() == 0);
+  // Empty ring fits an allocation of its full capacity, wherever the previous frames ended.
+  check(ring.allocate(8 * A) == 0);
+  ring.end_frame(2);
+  ring.retire(2);
+  check(ring.allocate(A) == 0);
+}
+
+// Frames of random sizes, retired a few frames late like a GPU would. No allocation may overlap
+// memory of a frame which is not retired.
+void test_random_frames()
+{
+  struct allocation
+  {
+    u64 fence;
+    u32 offset;
+    u32 size;
+  };
+
+  upload_ring ring;
+  ring.init(64 * A);
+  vector<allocation> live;
+  u32 random = 1;
+  u32 failed = 0;
+  bool overlaps = false;
+  bool in_bounds = true;
+  for (u64 fence = 1; fence <= 2000; fence++)
+  {
+    const u32 count = 1 + random % 6;
+    for (u32 i = 0; i < count; i++)
+    {
+      random = random * 1664525u + 1013904223u;
+      const u32 size = 1 + (random >> 8) % (12 * A);
+      const u32 offset = ring.allocate(size);
+      if (offset == upload_ring::INVALID_OFFSET)
+      {
+        failed++;
+        continue;
+      }
+      const u32 aligned = (size + A - 1) & ~(A - 1);
+      in_bounds = in_bounds && offset % A == 0 && offset + aligned <= ring.capacity();
+      for (u32 j = 0; j < live.size(); j++)
+        overlaps = overlaps || (offset < live[j].offset + live[j].size && live[j].offset < offset + aligned);
+      live.push_back({ fence, offset, aligned });
+    }
+    ring.end_frame(fence);
+
+    // GPU is three frames behind.
+    if (fence > 3)
+    {
+      ring.retire(fence - 3);
+      u32 kept = 0;
+      for (u32 j = 0; j < live.size(); j++)
+      {
+        if (live[j].fence > fence - 3)
+          live[kept++] = live[j];
+      }
+      while (live.size() > kept)
+        live.pop_back();
+    }
+    check(ring.frames_in_flight() <= 3);
+  }
+  check(in_bounds);
+  check(overlaps == false);
+  // Sizes are picked so the ring fills up sometimes.
+  check(failed > 0);
+  ring.retire(2000);
+  check(ring.used() == 0);
+}
+} // namespace
+
+int main()
+{
+  test_alignment();
+  test_wrap_around();
+  test_unretired_frames();
+  test_retire_frees_space();
+  test_random_frames();
+  return test_result();
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.hpp"
+#include "cooked_mesh.hpp"
+#include "cooked_texture.hpp"
+#include "jobs.hpp"
+#include "mapped_file.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "platform.hpp"
+#include "tools.hpp"
+#include "vector.hpp"
+
+int run_replay(const char* path)
+{
+  vector<u8> data;
+  if (!read_capture_file(path, data))
+  {
+    fprintf(stderr, "error: can not read %s\n", path);
+    return 1;
+  }
+
+  recording_backend backend;
+  vector<replay_frame_stats> frames;
+  if (!replay_capture(data.data(), data.size(), backend, frames))
+  {
+    fprintf(stderr, "error: %s is not a valid capture\n", path);
+    return 1;
+  }
+
+  printf("%-8s %8s %8s %8s %10s %12s %10s\n", "frame", "commands", "draws", "states", "instances", "upload bytes",
+         "cpu ms");
+  replay_frame_stats total;
+  for (u32 i = 0; i < frames.size(); i++)
+  {
+    const replay_frame_stats& f = frames[i];
+    u32 commands = 0;
+    for (u32 op = 0; op < (u32)capture_op::count; op++)
+    {
+      commands += f.commands[op];
+      total.commands[op] += f.commands[op];
+    }
+    total.upload_bytes += f.upload_bytes;
+    total.cpu_time += f.cpu_time;
+    const u32 draws = f.commands[(u32)capture_op::draw_indexed] + f.commands[(u32)capture_op::draw_indexed_instanced];
+    const u32 states = f.commands[(u32)capture_op::set_pipeline] + f.commands[(u32)capture_op::set_mesh];
+    printf("%-8u %8u %8u %8u %10u %12llu %10.4f\n", f.frame, commands, draws, states,
+           f.commands[(u32)capture_op::set_instance_data], (unsigned long long)f.upload_bytes, f.cpu_time * 1000.0);
+  }
+
+  const u32 frame_count = frames.size() > 0 ? frames.size() : 1;
+  printf("%u frames, %u bytes\n", frames.size(), data.size());
+  for (u32 op = 0; op < (u32)capture_op::count; op++)
+  {
+    static const char* const OP_NAMES[(u32)capture_op::count] = {
+      "begin_frame", "end_frame", "create_buffer", "upload", "begin_pass", "set_pipeline", "set_mesh",
+      "set_object_constants", "draw_indexed", "set_instance_data", "draw_indexed_instanced"
+    };
+    printf("%-24s %10u %10.1f per frame\n", OP_NAMES[op], total.commands[op], (f64)total.commands[op] / frame_count);
+  }
+  printf("upload: %.1f bytes per frame\n", (f64)total.upload_bytes / frame_count);
+  printf("cpu: %.4f ms per frame\n", total.cpu_time * 1000.0 / frame_count);
+  return 0;
+}
+
+int run_cook(const char* obj_path, const char* mesh_path)
+{
+  const f64 start_time = platform::seconds();
+  mesh_lod lods[MAX_LODS];
+  if (import_obj(obj_path, lods[0]) == false)
+  {
+    fprintf(stderr, "error: can not import %s\n", obj_path);
+    return 1;
+  }
+  const f64 import_time = platform::seconds() - start_time;
+  const u32 lod_count = generate_lod_chain(lods, LOD_CHAIN_RATIOS, LOD_CHAIN_LEVELS);
+  for (u32 i = 0; i < lod_count; i++)
+    optimize_mesh(lods[i]);
+  const f64 process_time = platform::seconds() - start_time - import_time;
+  if (write_cooked_mesh(mesh_path, lods, lod_count) == false)
+  {
+    fprintf(stderr, "error: can not write %s\n", mesh_path);
+    return 1;
+  }
+
+  for (u32 i = 0; i < lod_count; i++)
+    printf("lod %u: %u vertices, %u triangles, error %.3e\n", i, lods[i].vertices.size(), lods[i].indices.size() / 3,
+           lods[i].error);
+  printf("import: %.3f ms, levels and optimization: %.3f ms, total: %.3f ms\n", import_time * 1000.0,
+         process_time * 1000.0, (platform::seconds() - start_time) * 1000.0);
+  return 0;
+}
+
+int run_load_benchmark(const char* mesh_path, u32 count)
+{
+  // Copies are separate files, so that every load opens and maps its own file.
+  vector<u8> blob;
+  {
+    mapped_file file;
+    cooked_mesh mesh;
+    if (open_cooked_mesh(mesh_path, file, mesh) == false)
+    {
+      fprintf(stderr, "error: %s is not a valid mesh\n", mesh_path);
+      return 1;
+    }
+    blob = vector<u8>{ file.data(), (u32)file.size() };
+  }
+  char path[1024];
+  for (u32 i = 0; i < count; i++)
+  {
+    snprintf(path, sizeof(path), "%s.%u", mesh_path, i);
+    FILE* f = fopen(path, "wb");
+    const bool ok = f != nullptr && fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+    if (f == nullptr || fclose(f) != 0 || !ok)
+    {
+      fprintf(stderr, "error: can not write %s\n", path);
+      return 1;
+    }
+  }
+
+  // Mapping and validation is what the GPU upload path waits for, occluder triangles are copied on top of it.
+  f64 map_time = 0.0;
+  f64 copy_time = 0.0;
+  u64 bytes = 0;
+  u64 checksum = 0;
+  u32 loaded = 0;
+  const f64 start_time = platform::seconds();
+  for (u32 i = 0; i < count; i++)
+  {
+    snprintf(path, sizeof(path), "%s.%u", mesh_path, i);
+    f64 t = platform::seconds();
+    mapped_file file;
+    cooked_mesh mesh;
+    if (file.open(path) == false || view_cooked_mesh(file.data(), file.size(), mesh) == false)
+      continue;
+    // Touches every page like an upload would.
+    for (u64 offset = 0; offset < file.size(); offset += 4096)
+      checksum += file.data()[offset];
+    const f64 mapped = platform::seconds();
+    map_time += mapped - t;
+    const vertex_data vd = make_vertex_data(mesh);
+    checksum += vd.vertex_count + meshlet_count(vd);
+    copy_time += platform::seconds() - mapped;
+    bytes += file.size();
+    loaded++;
+  }
+  const f64 total_time = platform::seconds() - start_time;
+
+  for (u32 i = 0; i < count; i++)
+  {
+    snprintf(path, sizeof(path), "%s.%u", mesh_path, i);
+    remove(path);
+  }
+
+  printf("%u of %u meshes loaded, %u bytes each, checksum %llu\n", loaded, count, blob.size(),
+         (unsigned long long)checksum);
+  printf("map and validate: %.3f ms, %.2f GB/s\n", map_time * 1000.0, (f64)bytes / map_time * 1e-9);
+  printf("cpu copies: %.3f ms, %.2f GB/s\n", copy_time * 1000.0, (f64)bytes / copy_time * 1e-9);
+  printf("startup: %.3f ms, %.2f us per mesh, %.2f GB/s\n", total_time * 1000.0, total_time * 1e6 / count,
+         (f64)bytes / total_time * 1e-9);
+  return loaded == count ? 0 : 1;
+}
+
+int run_texture_cook(const char* const* paths, u32 count)
+{
+  // Outputs replace the extension of sources with ".tex".
+  vector<char> names;
+  vector<u32> name_offsets;
+  for (u32 i = 0; i < count; i++)
+  {
+    const char* dot = strrchr(paths[i], '.');
+    const char* slash = strrchr(paths[i], '/');
+    const char* backslash = strrchr(paths[i], '\\');
+    const bool has_extension = dot != nullptr && dot > slash && dot > backslash;
+    const u32 stem = has_extension ? (u32)(dot - paths[i]) : (u32)strlen(paths[i]);
+    name_offsets.push_back(names.size());
+    for (u32 c = 0; c < stem; c++)
+      names.push_back(paths[i][c]);
+    for (const char* ext = ".tex"; *ext != '\0'; ext++)
+      names.push_back(*ext);
+    names.push_back('\0');
+  }
+  vector<const char*> output_paths;
+  for (u32 i = 0; i < count; i++)
+    output_paths.push_back(names.data() + name_offsets[i]);
+
+  jobs::init();
+  texture_cook_stats stats;
+  const f64 start_time = platform::seconds();
+  cook_textures(paths, output_paths.data(), count, texture_cook_settings{}, stats);
+  const f64 total_time = platform::seconds() - start_time;
+  const u32 threads = jobs::thread_count();
+  jobs::shutdown();
+
+  const f64 mb = (f64)stats.source_bytes / (1024.0 * 1024.0);
+  printf("%u cooked, %u up to date, %u failed\n", stats.cooked, stats.skipped, stats.failed);
+  printf("%.2f MB of RGBA8 -> %.2f MB with mips\n", mb, (f64)stats.output_bytes / (1024.0 * 1024.0));
+  printf("decode and mips: %.3f ms, compress: %.3f ms, write: %.3f ms, total: %.3f ms\n", stats.decode_time * 1000.0,
+         stats.compress_time * 1000.0, stats.write_time * 1000.0, total_time * 1000.0);
+  if (stats.cooked > 0)
+  {
+    printf("%u threads, %.2f MB/s, %.2f MB/s per core\n", threads, mb / total_time, mb / total_time / threads);
+  }
+  return stats.failed > 0 ? 1 : 0;
+}
+
+int run_tool(int argc, char** argv)
+{
+  // Usage: --replay capture.bin
+  if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+    return run_replay(argv[2]);
+
+  // Usage: --cook model.obj model.mesh
+  if (argc > 3 && strcmp(argv[1], "--cook") == 0)
+    return run_cook(argv[2], argv[3]);
+
+  // Usage: --load-benchmark model.mesh [count]
+  if (argc > 2 && strcmp(argv[1], "--load-benchmark") == 0)
+    return run_load_benchmark(argv[2], argc > 3 ? (u32)atoi(argv[3]) : 10000);
+
+  // Usage: --cook-textures image.png [more images]
+  if (argc > 2 && strcmp(argv[1], "--cook-textures") == 0)
+    return run_texture_cook(argv + 2, (u32)(argc - 2));
+
+  return -1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "types.hpp"
+
+// Command-line tools: capture replay and asset cooking.
+// Need neither a graphics device nor Lua, so they are part of the portable build as ssr_tools
+// and run wherever the engine core builds. The application and the headless executable take
+// the same arguments.
+
+// Replays a render command capture into a recording backend and prints per-frame command counts,
+// uploaded bytes and CPU time, see capture.hpp.
+int run_replay(const char* path);
+
+// Cooks an OBJ file into a mesh file and prints its levels of detail, see cooked_mesh.hpp.
+int run_cook(const char* obj_path, const char* mesh_path);
+
+// Writes count copies of a mesh file, loads them all and prints startup time and throughput.
+// Copies are removed afterwards. Files are read from the page cache, so this measures the warm case.
+int run_load_benchmark(const char* mesh_path, u32 count);
+
+// Cooks images into BC compressed textures with mips next to them, see cooked_texture.hpp.
+// Prints throughput, textures which are up to date are skipped.
+int run_texture_cook(const char* const* paths, u32 count);
+
+// Runs the tool named by the first argument. Returns its exit code, or -1 when there is none.
+int run_tool(int argc, char** argv);
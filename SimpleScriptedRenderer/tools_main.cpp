@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+#include "tools.hpp"
+
+// Entry point of ssr_tools of the CMake build, see tools.hpp.
+int main(int argc, char** argv)
+{
+  const int result = run_tool(argc, argv);
+  if (result >= 0)
+    return result;
+
+  fprintf(stderr, "usage: %s --replay capture.bin\n"
+                  "       %s --cook model.obj model.mesh\n"
+                  "       %s --load-benchmark model.mesh [count]\n"
+                  "       %s --cook-textures image.png [more images]\n",
+          argv[0], argv[0], argv[0], argv[0]);
+  return 1;
+}
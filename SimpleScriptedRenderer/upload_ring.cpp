@@ -0,0 +1,55 @@
+#include "my_assert.hpp"
+#include "upload_ring.hpp"
+
+void upload_ring::init(u32 capacity)
+{
+  my_assert(capacity % ALIGNMENT == 0);
+  m_capacity = capacity;
+  m_head = 0;
+  m_used = 0;
+  m_current_frame_size = 0;
+  m_first_frame = 0;
+  m_frame_count = 0;
+}
+
+u32 upload_ring::allocate(u32 size)
+{
+  size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  // Allocation which doesn't fit before the end of the buffer starts from zero,
+  // the skipped tail counts as used by the current frame.
+  const u32 padding = m_head + size > m_capacity ? m_capacity - m_head : 0;
+  if (m_used + padding + size > m_capacity)
+    return INVALID_OFFSET;
+
+  if (padding > 0)
+    m_head = 0;
+  const u32 offset = m_head;
+  m_head += size;
+  if (m_head == m_capacity)
+    m_head = 0;
+  m_used += padding + size;
+  m_current_frame_size += padding + size;
+  return offset;
+}
+
+void upload_ring::end_frame(u64 fence)
+{
+  my_assert(m_frame_count < MAX_FRAMES_IN_FLIGHT);
+  my_assert(m_frame_count == 0 || m_frames[(m_first_frame + m_frame_count - 1) % MAX_FRAMES_IN_FLIGHT].fence < fence);
+  m_frames[(m_first_frame + m_frame_count) % MAX_FRAMES_IN_FLIGHT] = { fence, m_current_frame_size };
+  m_frame_count++;
+  m_current_frame_size = 0;
+}
+
+void upload_ring::retire(u64 completed_fence)
+{
+  while (m_frame_count > 0 && m_frames[m_first_frame].fence <= completed_fence)
+  {
+    m_used -= m_frames[m_first_frame].size;
+    m_first_frame = (m_first_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_frame_count--;
+  }
+  // Nothing is in use, allocations can start from the beginning and take the whole buffer.
+  if (m_used == 0)
+    m_head = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "types.hpp"
+
+// Suballocator of a ring buffer for per-frame GPU uploads.
+// Allocations are aligned and never wrap around the end of the buffer.
+// Memory allocated during a frame is released only when that frame's fence
+// is known to be completed, so data which GPU may still read is never overwritten.
+class upload_ring
+{
+public:
+  static constexpr u32 ALIGNMENT = 256;
+  static constexpr u32 MAX_FRAMES_IN_FLIGHT = 8;
+  static constexpr u32 INVALID_OFFSET = (u32)-1;
+
+  void init(u32 capacity);
+
+  // Returns INVALID_OFFSET if there is no room until older frames are retired.
+  u32 allocate(u32 size);
+  // Closes allocations of the current frame under the given fence value.
+  // Fence values must increase from frame to frame.
+  void end_frame(u64 fence);
+  // Releases memory of every frame whose fence is not greater than completed_fence.
+  void retire(u64 completed_fence);
+
+  u32 capacity() const
+  {
+    return m_capacity;
+  }
+
+  u32 used() const
+  {
+    return m_used;
+  }
+
+  u32 frames_in_flight() const
+  {
+    return m_frame_count;
+  }
+
+private:
+  struct frame
+  {
+    u64 fence;
+    u32 size;
+  };
+
+  u32 m_capacity = 0;
+  u32 m_head = 0;
+  u32 m_used = 0;
+  // Bytes allocated since the last end_frame(), including padding skipped at the end of the buffer.
+  u32 m_current_frame_size = 0;
+  frame m_frames[MAX_FRAMES_IN_FLIGHT];
+  u32 m_first_frame = 0;
+  u32 m_frame_count = 0;
+};
@@ -121,6 +121,18 @@ inline u64 xorshift_64(u64 seed)
   return hash;
 }
 
+// Finalizer of MurmurHash3, every bit of the seed affects every bit of the hash.
+inline u64 fmix_64(u64 seed)
+{
+  u64 hash = seed;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
 inline u32 fnv_hash_32(const char* const stream, u64 count)
 {
   static const u32 fnv_offset_basis = 0x811c9dc5;
@@ -193,4 +205,15 @@ public:
   }
 };
 
+// For keys packed from several fields, hash_map probes by the low bits of the hash only.
+template <class T>
+class mixing_hasher
+{
+public:
+  inline u64 operator()(T const& val) const
+  {
+    return fmix_64((u64)val);
+  }
+};
+
 } // namespace util
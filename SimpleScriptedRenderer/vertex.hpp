@@ -0,0 +1,53 @@
+#pragma once
+#include "my_glm.hpp"
+#include "types.hpp"
+
+// Vertex description.
+// Should include:
+//  Position, normal, tangent (binormal inferred). Common for many meshes.
+//  UV channels (texture coordinates, morph displacements). Optional.
+//  Blend weights + blend indices (for skeletal meshes). Required for skeletal meshes.
+// Preferably in separate buffers/separate parts of buffers.
+struct vertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  // RGBA8, multiplies object color. Baked into static batches, white elsewhere.
+  u32 color = 0xFFFFFFFF;
+};
+
+// Formats of vertices in GPU memory. Float format is the vertex above as is.
+// Quantized formats store positions as 16-bit fractions of the mesh bounds
+// and normals octahedral-encoded into two signed 8 or 16-bit components.
+static constexpr u32 VERTEX_FORMAT_FLOAT = 0;
+static constexpr u32 VERTEX_FORMAT_QUANTIZED_8 = 1;
+static constexpr u32 VERTEX_FORMAT_QUANTIZED_16 = 2;
+static constexpr u32 VERTEX_FORMAT_COUNT = 3;
+
+struct vertex_quantized_8
+{
+  u16 position[3];
+  i8 normal[2];
+  u32 color;
+};
+
+struct vertex_quantized_16
+{
+  u16 position[3];
+  u16 _pad0;
+  i16 normal[2];
+  u32 color;
+};
+
+inline u32 vertex_format_size(u32 format)
+{
+  switch (format)
+  {
+    case VERTEX_FORMAT_QUANTIZED_8:
+      return sizeof(vertex_quantized_8);
+    case VERTEX_FORMAT_QUANTIZED_16:
+      return sizeof(vertex_quantized_16);
+    default:
+      return sizeof(vertex);
+  }
+}
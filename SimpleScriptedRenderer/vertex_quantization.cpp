@@ -0,0 +1,173 @@
+#include <math.h>
+#include <string.h>
+
+#include "my_assert.hpp"
+#include "vertex_quantization.hpp"
+
+vertex_quantization make_vertex_quantization(vertex const* vertices, u32 count)
+{
+  vertex_quantization ret = {};
+  if (count == 0)
+    return ret;
+  glm::vec3 min = vertices[0].position;
+  glm::vec3 max = vertices[0].position;
+  for (u32 i = 1; i < count; i++)
+  {
+    min = glm::min(min, vertices[i].position);
+    max = glm::max(max, vertices[i].position);
+  }
+  ret.position_min = min;
+  ret.position_scale = max - min;
+  return ret;
+}
+
+glm::vec2 octahedral_encode(glm::vec3 n)
+{
+  const f32 l1 = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+  if (l1 == 0.0f)
+    return { 0.0f, 0.0f };
+  glm::vec2 e = glm::vec2{ n.x, n.y } / l1;
+  if (n.z < 0.0f)
+  {
+    const glm::vec2 folded = 1.0f - glm::abs(glm::vec2{ e.y, e.x });
+    e.x = e.x >= 0.0f ? folded.x : -folded.x;
+    e.y = e.y >= 0.0f ? folded.y : -folded.y;
+  }
+  return e;
+}
+
+glm::vec3 octahedral_decode(glm::vec2 e)
+{
+  glm::vec3 n = { e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y) };
+  const f32 t = glm::max(-n.z, 0.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return glm::normalize(n);
+}
+
+namespace
+{
+u16 quantize_unorm16(f32 value, f32 min, f32 scale)
+{
+  if (scale <= 0.0f)
+    return 0;
+  const f32 t = glm::clamp((value - min) / scale, 0.0f, 1.0f);
+  return (u16)(t * 65535.0f + 0.5f);
+}
+
+f32 snorm_to_float(i32 value, f32 max)
+{
+  return glm::max((f32)value / max, -1.0f);
+}
+
+// Rounding each component to nearest is not the closest normal after decoding,
+// so the four neighbouring codes are tried.
+void encode_normal(glm::vec3 n, f32 max, i32* out)
+{
+  const glm::vec2 e = octahedral_encode(n) * max;
+  const glm::vec2 lo = glm::floor(e);
+  f32 best = -2.0f;
+  for (u32 i = 0; i < 4; i++)
+  {
+    const i32 x = (i32)glm::clamp(lo.x + (f32)(i & 1), -max, max);
+    const i32 y = (i32)glm::clamp(lo.y + (f32)(i >> 1), -max, max);
+    const f32 d = glm::dot(octahedral_decode({ snorm_to_float(x, max), snorm_to_float(y, max) }), n);
+    if (d > best)
+    {
+      best = d;
+      out[0] = x;
+      out[1] = y;
+    }
+  }
+}
+} // namespace
+
+void encode_vertices(vertex const* vertices, u32 count, u32 format, vertex_quantization const& q, void* out)
+{
+  if (format == VERTEX_FORMAT_FLOAT)
+  {
+    memcpy(out, vertices, count * sizeof(vertex));
+    return;
+  }
+
+  for (u32 i = 0; i < count; i++)
+  {
+    const vertex& v = vertices[i];
+    u16 position[3];
+    for (u32 c = 0; c < 3; c++)
+      position[c] = quantize_unorm16(v.position[c], q.position_min[c], q.position_scale[c]);
+    i32 normal[2];
+    if (format == VERTEX_FORMAT_QUANTIZED_8)
+    {
+      encode_normal(glm::normalize(v.normal), 127.0f, normal);
+      vertex_quantized_8& dst = static_cast<vertex_quantized_8*>(out)[i];
+      memcpy(dst.position, position, sizeof(position));
+      dst.normal[0] = (i8)normal[0];
+      dst.normal[1] = (i8)normal[1];
+      dst.color = v.color;
+    }
+    else
+    {
+      my_assert(format == VERTEX_FORMAT_QUANTIZED_16);
+      encode_normal(glm::normalize(v.normal), 32767.0f, normal);
+      vertex_quantized_16& dst = static_cast<vertex_quantized_16*>(out)[i];
+      memcpy(dst.position, position, sizeof(position));
+      dst._pad0 = 0;
+      dst.normal[0] = (i16)normal[0];
+      dst.normal[1] = (i16)normal[1];
+      dst.color = v.color;
+    }
+  }
+}
+
+vertex decode_vertex(void const* encoded, u32 index, u32 format, vertex_quantization const& q)
+{
+  if (format == VERTEX_FORMAT_FLOAT)
+    return static_cast<vertex const*>(encoded)[index];
+
+  u16 const* position;
+  glm::vec2 normal;
+  vertex ret;
+  if (format == VERTEX_FORMAT_QUANTIZED_8)
+  {
+    const vertex_quantized_8& src = static_cast<vertex_quantized_8 const*>(encoded)[index];
+    position = src.position;
+    normal = { snorm_to_float(src.normal[0], 127.0f), snorm_to_float(src.normal[1], 127.0f) };
+    ret.color = src.color;
+  }
+  else
+  {
+    const vertex_quantized_16& src = static_cast<vertex_quantized_16 const*>(encoded)[index];
+    position = src.position;
+    normal = { snorm_to_float(src.normal[0], 32767.0f), snorm_to_float(src.normal[1], 32767.0f) };
+    ret.color = src.color;
+  }
+  const glm::vec3 t = glm::vec3{ position[0], position[1], position[2] } / 65535.0f;
+  ret.position = q.position_min + q.position_scale * t;
+  ret.normal = octahedral_decode(normal);
+  return ret;
+}
+
+vertex_encoding_error measure_encoding_error(vertex const* vertices, u32 count, u32 format,
+                                             vertex_quantization const& q, void const* encoded)
+{
+  vertex_encoding_error ret;
+  if (count == 0)
+    return ret;
+  f64 squared_position_sum = 0.0;
+  f64 normal_angle_sum = 0.0;
+  for (u32 i = 0; i < count; i++)
+  {
+    const vertex decoded = decode_vertex(encoded, i, format, q);
+    const f32 position_error = glm::length(decoded.position - vertices[i].position);
+    const f32 cos_angle = glm::clamp(glm::dot(decoded.normal, glm::normalize(vertices[i].normal)), -1.0f, 1.0f);
+    const f32 normal_error = glm::degrees(acosf(cos_angle));
+    ret.max_position_error = glm::max(ret.max_position_error, position_error);
+    ret.max_normal_error_degrees = glm::max(ret.max_normal_error_degrees, normal_error);
+    squared_position_sum += (f64)position_error * position_error;
+    normal_angle_sum += normal_error;
+  }
+  ret.rms_position_error = (f32)sqrt(squared_position_sum / count);
+  ret.mean_normal_error_degrees = (f32)(normal_angle_sum / count);
+  return ret;
+}
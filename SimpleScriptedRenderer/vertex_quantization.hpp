@@ -0,0 +1,40 @@
+#pragma once
+#include "my_glm.hpp"
+#include "types.hpp"
+#include "vertex.hpp"
+
+// Encoding of vertices into quantized formats, see vertex.hpp.
+
+// Dequantization of positions, laid out as the mesh constant buffer of the quantized vertex shaders.
+// Position is position_min + position_scale * q, where q is the stored 16-bit fraction.
+struct vertex_quantization
+{
+  glm::vec3 position_min;
+  f32 _pad0;
+  glm::vec3 position_scale;
+  f32 _pad1;
+};
+
+// Bounds of the vertices.
+vertex_quantization make_vertex_quantization(vertex const* vertices, u32 count);
+
+// Maps a unit vector onto the [-1, 1] square: the octahedron |x| + |y| + |z| = 1 is unfolded,
+// lower half folded over the diagonals.
+glm::vec2 octahedral_encode(glm::vec3 n);
+glm::vec3 octahedral_decode(glm::vec2 e);
+
+// Writes vertices in the format, out has to hold count * vertex_format_size(format) bytes.
+void encode_vertices(vertex const* vertices, u32 count, u32 format, vertex_quantization const& q, void* out);
+vertex decode_vertex(void const* encoded, u32 index, u32 format, vertex_quantization const& q);
+
+struct vertex_encoding_error
+{
+  f32 max_position_error = 0.0f;
+  f32 rms_position_error = 0.0f;
+  f32 max_normal_error_degrees = 0.0f;
+  f32 mean_normal_error_degrees = 0.0f;
+};
+
+// Compares decoded vertices with the source, position errors are in units of the mesh.
+vertex_encoding_error measure_encoding_error(vertex const* vertices, u32 count, u32 format,
+                                             vertex_quantization const& q, void const* encoded);
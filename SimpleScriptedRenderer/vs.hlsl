@@ -2,11 +2,13 @@ struct vs_in
 {
   float3 position : POSITION;
   float3 normal : NORMAL;
+  float4 color : COLOR;
 };
 
 struct vs_out
 {
   float3 world_normal : WORLD_NORMAL;
+  float3 color : COLOR;
   float4 screen_position : SV_Position;
 };
 
@@ -21,12 +23,12 @@ struct scene_constants
   float _pad2;
 };
 
+// Rows of a 3x4 affine matrix, translation in w.
 struct object_constants
 {
-  float4x4 local_to_world;
-  float4x4 world_to_local_transposed;
-  float3 object_color;
-  float _pad0;
+  float4 local_to_world[3];
+  uint object_color;
+  uint3 _pad0;
 };
 
 cbuffer scene_constants : register(b0)
@@ -39,9 +41,29 @@ cbuffer object_constants : register(b1)
   object_constants ob;
 };
 
+// Normal matrix is inverse transpose of the linear part. Its columns are cross products
+// of columns of the matrix divided by determinant, only the sign of which matters after normalization.
+float3 transform_normal(float4 m[3], float3 n)
+{
+  float3 a = float3(m[0].x, m[1].x, m[2].x);
+  float3 b = float3(m[0].y, m[1].y, m[2].y);
+  float3 c = float3(m[0].z, m[1].z, m[2].z);
+  float3 bc = cross(b, c);
+  float3 ret = n.x * bc + n.y * cross(c, a) + n.z * cross(a, b);
+  return dot(a, bc) < 0.0 ? -ret : ret;
+}
+
+float3 unpack_color(uint c)
+{
+  return float3(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF) / 255.0;
+}
+
 void main(in vs_in input, out vs_out output)
 {
-  output.world_normal = mul(ob.world_to_local_transposed, float4(input.normal, 0.0)).xyz;
-  output.world_normal = normalize(output.world_normal);
-  output.screen_position = mul(sc.world_to_screen, mul(ob.local_to_world, float4(input.position, 1.0)));
+  float4 position = float4(input.position, 1.0);
+  float3 world_position = float3(dot(ob.local_to_world[0], position), dot(ob.local_to_world[1], position),
+                                 dot(ob.local_to_world[2], position));
+  output.world_normal = normalize(transform_normal(ob.local_to_world, input.normal));
+  output.color = unpack_color(ob.object_color) * input.color.rgb;
+  output.screen_position = mul(sc.world_to_screen, float4(world_position, 1.0));
 }
@@ -1,393 +0,0 @@
-#if 0
-//
-// Generated by Microsoft (R) HLSL Shader Compiler 10.1
-//
-//
-// Buffer Definitions: 
-//
-// cbuffer scene_constants
-// {
-//
-//   struct scene_constants
-//   {
-//       
-//       float4x4 world_to_screen;      // Offset:    0
-//       float3 light_dir;              // Offset:   64
-//       float _pad0;                   // Offset:   76
-//       float3 light_color;            // Offset:   80
-//       float _pad1;                   // Offset:   92
-//       float3 ambient_color;          // Offset:   96
-//       float _pad2;                   // Offset:  108
-//
-//   } sc;                              // Offset:    0 Size:   112
-//
-// }
-//
-// cbuffer object_constants
-// {
-//
-//   struct object_constants
-//   {
-//       
-//       float4x4 local_to_world;       // Offset:    0
-//       float4x4 world_to_local_transposed;// Offset:   64
-//       float3 object_color;           // Offset:  128
-//       float _pad0;                   // Offset:  140
-//
-//   } ob;                              // Offset:    0 Size:   144
-//
-// }
-//
-//
-// Resource Bindings:
-//
-// Name                                 Type  Format         Dim      HLSL Bind  Count
-// ------------------------------ ---------- ------- ----------- -------------- ------
-// scene_constants                   cbuffer      NA          NA            cb0      1 
-// object_constants                  cbuffer      NA          NA            cb1      1 
-//
-//
-//
-// Input signature:
-//
-// Name                 Index   Mask Register SysValue  Format   Used
-// -------------------- ----- ------ -------- -------- ------- ------
-// POSITION                 0   xyz         0     NONE   float   xyz 
-// NORMAL                   0   xyz         1     NONE   float   xyz 
-//
-//
-// Output signature:
-//
-// Name                 Index   Mask Register SysValue  Format   Used
-// -------------------- ----- ------ -------- -------- ------- ------
-// WORLD_NORMAL             0   xyz         0     NONE   float   xyz 
-// SV_Position              0   xyzw        1      POS   float   xyzw
-//
-vs_5_0
-dcl_globalFlags refactoringAllowed
-dcl_constantbuffer CB0[4], immediateIndexed
-dcl_constantbuffer CB1[7], immediateIndexed
-dcl_input v0.xyz
-dcl_input v1.xyz
-dcl_output o0.xyz
-dcl_output_siv o1.xyzw, position
-dcl_temps 2
-mul r0.xyz, v1.yyyy, cb1[5].xyzx
-mad r0.xyz, cb1[4].xyzx, v1.xxxx, r0.xyzx
-mad r0.xyz, cb1[6].xyzx, v1.zzzz, r0.xyzx
-dp3 r0.w, r0.xyzx, r0.xyzx
-rsq r0.w, r0.w
-mul o0.xyz, r0.wwww, r0.xyzx
-mul r0.xyzw, v0.yyyy, cb1[1].xyzw
-mad r0.xyzw, cb1[0].xyzw, v0.xxxx, r0.xyzw
-mad r0.xyzw, cb1[2].xyzw, v0.zzzz, r0.xyzw
-add r0.xyzw, r0.xyzw, cb1[3].xyzw
-mul r1.xyzw, r0.yyyy, cb0[1].xyzw
-mad r1.xyzw, cb0[0].xyzw, r0.xxxx, r1.xyzw
-mad r1.xyzw, cb0[2].xyzw, r0.zzzz, r1.xyzw
-mad o1.xyzw, cb0[3].xyzw, r0.wwww, r1.xyzw
-ret 
-// Approximately 15 instruction slots used
-#endif
-
-const BYTE vs_bytecode[] =
-{
-     68,  88,  66,  67,  52,  67, 
-    232, 169,  56,  46, 189,  80, 
-    182, 192,  22, 242,  11, 206, 
-    117, 190,   1,   0,   0,   0, 
-    252,   6,   0,   0,   5,   0, 
-      0,   0,  52,   0,   0,   0, 
-     92,   3,   0,   0, 172,   3, 
-      0,   0,   8,   4,   0,   0, 
-     96,   6,   0,   0,  82,  68, 
-     69,  70,  32,   3,   0,   0, 
-      2,   0,   0,   0, 160,   0, 
-      0,   0,   2,   0,   0,   0, 
-     60,   0,   0,   0,   0,   5, 
-    254, 255,   0,   1,   0,   0, 
-    248,   2,   0,   0,  82,  68, 
-     49,  49,  60,   0,   0,   0, 
-     24,   0,   0,   0,  32,   0, 
-      0,   0,  40,   0,   0,   0, 
-     36,   0,   0,   0,  12,   0, 
-      0,   0,   0,   0,   0,   0, 
-    124,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      1,   0,   0,   0,   1,   0, 
-      0,   0, 140,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   1,   0, 
-      0,   0,   1,   0,   0,   0, 
-      1,   0,   0,   0, 115,  99, 
-    101, 110, 101,  95,  99, 111, 
-    110, 115, 116,  97, 110, 116, 
-    115,   0, 111,  98, 106, 101, 
-     99, 116,  95,  99, 111, 110, 
-    115, 116,  97, 110, 116, 115, 
-      0, 171, 171, 171, 124,   0, 
-      0,   0,   1,   0,   0,   0, 
-    208,   0,   0,   0, 112,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0, 140,   0, 
-      0,   0,   1,   0,   0,   0, 
-     64,   2,   0,   0, 144,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0, 248,   0, 
-      0,   0,   0,   0,   0,   0, 
-    112,   0,   0,   0,   2,   0, 
-      0,   0,  28,   2,   0,   0, 
-      0,   0,   0,   0, 255, 255, 
-    255, 255,   0,   0,   0,   0, 
-    255, 255, 255, 255,   0,   0, 
-      0,   0, 115,  99,   0, 119, 
-    111, 114, 108, 100,  95, 116, 
-    111,  95, 115,  99, 114, 101, 
-    101, 110,   0, 102, 108, 111, 
-     97, 116,  52, 120,  52,   0, 
-      3,   0,   3,   0,   4,   0, 
-      4,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,  11,   1,   0,   0, 
-    108, 105, 103, 104, 116,  95, 
-    100, 105, 114,   0, 102, 108, 
-    111,  97, 116,  51,   0, 171, 
-    171, 171,   1,   0,   3,   0, 
-      1,   0,   3,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,  66,   1, 
-      0,   0,  95, 112,  97, 100, 
-     48,   0, 102, 108, 111,  97, 
-    116,   0,   0,   0,   3,   0, 
-      1,   0,   1,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0, 118,   1, 
-      0,   0, 108, 105, 103, 104, 
-    116,  95,  99, 111, 108, 111, 
-    114,   0,  95, 112,  97, 100, 
-     49,   0,  97, 109,  98, 105, 
-    101, 110, 116,  95,  99, 111, 
-    108, 111, 114,   0,  95, 112, 
-     97, 100,  50,   0, 171, 171, 
-    251,   0,   0,   0,  20,   1, 
-      0,   0,   0,   0,   0,   0, 
-     56,   1,   0,   0,  76,   1, 
-      0,   0,  64,   0,   0,   0, 
-    112,   1,   0,   0, 124,   1, 
-      0,   0,  76,   0,   0,   0, 
-    160,   1,   0,   0,  76,   1, 
-      0,   0,  80,   0,   0,   0, 
-    172,   1,   0,   0, 124,   1, 
-      0,   0,  92,   0,   0,   0, 
-    178,   1,   0,   0,  76,   1, 
-      0,   0,  96,   0,   0,   0, 
-    192,   1,   0,   0, 124,   1, 
-      0,   0, 108,   0,   0,   0, 
-      5,   0,   0,   0,   1,   0, 
-     28,   0,   0,   0,   7,   0, 
-    200,   1,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0, 124,   0,   0,   0, 
-    104,   2,   0,   0,   0,   0, 
-      0,   0, 144,   0,   0,   0, 
-      2,   0,   0,   0, 212,   2, 
-      0,   0,   0,   0,   0,   0, 
-    255, 255, 255, 255,   0,   0, 
-      0,   0, 255, 255, 255, 255, 
-      0,   0,   0,   0, 111,  98, 
-      0, 108, 111,  99,  97, 108, 
-     95, 116, 111,  95, 119, 111, 
-    114, 108, 100,   0, 119, 111, 
-    114, 108, 100,  95, 116, 111, 
-     95, 108, 111,  99,  97, 108, 
-     95, 116, 114,  97, 110, 115, 
-    112, 111, 115, 101, 100,   0, 
-    111,  98, 106, 101,  99, 116, 
-     95,  99, 111, 108, 111, 114, 
-      0, 171, 171, 171, 107,   2, 
-      0,   0,  20,   1,   0,   0, 
-      0,   0,   0,   0, 122,   2, 
-      0,   0,  20,   1,   0,   0, 
-     64,   0,   0,   0, 148,   2, 
-      0,   0,  76,   1,   0,   0, 
-    128,   0,   0,   0, 112,   1, 
-      0,   0, 124,   1,   0,   0, 
-    140,   0,   0,   0,   5,   0, 
-      0,   0,   1,   0,  36,   0, 
-      0,   0,   4,   0, 164,   2, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-    140,   0,   0,   0,  77, 105, 
-     99, 114, 111, 115, 111, 102, 
-    116,  32,  40,  82,  41,  32, 
-     72,  76,  83,  76,  32,  83, 
-    104,  97, 100, 101, 114,  32, 
-     67, 111, 109, 112, 105, 108, 
-    101, 114,  32,  49,  48,  46, 
-     49,   0,  73,  83,  71,  78, 
-     72,   0,   0,   0,   2,   0, 
-      0,   0,   8,   0,   0,   0, 
-     56,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      3,   0,   0,   0,   0,   0, 
-      0,   0,   7,   7,   0,   0, 
-     65,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      3,   0,   0,   0,   1,   0, 
-      0,   0,   7,   7,   0,   0, 
-     80,  79,  83,  73,  84,  73, 
-     79,  78,   0,  78,  79,  82, 
-     77,  65,  76,   0,  79,  83, 
-     71,  78,  84,   0,   0,   0, 
-      2,   0,   0,   0,   8,   0, 
-      0,   0,  56,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   3,   0,   0,   0, 
-      0,   0,   0,   0,   7,   8, 
-      0,   0,  69,   0,   0,   0, 
-      0,   0,   0,   0,   1,   0, 
-      0,   0,   3,   0,   0,   0, 
-      1,   0,   0,   0,  15,   0, 
-      0,   0,  87,  79,  82,  76, 
-     68,  95,  78,  79,  82,  77, 
-     65,  76,   0,  83,  86,  95, 
-     80, 111, 115, 105, 116, 105, 
-    111, 110,   0, 171, 171, 171, 
-     83,  72,  69,  88,  80,   2, 
-      0,   0,  80,   0,   1,   0, 
-    148,   0,   0,   0, 106,   8, 
-      0,   1,  89,   0,   0,   4, 
-     70, 142,  32,   0,   0,   0, 
-      0,   0,   4,   0,   0,   0, 
-     89,   0,   0,   4,  70, 142, 
-     32,   0,   1,   0,   0,   0, 
-      7,   0,   0,   0,  95,   0, 
-      0,   3, 114,  16,  16,   0, 
-      0,   0,   0,   0,  95,   0, 
-      0,   3, 114,  16,  16,   0, 
-      1,   0,   0,   0, 101,   0, 
-      0,   3, 114,  32,  16,   0, 
-      0,   0,   0,   0, 103,   0, 
-      0,   4, 242,  32,  16,   0, 
-      1,   0,   0,   0,   1,   0, 
-      0,   0, 104,   0,   0,   2, 
-      2,   0,   0,   0,  56,   0, 
-      0,   8, 114,   0,  16,   0, 
-      0,   0,   0,   0,  86,  21, 
-     16,   0,   1,   0,   0,   0, 
-     70, 130,  32,   0,   1,   0, 
-      0,   0,   5,   0,   0,   0, 
-     50,   0,   0,  10, 114,   0, 
-     16,   0,   0,   0,   0,   0, 
-     70, 130,  32,   0,   1,   0, 
-      0,   0,   4,   0,   0,   0, 
-      6,  16,  16,   0,   1,   0, 
-      0,   0,  70,   2,  16,   0, 
-      0,   0,   0,   0,  50,   0, 
-      0,  10, 114,   0,  16,   0, 
-      0,   0,   0,   0,  70, 130, 
-     32,   0,   1,   0,   0,   0, 
-      6,   0,   0,   0, 166,  26, 
-     16,   0,   1,   0,   0,   0, 
-     70,   2,  16,   0,   0,   0, 
-      0,   0,  16,   0,   0,   7, 
-    130,   0,  16,   0,   0,   0, 
-      0,   0,  70,   2,  16,   0, 
-      0,   0,   0,   0,  70,   2, 
-     16,   0,   0,   0,   0,   0, 
-     68,   0,   0,   5, 130,   0, 
-     16,   0,   0,   0,   0,   0, 
-     58,   0,  16,   0,   0,   0, 
-      0,   0,  56,   0,   0,   7, 
-    114,  32,  16,   0,   0,   0, 
-      0,   0, 246,  15,  16,   0, 
-      0,   0,   0,   0,  70,   2, 
-     16,   0,   0,   0,   0,   0, 
-     56,   0,   0,   8, 242,   0, 
-     16,   0,   0,   0,   0,   0, 
-     86,  21,  16,   0,   0,   0, 
-      0,   0,  70, 142,  32,   0, 
-      1,   0,   0,   0,   1,   0, 
-      0,   0,  50,   0,   0,  10, 
-    242,   0,  16,   0,   0,   0, 
-      0,   0,  70, 142,  32,   0, 
-      1,   0,   0,   0,   0,   0, 
-      0,   0,   6,  16,  16,   0, 
-      0,   0,   0,   0,  70,  14, 
-     16,   0,   0,   0,   0,   0, 
-     50,   0,   0,  10, 242,   0, 
-     16,   0,   0,   0,   0,   0, 
-     70, 142,  32,   0,   1,   0, 
-      0,   0,   2,   0,   0,   0, 
-    166,  26,  16,   0,   0,   0, 
-      0,   0,  70,  14,  16,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   8, 242,   0,  16,   0, 
-      0,   0,   0,   0,  70,  14, 
-     16,   0,   0,   0,   0,   0, 
-     70, 142,  32,   0,   1,   0, 
-      0,   0,   3,   0,   0,   0, 
-     56,   0,   0,   8, 242,   0, 
-     16,   0,   1,   0,   0,   0, 
-     86,   5,  16,   0,   0,   0, 
-      0,   0,  70, 142,  32,   0, 
-      0,   0,   0,   0,   1,   0, 
-      0,   0,  50,   0,   0,  10, 
-    242,   0,  16,   0,   1,   0, 
-      0,   0,  70, 142,  32,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   6,   0,  16,   0, 
-      0,   0,   0,   0,  70,  14, 
-     16,   0,   1,   0,   0,   0, 
-     50,   0,   0,  10, 242,   0, 
-     16,   0,   1,   0,   0,   0, 
-     70, 142,  32,   0,   0,   0, 
-      0,   0,   2,   0,   0,   0, 
-    166,  10,  16,   0,   0,   0, 
-      0,   0,  70,  14,  16,   0, 
-      1,   0,   0,   0,  50,   0, 
-      0,  10, 242,  32,  16,   0, 
-      1,   0,   0,   0,  70, 142, 
-     32,   0,   0,   0,   0,   0, 
-      3,   0,   0,   0, 246,  15, 
-     16,   0,   0,   0,   0,   0, 
-     70,  14,  16,   0,   1,   0, 
-      0,   0,  62,   0,   0,   1, 
-     83,  84,  65,  84, 148,   0, 
-      0,   0,  15,   0,   0,   0, 
-      2,   0,   0,   0,   0,   0, 
-      0,   0,   4,   0,   0,   0, 
-     14,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      1,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0, 
-      0,   0,   0,   0,   0,   0
-};
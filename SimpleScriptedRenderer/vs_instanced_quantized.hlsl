@@ -0,0 +1,77 @@
+// Quantized vertex, same as in vs_quantized.hlsl.
+struct vs_in
+{
+  float2 position_xy : POSITION0;
+  float position_z : POSITION1;
+  float2 normal : NORMAL;
+  float4 color : COLOR;
+  // Per-instance data, same layout as object constants.
+  float4 local_to_world[3] : LOCAL_TO_WORLD;
+  float4 object_color : OBJECT_COLOR;
+};
+
+struct vs_out
+{
+  float3 world_normal : WORLD_NORMAL;
+  float3 color : COLOR;
+  float4 screen_position : SV_Position;
+};
+
+// Dequantization of positions of the current mesh.
+struct mesh_constants
+{
+  float3 position_min;
+  float _pad0;
+  float3 position_scale;
+  float _pad1;
+};
+
+struct scene_constants
+{
+  float4x4 world_to_screen;
+  float3 light_dir;
+  float _pad0;
+  float3 light_color;
+  float _pad1;
+  float3 ambient_color;
+  float _pad2;
+};
+
+cbuffer scene_constants : register(b0)
+{
+  scene_constants sc;
+};
+
+cbuffer mesh_constants : register(b2)
+{
+  mesh_constants mc;
+};
+
+// Same as in vs.hlsl, rows of a 3x4 affine matrix.
+float3 transform_normal(float4 m[3], float3 n)
+{
+  float3 a = float3(m[0].x, m[1].x, m[2].x);
+  float3 b = float3(m[0].y, m[1].y, m[2].y);
+  float3 c = float3(m[0].z, m[1].z, m[2].z);
+  float3 bc = cross(b, c);
+  float3 ret = n.x * bc + n.y * cross(c, a) + n.z * cross(a, b);
+  return dot(a, bc) < 0.0 ? -ret : ret;
+}
+
+float3 octahedral_decode(float2 e)
+{
+  float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += n.xy >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+void main(in vs_in input, out vs_out output)
+{
+  float4 position = float4(mc.position_min + mc.position_scale * float3(input.position_xy, input.position_z), 1.0);
+  float3 world_position = float3(dot(input.local_to_world[0], position), dot(input.local_to_world[1], position),
+                                 dot(input.local_to_world[2], position));
+  output.world_normal = normalize(transform_normal(input.local_to_world, octahedral_decode(input.normal)));
+  output.color = input.object_color.rgb * input.color.rgb;
+  output.screen_position = mul(sc.world_to_screen, float4(world_position, 1.0));
+}